@@ -35,6 +35,7 @@ extern "C" {
 #define BLUR_CAP_COLOR_CONTROL         0x0008  /* Color tint control supported */
 #define BLUR_CAP_ANIMATION_CONTROL     0x0010  /* Animation control supported */
 #define BLUR_CAP_D2D_BLUR              0x0020  /* Direct2D Gaussian Blur supported */
+#define BLUR_CAP_CALIBRATED            0x0040  /* A calibration model drives BLUR_ALGORITHM_AUTO */
 
 
 /* ============================================================================
@@ -50,6 +51,32 @@ extern "C" {
 #define BLUR_INTERNAL_ERROR     7   /* Internal error occurred */
 #define BLUR_INVALID_PARAMS     8   /* Invalid parameters provided */
 #define BLUR_ALREADY_APPLIED    9   /* Blur already applied to window */
+#define BLUR_ERROR_CODE_COUNT   10  /* Codes counted by blur_get_error_count */
+
+/* ============================================================================
+ * Statistics Counters (read with blur_get_stat)
+ * ============================================================================ */
+#define BLUR_STAT_FRAMES_RENDERED      0   /* Refresh frames captured, blurred and presented */
+#define BLUR_STAT_FRAMES_CULLED        1   /* Frames skipped: minimized, cloaked, off-screen or covered */
+#define BLUR_STAT_FRAMES_PARTIAL       2   /* Frames shrunk to a partly covered window's visible area */
+#define BLUR_STAT_PIXELS_BLURRED       3   /* Window pixels blurred */
+#define BLUR_STAT_PIXELS_CULLED        4   /* Window pixels skipped by visibility culling */
+#define BLUR_STAT_PIXELS_CAPTURED      5   /* Screen pixels copied by refresh ticks */
+#define BLUR_STAT_PIXELS_CAPTURE_SAVED 6   /* Requested capture pixels served by another window's capture */
+#define BLUR_STAT_PIXELS_BLUR_SAVED    7   /* Output pixels served by another window's blur */
+#define BLUR_STAT_ARENA_HIGH_WATER     8   /* Largest scratch arena footprint of any thread, in bytes (a maximum) */
+#define BLUR_STAT_ARENA_BLOCK_ALLOCS   9   /* Heap allocations made by scratch arenas; flat once frames are steady */
+#define BLUR_STAT_PIXELS_REUSED        10  /* Output pixels of moving windows copied from the previous tick */
+#define BLUR_STAT_QUALITY_STEPS_DOWN   11  /* Frames that stepped a window down its quality ladder to meet a deadline */
+#define BLUR_STAT_QUALITY_STEPS_UP     12  /* Frames that stepped a window back up once it had headroom */
+#define BLUR_STAT_QUALITY_DRAG_STEPS   13  /* Drags that started by stepping the window down */
+#define BLUR_STAT_FRAMES_DEGRADED      14  /* Frames rendered below the requested quality */
+#define BLUR_STAT_FRAMES_REPEATED      15  /* Frames that presented the window's last frame again */
+#define BLUR_STAT_DEADLINE_MISSES      16  /* Rendered frames that took longer than their deadline allowed */
+#define BLUR_STAT_MEMORY_BYTES         17  /* Bytes of window surfaces and backdrop caches held now (a gauge) */
+#define BLUR_STAT_MEMORY_PEAK          18  /* Most bytes of window surfaces and backdrop caches held at once (a maximum) */
+#define BLUR_STAT_MEMORY_EVICTIONS     19  /* Windows whose buffers were freed to fit the memory budget */
+#define BLUR_STAT_COUNT                20
 
 /* ============================================================================
  * EffectParams Structure (Version 1)
@@ -61,13 +88,233 @@ typedef struct EffectParams_V1 {
     uint32_t color_argb;          /* 0xAARRGGBB (0 = no override) */
     uint8_t  animate;             /* 0 = no animation, 1 = animate */
     uint32_t animation_ms;        /* Animation duration in milliseconds */
-    uint32_t reserved_flags;      /* Reserved for future use */
+    uint32_t reserved_flags;      /* BLUR_PARAMS_FLAG_* bits (0 = defaults) */
     uint8_t  reserved_padding[4]; /* Alignment padding */
 } EffectParams_V1;
 #pragma pack(pop)
 
 typedef EffectParams_V1 EffectParams;
 
+/* ============================================================================
+ * EffectParams Structure (Version 2)
+ *
+ * Starts with the Version 1 fields at the same offsets, so a V2 struct is
+ * passed to blur_apply_to_window() as (const EffectParams*)&params. Zero in
+ * any V2 field selects the Version 1 behaviour.
+ * ============================================================================ */
+#pragma pack(push, 1)
+typedef struct EffectParams_V2 {
+    uint32_t struct_version;      /* Must be 2 */
+    float    intensity;           /* 0.0 to 1.0 */
+    uint32_t color_argb;          /* 0xAARRGGBB (0 = no override) */
+    uint8_t  animate;             /* 0 = no animation, 1 = animate */
+    uint32_t animation_ms;        /* Animation duration in milliseconds */
+    uint32_t reserved_flags;      /* BLUR_PARAMS_FLAG_* bits (0 = defaults) */
+    uint8_t  reserved_padding[4]; /* Alignment padding */
+    uint32_t algorithm;           /* BLUR_ALGORITHM_* */
+    uint32_t downsample;          /* Blur at 1/N resolution: 0 or 1 = full, up to BLUR_MAX_DOWNSAMPLE */
+    uint32_t max_refresh_hz;      /* Refresh rate cap (0 = 10 Hz, up to BLUR_MAX_REFRESH_HZ) */
+    uint32_t worker_threads;      /* CPU worker threads for this window (0 = library default) */
+    uint32_t frame_budget_us;     /* Per-frame time budget in microseconds (0 = the refresh interval) */
+    uint8_t  reserved_v2[12];     /* Must be zero */
+} EffectParams_V2;
+#pragma pack(pop)
+
+/* EffectParams_V2 algorithm values */
+#define BLUR_ALGORITHM_EXACT    0   /* Separable Gaussian, D2D where available */
+#define BLUR_ALGORITHM_BOX      1   /* Three box passes approximating the Gaussian */
+#define BLUR_ALGORITHM_PYRAMID  2   /* Repeated 2x reduction, small Gaussian, 2x expansion */
+#define BLUR_ALGORITHM_IIR      3   /* Recursive Gaussian: exact-looking at the same cost for any intensity */
+#define BLUR_ALGORITHM_AUTO     4   /* Cheapest per the startup calibration (exact without one) */
+
+#define BLUR_MAX_DOWNSAMPLE     8
+#define BLUR_MAX_REFRESH_HZ     240
+#define BLUR_MAX_WORKER_THREADS 64
+#define BLUR_MAX_CPU_BUDGET     (1000 * BLUR_MAX_WORKER_THREADS)   /* blur_set_cpu_budget, per mille of one core */
+
+/* EffectParams reserved_flags bits */
+#define BLUR_PARAMS_FLAG_STREAMING  0x00000001  /* Force bounded-memory streaming blur */
+#define BLUR_PARAMS_FLAG_REGIONS    0x00000002  /* A BlurRegionList follows the params */
+#define BLUR_PARAMS_FLAG_LINEAR_LIGHT 0x00000004  /* Blur in linear light (exact and IIR kernels, CPU path) */
+#define BLUR_PARAMS_FLAG_EFFECTS    0x00000008  /* A BlurEffectList follows the params (and region list) */
+
+/* ============================================================================
+ * Blur Regions Extension (Version 1)
+ *
+ * Restricts the blur to a list of window-relative rectangles. To use it, fill
+ * an EffectParamsRegions_V1 (or V2), set BLUR_PARAMS_FLAG_REGIONS in
+ * params.reserved_flags and pass &ext.params to blur_apply_to_window().
+ * The list directly follows the params struct of either version.
+ * ============================================================================ */
+#define BLUR_MAX_REGIONS 16
+
+#pragma pack(push, 1)
+typedef struct BlurRect {
+    int32_t  left;                /* Window-relative, inclusive */
+    int32_t  top;
+    int32_t  right;               /* Exclusive */
+    int32_t  bottom;
+    uint32_t corner_radius;       /* 0 = square corners */
+} BlurRect;
+
+typedef struct BlurRegionList_V1 {
+    uint32_t struct_version;      /* Must be 1 */
+    uint32_t rect_count;          /* 0 to BLUR_MAX_REGIONS (0 = whole window) */
+    BlurRect rects[BLUR_MAX_REGIONS];
+} BlurRegionList_V1;
+
+typedef struct EffectParamsRegions_V1 {
+    EffectParams_V1   params;     /* reserved_flags must include BLUR_PARAMS_FLAG_REGIONS */
+    BlurRegionList_V1 regions;
+} EffectParamsRegions_V1;
+
+typedef struct EffectParamsRegions_V2 {
+    EffectParams_V2   params;     /* reserved_flags must include BLUR_PARAMS_FLAG_REGIONS */
+    BlurRegionList_V1 regions;
+} EffectParamsRegions_V2;
+#pragma pack(pop)
+
+/* ============================================================================
+ * Effect Graph Extension (Version 1)
+ *
+ * Replaces the color_argb tint with a chain of point-wise nodes run in order
+ * on the blurred pixels, e.g. saturation, a luminosity blend, a tint and
+ * noise for an acrylic material. Set BLUR_PARAMS_FLAG_EFFECTS and place a
+ * BlurEffectList_V1 directly after the params struct, or after the region
+ * list when BLUR_PARAMS_FLAG_REGIONS is set as well. The library compiles the
+ * chain into a single pass over the pixels, folded into the blur's last pass
+ * where the blur is not cached. Windows with effects blur on the CPU.
+ * ============================================================================ */
+#define BLUR_MAX_EFFECTS 8
+
+/* BlurEffect types */
+#define BLUR_EFFECT_SATURATION  1   /* amount: 0 = grey, 1 = unchanged, up to 4 */
+#define BLUR_EFFECT_LUMINOSITY  2   /* Luminosity blend: color's luminosity, the backdrop's hue and saturation */
+#define BLUR_EFFECT_EXCLUSION   3   /* Exclusion blend with color */
+#define BLUR_EFFECT_TINT        4   /* Source-over fill with color */
+#define BLUR_EFFECT_NOISE       5   /* Grain fixed to the window; amount 0.0 to 1.0 */
+#define BLUR_EFFECT_VIGNETTE    6   /* Darkens toward the corners; amount 0.0 to 1.0 */
+
+#pragma pack(push, 1)
+typedef struct BlurEffect {
+    uint32_t type;                /* BLUR_EFFECT_* */
+    uint32_t color_argb;          /* Blend and tint color; its alpha is the node's opacity */
+    float    amount;              /* Saturation, noise and vignette strength */
+    uint32_t reserved;            /* Must be zero */
+} BlurEffect;
+
+typedef struct BlurEffectList_V1 {
+    uint32_t   struct_version;    /* Must be 1 */
+    uint32_t   effect_count;      /* 0 to BLUR_MAX_EFFECTS (0 = no tint) */
+    BlurEffect effects[BLUR_MAX_EFFECTS];
+} BlurEffectList_V1;
+
+typedef struct EffectParamsEffects_V1 {
+    EffectParams_V1   params;     /* reserved_flags must include BLUR_PARAMS_FLAG_EFFECTS */
+    BlurEffectList_V1 effects;
+} EffectParamsEffects_V1;
+
+typedef struct EffectParamsEffects_V2 {
+    EffectParams_V2   params;     /* reserved_flags must include BLUR_PARAMS_FLAG_EFFECTS */
+    BlurEffectList_V1 effects;
+} EffectParamsEffects_V2;
+#pragma pack(pop)
+
+/* ============================================================================
+ * Init Options (Version 1, for blur_init_ex)
+ * ============================================================================ */
+#define BLUR_INIT_CALIBRATE     0x00000001  /* Measure the CPU algorithms at startup */
+#define BLUR_INIT_HUGE_PAGES    0x00000002  /* Back large scratch arenas with huge pages where supported */
+#define BLUR_INIT_WARMUP        0x00000004  /* Create devices, surfaces and kernels on a background thread */
+
+#pragma pack(push, 1)
+typedef struct BlurInitOptions_V1 {
+    uint32_t    struct_version;         /* Must be 1 */
+    uint32_t    flags;                  /* BLUR_INIT_* bits */
+    const char* calibration_cache_utf8; /* Calibration cache file (NULL = always measure) */
+} BlurInitOptions_V1;
+#pragma pack(pop)
+
+typedef BlurInitOptions_V1 BlurInitOptions;
+
+/* ============================================================================
+ * Init Options (Version 2)
+ *
+ * Starts with the Version 1 fields at the same offsets, so a V2 struct is
+ * passed to blur_init_ex() as (const BlurInitOptions*)&options.
+ * ============================================================================ */
+#pragma pack(push, 1)
+typedef struct BlurInitOptions_V2 {
+    uint32_t    struct_version;         /* Must be 2 */
+    uint32_t    flags;                  /* BLUR_INIT_* bits */
+    const char* calibration_cache_utf8; /* Calibration cache file (NULL = always measure) */
+    uint32_t    worker_threads;         /* Shared CPU blur workers, up to BLUR_MAX_WORKER_THREADS (0 = one per core, less one) */
+    uint8_t     reserved_v2[12];        /* Must be zero */
+} BlurInitOptions_V2;
+#pragma pack(pop)
+
+/* ============================================================================
+ * Init Phases (microseconds each, read with blur_get_init_timing)
+ * ============================================================================ */
+#define BLUR_INIT_PHASE_DETECT          0   /* Capability detection in blur_init */
+#define BLUR_INIT_PHASE_CALIBRATION     1   /* BLUR_INIT_CALIBRATE, cached or measured */
+#define BLUR_INIT_PHASE_D2D_FACTORY     2   /* Direct2D factory */
+#define BLUR_INIT_PHASE_D3D_DEVICE      3   /* D3D11CreateDevice */
+#define BLUR_INIT_PHASE_D2D_CONTEXT     4   /* Direct2D device and device context */
+#define BLUR_INIT_PHASE_SURFACE_POOL    5   /* Capture and window surfaces sized for the primary monitor */
+#define BLUR_INIT_PHASE_KERNEL_TABLES   6   /* Kernels for common intensities */
+#define BLUR_INIT_PHASE_WARMUP_TOTAL    7   /* Whole background warm-up */
+#define BLUR_INIT_PHASE_APPLY_WAIT      8   /* How long the first apply waited for warm-up (0 = not at all) */
+#define BLUR_INIT_PHASE_FIRST_APPLY     9   /* First blur_apply_to_window call, end to end */
+#define BLUR_INIT_PHASE_COUNT           10
+
+/* ============================================================================
+ * Tick Recording Flags (blur_record_start)
+ * ============================================================================ */
+#define BLUR_RECORD_DELTA       0x00000001  /* Store frames as zero-run deltas against the previous tick's */
+
+/* ============================================================================
+ * Tracked Window Snapshots (blur_get_window_snapshot / blur_get_window_changes)
+ * ============================================================================ */
+#define BLUR_BACKEND_NONE           0
+#define BLUR_BACKEND_D2D            1   /* Layered window refreshed by the library */
+#define BLUR_BACKEND_COMPOSITION    2   /* SetWindowCompositionAttribute */
+#define BLUR_BACKEND_DWM            3   /* DWM blur-behind */
+
+/* Table size: arrays of this many entries always suffice for snapshots and changes */
+#define BLUR_MAX_TRACKED_WINDOWS    512
+
+#define BLUR_CHANGE_ADDED           1
+#define BLUR_CHANGE_UPDATED         2   /* Parameters or backend changed */
+#define BLUR_CHANGE_REMOVED         3
+
+/* blur_get_window_changes out_flags: removals were forgotten, the result is a full list */
+#define BLUR_CHANGES_RESYNC         0x00000001
+
+#pragma pack(push, 1)
+typedef struct BlurWindowInfo_V1 {
+    uint64_t window_handle;
+    uint32_t backend;               /* BLUR_BACKEND_* */
+    uint32_t algorithm;             /* Requested BLUR_ALGORITHM_* */
+    float    intensity;
+    uint32_t color_argb;
+    uint32_t flags;                 /* BLUR_PARAMS_FLAG_* */
+    uint32_t downsample;
+    uint32_t refresh_interval_ms;
+    uint32_t region_count;          /* 0 = whole window */
+    uint32_t last_frame_us;         /* CPU time of the last refresh (0 = none yet or not refreshed by the library) */
+    uint32_t reserved;
+    uint64_t last_frame_pixels;     /* Pixels blurred by the last refresh */
+    uint64_t epoch;                 /* Epoch of the last add or parameter change */
+} BlurWindowInfo_V1;
+
+typedef struct BlurWindowChange_V1 {
+    uint32_t kind;                  /* BLUR_CHANGE_* */
+    uint32_t reserved;
+    BlurWindowInfo_V1 info;         /* Last known state; for removals epoch is the removal */
+} BlurWindowChange_V1;
+#pragma pack(pop)
+
 /* ============================================================================
  * Log Levels
  * ============================================================================ */
@@ -92,6 +339,20 @@ typedef void (BLUR_CALL *BlurLogCallback)(int32_t level, const char* utf8_msg, v
  */
 BLUR_API int32_t BLUR_CALL blur_init(uint32_t* capabilities);
 
+/**
+ * Initialize the blur library with options.
+ * With BLUR_INIT_CALIBRATE, loads the calibration cache if it matches this
+ * machine, otherwise measures for a few milliseconds and rewrites the cache.
+ * With BLUR_INIT_WARMUP, device creation and other first-use work start on a
+ * background thread; an apply made before they finish waits for them.
+ * Starts the shared CPU blur workers; a BlurInitOptions_V2 sets their count.
+ * 
+ * @param capabilities Output pointer to receive capability bits
+ * @param options Init options (NULL behaves like blur_init)
+ * @return BLUR_SUCCESS on success, error code otherwise
+ */
+BLUR_API int32_t BLUR_CALL blur_init_ex(uint32_t* capabilities, const BlurInitOptions* options);
+
 /**
  * Shutdown the blur library and release all resources.
  * Optionally clears all applied blur effects.
@@ -102,8 +363,9 @@ BLUR_API void BLUR_CALL blur_shutdown(void);
  * Apply blur effect to a window.
  * 
  * @param window_handle HWND of the target window
- * @param params Effect parameters (NULL for defaults)
- * @param timeout_ms Maximum time to wait (0 = default SLO)
+ * @param params Effect parameters, EffectParams_V1 or EffectParams_V2 (NULL for defaults)
+ * @param timeout_ms Deadline for the first frame (0 = default SLO of 300 ms); a frame that
+ *                   would miss it is rendered at reduced quality rather than late
  * @return BLUR_SUCCESS on success, error code otherwise
  */
 BLUR_API int32_t BLUR_CALL blur_apply_to_window(
@@ -129,9 +391,13 @@ BLUR_API int32_t BLUR_CALL blur_clear_from_window(
  * ============================================================================ */
 
 /**
- * Restore all windows to their original state.
+ * Restore all windows to their original state. Windows are cleared in
+ * parallel on a few worker threads, each through the backend that blurred
+ * it; windows destroyed meanwhile are skipped. The calling thread keeps
+ * handling messages sent to its own windows while it waits.
  * 
- * @return BLUR_SUCCESS on success, error code otherwise
+ * @return BLUR_SUCCESS if every window was restored, otherwise the code of
+ *         the first window that failed
  */
 BLUR_API int32_t BLUR_CALL blur_restore_all(void);
 
@@ -144,13 +410,63 @@ BLUR_API int32_t BLUR_CALL blur_restore_all(void);
 BLUR_API int32_t BLUR_CALL blur_get_blurred_list(char** out_json_utf8);
 
 /**
- * Get the last error message.
+ * Fill a caller-provided array with every tracked window. Lock-free and
+ * allocation-free, so it is cheap enough to poll.
+ * 
+ * @param out Array of capacity entries (may be NULL when capacity is 0)
+ * @param capacity Entries available in out
+ * @param out_count Receives the number of tracked windows
+ * @param out_epoch Receives the epoch the snapshot reflects (optional)
+ * @return BLUR_SUCCESS, or BLUR_INVALID_PARAMS if capacity < *out_count
+ */
+BLUR_API int32_t BLUR_CALL blur_get_window_snapshot(BlurWindowInfo_V1* out, uint32_t capacity,
+                                                    uint32_t* out_count, uint64_t* out_epoch);
+
+/**
+ * Fill a caller-provided array with the windows added, updated or removed
+ * after since_epoch (0 for everything). Removals come first, so a window
+ * removed and re-applied in between appears as REMOVED then ADDED. Pass
+ * *out_epoch back as since_epoch next time; a change may be repeated once.
+ * Frame cost changes alone are not updates. Lock-free and allocation-free.
+ * 
+ * @param since_epoch Epoch returned by the previous call
+ * @param out Array of capacity entries (may be NULL when capacity is 0)
+ * @param capacity Entries available in out
+ * @param out_count Receives the number of changes
+ * @param out_epoch Receives the epoch to pass next time
+ * @param out_flags Receives BLUR_CHANGES_* bits (optional)
+ * @return BLUR_SUCCESS, or BLUR_INVALID_PARAMS if capacity < *out_count
+ */
+BLUR_API int32_t BLUR_CALL blur_get_window_changes(uint64_t since_epoch, BlurWindowChange_V1* out,
+                                                   uint32_t capacity, uint32_t* out_count,
+                                                   uint64_t* out_epoch, uint32_t* out_flags);
+
+/**
+ * Get the startup calibration: per-algorithm cost model, whether it came from
+ * the cache, and what BLUR_ALGORITHM_AUTO picks for typical window sizes.
+ * 
+ * @param out_json_utf8 Output pointer to receive JSON string (free with blur_free_string)
+ * @return BLUR_SUCCESS on success, error code otherwise
+ */
+BLUR_API int32_t BLUR_CALL blur_get_calibration_info(char** out_json_utf8);
+
+/**
+ * Get the last error message recorded on the calling thread. Errors on other
+ * threads never overwrite it.
  * 
  * @param out_utf8 Output pointer to receive error message (free with blur_free_string)
  * @return BLUR_SUCCESS on success, error code otherwise
  */
 BLUR_API int32_t BLUR_CALL blur_get_last_error(char** out_utf8);
 
+/**
+ * Get the code of the last error recorded on the calling thread.
+ * 
+ * @param out_code Output pointer to receive the code (BLUR_SUCCESS if none)
+ * @return BLUR_SUCCESS on success, BLUR_INVALID_PARAMS if out_code is NULL
+ */
+BLUR_API int32_t BLUR_CALL blur_get_last_error_code(int32_t* out_code);
+
 /**
  * Get the library version string.
  * 
@@ -185,6 +501,108 @@ BLUR_API void BLUR_CALL blur_set_log_level(int32_t level);
  */
 BLUR_API void BLUR_CALL blur_set_log_callback(BlurLogCallback callback, void* user_data);
 
+/* ============================================================================
+ * Tick Recording API Functions
+ * ============================================================================ */
+
+/**
+ * Start recording the inputs of every refresh tick (window rects, blur
+ * parameters and the captured backdrop) to a file, for replay with the
+ * blur_replay tool. Only windows on the Direct2D path are recorded. A
+ * recording grows by the captured pixels of every tick unless
+ * BLUR_RECORD_DELTA is set; even then, keep recordings short.
+ * 
+ * @param path_utf8 File to create (replaced if it exists)
+ * @param flags BLUR_RECORD_* flags
+ * @return BLUR_SUCCESS on success, BLUR_ALREADY_APPLIED if already recording,
+ *         error code otherwise
+ */
+BLUR_API int32_t BLUR_CALL blur_record_start(const char* path_utf8, uint32_t flags);
+
+/**
+ * Stop recording and close the file. Also done by blur_shutdown.
+ * 
+ * @return BLUR_SUCCESS, also when no recording was running
+ */
+BLUR_API int32_t BLUR_CALL blur_record_stop(void);
+
+/* ============================================================================
+ * Resource Budget API Functions
+ * ============================================================================ */
+
+/**
+ * Cap the CPU time all blurred windows spend refreshing together. The budget
+ * is split by weighted fair share, with the foreground window counting four
+ * times: windows whose share does not pay for their refresh interval refresh
+ * less often (at most every 2 seconds). The setting outlives blur_shutdown.
+ * 
+ * @param per_mille Share of one core in thousandths (50 = 5%; 0 = no limit, the default)
+ * @return BLUR_SUCCESS, or BLUR_INVALID_PARAMS above BLUR_MAX_CPU_BUDGET
+ */
+BLUR_API int32_t BLUR_CALL blur_set_cpu_budget(uint32_t per_mille);
+
+/**
+ * Get the CPU budget: its size, what the current refresh intervals spend, and
+ * per window the weight, measured refresh cost and requested and granted
+ * intervals.
+ * 
+ * @param out_json_utf8 Output pointer to receive JSON string (free with blur_free_string)
+ * @return BLUR_SUCCESS on success, error code otherwise
+ */
+BLUR_API int32_t BLUR_CALL blur_get_cpu_budget_info(char** out_json_utf8);
+
+/**
+ * Cap the memory that blurred windows' surfaces and backdrop caches hold
+ * together. Over the budget, the windows presented least recently free their
+ * buffers and allocate them again on their next refresh. Usage is reported
+ * by BLUR_STAT_MEMORY_BYTES and BLUR_STAT_MEMORY_PEAK. Background and idle
+ * windows keep their backdrop caches at half resolution with or without a
+ * budget. The setting outlives blur_shutdown.
+ * 
+ * @param bytes Budget in bytes (0 = no limit, the default)
+ * @return BLUR_SUCCESS
+ */
+BLUR_API int32_t BLUR_CALL blur_set_memory_budget(uint64_t bytes);
+
+/* ============================================================================
+ * Statistics API Functions
+ * ============================================================================ */
+
+/**
+ * Read a statistics counter.
+ * 
+ * @param stat_id Counter to read (BLUR_STAT_*)
+ * @param out_value Output pointer to receive the counter value
+ * @return BLUR_SUCCESS on success, BLUR_INVALID_PARAMS for an unknown counter
+ */
+BLUR_API int32_t BLUR_CALL blur_get_stat(uint32_t stat_id, uint64_t* out_value);
+
+/**
+ * Read how many errors with a given code the library has reported, across
+ * all threads. Lock-free; meant for monitoring.
+ * 
+ * @param code Error code (BLUR_NOT_INITIALIZED .. BLUR_ERROR_CODE_COUNT - 1)
+ * @param out_value Output pointer to receive the count
+ * @return BLUR_SUCCESS on success, BLUR_INVALID_PARAMS for an unknown code
+ */
+BLUR_API int32_t BLUR_CALL blur_get_error_count(int32_t code, uint64_t* out_value);
+
+/**
+ * Read how long an init phase took, in microseconds. Phases that ran on the
+ * warm-up thread and phases that ran inline on first use are both recorded;
+ * phases that have not run read as 0. Reset by blur_init, not blur_reset_stats.
+ * 
+ * @param phase Phase to read (BLUR_INIT_PHASE_*)
+ * @param out_us Output pointer to receive the duration
+ * @return BLUR_SUCCESS on success, BLUR_INVALID_PARAMS for an unknown phase
+ */
+BLUR_API int32_t BLUR_CALL blur_get_init_timing(uint32_t phase, uint64_t* out_us);
+
+/**
+ * Reset all statistics counters and error counts to zero.
+ */
+BLUR_API void BLUR_CALL blur_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
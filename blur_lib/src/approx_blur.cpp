@@ -0,0 +1,285 @@
+/*
+ * approx_blur.cpp - Box, pyramid and downsampled blur kernels
+ *
+ * These trade accuracy for CPU time. Each one works on a copy of the pixels a
+ * rect reads (its footprint): reduce to the working resolution, blur there
+ * and expand back bilinearly into the output rect. Downsampled IIR kernels
+ * blur the working resolution with the recursion.
+ */
+
+#include "cpu_blur.h"
+#include "scratch_arena.h"
+#include <cmath>
+#include <cstring>
+
+/* Largest number of 2x pyramid reductions */
+#define PYRAMID_MAX_LEVELS 4
+/* Pyramids stop reducing once the working sigma would drop below this */
+#define PYRAMID_MIN_SIGMA 1.5f
+
+static inline int32_t clamp_index(int32_t i, int32_t n) {
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+/* Three box widths whose successive passes best match a Gaussian of sigma */
+static void box_radii_for_sigma(float sigma, int32_t radii[3]) {
+    if (sigma <= 0.0f) {
+        radii[0] = radii[1] = radii[2] = 0;
+        return;
+    }
+    const double s2 = (double)sigma * sigma;
+    int32_t wl = (int32_t)std::floor(std::sqrt(12.0 * s2 / 3.0 + 1.0));
+    if (wl % 2 == 0) wl--;
+    const int32_t wu = wl + 2;
+    const int32_t m = (int32_t)std::lround((12.0 * s2 - 3.0 * wl * wl - 12.0 * wl - 9.0) / (-4.0 * wl - 4.0));
+    for (int32_t i = 0; i < 3; i++) radii[i] = ((i < m ? wl : wu) - 1) / 2;
+}
+
+void build_blur_kernel(float sigma, uint32_t algorithm, int32_t downsample, BlurKernel* out) {
+    build_gaussian_kernel(sigma, out);
+    out->algorithm = algorithm;
+
+    const int32_t d = downsample < 1 ? 1 : downsample;
+    int32_t levels = 0;
+    if (algorithm == BLUR_ALGORITHM_PYRAMID) {
+        while (levels < PYRAMID_MAX_LEVELS && sigma / (float)(d << (levels + 1)) >= PYRAMID_MIN_SIGMA) {
+            levels++;
+        }
+    }
+    out->levels = levels;
+    out->scale = d << levels;
+    if (algorithm == BLUR_ALGORITHM_IIR) {
+        if (sigma / (float)out->scale >= IIR_MIN_SIGMA) {
+            build_iir_coefficients(sigma / (float)out->scale, &out->iir);
+        } else {
+            out->algorithm = BLUR_ALGORITHM_EXACT;
+        }
+    }
+    if (kernel_is_direct(out)) return;
+
+    /* Reach at the working resolution, then back in full-resolution pixels */
+    out->work_sigma = sigma / (float)out->scale;
+    int32_t reach;
+    if (algorithm == BLUR_ALGORITHM_BOX) {
+        box_radii_for_sigma(out->work_sigma, out->box_radius);
+        reach = out->box_radius[0] + out->box_radius[1] + out->box_radius[2];
+        out->weights.clear();
+    } else {
+        BlurKernel work;
+        build_gaussian_kernel(out->work_sigma, &work);
+        reach = work.radius;
+        out->weights = work.weights;
+    }
+    /* Two more working pixels cover the reduction block and the bilinear expansion */
+    out->radius = out->scale == 1 ? reach : out->scale * (reach + 2);
+}
+
+/* ============================================================================
+ * Planes (all scratch comes from the calling thread's arena)
+ * ============================================================================ */
+static int32_t alloc_plane(ScratchArena& arena, int32_t w, int32_t h, BlurSurface* s) {
+    uint8_t* pixels = arena.alloc_array<uint8_t>((size_t)w * h * 4);
+    if (!pixels) return BLUR_OUT_OF_MEMORY;
+    BlurSurface p = { pixels, w, h, w * 4 };
+    *s = p;
+    return BLUR_SUCCESS;
+}
+
+/* Area average of factor x factor blocks; partial blocks at the edges average what exists */
+static int32_t reduce_plane(ScratchArena& arena, const BlurSurface* in, int32_t factor, BlurSurface* out) {
+    const int32_t ow = (in->width + factor - 1) / factor, oh = (in->height + factor - 1) / factor;
+    int32_t rc = alloc_plane(arena, ow, oh, out);
+    if (rc != BLUR_SUCCESS) return rc;
+
+    ArenaScope scope(arena);
+    uint32_t* acc = arena.alloc_array<uint32_t>((size_t)ow * 4);
+    if (!acc) return BLUR_OUT_OF_MEMORY;
+    for (int32_t oy = 0; oy < oh; oy++) {
+        const int32_t y0 = oy * factor;
+        const int32_t y1 = y0 + factor < in->height ? y0 + factor : in->height;
+        memset(acc, 0, (size_t)ow * 4 * sizeof(uint32_t));
+        for (int32_t y = y0; y < y1; y++) {
+            const uint8_t* p = in->pixels + (size_t)y * in->stride;
+            for (int32_t x = 0; x < in->width; x++, p += 4) {
+                uint32_t* a = &acc[(size_t)(x / factor) * 4];
+                a[0] += p[0]; a[1] += p[1]; a[2] += p[2]; a[3] += p[3];
+            }
+        }
+        uint8_t* o = out->pixels + (size_t)oy * out->stride;
+        for (int32_t ox = 0; ox < ow; ox++) {
+            const int32_t x0 = ox * factor;
+            const int32_t cw = (x0 + factor < in->width ? factor : in->width - x0);
+            const uint32_t count = (uint32_t)(cw * (y1 - y0));
+            for (int32_t ch = 0; ch < 4; ch++) {
+                o[ox * 4 + ch] = (uint8_t)((acc[(size_t)ox * 4 + ch] + count / 2) / count);
+            }
+        }
+    }
+    return BLUR_SUCCESS;
+}
+
+/*
+ * Bilinear expansion: out pixel (X, Y) sits at (ox + X, oy + Y) on the grid
+ * that is factor times finer than in, with block centres aligned.
+ */
+static int32_t expand_plane(ScratchArena& arena, const BlurSurface* in, int32_t factor, int32_t ox,
+                            int32_t oy, BlurSurface* out, const BlurRowHook* hook = nullptr) {
+    ArenaScope scope(arena);
+    int32_t* xi = arena.alloc_array<int32_t>(out->width);
+    int32_t* xf = arena.alloc_array<int32_t>(out->width);
+    if (!xi || !xf) return BLUR_OUT_OF_MEMORY;
+    for (int32_t x = 0; x < out->width; x++) {
+        /* Position in Q8 input pixels: (x + 0.5) / factor - 0.5 */
+        int32_t u = (((ox + x) * 2 + 1) * 256) / (2 * factor) - 128;
+        if (u < 0) u = 0;
+        xi[x] = clamp_index(u >> 8, in->width);
+        xf[x] = (u >> 8) + 1 < in->width ? (u & 255) : 0;
+    }
+    for (int32_t y = 0; y < out->height; y++) {
+        int32_t v = (((oy + y) * 2 + 1) * 256) / (2 * factor) - 128;
+        if (v < 0) v = 0;
+        const int32_t y0 = clamp_index(v >> 8, in->height);
+        const int32_t y1 = clamp_index(y0 + 1, in->height);
+        const int32_t fy = y1 != y0 ? (v & 255) : 0;
+        const uint8_t* r0 = in->pixels + (size_t)y0 * in->stride;
+        const uint8_t* r1 = in->pixels + (size_t)y1 * in->stride;
+        uint8_t* o = out->pixels + (size_t)y * out->stride;
+        for (int32_t x = 0; x < out->width; x++, o += 4) {
+            const int32_t i0 = xi[x] * 4, i1 = (xf[x] ? xi[x] + 1 : xi[x]) * 4, fx = xf[x];
+            for (int32_t ch = 0; ch < 4; ch++) {
+                int32_t top = r0[i0 + ch] * (256 - fx) + r0[i1 + ch] * fx;
+                int32_t bot = r1[i0 + ch] * (256 - fx) + r1[i1 + ch] * fx;
+                o[ch] = (uint8_t)((top * (256 - fy) + bot * fy + 32768) >> 16);
+            }
+        }
+        run_row_hook(hook, out->pixels + (size_t)y * out->stride, out->width, y);
+    }
+    return BLUR_SUCCESS;
+}
+
+/* One horizontal box pass of radius r with clamped borders */
+static void box_pass_h(const BlurSurface* in, BlurSurface* out, int32_t r) {
+    const int32_t w = in->width, n = 2 * r + 1;
+    for (int32_t y = 0; y < in->height; y++) {
+        const uint8_t* p = in->pixels + (size_t)y * in->stride;
+        uint8_t* o = out->pixels + (size_t)y * out->stride;
+        int32_t a[4] = { 0, 0, 0, 0 };
+        for (int32_t k = -r; k <= r; k++) {
+            const uint8_t* q = p + (size_t)clamp_index(k, w) * 4;
+            for (int32_t ch = 0; ch < 4; ch++) a[ch] += q[ch];
+        }
+        for (int32_t x = 0; x < w; x++) {
+            const uint8_t* add = p + (size_t)clamp_index(x + r + 1, w) * 4;
+            const uint8_t* sub = p + (size_t)clamp_index(x - r, w) * 4;
+            for (int32_t ch = 0; ch < 4; ch++) {
+                o[x * 4 + ch] = (uint8_t)((a[ch] + n / 2) / n);
+                a[ch] += add[ch] - sub[ch];
+            }
+        }
+    }
+}
+
+/* One vertical box pass of radius r, a row at a time with column accumulators */
+static void box_pass_v(const BlurSurface* in, BlurSurface* out, int32_t r, int32_t* acc) {
+    const int32_t h = in->height, n = 2 * r + 1, row = in->width * 4;
+    memset(acc, 0, (size_t)row * sizeof(int32_t));
+    for (int32_t k = -r; k <= r; k++) {
+        const uint8_t* q = in->pixels + (size_t)clamp_index(k, h) * in->stride;
+        for (int32_t i = 0; i < row; i++) acc[i] += q[i];
+    }
+    for (int32_t y = 0; y < h; y++) {
+        uint8_t* o = out->pixels + (size_t)y * out->stride;
+        const uint8_t* add = in->pixels + (size_t)clamp_index(y + r + 1, h) * in->stride;
+        const uint8_t* sub = in->pixels + (size_t)clamp_index(y - r, h) * in->stride;
+        for (int32_t i = 0; i < row; i++) {
+            o[i] = (uint8_t)((acc[i] + n / 2) / n);
+            acc[i] += add[i] - sub[i];
+        }
+    }
+}
+
+static int32_t box_blur_plane(ScratchArena& arena, BlurSurface* s, const int32_t radii[3]) {
+    ArenaScope scope(arena);
+    BlurSurface tmp;
+    int32_t rc = alloc_plane(arena, s->width, s->height, &tmp);
+    if (rc != BLUR_SUCCESS) return rc;
+    int32_t* acc = arena.alloc_array<int32_t>((size_t)s->width * 4);
+    if (!acc) return BLUR_OUT_OF_MEMORY;
+    for (int32_t i = 0; i < 3; i++) {
+        if (radii[i] == 0) continue;
+        box_pass_h(s, &tmp, radii[i]);
+        box_pass_v(&tmp, s, radii[i], acc);
+    }
+    return BLUR_SUCCESS;
+}
+
+/* ============================================================================
+ * Rect blur
+ * ============================================================================ */
+int32_t approx_blur_rect(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                         int32_t x0, int32_t y0, const BlurRowHook* hook) {
+    const int32_t w = src->width, h = src->height, R = kernel->radius, s = kernel->scale;
+    const int32_t ow = dst->width, oh = dst->height;
+    if (ow <= 0 || oh <= 0) return BLUR_SUCCESS;
+
+    /* Footprint, snapped outwards to the reduction grid of the whole surface */
+    int32_t fx0 = x0 - R > 0 ? x0 - R : 0, fy0 = y0 - R > 0 ? y0 - R : 0;
+    int32_t fx1 = x0 + ow + R < w ? x0 + ow + R : w, fy1 = y0 + oh + R < h ? y0 + oh + R : h;
+    fx0 -= fx0 % s; fy0 -= fy0 % s;
+    fx1 = (fx1 + s - 1) / s * s; fy1 = (fy1 + s - 1) / s * s;
+    if (fx1 > w) fx1 = w;
+    if (fy1 > h) fy1 = h;
+
+    BlurSurface footprint = { src->pixels + (size_t)fy0 * src->stride + (size_t)fx0 * 4,
+                              fx1 - fx0, fy1 - fy0, src->stride };
+
+    /* levels + 1 planes: the downsampled footprint, then each 2x reduction */
+    const int32_t d = s >> kernel->levels;
+    ScratchArena& arena = scratch_arena();
+    ArenaScope scope(arena);
+    BlurSurface planes[PYRAMID_MAX_LEVELS + 1];
+    int32_t rc;
+    if (d > 1) {
+        rc = reduce_plane(arena, &footprint, d, &planes[0]);
+    } else {
+        rc = alloc_plane(arena, footprint.width, footprint.height, &planes[0]);
+        for (int32_t y = 0; rc == BLUR_SUCCESS && y < footprint.height; y++) {
+            memcpy(planes[0].pixels + (size_t)y * planes[0].stride,
+                   footprint.pixels + (size_t)y * footprint.stride, (size_t)footprint.width * 4);
+        }
+    }
+    for (int32_t l = 1; rc == BLUR_SUCCESS && l <= kernel->levels; l++) {
+        rc = reduce_plane(arena, &planes[l - 1], 2, &planes[l]);
+    }
+    if (rc != BLUR_SUCCESS) return rc;
+
+    BlurSurface& top = planes[kernel->levels];
+    if (kernel->algorithm == BLUR_ALGORITHM_BOX) {
+        rc = box_blur_plane(arena, &top, kernel->box_radius);
+    } else if (kernel->algorithm == BLUR_ALGORITHM_IIR) {
+        rc = iir_blur_rect(&top, &top, &kernel->iir, 0, BLUR_TRANSFER_SRGB, 0, 0);
+    } else {
+        /* weights holds the working-resolution Gaussian */
+        rc = cpu_blur_taps(&top, &top, kernel->weights.data(), (int32_t)(kernel->weights.size() / 2),
+                           CPU_BLUR_STREAMING, 0, 0);
+    }
+    if (rc != BLUR_SUCCESS) return rc;
+
+    for (int32_t l = kernel->levels; rc == BLUR_SUCCESS && l > 0; l--) {
+        rc = expand_plane(arena, &planes[l], 2, 0, 0, &planes[l - 1]);
+    }
+    if (rc != BLUR_SUCCESS) return rc;
+
+    if (d > 1) {
+        rc = expand_plane(arena, &planes[0], d, x0 - fx0, y0 - fy0, dst, hook);
+        if (rc != BLUR_SUCCESS) return rc;
+    } else {
+        for (int32_t y = 0; y < oh; y++) {
+            memcpy(dst->pixels + (size_t)y * dst->stride,
+                   planes[0].pixels + (size_t)(y0 - fy0 + y) * planes[0].stride + (size_t)(x0 - fx0) * 4,
+                   (size_t)ow * 4);
+            run_row_hook(hook, dst->pixels + (size_t)y * dst->stride, ow, y);
+        }
+    }
+    return BLUR_SUCCESS;
+}
@@ -0,0 +1,189 @@
+/*
+ * backdrop_cache.cpp - Reuse of a window's blurred backdrop while it moves
+ */
+
+#include "backdrop_cache.h"
+#include <cstring>
+
+/* Geometry scratch kept per thread so steady drags do not allocate */
+struct BackdropScratch {
+    std::vector<RegionRect> interior, inside, shifted;
+};
+
+static BackdropScratch& backdrop_scratch() {
+    thread_local BackdropScratch scratch;
+    return scratch;
+}
+
+static bool same_rect(const RegionRect& a, const RegionRect& b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+/* Output pixels whose whole kernel footprint lies inside a width x height window */
+static void interior_output(int32_t width, int32_t height, int32_t radius,
+                            const std::vector<RegionRect>& output, std::vector<RegionRect>* out) {
+    std::vector<RegionRect>& interior = backdrop_scratch().interior;
+    RegionRect win = { 0, 0, width, height };
+    interior.assign(1, rect_inflate(win, -radius));
+    out->clear();
+    if (rect_is_empty(interior[0])) return;
+    region_intersect(output, interior, out);
+}
+
+void backdrop_reusable(const BackdropCache* cache, const RegionRect& screen, const BlurKernel* kernel,
+                       const std::vector<RegionRect>& output, std::vector<RegionRect>* reuse) {
+    reuse->clear();
+    if (!cache || !kernel || kernel->scale != 1 || kernel_is_recursive(kernel) || cache->valid.empty()) return;
+    if (!backdrop_moved(cache, screen) || !kernels_equal(&cache->kernel, kernel)) return;
+
+    BackdropScratch& bs = backdrop_scratch();
+    interior_output(screen.right - screen.left, screen.bottom - screen.top, kernel->radius, output, &bs.inside);
+    if (bs.inside.empty()) return;
+
+    /* The cached pixels, moved into the new window's coordinates */
+    int32_t dx = cache->screen.left - screen.left, dy = cache->screen.top - screen.top;
+    bs.shifted.clear();
+    for (const RegionRect& r : cache->valid) {
+        RegionRect o = { r.left + dx, r.top + dy, r.right + dx, r.bottom + dy };
+        bs.shifted.push_back(o);
+    }
+    region_intersect(bs.inside, bs.shifted, reuse);
+}
+
+/*
+ * Neighbours and weight (in quarters, of hi) of reduced pixels around full
+ * pixel x: its centre lies at (2x - 1) / 4 in a half-size image of n pixels
+ */
+static void reduced_taps(int32_t x, int32_t n, int32_t* lo, int32_t* hi, int32_t* weight) {
+    int32_t u = 2 * x - 1;
+    int32_t i = u >= 0 ? u / 4 : -1;
+    *weight = u - 4 * i;
+    *lo = i < 0 ? 0 : i;
+    *hi = i + 1 < n ? i + 1 : n - 1;
+}
+
+/* Bilinear upsampling of the reuse pixels from a half-resolution cache */
+static void restore_reduced(const BackdropCache* cache, int32_t dx, int32_t dy,
+                            const std::vector<RegionRect>& reuse, BlurSurface* target) {
+    int32_t rw = (cache->screen.right - cache->screen.left + 1) / 2;
+    int32_t rh = (cache->screen.bottom - cache->screen.top + 1) / 2;
+    size_t stride = (size_t)rw * 4;
+    for (const RegionRect& r : reuse) {
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            int32_t j0, j1, fy;
+            reduced_taps(y + dy, rh, &j0, &j1, &fy);
+            const uint8_t* row0 = cache->pixels.data() + (size_t)j0 * stride;
+            const uint8_t* row1 = cache->pixels.data() + (size_t)j1 * stride;
+            uint8_t* out = target->pixels + (size_t)y * target->stride + (size_t)r.left * 4;
+            for (int32_t x = r.left; x < r.right; x++, out += 4) {
+                int32_t i0, i1, fx;
+                reduced_taps(x + dx, rw, &i0, &i1, &fx);
+                const int32_t w00 = (4 - fx) * (4 - fy), w10 = fx * (4 - fy), w01 = (4 - fx) * fy, w11 = fx * fy;
+                for (int32_t c = 0; c < 4; c++) {
+                    out[c] = (uint8_t)((row0[i0 * 4 + c] * w00 + row0[i1 * 4 + c] * w10 +
+                                        row1[i0 * 4 + c] * w01 + row1[i1 * 4 + c] * w11 + 8) >> 4);
+                }
+            }
+        }
+    }
+}
+
+void backdrop_restore(const BackdropCache* cache, const RegionRect& screen,
+                      const std::vector<RegionRect>& reuse, BlurSurface* target) {
+    int32_t dx = screen.left - cache->screen.left, dy = screen.top - cache->screen.top;
+    if (cache->reduction == 2) {
+        restore_reduced(cache, dx, dy, reuse, target);
+        return;
+    }
+    size_t stride = (size_t)(cache->screen.right - cache->screen.left) * 4;
+    for (const RegionRect& r : reuse) {
+        size_t bytes = (size_t)(r.right - r.left) * 4;
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            memcpy(target->pixels + (size_t)y * target->stride + (size_t)r.left * 4,
+                   cache->pixels.data() + (size_t)(y + dy) * stride + (size_t)(r.left + dx) * 4, bytes);
+        }
+    }
+}
+
+/*
+ * Averages 2x2 blocks of the valid pixels into a half-size buffer. Blocks on
+ * a rect's edge may read pixels outside it; only the full pixels within 2 of
+ * the edge sample those blocks, so the rects shrink by 2.
+ */
+static void store_reduced(BackdropCache* cache, int32_t w, int32_t h, const BlurSurface* target) {
+    int32_t rw = (w + 1) / 2, rh = (h + 1) / 2;
+    size_t stride = (size_t)rw * 4;
+    if (cache->pixels.size() < stride * rh) cache->pixels.resize(stride * rh);
+    for (const RegionRect& r : cache->valid) {
+        for (int32_t j = r.top / 2; j < (r.bottom + 1) / 2; j++) {
+            const uint8_t* row0 = target->pixels + (size_t)(2 * j) * target->stride;
+            const uint8_t* row1 = target->pixels + (size_t)(2 * j + 1 < h ? 2 * j + 1 : h - 1) * target->stride;
+            uint8_t* out = cache->pixels.data() + (size_t)j * stride;
+            for (int32_t i = r.left / 2; i < (r.right + 1) / 2; i++) {
+                int32_t x0 = 2 * i * 4, x1 = (2 * i + 1 < w ? 2 * i + 1 : w - 1) * 4;
+                for (int32_t c = 0; c < 4; c++) {
+                    out[i * 4 + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                }
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for (const RegionRect& r : cache->valid) {
+        RegionRect inner = rect_inflate(r, -2);
+        if (!rect_is_empty(inner)) cache->valid[kept++] = inner;
+    }
+    cache->valid.resize(kept);
+}
+
+void backdrop_store(BackdropCache* cache, const RegionRect& screen, const BlurKernel* kernel,
+                    const std::vector<RegionRect>& output, const BlurSurface* target) {
+    cache->screen = screen;
+    if (!kernel || kernel->scale != 1) {
+        cache->valid.clear();
+        return;
+    }
+    int32_t w = screen.right - screen.left, h = screen.bottom - screen.top;
+    interior_output(w, h, kernel->radius, output, &cache->valid);
+    if (!kernels_equal(&cache->kernel, kernel)) cache->kernel = *kernel;
+
+    int32_t n = cache->store_reduction == 2 ? 2 : 1;
+    if (n != cache->reduction) {
+        /* Going down to half resolution frees the full-size buffer */
+        if (n > cache->reduction) std::vector<uint8_t>().swap(cache->pixels);
+        cache->reduction = n;
+    }
+    if (n == 2) {
+        store_reduced(cache, w, h, target);
+        return;
+    }
+
+    /* Resizing keeps the buffer's capacity, so a drag never reallocates */
+    size_t stride = (size_t)w * 4;
+    if (cache->pixels.size() < stride * h) cache->pixels.resize(stride * h);
+    for (const RegionRect& r : cache->valid) {
+        size_t bytes = (size_t)(r.right - r.left) * 4;
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            memcpy(cache->pixels.data() + (size_t)y * stride + (size_t)r.left * 4,
+                   target->pixels + (size_t)y * target->stride + (size_t)r.left * 4, bytes);
+        }
+    }
+}
+
+void backdrop_reset(BackdropCache* cache, const RegionRect& screen) {
+    cache->screen = screen;
+    cache->valid.clear();
+}
+
+void backdrop_release(BackdropCache* cache) {
+    std::vector<RegionRect>().swap(cache->valid);
+    std::vector<uint8_t>().swap(cache->pixels);
+}
+
+size_t backdrop_bytes(const BackdropCache* cache) {
+    return cache->pixels.capacity() + cache->valid.capacity() * sizeof(RegionRect);
+}
+
+bool backdrop_moved(const BackdropCache* cache, const RegionRect& screen) {
+    return !rect_is_empty(cache->screen) && !same_rect(cache->screen, screen);
+}
@@ -0,0 +1,66 @@
+/*
+ * backdrop_cache.h - Reuse of a window's blurred backdrop while it moves
+ *
+ * While a window is dragged or resized, most of the desktop under its new
+ * rect was already blurred on the previous tick, just at another offset.
+ * The cache keeps a window's last untinted blur and where it was on screen.
+ * When the rect changes, a tick copies every output pixel whose kernel
+ * footprint lay inside both the old and the new window, and captures and
+ * blurs only the rest: the newly exposed strips plus the kernel-wide band
+ * along the window edges.
+ *
+ * Reuse assumes the desktop under the window did not change between the two
+ * ticks. A window that stays put is blurred in full every tick, so anything
+ * stale is gone on the first tick after the drag stops.
+ *
+ * Idle and background windows may keep their blur at half resolution
+ * (store_reduction = 2), a quarter of the memory: a blurred backdrop has
+ * little detail left to lose, and a drag that starts from a reduced cache
+ * gets it back bilinearly upsampled. Reduced caches give up the 2 pixels
+ * along every reusable rect's edges, which the tick blurs instead.
+ */
+
+#ifndef BLUR_LIB_BACKDROP_CACHE_H
+#define BLUR_LIB_BACKDROP_CACHE_H
+
+#include "region.h"
+
+struct BackdropCache {
+    RegionRect screen = { 0, 0, 0, 0 };     /* Window rect of the last tick; empty before the first */
+    BlurKernel kernel = BlurKernel();       /* Kernel the cached pixels were blurred with */
+    std::vector<RegionRect> valid;          /* Reusable pixels, relative to screen */
+    std::vector<uint8_t> pixels;            /* Untinted blur at 1/reduction resolution, rows of (width + reduction - 1) / reduction * 4 bytes */
+    int32_t reduction = 1;                  /* Resolution pixels were stored at: 1 or 2 */
+    int32_t store_reduction = 1;            /* Resolution the next store uses, set by the owner */
+};
+
+/*
+ * Window-relative output pixels of a window now at screen that can be copied
+ * from the cache; empty unless the window moved or resized and the kernel is
+ * unchanged. Only full-resolution, non-recursive kernels qualify, as for
+ * shared blurs.
+ */
+void backdrop_reusable(const BackdropCache* cache, const RegionRect& screen, const BlurKernel* kernel,
+                       const std::vector<RegionRect>& output, std::vector<RegionRect>* reuse);
+
+/* Copies the reuse pixels from the cache into the window's target, upsampling a reduced cache */
+void backdrop_restore(const BackdropCache* cache, const RegionRect& screen,
+                      const std::vector<RegionRect>& reuse, BlurSurface* target);
+
+/* Keeps the untinted blur of output from target for the next tick */
+void backdrop_store(BackdropCache* cache, const RegionRect& screen, const BlurKernel* kernel,
+                    const std::vector<RegionRect>& output, const BlurSurface* target);
+
+/* Forgets the pixels (e.g. after a GPU frame) but remembers where the window is */
+void backdrop_reset(BackdropCache* cache, const RegionRect& screen);
+
+/* Forgets the pixels and frees their memory; the next store allocates again */
+void backdrop_release(BackdropCache* cache);
+
+/* Heap bytes the cache holds */
+size_t backdrop_bytes(const BackdropCache* cache);
+
+/* True when the window is not where the cache last saw it (false before the first tick) */
+bool backdrop_moved(const BackdropCache* cache, const RegionRect& screen);
+
+#endif /* BLUR_LIB_BACKDROP_CACHE_H */
@@ -4,18 +4,129 @@
 
 #include "blur_lib.h"
 #include "internal.h"
+#include "calibration.h"
+#include "cpu_budget.h"
+#include "effect_params.h"
+#include "executor.h"
+#include "memory_budget.h"
+#include "scratch_arena.h"
+#include "stats.h"
+#include "tick_recorder.h"
+#include "warmup.h"
+#include "window_registry.h"
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
 
 /* Global state */
 static std::atomic<bool> g_initialized{false};
 static std::mutex g_mutex;
 static uint32_t g_capabilities = 0;
+static std::atomic<bool> g_firstApplyPending{false};
 
 /* Function pointers loaded dynamically */
 static SetWindowCompositionAttributeFunc g_pSetWindowCompositionAttribute = nullptr;
 
+/* UTF-8 path to a wide string for the file APIs */
+static std::wstring WidePath(const char* utf8) {
+    int n = MultiByteToWideChar(CP_UTF8, 0, utf8, -1, nullptr, 0);
+    if (n <= 0) return std::wstring();
+    std::wstring w(n - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, utf8, -1, &w[0], n);
+    return w;
+}
+
+/* Recording file written chunk by chunk from the tick thread */
+class FileRecordSink : public RecordSink {
+public:
+    explicit FileRecordSink(HANDLE h) : m_h(h) {}
+    ~FileRecordSink() { CloseHandle(m_h); }
+
+    bool write(const void* data, size_t bytes) override {
+        DWORD written = 0;
+        return WriteFile(m_h, data, (DWORD)bytes, &written, nullptr) && written == bytes;
+    }
+
+private:
+    HANDLE m_h;
+};
+
+static std::unique_ptr<FileRecordSink> g_recordSink;   /* Guarded by g_mutex */
+static std::unique_ptr<TickRecorder> g_recorder;       /* Guarded by g_mutex */
+
+static bool ReadCacheFile(const char* path, std::string* out) {
+    std::wstring wpath = WidePath(path);
+    HANDLE h = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    char buf[4096];
+    DWORD got = 0;
+    bool ok = ReadFile(h, buf, sizeof(buf) - 1, &got, nullptr) != FALSE;
+    CloseHandle(h);
+    if (!ok) return false;
+    out->assign(buf, got);
+    return true;
+}
+
+static void WriteCacheFile(const char* path, const std::string& text) {
+    std::wstring wpath = WidePath(path);
+    HANDLE h = CreateFileW(wpath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        LOG_WARN("Cannot write calibration cache %s", path);
+        return;
+    }
+    DWORD written = 0;
+    WriteFile(h, text.data(), (DWORD)text.size(), &written, nullptr);
+    CloseHandle(h);
+}
+
+/* Loads the calibration cache or measures, then activates the model */
+static bool Calibrate(const char* cache_path) {
+    CalibrationModel model = {};
+    CalibrationKey key;
+    current_calibration_key((int64_t)GetSystemMetrics(SM_CXSCREEN) * GetSystemMetrics(SM_CYSCREEN), &key);
+    std::string text;
+    bool cached = cache_path && ReadCacheFile(cache_path, &text) &&
+        calibration_from_text(text.c_str(), key, &model) == BLUR_SUCCESS;
+    if (!cached) {
+        if (run_calibration(key, &model) != BLUR_SUCCESS) {
+            LOG_WARN("Calibration failed; BLUR_ALGORITHM_AUTO uses the exact kernel");
+            return false;
+        }
+        if (cache_path) {
+            calibration_to_text(model, &text);
+            WriteCacheFile(cache_path, text);
+        }
+    }
+    set_active_calibration(model);
+
+    std::string json;
+    calibration_to_json(model, &json);
+    LOG_INFO("Calibration %s: %s", cached ? "loaded from cache" : "measured", json.c_str());
+    return true;
+}
+
 int32_t BLUR_CALL blur_init(uint32_t* capabilities) {
+    return blur_init_ex(capabilities, nullptr);
+}
+
+int32_t BLUR_CALL blur_init_ex(uint32_t* capabilities, const BlurInitOptions* options) {
+    uint32_t workers = 0;
+    if (options && options->struct_version == 2) {
+        const BlurInitOptions_V2* v2 = (const BlurInitOptions_V2*)options;
+        bool reserved_clear = true;
+        for (uint8_t b : v2->reserved_v2) reserved_clear = reserved_clear && !b;
+        if (v2->worker_threads > BLUR_MAX_WORKER_THREADS || !reserved_clear) {
+            set_last_error(BLUR_INVALID_PARAMS, ERR_MSG_INIT_OPTIONS);
+            return BLUR_INVALID_PARAMS;
+        }
+        workers = v2->worker_threads;
+    } else if (options && options->struct_version != 1) {
+        set_last_error(BLUR_INVALID_PARAMS, ERR_MSG_INIT_OPTIONS);
+        return BLUR_INVALID_PARAMS;
+    }
+    
     std::lock_guard<std::mutex> lock(g_mutex);
     
     if (g_initialized.load()) {
@@ -29,6 +140,9 @@ int32_t BLUR_CALL blur_init(uint32_t* capabilities) {
     log_init();
     LOG_INFO("Initializing blur_lib...");
     
+    init_timings_reset();
+    std::chrono::steady_clock::time_point detectStart = std::chrono::steady_clock::now();
+    
     /* Detect capabilities */
     g_capabilities = 0;
     
@@ -63,6 +177,29 @@ int32_t BLUR_CALL blur_init(uint32_t* capabilities) {
     // We can just set the cap for now since we link to it
     g_capabilities |= BLUR_CAP_D2D_BLUR;
     LOG_INFO("Direct2D blur capability enabled");
+    
+    /* Must precede any blur so every arena sees it */
+    set_scratch_huge_pages(options && (options->flags & BLUR_INIT_HUGE_PAGES));
+    init_timing_record(BLUR_INIT_PHASE_DETECT, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - detectStart).count());
+
+    /* Optional cost model for BLUR_ALGORITHM_AUTO */
+    if (options && (options->flags & BLUR_INIT_CALIBRATE)) {
+        PhaseTimer t(BLUR_INIT_PHASE_CALIBRATION);
+        if (Calibrate(options->calibration_cache_utf8)) {
+            g_capabilities |= BLUR_CAP_CALIBRATED;
+        }
+    }
+
+    /* Devices, surfaces and kernels for the first apply, off the caller's thread */
+    if (options && (options->flags & BLUR_INIT_WARMUP)) {
+        warmup_start(warmup_d2d_resources);
+    }
+    g_firstApplyPending.store(true);
+
+    /* Workers for banded CPU blurs; interactive work goes ahead of background refreshes */
+    executor_start(workers);
+    LOG_INFO("Blur executor started with %u workers", executor_workers());
 
     
     g_initialized.store(true);
@@ -75,6 +212,18 @@ int32_t BLUR_CALL blur_init(uint32_t* capabilities) {
     return BLUR_SUCCESS;
 }
 
+/* Caller holds g_mutex */
+static void StopRecording() {
+    if (!g_recorder) return;
+    set_d2d_recorder(nullptr);
+    TickRecorderStats rs = g_recorder->stats();
+    LOG_INFO("Recorded %llu ticks, %llu frames in %llu bytes%s", (unsigned long long)rs.ticks,
+             (unsigned long long)rs.frames, (unsigned long long)rs.bytes_written,
+             g_recorder->failed() ? " (stopped early by a write error)" : "");
+    g_recorder.reset();
+    g_recordSink.reset();
+}
+
 void BLUR_CALL blur_shutdown(void) {
     std::lock_guard<std::mutex> lock(g_mutex);
     
@@ -84,25 +233,34 @@ void BLUR_CALL blur_shutdown(void) {
     
     LOG_INFO("Shutting down blur_lib...");
     
+    /* New applies fail fast instead of racing the restore */
+    g_initialized.store(false);
+    
+    /* Warm-up may still be creating resources cleanup would free */
+    warmup_join();
+    
     /* Restore all windows */
-    blur_restore_all();
+    restore_all_tracked_windows(g_pSetWindowCompositionAttribute);
+
+    /* Runs what is still queued; later blurs run on the calling thread */
+    executor_stop();
+    StopRecording();
     
     /* Cleanup */
+    cleanup_d2d_resources();
     cleanup_window_tracker();
     log_shutdown();
     
+    clear_active_calibration();
+    cpu_budget().clear();
+    memory_budget().clear();
     g_pSetWindowCompositionAttribute = nullptr;
     g_capabilities = 0;
-    g_initialized.store(false);
 }
 
-int32_t BLUR_CALL blur_apply_to_window(
-    uintptr_t window_handle,
-    const EffectParams* params,
-    uint32_t timeout_ms
-) {
+static int32_t ApplyToWindow(uintptr_t window_handle, const EffectParams* params, uint32_t timeout_ms) {
     if (!g_initialized.load()) {
-        set_last_error("Library not initialized");
+        set_last_error(BLUR_NOT_INITIALIZED, ERR_MSG_NOT_INITIALIZED);
         return BLUR_NOT_INITIALIZED;
     }
     
@@ -110,14 +268,14 @@ int32_t BLUR_CALL blur_apply_to_window(
     
     /* Validate window handle */
     if (!IsWindow(hwnd)) {
-        set_last_error("Invalid window handle");
+        set_last_error(BLUR_INVALID_HANDLE, ERR_MSG_INVALID_HANDLE);
         return BLUR_INVALID_HANDLE;
     }
     
-    /* Check if already applied - if so, clear first to allow re-apply with new params */
-    if (is_blur_applied(hwnd)) {
-        LOG_DEBUG("Blur already applied, clearing first to update params");
-        untrack_window(hwnd);
+    /* Re-applying updates the tracked entry in place so change feeds see an update */
+    bool reapply = is_blur_applied(hwnd);
+    if (reapply) {
+        LOG_DEBUG("Blur already applied, re-applying with new params");
     }
     
     /* Use default params if not provided */
@@ -130,14 +288,11 @@ int32_t BLUR_CALL blur_apply_to_window(
     
     const EffectParams* effective_params = params ? params : &default_params;
     
-    /* Validate params */
-    if (effective_params->struct_version != 1) {
-        set_last_error("Invalid struct_version");
-        return BLUR_INVALID_PARAMS;
-    }
-    
-    if (effective_params->intensity < 0.0f || effective_params->intensity > 1.0f) {
-        set_last_error("Intensity must be between 0.0 and 1.0");
+    /* Validate params (V1 or V2, plus any trailing region list) */
+    BlurSettings settings;
+    const char* error = nullptr;
+    if (read_effect_params(effective_params, &settings, &error) != BLUR_SUCCESS) {
+        set_last_error(BLUR_INVALID_PARAMS, ERR_MSG_DETAIL, 0, error);
         return BLUR_INVALID_PARAMS;
     }
     
@@ -147,9 +302,13 @@ int32_t BLUR_CALL blur_apply_to_window(
     
     /* Try Direct2D blur first (User preferred for Acrylic) */
     if (g_capabilities & BLUR_CAP_D2D_BLUR) {
-        result = apply_d2d_blur(hwnd, effective_params);
+        result = apply_d2d_blur(hwnd, effective_params, timeout_ms);
         if (result == BLUR_SUCCESS) {
-            track_window(hwnd, effective_params);
+            if (track_window(hwnd, effective_params, BLUR_BACKEND_D2D) != BLUR_SUCCESS) {
+                clear_d2d_blur(hwnd);
+                set_last_error(BLUR_OUT_OF_MEMORY, ERR_MSG_TOO_MANY_WINDOWS);
+                return BLUR_OUT_OF_MEMORY;
+            }
             LOG_INFO("Blur applied via Direct2D");
             return BLUR_SUCCESS;
         }
@@ -159,7 +318,11 @@ int32_t BLUR_CALL blur_apply_to_window(
     if (g_capabilities & BLUR_CAP_SETWINDOWCOMPOSITION) {
         result = apply_composition_blur(hwnd, effective_params, g_pSetWindowCompositionAttribute);
         if (result == BLUR_SUCCESS) {
-            track_window(hwnd, effective_params);
+            if (track_window(hwnd, effective_params, BLUR_BACKEND_COMPOSITION) != BLUR_SUCCESS) {
+                clear_composition_blur(hwnd, g_pSetWindowCompositionAttribute);
+                set_last_error(BLUR_OUT_OF_MEMORY, ERR_MSG_TOO_MANY_WINDOWS);
+                return BLUR_OUT_OF_MEMORY;
+            }
             LOG_INFO("Blur applied via SetWindowCompositionAttribute");
             return BLUR_SUCCESS;
         }
@@ -169,14 +332,37 @@ int32_t BLUR_CALL blur_apply_to_window(
     if (g_capabilities & BLUR_CAP_DWM_BLUR) {
         result = apply_dwm_blur(hwnd, effective_params);
         if (result == BLUR_SUCCESS) {
-            track_window(hwnd, effective_params);
+            if (track_window(hwnd, effective_params, BLUR_BACKEND_DWM) != BLUR_SUCCESS) {
+                clear_dwm_blur(hwnd);
+                set_last_error(BLUR_OUT_OF_MEMORY, ERR_MSG_TOO_MANY_WINDOWS);
+                return BLUR_OUT_OF_MEMORY;
+            }
             LOG_INFO("Blur applied via DWM blur-behind");
             return BLUR_SUCCESS;
         }
     }
 
     
-    set_last_error("No blur method available or all methods failed");
+    if (reapply) {
+        untrack_window(hwnd);
+    }
+    set_last_error(result, ERR_MSG_NO_METHOD);
+    return result;
+}
+
+int32_t BLUR_CALL blur_apply_to_window(
+    uintptr_t window_handle,
+    const EffectParams* params,
+    uint32_t timeout_ms
+) {
+    /* Cold-start latency is tracked apart from steady-state applies */
+    bool first = g_firstApplyPending.exchange(false);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int32_t result = ApplyToWindow(window_handle, params, timeout_ms);
+    if (first) {
+        init_timing_record(BLUR_INIT_PHASE_FIRST_APPLY, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
     return result;
 }
 
@@ -185,7 +371,7 @@ int32_t BLUR_CALL blur_clear_from_window(
     uint32_t timeout_ms
 ) {
     if (!g_initialized.load()) {
-        set_last_error("Library not initialized");
+        set_last_error(BLUR_NOT_INITIALIZED, ERR_MSG_NOT_INITIALIZED);
         return BLUR_NOT_INITIALIZED;
     }
     
@@ -231,7 +417,7 @@ int32_t BLUR_CALL blur_clear_from_window(
 
 int32_t BLUR_CALL blur_restore_all(void) {
     if (!g_initialized.load()) {
-        set_last_error("Library not initialized");
+        set_last_error(BLUR_NOT_INITIALIZED, ERR_MSG_NOT_INITIALIZED);
         return BLUR_NOT_INITIALIZED;
     }
     
@@ -248,3 +434,127 @@ int32_t BLUR_CALL blur_get_version(char** out_utf8) {
     *out_utf8 = alloc_string(version);
     return *out_utf8 ? BLUR_SUCCESS : BLUR_OUT_OF_MEMORY;
 }
+
+int32_t BLUR_CALL blur_get_window_snapshot(BlurWindowInfo_V1* out, uint32_t capacity,
+                                           uint32_t* out_count, uint64_t* out_epoch) {
+    return registry_snapshot(out, capacity, out_count, out_epoch);
+}
+
+int32_t BLUR_CALL blur_get_window_changes(uint64_t since_epoch, BlurWindowChange_V1* out,
+                                          uint32_t capacity, uint32_t* out_count,
+                                          uint64_t* out_epoch, uint32_t* out_flags) {
+    return registry_changes(since_epoch, out, capacity, out_count, out_epoch, out_flags);
+}
+
+int32_t BLUR_CALL blur_get_calibration_info(char** out_json_utf8) {
+    if (!out_json_utf8) {
+        return BLUR_INVALID_PARAMS;
+    }
+    
+    CalibrationModel model;
+    get_active_calibration(&model);
+    std::string json;
+    calibration_to_json(model, &json);
+    
+    *out_json_utf8 = alloc_string(json.c_str());
+    return *out_json_utf8 ? BLUR_SUCCESS : BLUR_OUT_OF_MEMORY;
+}
+
+int32_t BLUR_CALL blur_set_cpu_budget(uint32_t per_mille) {
+    if (per_mille > BLUR_MAX_CPU_BUDGET) {
+        set_last_error(BLUR_INVALID_PARAMS, ERR_MSG_DETAIL, 0, "CPU budget above BLUR_MAX_CPU_BUDGET");
+        return BLUR_INVALID_PARAMS;
+    }
+    cpu_budget().set_budget(per_mille);
+    LOG_INFO("CPU budget set to %u per mille of a core", per_mille);
+    return BLUR_SUCCESS;
+}
+
+int32_t BLUR_CALL blur_get_cpu_budget_info(char** out_json_utf8) {
+    if (!out_json_utf8) {
+        return BLUR_INVALID_PARAMS;
+    }
+
+    std::string json;
+    cpu_budget().to_json(&json);
+
+    *out_json_utf8 = alloc_string(json.c_str());
+    return *out_json_utf8 ? BLUR_SUCCESS : BLUR_OUT_OF_MEMORY;
+}
+
+int32_t BLUR_CALL blur_set_memory_budget(uint64_t bytes) {
+    memory_budget().set_budget(bytes);
+    LOG_INFO("Memory budget set to %llu bytes", (unsigned long long)bytes);
+    return BLUR_SUCCESS;
+}
+
+int32_t BLUR_CALL blur_record_start(const char* path_utf8, uint32_t flags) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_initialized.load()) {
+        set_last_error(BLUR_NOT_INITIALIZED, ERR_MSG_NOT_INITIALIZED);
+        return BLUR_NOT_INITIALIZED;
+    }
+    if (!path_utf8 || !*path_utf8 || (flags & ~BLUR_RECORD_DELTA)) {
+        return BLUR_INVALID_PARAMS;
+    }
+    if (g_recorder) {
+        return BLUR_ALREADY_APPLIED;
+    }
+
+    std::wstring wpath = WidePath(path_utf8);
+    HANDLE h = CreateFileW(wpath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        set_last_error(BLUR_INVALID_PARAMS, ERR_MSG_DETAIL, 0, "Cannot create the recording file");
+        return BLUR_INVALID_PARAMS;
+    }
+    std::unique_ptr<FileRecordSink> sink(new FileRecordSink(h));
+    std::unique_ptr<TickRecorder> recorder(new TickRecorder());
+    if (recorder->open(sink.get(), flags) != BLUR_SUCCESS) {
+        set_last_error(BLUR_INVALID_PARAMS, ERR_MSG_DETAIL, 0, "Cannot write the recording file");
+        return BLUR_INVALID_PARAMS;
+    }
+    g_recordSink = std::move(sink);
+    g_recorder = std::move(recorder);
+    set_d2d_recorder(g_recorder.get());
+    LOG_INFO("Recording ticks to %s", path_utf8);
+    return BLUR_SUCCESS;
+}
+
+int32_t BLUR_CALL blur_record_stop(void) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    StopRecording();
+    return BLUR_SUCCESS;
+}
+
+int32_t BLUR_CALL blur_get_stat(uint32_t stat_id, uint64_t* out_value) {
+    if (!out_value || stat_id >= BLUR_STAT_COUNT) {
+        return BLUR_INVALID_PARAMS;
+    }
+    
+    *out_value = stats_get(stat_id);
+    return BLUR_SUCCESS;
+}
+
+int32_t BLUR_CALL blur_get_error_count(int32_t code, uint64_t* out_value) {
+    if (!out_value || code <= BLUR_SUCCESS || code >= BLUR_ERROR_CODE_COUNT) {
+        return BLUR_INVALID_PARAMS;
+    }
+    
+    *out_value = error_count(code);
+    return BLUR_SUCCESS;
+}
+
+int32_t BLUR_CALL blur_get_init_timing(uint32_t phase, uint64_t* out_us) {
+    if (!out_us || phase >= BLUR_INIT_PHASE_COUNT) {
+        return BLUR_INVALID_PARAMS;
+    }
+    
+    *out_us = init_timing_get(phase);
+    return BLUR_SUCCESS;
+}
+
+void BLUR_CALL blur_reset_stats(void) {
+    stats_reset();
+    error_counts_reset();
+}
@@ -0,0 +1,716 @@
+/*
+ * blur_service.cpp - Cross-process blur service over shared memory
+ */
+
+#include "blur_service.h"
+#include "calibration.h"
+#include "kernel_cache.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* The layout must not depend on the compiler or the target */
+static_assert(sizeof(ServiceCommand) == 40 + SERVICE_MAX_PARAMS_BYTES, "ServiceCommand layout changed");
+static_assert(offsetof(ServiceCommand, params) == 40, "ServiceCommand layout changed");
+static_assert(sizeof(ServiceReply) == 24, "ServiceReply layout changed");
+static_assert(sizeof(ServiceHeader) == 56, "ServiceHeader layout changed");
+static_assert(offsetof(ServiceSlotHeader, width) == 24, "ServiceSlotHeader layout changed");
+static_assert(sizeof(ServiceClientBlock) % 64 == 0, "client blocks keep their rings on separate cache lines");
+static_assert((SERVICE_RING_ENTRIES & (SERVICE_RING_ENTRIES - 1)) == 0, "ring indices wrap at 2^32");
+
+static inline uint64_t align64(uint64_t n) {
+    return (n + 63) / 64 * 64;
+}
+
+static uint64_t blocks_offset(void) {
+    return align64(sizeof(ServiceHeader));
+}
+
+static uint64_t slots_offset(uint32_t max_clients) {
+    return blocks_offset() + (uint64_t)max_clients * sizeof(ServiceClientBlock);
+}
+
+static uint64_t slot_stride(uint64_t slot_bytes) {
+    return SERVICE_SLOT_HEADER_BYTES + align64(slot_bytes);
+}
+
+size_t service_segment_bytes(uint32_t max_clients, uint32_t slots_per_client, uint64_t slot_bytes) {
+    return (size_t)(slots_offset(max_clients) + (uint64_t)max_clients * slots_per_client * slot_stride(slot_bytes));
+}
+
+uint64_t service_now_us(void) {
+    /* CLOCK_MONOTONIC and QueryPerformanceCounter count the same for every process */
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool host_is_alive(const ServiceHeader* header, uint64_t now_us) {
+    if (header->host_running.load(std::memory_order_acquire) != 1) return false;
+    uint64_t beat = header->host_heartbeat_us.load(std::memory_order_relaxed);
+    return now_us < beat || now_us - beat < SERVICE_DEFAULT_CLIENT_TIMEOUT_US;
+}
+
+/* ============================================================================
+ * SharedSegment
+ * ============================================================================ */
+SharedSegment::SharedSegment() : m_data(nullptr), m_size(0), m_owner(false), m_name(), m_handle(nullptr) {}
+
+SharedSegment::~SharedSegment() {
+    close();
+}
+
+/* "/name" for shm_open, "Local\name" for a session-local file mapping */
+static bool segment_path(const char* name, char* out, size_t size) {
+    if (!name || !*name || strchr(name, '/') || strchr(name, '\\')) return false;
+#ifdef _WIN32
+    int n = snprintf(out, size, "Local\\%s", name);
+#else
+    int n = snprintf(out, size, "/%s", name);
+#endif
+    return n > 0 && (size_t)n < size;
+}
+
+int32_t SharedSegment::create(const char* name, size_t bytes) {
+    close();
+    char path[sizeof(m_name)];
+    if (!segment_path(name, path, sizeof(path)) || !bytes) return BLUR_INVALID_PARAMS;
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, path);
+    if (!mapping) return BLUR_OUT_OF_MEMORY;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        /* Mappings live as long as any handle: another host, or clients of a dead one */
+        CloseHandle(mapping);
+        return BLUR_ALREADY_APPLIED;
+    }
+    void* p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!p) {
+        CloseHandle(mapping);
+        return BLUR_OUT_OF_MEMORY;
+    }
+    m_handle = mapping;
+#else
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return errno == EEXIST ? BLUR_ALREADY_APPLIED : BLUR_PERMISSION_DENIED;
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        ::close(fd);
+        shm_unlink(path);
+        return BLUR_OUT_OF_MEMORY;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(path);
+        return BLUR_OUT_OF_MEMORY;
+    }
+#endif
+    m_data = (uint8_t*)p;
+    m_size = bytes;
+    m_owner = true;
+    memcpy(m_name, path, sizeof(path));
+    return BLUR_SUCCESS;
+}
+
+int32_t SharedSegment::open(const char* name) {
+    close();
+    char path[sizeof(m_name)];
+    if (!segment_path(name, path, sizeof(path))) return BLUR_INVALID_PARAMS;
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+    if (!mapping) return BLUR_NOT_INITIALIZED;
+    void* p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (!p || !VirtualQuery(p, &info, sizeof(info))) {
+        if (p) UnmapViewOfFile(p);
+        CloseHandle(mapping);
+        return BLUR_NOT_INITIALIZED;
+    }
+    m_handle = mapping;
+    m_size = info.RegionSize;
+#else
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0) return errno == ENOENT ? BLUR_NOT_INITIALIZED : BLUR_PERMISSION_DENIED;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return BLUR_NOT_INITIALIZED;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return BLUR_OUT_OF_MEMORY;
+    m_size = (size_t)st.st_size;
+#endif
+    m_data = (uint8_t*)p;
+    m_owner = false;
+    memcpy(m_name, path, sizeof(path));
+    return BLUR_SUCCESS;
+}
+
+void SharedSegment::close() {
+    if (!m_data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle((HANDLE)m_handle);
+    m_handle = nullptr;
+#else
+    munmap(m_data, m_size);
+    if (m_owner) shm_unlink(m_name);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_owner = false;
+}
+
+/* ============================================================================
+ * Host
+ * ============================================================================ */
+ServiceHost::ServiceHost() : m_header(nullptr), m_options(), m_source(nullptr), m_stats() {}
+
+ServiceHost::~ServiceHost() {
+    stop();
+}
+
+int32_t ServiceHost::start(const char* name, const ServiceHostOptions& options, CaptureSource* source) {
+    stop();
+    if (!source || !options.max_clients || options.max_clients > SERVICE_MAX_CLIENTS ||
+        !options.slots_per_client || options.slots_per_client > SERVICE_MAX_SLOTS ||
+        options.slot_bytes < 4 || !options.client_timeout_us) return BLUR_INVALID_PARAMS;
+
+    size_t bytes = service_segment_bytes(options.max_clients, options.slots_per_client, options.slot_bytes);
+    int32_t result = m_segment.create(name, bytes);
+    if (result == BLUR_ALREADY_APPLIED) {
+        /* Left behind by a host that died; a live one keeps its heartbeat fresh */
+        SharedSegment probe;
+        if (probe.open(name) == BLUR_SUCCESS && probe.size() >= sizeof(ServiceHeader) &&
+            host_is_alive((const ServiceHeader*)probe.data(), service_now_us())) {
+            return BLUR_ALREADY_APPLIED;
+        }
+        probe.close();
+#ifndef _WIN32
+        char path[64];
+        if (segment_path(name, path, sizeof(path))) shm_unlink(path);
+#endif
+        result = m_segment.create(name, bytes);
+    }
+    if (result != BLUR_SUCCESS) return result;
+
+    uint8_t* base = m_segment.data();
+    m_header = new (base) ServiceHeader();
+    m_header->version = SERVICE_PROTOCOL_VERSION;
+    m_header->max_clients = options.max_clients;
+    m_header->slots_per_client = options.slots_per_client;
+    m_header->slot_bytes = options.slot_bytes;
+    m_header->segment_bytes = bytes;
+    m_header->host_heartbeat_us.store(service_now_us(), std::memory_order_relaxed);
+    m_header->ticks.store(0, std::memory_order_relaxed);
+    for (uint32_t c = 0; c < options.max_clients; c++) {
+        ServiceClientBlock* b = new (base + blocks_offset() + (uint64_t)c * sizeof(ServiceClientBlock)) ServiceClientBlock();
+        b->state.store(SERVICE_CLIENT_FREE, std::memory_order_relaxed);
+        b->generation.store(0, std::memory_order_relaxed);
+        b->commands.reset();
+        b->replies.reset();
+        for (uint32_t s = 0; s < options.slots_per_client; s++) {
+            new (base + slots_offset(options.max_clients) +
+                 ((uint64_t)c * options.slots_per_client + s) * slot_stride(options.slot_bytes)) ServiceSlotHeader();
+        }
+    }
+    m_header->magic = SERVICE_MAGIC;
+    m_header->host_running.store(1, std::memory_order_release);
+
+    m_options = options;
+    m_source = source;
+    m_windows.clear();
+    m_generations.assign(options.max_clients, 0);
+    m_stats = ServiceHostStats();
+    return BLUR_SUCCESS;
+}
+
+void ServiceHost::stop() {
+    if (!m_header) return;
+    m_header->host_running.store(0, std::memory_order_release);
+    m_windows.clear();
+    m_segment.close();
+    m_header = nullptr;
+    m_source = nullptr;
+}
+
+ServiceClientBlock* ServiceHost::client_block(uint32_t client) const {
+    return (ServiceClientBlock*)(m_segment.data() + blocks_offset() + (uint64_t)client * sizeof(ServiceClientBlock));
+}
+
+ServiceSlotHeader* ServiceHost::slot_header(uint32_t client, uint32_t slot) const {
+    return (ServiceSlotHeader*)(m_segment.data() + slots_offset(m_options.max_clients) +
+        ((uint64_t)client * m_options.slots_per_client + slot) * slot_stride(m_options.slot_bytes));
+}
+
+void ServiceHost::reply(uint32_t client, uint32_t sequence, int32_t status, uint64_t handle, uint32_t slot) {
+    ServiceReply r = { sequence, status, handle, slot, 0 };
+    if (!client_block(client)->replies.push(r)) m_stats.replies_dropped++;
+}
+
+/* Rewrites a slot under its seqlock; frames land in pixels, or the slot is emptied */
+static void write_slot(ServiceSlotHeader* h, uint64_t handle, const BlurSurface* frame) {
+    uint32_t seq = h->sequence.load(std::memory_order_relaxed);
+    h->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    h->handle = handle;
+    if (frame) {
+        h->frame++;
+        h->width = frame->width;
+        h->height = frame->height;
+        uint8_t* dst = (uint8_t*)h + SERVICE_SLOT_HEADER_BYTES;
+        for (int32_t y = 0; y < frame->height; y++) {
+            memcpy(dst + (size_t)y * frame->width * 4, frame->pixels + (size_t)y * frame->stride, (size_t)frame->width * 4);
+        }
+    } else {
+        h->frame = 0;
+        h->width = 0;
+        h->height = 0;
+    }
+    h->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void ServiceHost::release_window(std::map<uint64_t, Window>::iterator it) {
+    write_slot(slot_header(it->second.client, it->second.slot), 0, nullptr);
+    m_windows.erase(it);
+}
+
+void ServiceHost::release_client(uint32_t client) {
+    for (std::map<uint64_t, Window>::iterator it = m_windows.begin(); it != m_windows.end();) {
+        std::map<uint64_t, Window>::iterator next = std::next(it);
+        if (it->second.client == client) release_window(it);
+        it = next;
+    }
+}
+
+int32_t ServiceHost::apply(uint32_t client, uint32_t generation, const ServiceCommand& cmd, bool* deferred) {
+    if (cmd.params_bytes < sizeof(EffectParams_V1) || cmd.params_bytes > SERVICE_MAX_PARAMS_BYTES) {
+        return BLUR_INVALID_PARAMS;
+    }
+    RegionRect screen = { cmd.left, cmd.top, cmd.right, cmd.bottom };
+    if (rect_is_empty(screen)) return BLUR_INVALID_PARAMS;
+    if ((uint64_t)rect_area(screen) * 4 > m_options.slot_bytes) return BLUR_OUT_OF_MEMORY;
+
+    std::map<uint64_t, Window>::iterator it = m_windows.find(cmd.handle);
+    if (it != m_windows.end() && it->second.client != client) return BLUR_PERMISSION_DENIED;
+
+    /* Trailing lists the flags announce beyond params_bytes read as zeros and fail validation */
+    std::vector<uint8_t> params(SERVICE_MAX_PARAMS_BYTES, 0);
+    memcpy(params.data(), cmd.params, cmd.params_bytes);
+    BlurSettings settings;
+    if (read_effect_params((const EffectParams*)params.data(), &settings, nullptr) != BLUR_SUCCESS) {
+        return BLUR_INVALID_PARAMS;
+    }
+
+    if (it == m_windows.end()) {
+        uint64_t used = 0;
+        for (const std::pair<const uint64_t, Window>& kv : m_windows) {
+            if (kv.second.client == client) used |= 1ull << kv.second.slot;
+        }
+        uint32_t slot = 0;
+        while (slot < m_options.slots_per_client && (used >> slot & 1)) slot++;
+        if (slot == m_options.slots_per_client) return BLUR_OUT_OF_MEMORY;
+        it = m_windows.emplace(cmd.handle, Window()).first;
+        it->second.client = client;
+        it->second.slot = slot;
+    } else if (it->second.reply_pending) {
+        /* Superseded before its first frame */
+        reply(client, it->second.reply_sequence, BLUR_SUCCESS, cmd.handle, it->second.slot);
+    }
+
+    Window& w = it->second;
+    w.generation = generation;
+    w.screen = screen;
+    w.params.swap(params);
+    read_effect_params((const EffectParams*)w.params.data(), &w.settings, nullptr);
+    w.has_effects = w.settings.effects && compile_effect_graph(w.settings.effects, &w.effects) == BLUR_SUCCESS;
+    w.next_due_us = 0;
+    w.reply_pending = true;
+    w.reply_sequence = cmd.sequence;
+    *deferred = true;
+    return BLUR_SUCCESS;
+}
+
+int32_t ServiceHost::execute(uint32_t client, uint32_t generation, const ServiceCommand& cmd, bool* deferred) {
+    *deferred = false;
+    if (cmd.type == SERVICE_CMD_APPLY) return apply(client, generation, cmd, deferred);
+    if (cmd.type != SERVICE_CMD_MOVE && cmd.type != SERVICE_CMD_CLEAR) return BLUR_INVALID_PARAMS;
+
+    std::map<uint64_t, Window>::iterator it = m_windows.find(cmd.handle);
+    if (it == m_windows.end()) {
+        /* Clearing a window that is not blurred succeeds, as blur_clear_from_window() does */
+        return cmd.type == SERVICE_CMD_CLEAR ? BLUR_SUCCESS : BLUR_INVALID_HANDLE;
+    }
+    if (it->second.client != client) return BLUR_PERMISSION_DENIED;
+
+    if (cmd.type == SERVICE_CMD_CLEAR) {
+        if (it->second.reply_pending) reply(client, it->second.reply_sequence, BLUR_SUCCESS, cmd.handle, it->second.slot);
+        release_window(it);
+        return BLUR_SUCCESS;
+    }
+    RegionRect screen = { cmd.left, cmd.top, cmd.right, cmd.bottom };
+    if (rect_is_empty(screen)) return BLUR_INVALID_PARAMS;
+    if ((uint64_t)rect_area(screen) * 4 > m_options.slot_bytes) return BLUR_OUT_OF_MEMORY;
+    it->second.screen = screen;
+    /* A moving window refreshes at once; its backdrop cache covers most of it */
+    it->second.next_due_us = 0;
+    return BLUR_SUCCESS;
+}
+
+void ServiceHost::poll(uint64_t now_us) {
+    if (!m_header) return;
+    m_header->host_heartbeat_us.store(now_us, std::memory_order_relaxed);
+
+    for (uint32_t c = 0; c < m_options.max_clients; c++) {
+        ServiceClientBlock* b = client_block(c);
+        uint32_t state = b->state.load(std::memory_order_acquire);
+        if (state == SERVICE_CLIENT_DETACHING) {
+            release_client(c);
+            m_generations[c] = 0;
+            b->state.store(SERVICE_CLIENT_FREE, std::memory_order_release);
+            continue;
+        }
+        if (state != SERVICE_CLIENT_ATTACHED) continue;
+
+        /* A new claim of the block: whatever the previous holder left is gone */
+        uint32_t generation = b->generation.load(std::memory_order_relaxed);
+        if (generation != m_generations[c]) {
+            release_client(c);
+            m_generations[c] = generation;
+            m_stats.clients_attached++;
+        }
+
+        ServiceCommand cmd;
+        while (b->commands.pop(&cmd)) {
+            m_stats.commands++;
+            bool deferred = false;
+            int32_t status = execute(c, generation, cmd, &deferred);
+            if (status != BLUR_SUCCESS) {
+                m_stats.rejected++;
+                if (status == BLUR_PERMISSION_DENIED) m_stats.denied++;
+            }
+            if (!deferred) reply(c, cmd.sequence, status, cmd.handle, 0);
+        }
+
+        uint64_t beat = b->heartbeat_us.load(std::memory_order_relaxed);
+        if (now_us > beat && now_us - beat > m_options.client_timeout_us) {
+            uint32_t expected = SERVICE_CLIENT_ATTACHED;
+            if (b->state.compare_exchange_strong(expected, SERVICE_CLIENT_FREE, std::memory_order_acq_rel)) {
+                release_client(c);
+                m_generations[c] = 0;
+                m_stats.clients_reaped++;
+            }
+        }
+    }
+}
+
+void ServiceHost::publish(Window* w, uint64_t handle, bool rendered) {
+    if (rendered) {
+        BlurSurface frame = { w->target.data(), w->screen.right - w->screen.left, w->screen.bottom - w->screen.top,
+                              (w->screen.right - w->screen.left) * 4 };
+        write_slot(slot_header(w->client, w->slot), handle, &frame);
+        m_stats.frames++;
+    }
+    if (w->reply_pending) {
+        reply(w->client, w->reply_sequence, rendered ? BLUR_SUCCESS : BLUR_INTERNAL_ERROR, handle, w->slot);
+        w->reply_pending = false;
+    }
+}
+
+int32_t ServiceHost::tick(uint64_t now_us) {
+    if (!m_header) return BLUR_NOT_INITIALIZED;
+    poll(now_us);
+
+    std::vector<TickWindow> windows;
+    std::vector<std::pair<uint64_t, Window*>> owners;
+    for (std::pair<const uint64_t, Window>& kv : m_windows) {
+        Window& w = kv.second;
+        if (now_us < w.next_due_us) continue;
+        /* Due times sit on a grid of the interval, so windows at one rate share their ticks */
+        uint64_t interval = (uint64_t)(w.settings.refresh_interval_ms ? w.settings.refresh_interval_ms : 1) * 1000;
+        w.next_due_us = (now_us / interval + 1) * interval;
+
+        int32_t width = w.screen.right - w.screen.left, height = w.screen.bottom - w.screen.top;
+        float sigma = sigma_from_intensity(w.settings.intensity);
+        uint32_t algorithm = resolve_algorithm(w.settings.algorithm, (int64_t)width * height, sigma);
+        bool linear = (w.settings.flags & BLUR_PARAMS_FLAG_LINEAR_LIGHT) != 0;
+        const BlurKernel* kernel = get_blur_kernel(sigma, algorithm, w.settings.downsample, linear, &w.kernel);
+
+        TickWindow tw;
+        if (plan_region_blur(w.settings.regions, width, height, kernel->radius, &tw.plan) != BLUR_SUCCESS) {
+            publish(&w, kv.first, false);
+            continue;
+        }
+        w.target.assign((size_t)width * height * 4, 0);
+        tw.handle = (uintptr_t)kv.first;
+        tw.screen = w.screen;
+        tw.kernel = kernel;
+        tw.color_argb = w.settings.color_argb;
+        tw.effects = w.has_effects ? &w.effects : nullptr;
+        tw.mode = ((w.settings.flags & BLUR_PARAMS_FLAG_STREAMING) ||
+                   region_area(tw.plan.capture) >= BLUR_STREAMING_THRESHOLD_PIXELS)
+            ? CPU_BLUR_STREAMING : CPU_BLUR_FULL_FRAME;
+        BlurSurface target = { w.target.data(), width, height, width * 4 };
+        tw.target = target;
+        tw.backdrop = &w.backdrop;
+        /* A client waiting on its apply goes ahead of periodic refreshes */
+        tw.lane = w.reply_pending ? EXECUTOR_LANE_INTERACTIVE : EXECUTOR_LANE_BACKGROUND;
+        tw.max_tasks = w.settings.worker_threads;
+        windows.push_back(tw);
+        owners.push_back(std::make_pair(kv.first, &w));
+    }
+    if (windows.empty()) return BLUR_SUCCESS;
+
+    /* One capture and blur for every client's windows */
+    TickStats ts;
+    int32_t result = run_shared_tick(windows.data(), windows.size(), m_source, &ts);
+    if (result == BLUR_SUCCESS) {
+        record_tick_stats(ts);
+        m_stats.ticks++;
+        m_stats.shared.pixels_requested += ts.pixels_requested;
+        m_stats.shared.pixels_captured += ts.pixels_captured;
+        m_stats.shared.pixels_blur_requested += ts.pixels_blur_requested;
+        m_stats.shared.pixels_blur_computed += ts.pixels_blur_computed;
+        m_stats.shared.pixels_reused += ts.pixels_reused;
+        m_stats.shared.frames += ts.frames;
+        m_header->ticks.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (const std::pair<uint64_t, Window*>& o : owners) publish(o.second, o.first, result == BLUR_SUCCESS);
+    return result;
+}
+
+uint64_t ServiceHost::next_due_us() const {
+    uint64_t due = UINT64_MAX;
+    for (const std::pair<const uint64_t, Window>& kv : m_windows) {
+        if (kv.second.next_due_us < due) due = kv.second.next_due_us;
+    }
+    return due;
+}
+
+/* ============================================================================
+ * Client
+ * ============================================================================ */
+ServiceClient::ServiceClient() : m_header(nullptr), m_block(nullptr), m_index(0), m_generation(0), m_sequence(0) {}
+
+ServiceClient::~ServiceClient() {
+    detach();
+}
+
+static uint32_t current_pid(void) {
+#ifdef _WIN32
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+int32_t ServiceClient::attach(const char* name) {
+    detach();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int32_t result = m_segment.open(name);
+    if (result != BLUR_SUCCESS) return result;
+
+    ServiceHeader* header = (ServiceHeader*)m_segment.data();
+    if (m_segment.size() < sizeof(ServiceHeader) || !host_is_alive(header, service_now_us())) {
+        m_segment.close();
+        return BLUR_NOT_INITIALIZED;
+    }
+    if (header->magic != SERVICE_MAGIC || header->version != SERVICE_PROTOCOL_VERSION ||
+        header->max_clients > SERVICE_MAX_CLIENTS || header->slots_per_client > SERVICE_MAX_SLOTS ||
+        header->segment_bytes > m_segment.size() ||
+        header->segment_bytes != service_segment_bytes(header->max_clients, header->slots_per_client, header->slot_bytes)) {
+        m_segment.close();
+        return BLUR_API_UNSUPPORTED;
+    }
+
+    for (uint32_t c = 0; c < header->max_clients; c++) {
+        ServiceClientBlock* b = (ServiceClientBlock*)(m_segment.data() + blocks_offset() + (uint64_t)c * sizeof(ServiceClientBlock));
+        uint32_t expected = SERVICE_CLIENT_FREE;
+        if (!b->state.compare_exchange_strong(expected, SERVICE_CLIENT_CLAIMED, std::memory_order_acq_rel)) continue;
+
+        /* The host ignores claimed blocks, so the rings can be reset in place */
+        b->commands.reset();
+        b->replies.reset();
+        b->pid = current_pid();
+        b->heartbeat_us.store(service_now_us(), std::memory_order_relaxed);
+        m_generation = b->generation.load(std::memory_order_relaxed) + 1;
+        if (!m_generation) m_generation = 1;
+        b->generation.store(m_generation, std::memory_order_relaxed);
+        b->state.store(SERVICE_CLIENT_ATTACHED, std::memory_order_release);
+
+        m_header = header;
+        m_block = b;
+        m_index = c;
+        return BLUR_SUCCESS;
+    }
+    m_segment.close();
+    return BLUR_OUT_OF_MEMORY;
+}
+
+void ServiceClient::detach() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_block) return;
+    /* Fails if the host already dropped this client */
+    uint32_t expected = SERVICE_CLIENT_ATTACHED;
+    if (m_block->generation.load(std::memory_order_relaxed) == m_generation) {
+        m_block->state.compare_exchange_strong(expected, SERVICE_CLIENT_DETACHING, std::memory_order_acq_rel);
+    }
+    m_segment.close();
+    m_header = nullptr;
+    m_block = nullptr;
+}
+
+bool ServiceClient::host_alive() const {
+    return host_is_alive(m_header, service_now_us());
+}
+
+void ServiceClient::heartbeat() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_block) m_block->heartbeat_us.store(service_now_us(), std::memory_order_relaxed);
+}
+
+/* Caller holds m_mutex */
+int32_t ServiceClient::call(ServiceCommand* cmd, uint32_t timeout_ms, ServiceReply* reply) {
+    if (!m_block) return BLUR_NOT_INITIALIZED;
+    if (m_block->state.load(std::memory_order_acquire) != SERVICE_CLIENT_ATTACHED ||
+        m_block->generation.load(std::memory_order_relaxed) != m_generation) return BLUR_NOT_INITIALIZED;
+
+    if (!++m_sequence) m_sequence = 1;
+    cmd->sequence = m_sequence;
+    uint64_t deadline = service_now_us() + (uint64_t)timeout_ms * 1000;
+    bool sent = false;
+    for (uint32_t spins = 0;; spins++) {
+        uint64_t now = service_now_us();
+        m_block->heartbeat_us.store(now, std::memory_order_relaxed);
+        if (!sent) sent = m_block->commands.push(*cmd);
+        if (sent) {
+            /* Replies to calls that timed out earlier are skipped */
+            ServiceReply r;
+            while (m_block->replies.pop(&r)) {
+                if (r.sequence == m_sequence) {
+                    *reply = r;
+                    return r.status;
+                }
+            }
+        }
+        if (now >= deadline) return BLUR_TIMEOUT;
+        if (!host_alive()) return BLUR_NOT_INITIALIZED;
+        /* The host polls between ticks: spin briefly, then sleep */
+        if (spins < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+/* Bytes of params plus the trailing lists its flags announce; 0 for an unknown version */
+static uint32_t params_bytes(const EffectParams* params) {
+    uint32_t bytes = params->struct_version == 2 ? sizeof(EffectParams_V2)
+                   : params->struct_version == 1 ? sizeof(EffectParams_V1) : 0;
+    if (!bytes) return 0;
+    if (params->reserved_flags & BLUR_PARAMS_FLAG_REGIONS) bytes += sizeof(BlurRegionList_V1);
+    if (params->reserved_flags & BLUR_PARAMS_FLAG_EFFECTS) bytes += sizeof(BlurEffectList_V1);
+    return bytes;
+}
+
+int32_t ServiceClient::apply(uint64_t handle, const RegionRect& screen, const EffectParams* params,
+                             uint32_t timeout_ms, uint32_t* slot) {
+    EffectParams defaults = {};
+    defaults.struct_version = 1;
+    defaults.intensity = 1.0f;
+    if (!params) params = &defaults;
+    uint32_t bytes = params_bytes(params);
+    if (!bytes) return BLUR_INVALID_PARAMS;
+
+    ServiceCommand cmd = {};
+    cmd.type = SERVICE_CMD_APPLY;
+    cmd.handle = handle;
+    cmd.left = screen.left;
+    cmd.top = screen.top;
+    cmd.right = screen.right;
+    cmd.bottom = screen.bottom;
+    cmd.params_bytes = bytes;
+    memcpy(cmd.params, params, bytes);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ServiceReply r;
+    int32_t result = call(&cmd, timeout_ms, &r);
+    if (result == BLUR_SUCCESS && slot) *slot = r.slot;
+    return result;
+}
+
+int32_t ServiceClient::move(uint64_t handle, const RegionRect& screen, uint32_t timeout_ms) {
+    ServiceCommand cmd = {};
+    cmd.type = SERVICE_CMD_MOVE;
+    cmd.handle = handle;
+    cmd.left = screen.left;
+    cmd.top = screen.top;
+    cmd.right = screen.right;
+    cmd.bottom = screen.bottom;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ServiceReply r;
+    return call(&cmd, timeout_ms, &r);
+}
+
+int32_t ServiceClient::clear(uint64_t handle, uint32_t timeout_ms) {
+    ServiceCommand cmd = {};
+    cmd.type = SERVICE_CMD_CLEAR;
+    cmd.handle = handle;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ServiceReply r;
+    return call(&cmd, timeout_ms, &r);
+}
+
+int32_t ServiceClient::read_frame(uint64_t handle, uint32_t slot, BlurSurface* dst, uint64_t* frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_block) return BLUR_NOT_INITIALIZED;
+    if (!dst || !frame || slot >= m_header->slots_per_client) return BLUR_INVALID_PARAMS;
+    m_block->heartbeat_us.store(service_now_us(), std::memory_order_relaxed);
+
+    const ServiceSlotHeader* h = (const ServiceSlotHeader*)(m_segment.data() + slots_offset(m_header->max_clients) +
+        ((uint64_t)m_index * m_header->slots_per_client + slot) * slot_stride(m_header->slot_bytes));
+    const uint8_t* src = (const uint8_t*)h + SERVICE_SLOT_HEADER_BYTES;
+    for (;;) {
+        uint32_t before = h->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        /*
+         * The fields and pixels are plain memory shared with another process;
+         * anything read while the host rewrote them is thrown away below, so
+         * bounds come from the copy and are checked before they are used.
+         */
+        uint64_t owner = h->handle, number = h->frame;
+        int32_t width = h->width, height = h->height;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bool torn = h->sequence.load(std::memory_order_relaxed) != before;
+        if (torn) continue;
+        if (owner != handle) return BLUR_INVALID_HANDLE;
+        if (number <= *frame) return BLUR_TIMEOUT;
+        if (width <= 0 || height <= 0 || (uint64_t)width * height * 4 > m_header->slot_bytes) continue;
+        if (width > dst->width || height > dst->height) return BLUR_INVALID_PARAMS;
+
+        for (int32_t y = 0; y < height; y++) {
+            memcpy(dst->pixels + (size_t)y * dst->stride, src + (size_t)y * width * 4, (size_t)width * 4);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h->sequence.load(std::memory_order_relaxed) != before) continue;
+        *frame = number;
+        return BLUR_SUCCESS;
+    }
+}
@@ -0,0 +1,322 @@
+/*
+ * blur_service.h - Cross-process blur service over shared memory
+ *
+ * Processes that each load the library would each capture and blur the same
+ * desktop with their own devices and timers. In service mode one host
+ * process owns capture, blur and scheduling for all of them: every client
+ * window goes into the host's shared tick, so windows of different processes
+ * that overlap are captured and blurred once.
+ *
+ * Host and clients meet in one named shared-memory segment (POSIX shm,
+ * a file mapping on Windows). It holds no pointers, only fixed-width fields
+ * at fixed offsets, so any two processes that map it agree on its layout:
+ *
+ *   ServiceHeader
+ *   ServiceClientBlock[max_clients]     claimed by clients, one each
+ *   frame slots[max_clients][slots_per_client]
+ *
+ * Each client block carries a single-producer ring of commands (the client
+ * writes, the host reads) and one of replies the other way. A window's
+ * frames go to one of its client's slots under a seqlock, so a client
+ * copies out the newest complete frame without ever blocking the host.
+ *
+ * The host tracks which client owns each window handle: commands naming
+ * another client's handle fail with BLUR_PERMISSION_DENIED, and a client
+ * that detaches or stops sending heartbeats loses every window it owned.
+ */
+
+#ifndef BLUR_LIB_BLUR_SERVICE_H
+#define BLUR_LIB_BLUR_SERVICE_H
+
+#include "capture_planner.h"
+#include "effect_graph.h"
+#include "effect_params.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#define SERVICE_MAGIC               0x56534C42u     /* "BLSV" */
+#define SERVICE_PROTOCOL_VERSION    1
+
+#define SERVICE_MAX_CLIENTS         64
+#define SERVICE_MAX_SLOTS           64              /* Windows per client */
+#define SERVICE_RING_ENTRIES        64              /* Power of two */
+
+/* Clients that send nothing for this long are dropped with their windows */
+#define SERVICE_DEFAULT_CLIENT_TIMEOUT_US   2000000
+
+/* Largest params block: V2 params, a region list and an effect list */
+#define SERVICE_MAX_PARAMS_BYTES \
+    ((sizeof(EffectParams_V2) + sizeof(BlurRegionList_V1) + sizeof(BlurEffectList_V1) + 7) / 8 * 8)
+
+/* Commands */
+#define SERVICE_CMD_APPLY   1   /* Track handle at rect with params; replies once its first frame is out */
+#define SERVICE_CMD_MOVE    2   /* New screen rect for handle */
+#define SERVICE_CMD_CLEAR   3   /* Stop blurring handle and free its slot */
+
+/* ServiceClientBlock states */
+#define SERVICE_CLIENT_FREE         0
+#define SERVICE_CLIENT_CLAIMED      1   /* A client is resetting the block */
+#define SERVICE_CLIENT_ATTACHED     2
+#define SERVICE_CLIENT_DETACHING    3   /* The host frees its windows, then the block */
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the shared segment needs address-free atomics");
+
+/* ============================================================================
+ * Wire layout (little-endian, as on every target)
+ * ============================================================================ */
+struct ServiceCommand {
+    uint32_t type;              /* SERVICE_CMD_* */
+    uint32_t sequence;          /* Echoed by the reply */
+    uint64_t handle;            /* The client's window */
+    int32_t  left, top, right, bottom;  /* Screen rect (APPLY and MOVE) */
+    uint32_t params_bytes;      /* APPLY: bytes of params used */
+    uint32_t reserved;
+    uint8_t  params[SERVICE_MAX_PARAMS_BYTES];
+};
+
+struct ServiceReply {
+    uint32_t sequence;
+    int32_t  status;            /* BLUR_* */
+    uint64_t handle;
+    uint32_t slot;              /* APPLY: the client's slot holding the window's frames */
+    uint32_t reserved;
+};
+
+/* Single producer, single consumer; indices only ever grow and wrap at 2^32 */
+template <typename T>
+struct ServiceRing {
+    alignas(64) std::atomic<uint32_t> head;     /* Written by the producer */
+    alignas(64) std::atomic<uint32_t> tail;     /* Written by the consumer */
+    alignas(64) T entries[SERVICE_RING_ENTRIES];
+
+    void reset() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(const T& entry) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == SERVICE_RING_ENTRIES) return false;
+        entries[h % SERVICE_RING_ENTRIES] = entry;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T* entry) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        *entry = entries[t % SERVICE_RING_ENTRIES];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+struct ServiceHeader {
+    uint32_t magic;                 /* SERVICE_MAGIC once the host finished setting up */
+    uint32_t version;               /* SERVICE_PROTOCOL_VERSION */
+    uint32_t max_clients;
+    uint32_t slots_per_client;
+    uint64_t slot_bytes;            /* Pixel bytes per frame slot */
+    uint64_t segment_bytes;
+    std::atomic<uint32_t> host_running;
+    uint32_t reserved;
+    std::atomic<uint64_t> host_heartbeat_us;    /* service_now_us() of the host's latest poll */
+    std::atomic<uint64_t> ticks;
+};
+
+struct ServiceClientBlock {
+    alignas(64) std::atomic<uint32_t> state;    /* SERVICE_CLIENT_* */
+    std::atomic<uint32_t> generation;           /* Bumped by every claim */
+    std::atomic<uint64_t> heartbeat_us;         /* service_now_us() of the client's latest call */
+    uint32_t pid;
+    uint32_t reserved;
+    ServiceRing<ServiceCommand> commands;
+    ServiceRing<ServiceReply>   replies;
+};
+
+/* Seqlock: sequence is odd while the host rewrites the slot */
+struct ServiceSlotHeader {
+    std::atomic<uint32_t> sequence;
+    uint32_t reserved;
+    uint64_t handle;                /* 0: free */
+    uint64_t frame;                 /* Frames published to the slot so far */
+    int32_t  width;                 /* Rows of width * 4 bytes follow the header */
+    int32_t  height;
+};
+
+#define SERVICE_SLOT_HEADER_BYTES 64
+static_assert(sizeof(ServiceSlotHeader) <= SERVICE_SLOT_HEADER_BYTES, "slot header grew");
+
+/* Segment bytes for a host configuration */
+size_t service_segment_bytes(uint32_t max_clients, uint32_t slots_per_client, uint64_t slot_bytes);
+
+/* Microseconds on a clock every process on the machine shares */
+uint64_t service_now_us(void);
+
+/* ============================================================================
+ * Shared memory
+ * ============================================================================ */
+class SharedSegment {
+public:
+    SharedSegment();
+    ~SharedSegment();
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    /* Creates a zero-filled segment, replacing a stale one of the same name */
+    int32_t create(const char* name, size_t bytes);
+
+    /* Maps an existing segment; BLUR_NOT_INITIALIZED if there is none */
+    int32_t open(const char* name);
+
+    /* Unmaps; the creator also removes the name */
+    void close();
+
+    uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    uint8_t* m_data;
+    size_t   m_size;
+    bool     m_owner;
+    char     m_name[64];
+    void*    m_handle;              /* The file mapping on Windows */
+};
+
+/* ============================================================================
+ * Host
+ * ============================================================================ */
+struct ServiceHostOptions {
+    uint32_t max_clients = 8;
+    uint32_t slots_per_client = 8;
+    uint64_t slot_bytes = (uint64_t)1920 * 1080 * 4;    /* Largest window frame */
+    uint64_t client_timeout_us = SERVICE_DEFAULT_CLIENT_TIMEOUT_US;
+};
+
+struct ServiceHostStats {
+    uint64_t ticks;                 /* Shared ticks that rendered windows */
+    uint64_t commands;
+    uint64_t rejected;              /* Commands answered with an error */
+    uint64_t denied;                /* Of those, commands on another client's handle */
+    uint64_t frames;                /* Frames published to slots */
+    uint64_t replies_dropped;       /* Replies to clients whose reply ring was full */
+    uint64_t clients_attached;
+    uint64_t clients_reaped;        /* Clients dropped for missing heartbeats */
+    TickStats shared;               /* Capture and blur savings, summed over ticks */
+};
+
+class ServiceHost {
+public:
+    ServiceHost();
+    ~ServiceHost();
+
+    /* Creates the segment; source provides the screen for every tick and must outlive the host */
+    int32_t start(const char* name, const ServiceHostOptions& options, CaptureSource* source);
+
+    /* Tells attached clients the host is gone and removes the segment */
+    void stop();
+
+    /* Takes every pending command, and drops detached and silent clients */
+    void poll(uint64_t now_us);
+
+    /* Polls, then captures, blurs and publishes every window that is due */
+    int32_t tick(uint64_t now_us);
+
+    /* When the next window is due (UINT64_MAX: none tracked) */
+    uint64_t next_due_us() const;
+
+    uint32_t window_count() const { return (uint32_t)m_windows.size(); }
+    ServiceHostStats stats() const { return m_stats; }
+
+private:
+    struct Window {
+        uint32_t       client;
+        uint32_t       generation;
+        uint32_t       slot;
+        RegionRect     screen;
+        std::vector<uint8_t> params;    /* Owned copy the settings point into */
+        BlurSettings   settings;
+        bool           has_effects = false;
+        EffectProgram  effects;
+        BlurKernel     kernel;          /* Used once the kernel cache is full */
+        BackdropCache  backdrop;
+        std::vector<uint8_t> target;
+        uint64_t       next_due_us = 0;
+        bool           reply_pending = false;  /* APPLY answered after the first frame */
+        uint32_t       reply_sequence = 0;
+    };
+
+    ServiceClientBlock* client_block(uint32_t client) const;
+    ServiceSlotHeader* slot_header(uint32_t client, uint32_t slot) const;
+    void reply(uint32_t client, uint32_t sequence, int32_t status, uint64_t handle, uint32_t slot);
+    int32_t execute(uint32_t client, uint32_t generation, const ServiceCommand& cmd, bool* deferred);
+    int32_t apply(uint32_t client, uint32_t generation, const ServiceCommand& cmd, bool* deferred);
+    void release_window(std::map<uint64_t, Window>::iterator it);
+    void release_client(uint32_t client);
+    void publish(Window* w, uint64_t handle, bool rendered);
+
+    SharedSegment m_segment;
+    ServiceHeader* m_header;
+    ServiceHostOptions m_options;
+    CaptureSource* m_source;
+    std::map<uint64_t, Window> m_windows;
+    std::vector<uint32_t> m_generations;    /* Generation each attached client was admitted with */
+    ServiceHostStats m_stats;
+};
+
+/* ============================================================================
+ * Client
+ * ============================================================================ */
+class ServiceClient {
+public:
+    ServiceClient();
+    ~ServiceClient();
+
+    /*
+     * Claims a client block of the host's segment. BLUR_NOT_INITIALIZED if no
+     * host runs under name, BLUR_API_UNSUPPORTED for another protocol version
+     * and BLUR_OUT_OF_MEMORY if every block is taken.
+     */
+    int32_t attach(const char* name);
+
+    /* Hands every window back to the host */
+    void detach();
+
+    bool attached() const { return m_block != nullptr; }
+
+    /*
+     * Starts or updates the blur of handle at screen. Returns once the host
+     * published its first frame, or BLUR_TIMEOUT; *slot (optional) receives
+     * the slot holding its frames.
+     */
+    int32_t apply(uint64_t handle, const RegionRect& screen, const EffectParams* params,
+                  uint32_t timeout_ms, uint32_t* slot);
+    int32_t move(uint64_t handle, const RegionRect& screen, uint32_t timeout_ms);
+    int32_t clear(uint64_t handle, uint32_t timeout_ms);
+
+    /*
+     * Copies the newest frame of handle into dst (at least its size) when it
+     * is newer than *frame, updating *frame. BLUR_TIMEOUT if there is no new
+     * frame yet, BLUR_INVALID_HANDLE if the slot no longer holds handle.
+     */
+    int32_t read_frame(uint64_t handle, uint32_t slot, BlurSurface* dst, uint64_t* frame);
+
+    /* Keeps the client's windows alive while it sends no commands */
+    void heartbeat();
+
+private:
+    int32_t call(ServiceCommand* cmd, uint32_t timeout_ms, ServiceReply* reply);
+    bool host_alive() const;
+
+    std::mutex m_mutex;             /* Calls share the rings */
+    SharedSegment m_segment;
+    ServiceHeader* m_header;
+    ServiceClientBlock* m_block;
+    uint32_t m_index;
+    uint32_t m_generation;
+    uint32_t m_sequence;
+};
+
+#endif /* BLUR_LIB_BLUR_SERVICE_H */
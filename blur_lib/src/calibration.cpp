@@ -0,0 +1,301 @@
+/*
+ * calibration.cpp - Startup self-calibration of the CPU blur algorithms
+ */
+
+#include "calibration.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CAL_HAVE_CPUID 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CAL_HAVE_CPUID 1
+#endif
+
+/* Synthetic frame sizes and sigmas: small enough to keep startup in the milliseconds */
+#define CAL_SMALL_W   128
+#define CAL_LARGE_W   256
+#define CAL_H         128
+#define CAL_SIGMA_LO  4.0f
+#define CAL_SIGMA_HI  16.0f
+#define CAL_REPEATS   2
+
+static const uint32_t g_algorithms[CALIBRATION_ALGORITHMS] = {
+    BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX, BLUR_ALGORITHM_PYRAMID, BLUR_ALGORITHM_IIR
+};
+
+static std::mutex g_cal_mutex;
+static CalibrationModel g_active = {};
+
+/* Extended CPUID leaf into regs; false when the CPU lacks it */
+static bool cpuid_leaf(uint32_t leaf, uint32_t regs[4]) {
+#if defined(CAL_HAVE_CPUID) && defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, (int)(leaf & 0x80000000u));
+    if ((uint32_t)r[0] < leaf) return false;
+    __cpuid(r, (int)leaf);
+    memcpy(regs, r, sizeof(r));
+    return true;
+#elif defined(CAL_HAVE_CPUID)
+    return __get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]) != 0;
+#else
+    (void)leaf; (void)regs;
+    return false;
+#endif
+}
+
+uint32_t calibration_size_class(int64_t screen_pixels) {
+    static const int64_t limits[CALIBRATION_SIZE_CLASSES - 1] = { 1000000, 2500000, 5000000 };
+    uint32_t c = 0;
+    while (c < CALIBRATION_SIZE_CLASSES - 1 && screen_pixels > limits[c]) c++;
+    return c;
+}
+
+void current_calibration_key(int64_t screen_pixels, CalibrationKey* key) {
+    CalibrationKey k = {};
+    k.hardware_threads = std::thread::hardware_concurrency();
+    k.size_class = calibration_size_class(screen_pixels);
+
+    /* The brand string is 48 bytes in leaves 0x80000002..4; anything but [A-Za-z0-9().@+-] becomes '_' */
+    char brand[49] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        uint32_t regs[4];
+        if (!cpuid_leaf(0x80000002u + i, regs)) {
+            brand[0] = 0;
+            break;
+        }
+        memcpy(brand + i * 16, regs, 16);
+    }
+    size_t n = 0;
+    for (const char* p = brand; *p && n < sizeof(k.cpu_model) - 1; p++) {
+        char c = *p;
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                     (c && strchr("().@+-", c));
+        if (!plain) {
+            if (n && k.cpu_model[n - 1] != '_') k.cpu_model[n++] = '_';
+        } else {
+            k.cpu_model[n++] = c;
+        }
+    }
+    while (n && k.cpu_model[n - 1] == '_') n--;
+    k.cpu_model[n] = 0;
+    if (!n) snprintf(k.cpu_model, sizeof(k.cpu_model), "unknown");
+    *key = k;
+}
+
+static bool same_key(const CalibrationKey& a, const CalibrationKey& b) {
+    return a.hardware_threads == b.hardware_threads && a.size_class == b.size_class &&
+           strcmp(a.cpu_model, b.cpu_model) == 0;
+}
+
+/* Best of CAL_REPEATS runs, in nanoseconds */
+static double time_blur(BlurSurface* s, const BlurKernel* k) {
+    double best = 0.0;
+    for (int i = 0; i < CAL_REPEATS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        cpu_blur(s, s, k, CPU_BLUR_STREAMING);
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        if (i == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+int32_t run_calibration(const CalibrationKey& key, CalibrationModel* model) {
+    if (!model) return BLUR_INVALID_PARAMS;
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<uint8_t> pixels;
+    try {
+        pixels.resize((size_t)CAL_LARGE_W * CAL_H * 4);
+    } catch (const std::bad_alloc&) {
+        return BLUR_OUT_OF_MEMORY;
+    }
+    uint32_t seed = 0x9E3779B9u;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pixels[i] = (uint8_t)(seed >> 24);
+    }
+    BlurSurface small = { pixels.data(), CAL_SMALL_W, CAL_H, CAL_LARGE_W * 4 };
+    BlurSurface large = { pixels.data(), CAL_LARGE_W, CAL_H, CAL_LARGE_W * 4 };
+    const double small_px = (double)CAL_SMALL_W * CAL_H, large_px = (double)CAL_LARGE_W * CAL_H;
+
+    CalibrationModel m = {};
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        BlurKernel lo, hi;
+        build_blur_kernel(CAL_SIGMA_LO, g_algorithms[i], 1, &lo);
+        build_blur_kernel(CAL_SIGMA_HI, g_algorithms[i], 1, &hi);
+        double t_small_lo = time_blur(&small, &lo);
+        double t_small_hi = time_blur(&small, &hi);
+        double t_large_lo = time_blur(&large, &lo);
+
+        /* Two sizes give the per-pixel and fixed parts, two sigmas the sigma slope */
+        AlgorithmCost& c = m.costs[i];
+        c.algorithm = g_algorithms[i];
+        double per_px = (t_large_lo - t_small_lo) / (large_px - small_px);
+        if (per_px <= 0.0) per_px = t_large_lo / large_px;
+        c.fixed_ns = t_small_lo - per_px * small_px;
+        if (c.fixed_ns < 0.0) c.fixed_ns = 0.0;
+        c.ns_per_pixel_sigma = (t_small_hi - t_small_lo) / small_px / (CAL_SIGMA_HI - CAL_SIGMA_LO);
+        if (c.ns_per_pixel_sigma < 0.0) c.ns_per_pixel_sigma = 0.0;
+        c.ns_per_pixel = per_px - c.ns_per_pixel_sigma * CAL_SIGMA_LO;
+        if (c.ns_per_pixel < 0.0) c.ns_per_pixel = 0.0;
+    }
+
+    m.valid = true;
+    m.from_cache = false;
+    m.key = key;
+    m.measure_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    *model = m;
+    return BLUR_SUCCESS;
+}
+
+double predict_cost_ns(const CalibrationModel& model, uint32_t algorithm, int64_t pixels, float sigma) {
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        const AlgorithmCost& c = model.costs[i];
+        if (c.algorithm == algorithm) {
+            return c.fixed_ns + (double)pixels * (c.ns_per_pixel + c.ns_per_pixel_sigma * sigma);
+        }
+    }
+    return -1.0;
+}
+
+uint32_t choose_algorithm(const CalibrationModel& model, int64_t pixels, float sigma) {
+    if (!model.valid || sigma <= 0.0f) return BLUR_ALGORITHM_EXACT;
+
+    uint32_t best = BLUR_ALGORITHM_EXACT;
+    double best_ns = predict_cost_ns(model, BLUR_ALGORITHM_EXACT, pixels, sigma);
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        uint32_t a = model.costs[i].algorithm;
+        if (a == BLUR_ALGORITHM_PYRAMID) {
+            BlurKernel k;
+            build_blur_kernel(sigma, a, 1, &k);
+            if (k.levels == 0) continue;
+        }
+        double ns = predict_cost_ns(model, a, pixels, sigma);
+        if (ns >= 0.0 && ns < best_ns) {
+            best = a;
+            best_ns = ns;
+        }
+    }
+    return best;
+}
+
+void calibration_to_text(const CalibrationModel& model, std::string* out) {
+    std::ostringstream oss;
+    oss.precision(9);
+    oss << "shin-blur-calibration " << CALIBRATION_FORMAT_VERSION << "\n";
+    oss << "hardware_threads " << model.key.hardware_threads << "\n";
+    oss << "cpu_model " << model.key.cpu_model << "\n";
+    oss << "size_class " << model.key.size_class << "\n";
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        const AlgorithmCost& c = model.costs[i];
+        oss << "cost " << c.algorithm << " " << c.fixed_ns << " " << c.ns_per_pixel << " "
+            << c.ns_per_pixel_sigma << "\n";
+    }
+    *out = oss.str();
+}
+
+int32_t calibration_from_text(const char* text, const CalibrationKey& key, CalibrationModel* model) {
+    if (!text || !model) return BLUR_INVALID_PARAMS;
+
+    std::istringstream in(text);
+    std::string magic;
+    uint32_t version = 0;
+    if (!(in >> magic >> version) || magic != "shin-blur-calibration" ||
+        version != CALIBRATION_FORMAT_VERSION) {
+        return BLUR_INVALID_PARAMS;
+    }
+
+    CalibrationModel m = {};
+    std::string name, model_name;
+    if (!(in >> name >> m.key.hardware_threads) || name != "hardware_threads" ||
+        !(in >> name >> model_name) || name != "cpu_model" || model_name.size() >= sizeof(m.key.cpu_model) ||
+        !(in >> name >> m.key.size_class) || name != "size_class") {
+        return BLUR_INVALID_PARAMS;
+    }
+    memcpy(m.key.cpu_model, model_name.c_str(), model_name.size() + 1);
+    if (!same_key(m.key, key)) return BLUR_INVALID_PARAMS;
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        AlgorithmCost& c = m.costs[i];
+        if (!(in >> name >> c.algorithm >> c.fixed_ns >> c.ns_per_pixel >> c.ns_per_pixel_sigma) ||
+            name != "cost" || c.algorithm != g_algorithms[i] ||
+            c.fixed_ns < 0.0 || c.ns_per_pixel < 0.0 || c.ns_per_pixel_sigma < 0.0) {
+            return BLUR_INVALID_PARAMS;
+        }
+    }
+
+    m.valid = true;
+    m.from_cache = true;
+    m.measure_ms = 0.0;
+    *model = m;
+    return BLUR_SUCCESS;
+}
+
+void calibration_to_json(const CalibrationModel& model, std::string* out) {
+    static const char* names[] = { "exact", "box", "pyramid", "iir" };
+    std::ostringstream oss;
+    oss << "{\"valid\":" << (model.valid ? "true" : "false")
+        << ",\"from_cache\":" << (model.from_cache ? "true" : "false")
+        << ",\"hardware_threads\":" << model.key.hardware_threads
+        << ",\"cpu_model\":\"" << model.key.cpu_model << "\""
+        << ",\"size_class\":" << model.key.size_class
+        << ",\"measure_ms\":" << model.measure_ms
+        << ",\"costs\":[";
+    for (int32_t i = 0; model.valid && i < CALIBRATION_ALGORITHMS; i++) {
+        const AlgorithmCost& c = model.costs[i];
+        if (i) oss << ",";
+        oss << "{\"algorithm\":\"" << names[c.algorithm] << "\""
+            << ",\"fixed_ns\":" << c.fixed_ns
+            << ",\"ns_per_pixel\":" << c.ns_per_pixel
+            << ",\"ns_per_pixel_sigma\":" << c.ns_per_pixel_sigma << "}";
+    }
+    oss << "]";
+
+    /* What AUTO picks for typical windows at intensity 0.5 and 1.0 */
+    if (model.valid) {
+        static const int64_t sizes[] = { 640 * 480, 1920 * 1080, 3840 * 2160 };
+        oss << ",\"choices\":[";
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            for (int32_t j = 0; j < 2; j++) {
+                float sigma = sigma_from_intensity(j ? 1.0f : 0.5f);
+                if (i || j) oss << ",";
+                oss << "{\"pixels\":" << sizes[i] << ",\"sigma\":" << sigma
+                    << ",\"algorithm\":\"" << names[choose_algorithm(model, sizes[i], sigma)] << "\"}";
+            }
+        }
+        oss << "]";
+    }
+    oss << "}";
+    *out = oss.str();
+}
+
+void set_active_calibration(const CalibrationModel& model) {
+    std::lock_guard<std::mutex> lock(g_cal_mutex);
+    g_active = model;
+}
+
+void clear_active_calibration(void) {
+    std::lock_guard<std::mutex> lock(g_cal_mutex);
+    g_active = CalibrationModel();
+}
+
+bool get_active_calibration(CalibrationModel* model) {
+    std::lock_guard<std::mutex> lock(g_cal_mutex);
+    if (model) *model = g_active;
+    return g_active.valid;
+}
+
+uint32_t resolve_algorithm(uint32_t algorithm, int64_t pixels, float sigma) {
+    if (algorithm != BLUR_ALGORITHM_AUTO) return algorithm;
+    std::lock_guard<std::mutex> lock(g_cal_mutex);
+    return choose_algorithm(g_active, pixels, sigma);
+}
@@ -0,0 +1,79 @@
+/*
+ * calibration.h - Startup self-calibration of the CPU blur algorithms
+ *
+ * A few milliseconds of blurring synthetic frames give a per-machine cost
+ * model, which BLUR_ALGORITHM_AUTO uses to pick the cheapest algorithm for a
+ * window size and sigma. Models serialize to a small text format so later
+ * startups can skip the measurement.
+ */
+
+#ifndef BLUR_LIB_CALIBRATION_H
+#define BLUR_LIB_CALIBRATION_H
+
+#include "cpu_blur.h"
+#include <string>
+
+/* Algorithms the model measures */
+#define CALIBRATION_ALGORITHMS 4
+
+/* Bumped whenever the engine changes enough to invalidate cached models */
+#define CALIBRATION_FORMAT_VERSION 3
+
+/* Screen size classes: up to 1 MP, 2.5 MP (1080p), 5 MP (1440p), then larger */
+#define CALIBRATION_SIZE_CLASSES 4
+
+/* Cost of one algorithm: fixed_ns + pixels * (ns_per_pixel + ns_per_pixel_sigma * sigma) */
+struct AlgorithmCost {
+    uint32_t algorithm;
+    double   fixed_ns;
+    double   ns_per_pixel;
+    double   ns_per_pixel_sigma;
+};
+
+/* Machine a model was measured on; a cache only loads under an identical key */
+struct CalibrationKey {
+    uint32_t hardware_threads;
+    uint32_t size_class;                /* calibration_size_class() of the screen */
+    char     cpu_model[64];             /* CPU brand string without spaces, or "unknown" */
+};
+
+struct CalibrationModel {
+    bool          valid;
+    bool          from_cache;
+    CalibrationKey key;
+    double        measure_ms;           /* Time the measurement took (0 when cached) */
+    AlgorithmCost costs[CALIBRATION_ALGORITHMS];
+};
+
+uint32_t calibration_size_class(int64_t screen_pixels);
+
+/* Key of this machine with a screen of screen_pixels */
+void current_calibration_key(int64_t screen_pixels, CalibrationKey* key);
+
+/* Measures every algorithm on synthetic frames; takes a few tens of milliseconds at most */
+int32_t run_calibration(const CalibrationKey& key, CalibrationModel* model);
+
+double predict_cost_ns(const CalibrationModel& model, uint32_t algorithm, int64_t pixels, float sigma);
+
+/*
+ * Cheapest algorithm for pixels at sigma. Pyramids are only candidates once
+ * they actually reduce; without a valid model the answer is the exact kernel.
+ */
+uint32_t choose_algorithm(const CalibrationModel& model, int64_t pixels, float sigma);
+
+/* Cache file contents; parsing fails for other format versions or keys */
+void calibration_to_text(const CalibrationModel& model, std::string* out);
+int32_t calibration_from_text(const char* text, const CalibrationKey& key, CalibrationModel* model);
+
+/* Diagnostics JSON, as returned by blur_get_calibration_info() */
+void calibration_to_json(const CalibrationModel& model, std::string* out);
+
+/* Process-wide model used by BLUR_ALGORITHM_AUTO */
+void set_active_calibration(const CalibrationModel& model);
+void clear_active_calibration(void);
+bool get_active_calibration(CalibrationModel* model);
+
+/* Resolves BLUR_ALGORITHM_AUTO with the active model; other values pass through */
+uint32_t resolve_algorithm(uint32_t algorithm, int64_t pixels, float sigma);
+
+#endif /* BLUR_LIB_CALIBRATION_H */
@@ -0,0 +1,445 @@
+/*
+ * capture_planner.cpp - Shared screen capture for one refresh tick
+ */
+
+#include "capture_planner.h"
+#include "scratch_arena.h"
+#include "stats.h"
+#include <chrono>
+#include <cstring>
+
+static RegionRect offset_rect(const RegionRect& r, int32_t dx, int32_t dy) {
+    RegionRect o = { r.left + dx, r.top + dy, r.right + dx, r.bottom + dy };
+    return o;
+}
+
+static void offset_region(const std::vector<RegionRect>& in, int32_t dx, int32_t dy,
+                          std::vector<RegionRect>* out) {
+    out->clear();
+    for (const RegionRect& r : in) out->push_back(offset_rect(r, dx, dy));
+}
+
+/* Copies a w x h block between two surfaces */
+static void copy_block(const BlurSurface* src, int32_t sx, int32_t sy,
+                       BlurSurface* dst, int32_t dx, int32_t dy, int32_t w, int32_t h) {
+    for (int32_t y = 0; y < h; y++) {
+        memcpy(dst->pixels + (size_t)(dy + y) * dst->stride + (size_t)dx * 4,
+               src->pixels + (size_t)(sy + y) * src->stride + (size_t)sx * 4, (size_t)w * 4);
+    }
+}
+
+/*
+ * Reduced-resolution kernels snap to a grid anchored at their source view,
+ * which differs per window, so only full-resolution results can be shared.
+ * A recursive kernel's result depends on the extent of the rect it runs over.
+ */
+static bool shareable_kernels(const BlurKernel* a, const BlurKernel* b) {
+    return a->scale == 1 && !kernel_is_recursive(a) && kernels_equal(a, b);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t elapsed_us(Clock::time_point since) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count();
+}
+
+/* Time blurred rects took: summed over their bands on every thread, and waited for by the caller */
+struct BlurTime {
+    uint64_t busy_us;
+    uint64_t wait_us;
+};
+
+/* Smallest band worth a task: each band re-reads a kernel radius of rows above and below */
+#define TICK_BAND_MIN_ROWS 32
+
+/* One row band of a blurred rect */
+struct BandJob {
+    const BlurSurface* src;
+    BlurSurface        dst;             /* View of the band in the destination */
+    const BlurKernel*  kernel;
+    CpuBlurMode        mode;
+    int32_t            x0, y0;          /* Band origin in src */
+    int32_t            rc;
+    uint64_t           busy_us;         /* On whichever thread ran it */
+};
+
+static void run_band(void* ctx) {
+    BandJob* job = (BandJob*)ctx;
+    Clock::time_point start = Clock::now();
+    job->rc = cpu_blur_rect(job->src, &job->dst, job->kernel, job->mode, job->x0, job->y0);
+    job->busy_us = elapsed_us(start);
+}
+
+/*
+ * cpu_blur_rect() split into row bands on the executor. Every output pixel
+ * depends only on its position in src, so the bands add up to the same
+ * result as one call; recursive kernels are not banded, as their recursion
+ * runs over the rect. Jobs live in the caller's arena until the wait returns.
+ * Adds the time of every band to time.
+ */
+static int32_t blur_rect_tasks(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                               CpuBlurMode mode, int32_t x0, int32_t y0,
+                               uint32_t lane, uint32_t max_tasks, ScratchArena& arena, BlurTime* time) {
+    Clock::time_point start = Clock::now();
+    int32_t tasks = (int32_t)executor_workers() + 1;
+    if (max_tasks && (int32_t)max_tasks < tasks) tasks = (int32_t)max_tasks;
+    int32_t min_rows = kernel->radius * 2 > TICK_BAND_MIN_ROWS ? kernel->radius * 2 : TICK_BAND_MIN_ROWS;
+    int32_t rows = (dst->height + tasks - 1) / (tasks > 0 ? tasks : 1);
+    if (rows < min_rows) rows = min_rows;
+    if (tasks <= 1 || rows >= dst->height || kernel_is_recursive(kernel)) {
+        int32_t rc = cpu_blur_rect(src, dst, kernel, mode, x0, y0);
+        uint64_t us = elapsed_us(start);
+        time->busy_us += us;
+        time->wait_us += us;
+        return rc;
+    }
+
+    int32_t bands = (dst->height + rows - 1) / rows;
+    BandJob* jobs = arena.alloc_array<BandJob>((size_t)bands);
+    if (!jobs) return BLUR_OUT_OF_MEMORY;
+    TaskGroup group;
+    for (int32_t b = 0; b < bands; b++) {
+        int32_t top = b * rows;
+        int32_t bottom = top + rows < dst->height ? top + rows : dst->height;
+        RegionRect band = { 0, top, dst->width, bottom };
+        BandJob& job = jobs[b];
+        job.src = src;
+        job.dst = surface_view(dst, band);
+        job.kernel = kernel;
+        job.mode = mode;
+        job.x0 = x0;
+        job.y0 = y0 + top;
+        job.rc = BLUR_SUCCESS;
+        job.busy_us = 0;
+        executor_submit(lane, run_band, &job, &group);
+    }
+    executor_wait(&group, lane);
+    time->wait_us += elapsed_us(start);
+
+    int32_t rc = BLUR_SUCCESS;
+    for (int32_t b = 0; b < bands; b++) {
+        time->busy_us += jobs[b].busy_us;
+        if (jobs[b].rc != BLUR_SUCCESS && rc == BLUR_SUCCESS) rc = jobs[b].rc;
+    }
+    return rc;
+}
+
+static size_t find_root(std::vector<size_t>& parent, size_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/* Output pixels blurred once for several windows that share a kernel */
+struct SharedBlur {
+    const BlurKernel* kernel;
+    std::vector<RegionRect> region;                 /* Frame coordinates */
+    uint8_t** pixels;                               /* Arena buffer per region rect */
+    uint64_t busy_us;                               /* Split evenly between the windows in the group */
+    uint32_t users;
+};
+
+/*
+ * Geometry scratch kept per thread. Vectors are cleared rather than freed and
+ * per-window lists only ever grow, so a steady tick reuses their capacity.
+ */
+struct TickScratch {
+    std::vector<RegionRect> bounds, shifted, deflated, both, pieces, from_shared, own, unreused, needed;
+    std::vector<size_t> parent, cluster_of, group;
+    std::vector<std::vector<RegionRect>> outputs, interiors;
+    std::vector<SharedBlur> shared;
+    std::vector<CaptureCluster> clusters;
+    uint64_t blur_wait_us;                          /* Caller time spent in blurs this tick */
+};
+
+static TickScratch& tick_scratch() {
+    thread_local TickScratch scratch;
+    return scratch;
+}
+
+template <typename T>
+static void reuse_lists(std::vector<std::vector<T>>* lists, size_t n) {
+    if (lists->size() < n) lists->resize(n);
+    for (size_t i = 0; i < n; i++) (*lists)[i].clear();
+}
+
+/* Window-relative pixels a window captures: its whole plan, or the halo of what it still blurs itself */
+static const std::vector<RegionRect>& needed_capture(const TickWindow& w, TickScratch& ts) {
+    if (w.reused.empty()) return w.plan.capture;
+    region_subtract(w.plan.output, w.reused, &ts.unreused);
+    RegionRect win = { 0, 0, w.target.width, w.target.height };
+    region_inflate(ts.unreused, w.kernel->radius, win, &ts.needed);
+    return ts.needed;
+}
+
+void plan_shared_capture(const TickWindow* windows, size_t count,
+                         std::vector<CaptureCluster>* clusters) {
+    TickScratch& ts = tick_scratch();
+    std::vector<RegionRect>& bounds = ts.bounds;
+    bounds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const TickWindow& w = windows[i];
+        bounds[i] = offset_rect(region_bounds(w.plan.capture), w.screen.left, w.screen.top);
+    }
+
+    /* Union-find over overlapping capture bounds; tick sizes are small */
+    std::vector<size_t>& parent = ts.parent;
+    parent.resize(count);
+    for (size_t i = 0; i < count; i++) parent[i] = i;
+    for (size_t i = 0; i < count; i++) {
+        if (rect_is_empty(bounds[i])) continue;
+        for (size_t j = i + 1; j < count; j++) {
+            if (!rect_is_empty(rect_intersect(bounds[i], bounds[j]))) {
+                parent[find_root(parent, j)] = find_root(parent, i);
+            }
+        }
+    }
+
+    /* Count clusters first so existing entries (and their capacity) are reused; frames cover whole plans */
+    std::vector<size_t>& cluster_of = ts.cluster_of;
+    cluster_of.assign(count, (size_t)-1);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (rect_is_empty(bounds[i])) continue;
+        size_t root = find_root(parent, i);
+        if (cluster_of[root] == (size_t)-1) cluster_of[root] = n++;
+    }
+    clusters->resize(n);
+    for (CaptureCluster& cl : *clusters) cl.members.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (!rect_is_empty(bounds[i])) (*clusters)[cluster_of[find_root(parent, i)]].members.push_back(i);
+    }
+
+    std::vector<RegionRect>& requested = ts.pieces;
+    for (CaptureCluster& cl : *clusters) {
+        requested.clear();
+        cl.bounds = bounds[cl.members[0]];
+        for (size_t i : cl.members) {
+            const RegionRect& b = bounds[i];
+            cl.bounds.left = b.left < cl.bounds.left ? b.left : cl.bounds.left;
+            cl.bounds.top = b.top < cl.bounds.top ? b.top : cl.bounds.top;
+            cl.bounds.right = b.right > cl.bounds.right ? b.right : cl.bounds.right;
+            cl.bounds.bottom = b.bottom > cl.bounds.bottom ? b.bottom : cl.bounds.bottom;
+            offset_region(needed_capture(windows[i], ts), windows[i].screen.left, windows[i].screen.top, &ts.shifted);
+            requested.insert(requested.end(), ts.shifted.begin(), ts.shifted.end());
+        }
+        region_union(requested.data(), requested.size(), &cl.areas);
+    }
+}
+
+static int32_t render_cluster(TickWindow* windows, const CaptureCluster& cl,
+                              const BlurSurface* frame, TickStats* stats) {
+    const size_t n = cl.members.size();
+    TickScratch& ts = tick_scratch();
+    ScratchArena& arena = scratch_arena();
+    ArenaScope scope(arena);
+
+    /*
+     * A pixel's blur only depends on the frame when its whole kernel footprint
+     * lies inside the window; nearer the edge the footprint is clamped to the
+     * window. Only such interior pixels can be shared.
+     */
+    std::vector<std::vector<RegionRect>>& outputs = ts.outputs;
+    std::vector<std::vector<RegionRect>>& interiors = ts.interiors;
+    reuse_lists(&outputs, n);
+    reuse_lists(&interiors, n);
+    std::vector<RegionRect>& deflated = ts.deflated;
+    deflated.resize(1);
+    for (size_t m = 0; m < n; m++) {
+        const TickWindow& w = windows[cl.members[m]];
+        int32_t dx = w.screen.left - cl.bounds.left, dy = w.screen.top - cl.bounds.top;
+        if (w.reused.empty()) {
+            offset_region(w.plan.output, dx, dy, &outputs[m]);
+        } else {
+            region_subtract(w.plan.output, w.reused, &ts.unreused);
+            offset_region(ts.unreused, dx, dy, &outputs[m]);
+        }
+        if (!w.kernel) continue;
+        RegionRect win = { dx, dy, dx + w.target.width, dy + w.target.height };
+        deflated[0] = rect_inflate(win, -w.kernel->radius);
+        if (rect_is_empty(deflated[0])) continue;
+        region_intersect(outputs[m], deflated, &interiors[m]);
+    }
+
+    /* Windows with shareable equal kernels form one group; each group shares one blur */
+    std::vector<SharedBlur>& shared = ts.shared;
+    size_t groups = 0;
+    std::vector<size_t>& group = ts.group;
+    group.assign(n, (size_t)-1);
+    for (size_t a = 0; a < n; a++) {
+        const BlurKernel* ka = windows[cl.members[a]].kernel;
+        if (!ka) continue;
+        for (size_t b = 0; b < a && group[a] == (size_t)-1; b++) {
+            const BlurKernel* kb = windows[cl.members[b]].kernel;
+            if (kb && shareable_kernels(ka, kb)) group[a] = group[b];
+        }
+        if (group[a] == (size_t)-1) {
+            group[a] = groups++;
+            if (shared.size() < groups) shared.resize(groups);
+            shared[group[a]].kernel = ka;
+            shared[group[a]].region.clear();
+        }
+    }
+
+    std::vector<RegionRect>& both = ts.both;
+    std::vector<RegionRect>& pieces = ts.pieces;
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = a + 1; b < n; b++) {
+            if (group[a] == (size_t)-1 || group[a] != group[b]) continue;
+            region_intersect(interiors[a], interiors[b], &both);
+            if (both.empty()) continue;
+            std::vector<RegionRect>& region = shared[group[a]].region;
+            pieces.assign(region.begin(), region.end());
+            pieces.insert(pieces.end(), both.begin(), both.end());
+            region_union(pieces.data(), pieces.size(), &region);
+        }
+    }
+
+    for (size_t g = 0; g < groups; g++) {
+        SharedBlur& sb = shared[g];
+        /* A shared blur runs on the most urgent lane of the windows that use it */
+        uint32_t lane = EXECUTOR_LANE_BACKGROUND, max_tasks = 0;
+        bool unlimited = false;
+        for (size_t m = 0; m < n; m++) {
+            const TickWindow& w = windows[cl.members[m]];
+            if (group[m] != g) continue;
+            if (w.lane < lane) lane = w.lane;
+            if (!w.max_tasks) unlimited = true;
+            else if (w.max_tasks > max_tasks) max_tasks = w.max_tasks;
+        }
+        if (unlimited) max_tasks = 0;
+        sb.users = 0;
+        for (size_t m = 0; m < n; m++) sb.users += group[m] == g ? 1 : 0;
+        BlurTime time = { 0, 0 };
+        sb.pixels = arena.alloc_array<uint8_t*>(sb.region.size());
+        if (!sb.pixels && !sb.region.empty()) return BLUR_OUT_OF_MEMORY;
+        for (size_t i = 0; i < sb.region.size(); i++) {
+            const RegionRect& r = sb.region[i];
+            sb.pixels[i] = arena.alloc_array<uint8_t>((size_t)rect_area(r) * 4);
+            if (!sb.pixels[i]) return BLUR_OUT_OF_MEMORY;
+            BlurSurface dst = { sb.pixels[i], r.right - r.left, r.bottom - r.top, (r.right - r.left) * 4 };
+            int32_t rc = blur_rect_tasks(frame, &dst, sb.kernel, CPU_BLUR_STREAMING, r.left, r.top,
+                                         lane, max_tasks, arena, &time);
+            if (rc != BLUR_SUCCESS) return rc;
+        }
+        sb.busy_us = time.busy_us;
+        ts.blur_wait_us += time.wait_us;
+        stats->pixels_blur_computed += region_area(sb.region);
+    }
+
+    std::vector<RegionRect>& from_shared = ts.from_shared;
+    std::vector<RegionRect>& own = ts.own;
+    for (size_t m = 0; m < n; m++) {
+        TickWindow& w = windows[cl.members[m]];
+        int32_t dx = w.screen.left - cl.bounds.left, dy = w.screen.top - cl.bounds.top;
+
+        if (!w.kernel) {
+            for (const RegionRect& r : w.plan.capture) {
+                copy_block(frame, r.left + dx, r.top + dy, &w.target, r.left, r.top,
+                           r.right - r.left, r.bottom - r.top);
+            }
+            if (w.backdrop) backdrop_reset(w.backdrop, w.screen);
+            continue;
+        }
+
+        /* The halo stays transparent; the output is written over it below */
+        for (const RegionRect& r : w.plan.capture) clear_rect(&w.target, r);
+        if (!w.reused.empty()) backdrop_restore(w.backdrop, w.screen, w.reused, &w.target);
+
+        from_shared.clear();
+        if (group[m] != (size_t)-1) {
+            region_intersect(interiors[m], shared[group[m]].region, &from_shared);
+        }
+        region_subtract(outputs[m], from_shared, &own);
+
+        /* The window's own pixels clamp at its capture bounds, as a private capture would */
+        RegionRect cb = offset_rect(region_bounds(w.plan.capture), dx, dy);
+        BlurSurface src = surface_view(frame, cb);
+        BlurTime time = { 0, 0 };
+        for (const RegionRect& r : own) {
+            BlurSurface dst = surface_view(&w.target, offset_rect(r, -dx, -dy));
+            int32_t rc = blur_rect_tasks(&src, &dst, w.kernel, w.mode, r.left - cb.left, r.top - cb.top,
+                                         w.lane, w.max_tasks, arena, &time);
+            if (rc != BLUR_SUCCESS) return rc;
+        }
+        w.cost_us += time.busy_us;
+        ts.blur_wait_us += time.wait_us;
+        if (group[m] != (size_t)-1) w.cost_us += shared[group[m]].busy_us / shared[group[m]].users;
+        stats->pixels_blur_requested += region_area(outputs[m]);
+        stats->pixels_blur_computed += region_area(own);
+
+        if (!from_shared.empty()) {
+            const SharedBlur& sb = shared[group[m]];
+            for (size_t i = 0; i < sb.region.size(); i++) {
+                const RegionRect& s = sb.region[i];
+                BlurSurface blurred = { sb.pixels[i], s.right - s.left, s.bottom - s.top,
+                                        (s.right - s.left) * 4 };
+                for (const RegionRect& u : from_shared) {
+                    RegionRect r = rect_intersect(u, s);
+                    if (rect_is_empty(r)) continue;
+                    copy_block(&blurred, r.left - s.left, r.top - s.top, &w.target,
+                               r.left - dx, r.top - dy, r.right - r.left, r.bottom - r.top);
+                }
+            }
+        }
+
+        if (w.backdrop) backdrop_store(w.backdrop, w.screen, w.kernel, w.plan.output, &w.target);
+        finish_region_blur(&w.target, &w.plan, w.color_argb, w.effects);
+    }
+    return BLUR_SUCCESS;
+}
+
+int32_t run_shared_tick(TickWindow* windows, size_t count, CaptureSource* source,
+                        TickStats* stats) {
+    if ((!windows && count) || !source || !stats) return BLUR_INVALID_PARAMS;
+    memset(stats, 0, sizeof(*stats));
+    Clock::time_point start = Clock::now();
+    TickScratch& ts = tick_scratch();
+    ts.blur_wait_us = 0;
+
+    /* Moving windows take what they can from their last tick before anything is captured */
+    for (size_t i = 0; i < count; i++) {
+        TickWindow& w = windows[i];
+        w.cost_us = 0;
+        backdrop_reusable(w.backdrop, w.screen, w.kernel, w.plan.output, &w.reused);
+        stats->pixels_reused += region_area(w.reused);
+    }
+
+    std::vector<CaptureCluster>& clusters = ts.clusters;
+    plan_shared_capture(windows, count, &clusters);
+    for (size_t i = 0; i < count; i++) stats->pixels_requested += region_area(needed_capture(windows[i], ts));
+
+    for (const CaptureCluster& cl : clusters) {
+        BlurSurface frame;
+        int32_t rc = source->begin_frame(cl.bounds, &frame);
+        if (rc != BLUR_SUCCESS) return rc;
+        for (const RegionRect& a : cl.areas) source->capture(a);
+        stats->pixels_captured += region_area(cl.areas);
+        stats->frames++;
+
+        rc = render_cluster(windows, cl, &frame, stats);
+        source->end_frame();
+        if (rc != BLUR_SUCCESS) return rc;
+    }
+
+    /* Capture, copies and effects ran on the caller outside the blurs; windows share them by capture area */
+    uint64_t wall_us = elapsed_us(start);
+    uint64_t rest_us = wall_us > ts.blur_wait_us ? wall_us - ts.blur_wait_us : 0;
+    int64_t captured = 0;
+    for (size_t i = 0; i < count; i++) captured += region_area(windows[i].plan.capture);
+    for (size_t i = 0; i < count; i++) {
+        TickWindow& w = windows[i];
+        if (captured > 0) w.cost_us += (uint64_t)((double)rest_us * region_area(w.plan.capture) / (double)captured);
+        stats->cost_us += w.cost_us;
+    }
+    return BLUR_SUCCESS;
+}
+
+void record_tick_stats(const TickStats& stats) {
+    stats_add(BLUR_STAT_PIXELS_CAPTURED, (uint64_t)stats.pixels_captured);
+    stats_add(BLUR_STAT_PIXELS_CAPTURE_SAVED, (uint64_t)(stats.pixels_requested - stats.pixels_captured));
+    stats_add(BLUR_STAT_PIXELS_BLUR_SAVED, (uint64_t)(stats.pixels_blur_requested - stats.pixels_blur_computed));
+    stats_add(BLUR_STAT_PIXELS_REUSED, (uint64_t)stats.pixels_reused);
+}
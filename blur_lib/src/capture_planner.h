@@ -0,0 +1,88 @@
+/*
+ * capture_planner.h - Shared screen capture for one refresh tick
+ *
+ * Every blurred window needs the desktop pixels under its capture plan. When
+ * windows overlap, those areas overlap too, so a tick groups overlapping
+ * windows into clusters, captures the union of each cluster's areas once into
+ * a shared frame and renders every window from a view of that frame. Pixels
+ * that several windows blur with the same kernel are blurred only once.
+ */
+
+#ifndef BLUR_LIB_CAPTURE_PLANNER_H
+#define BLUR_LIB_CAPTURE_PLANNER_H
+
+#include "backdrop_cache.h"
+#include "executor.h"
+
+/*
+ * Where the screen pixels come from: GDI on Windows, synthetic sources in the
+ * tests. All rects are in screen coordinates.
+ */
+class CaptureSource {
+public:
+    virtual ~CaptureSource() {}
+
+    /* Provides zeroed, bounds-sized storage for the next frame */
+    virtual int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) = 0;
+
+    /* Copies one screen area (inside bounds) into the current frame */
+    virtual void capture(const RegionRect& area) = 0;
+
+    /* Releases the current frame */
+    virtual void end_frame() = 0;
+};
+
+struct TickWindow {
+    uintptr_t      handle;
+    RegionRect     screen;      /* Window rect in screen coordinates */
+    RegionBlurPlan plan;        /* Window-relative, already clipped to the visible area */
+    const BlurKernel* kernel;   /* NULL: copy the captured pixels only (GPU blur later) */
+    uint32_t       color_argb;
+    const EffectProgram* effects = nullptr; /* Replaces the color_argb tint; runs after the backdrop store */
+    CpuBlurMode    mode;
+    BlurSurface    target;      /* Window-sized and zeroed; receives the result */
+    BackdropCache* backdrop = nullptr;  /* Reused while the window moves; NULL: always blur in full */
+    std::vector<RegionRect> reused;     /* Set by run_shared_tick: output copied from the backdrop */
+    uint32_t       lane = EXECUTOR_LANE_BACKGROUND; /* Executor lane of its blur tasks */
+    uint32_t       max_tasks = 0;       /* Row bands per blurred rect (0: one per worker plus the caller) */
+    uint64_t       cost_us = 0;         /* Set by run_shared_tick: its blur time summed over bands on every
+                                           thread, plus its share of the rest of the tick by capture area */
+};
+
+struct TickStats {
+    int64_t pixels_requested;   /* Sum of every window's capture area */
+    int64_t pixels_captured;    /* Screen pixels actually copied */
+    int64_t pixels_blur_requested; /* Sum of every CPU window's output area */
+    int64_t pixels_blur_computed;  /* Output pixels actually blurred */
+    int64_t pixels_reused;      /* Output pixels copied from backdrop caches (in neither blur count) */
+    int32_t frames;             /* Shared frames (clusters) captured */
+    uint64_t cost_us;           /* Sum of every window's cost_us: time across all threads */
+};
+
+struct CaptureCluster {
+    RegionRect              bounds;     /* Frame rect in screen coordinates */
+    std::vector<RegionRect> areas;      /* Disjoint screen areas to capture */
+    std::vector<size_t>     members;    /* Indices into the window array */
+};
+
+/* Groups windows whose capture bounds overlap and merges their capture areas */
+void plan_shared_capture(const TickWindow* windows, size_t count,
+                         std::vector<CaptureCluster>* clusters);
+
+/*
+ * Captures and renders every window of one tick. Each target ends up exactly
+ * as cpu_blur_regions() would leave it after a private capture of the window;
+ * windows without a kernel get the raw captured pixels. Windows with a
+ * backdrop cache that moved since the last tick capture and blur only what
+ * the cache cannot supply; the result matches a full tick as long as the
+ * screen under them did not change. While the executor runs, every blurred
+ * rect is split into row bands on the windows' lanes and the caller helps
+ * until they are done.
+ */
+int32_t run_shared_tick(TickWindow* windows, size_t count, CaptureSource* source,
+                        TickStats* stats);
+
+/* Adds a tick's savings to the BLUR_STAT_* counters */
+void record_tick_stats(const TickStats& stats);
+
+#endif /* BLUR_LIB_CAPTURE_PLANNER_H */
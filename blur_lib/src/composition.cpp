@@ -11,7 +11,7 @@
 int32_t apply_composition_blur(HWND hwnd, const EffectParams* params,
                                SetWindowCompositionAttributeFunc pFunc) {
     if (!pFunc) {
-        set_last_error("SetWindowCompositionAttribute not available");
+        set_last_error(BLUR_API_UNSUPPORTED, ERR_MSG_SWCA_UNAVAILABLE);
         return BLUR_API_UNSUPPORTED;
     }
     
@@ -66,10 +66,7 @@ int32_t apply_composition_blur(HWND hwnd, const EffectParams* params,
     data.cbData = sizeof(accent);
     
     if (!pFunc(hwnd, &data)) {
-        DWORD error = GetLastError();
-        char msg[256];
-        snprintf(msg, sizeof(msg), "SetWindowCompositionAttribute failed with error %lu", error);
-        set_last_error(msg);
+        set_last_error(BLUR_INTERNAL_ERROR, ERR_MSG_SWCA_FAILED, GetLastError());
         return BLUR_INTERNAL_ERROR;
     }
     
@@ -81,7 +78,7 @@ int32_t apply_composition_blur(HWND hwnd, const EffectParams* params,
 
 int32_t clear_composition_blur(HWND hwnd, SetWindowCompositionAttributeFunc pFunc) {
     if (!pFunc) {
-        set_last_error("SetWindowCompositionAttribute not available");
+        set_last_error(BLUR_API_UNSUPPORTED, ERR_MSG_SWCA_UNAVAILABLE);
         return BLUR_API_UNSUPPORTED;
     }
     
@@ -97,10 +94,7 @@ int32_t clear_composition_blur(HWND hwnd, SetWindowCompositionAttributeFunc pFun
     data.cbData = sizeof(accent);
     
     if (!pFunc(hwnd, &data)) {
-        DWORD error = GetLastError();
-        char msg[256];
-        snprintf(msg, sizeof(msg), "SetWindowCompositionAttribute (clear) failed with error %lu", error);
-        set_last_error(msg);
+        set_last_error(BLUR_INTERNAL_ERROR, ERR_MSG_SWCA_CLEAR_FAILED, GetLastError());
         return BLUR_INTERNAL_ERROR;
     }
     
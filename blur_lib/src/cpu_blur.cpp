@@ -0,0 +1,438 @@
+/*
+ * cpu_blur.cpp - Portable CPU blur engine
+ *
+ * The horizontal pass writes 16-bit rows (8 fractional bits) and the vertical
+ * pass folds 2r+1 of those rows into one output row. All arithmetic is integer,
+ * so the full-frame and streaming modes produce bit-identical results.
+ *
+ * The intermediate rows are w * 8 bytes apart, so folding whole rows streams
+ * 2r+1 rows and a row-sized accumulator through cache for every output row;
+ * at 4K that is several MB per row and neither stays in L1 or L2. The
+ * vertical pass therefore works in column strips narrow enough that the tap
+ * rows of a block of output rows fit L2 and the accumulator fits L1. Each
+ * strip row is then fetched once per block instead of once per output row.
+ *
+ * Linear-light kernels decode each source row to 16-bit linear just before
+ * its horizontal pass and encode each output row right after its vertical
+ * pass, so no frame-sized linear copy ever exists.
+ */
+
+#include "cpu_blur.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* Horizontal pass keeps 8 fractional bits: Q14 * Q0 >> 6 = Q8 */
+#define H_SHIFT (BLUR_KERNEL_SHIFT - 8)
+/* Vertical pass drops back to 8-bit: Q14 * Q8 >> 22 = Q0 */
+#define V_SHIFT (BLUR_KERNEL_SHIFT + 8)
+
+/* Linear passes stay in 16-bit linear: Q14 * 65535 fits int32, >> 14 = Q0 */
+#define LINEAR_SHIFT BLUR_KERNEL_SHIFT
+#define ENCODE_BITS 12
+
+static inline int32_t clamp_index(int32_t i, int32_t n) {
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+/* ============================================================================
+ * sRGB transfer tables
+ * ============================================================================ */
+struct TransferTables {
+    uint16_t decode[256];                       /* sRGB byte to linear 0..65535 */
+    uint8_t  encode[1 << ENCODE_BITS];          /* Linear >> 4 to the nearest sRGB byte */
+    uint8_t  encode_alpha[1 << ENCODE_BITS];    /* Alpha: 0..65535 >> 4 back to 0..255 */
+};
+
+double srgb_to_linear(double c) {
+    return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+double linear_to_srgb(double l) {
+    return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+}
+
+static TransferTables build_transfer_tables() {
+    TransferTables t;
+    for (int32_t i = 0; i < 256; i++) {
+        t.decode[i] = (uint16_t)std::lround(srgb_to_linear(i / 255.0) * 65535.0);
+    }
+    const int32_t shift = 16 - ENCODE_BITS;
+    for (int32_t j = 0; j < (1 << ENCODE_BITS); j++) {
+        /* Each bucket encodes its midpoint, except that bytes decoding into it map back to themselves */
+        double mid = ((j << shift) + (1 << (shift - 1))) / 65535.0;
+        t.encode[j] = (uint8_t)std::lround(linear_to_srgb(mid) * 255.0);
+        t.encode_alpha[j] = (uint8_t)std::lround(std::min(mid, 1.0) * 255.0);
+    }
+    for (int32_t i = 0; i < 256; i++) {
+        t.encode[t.decode[i] >> shift] = (uint8_t)i;
+        t.encode_alpha[(i * 257) >> shift] = (uint8_t)i;
+    }
+    return t;
+}
+
+static const TransferTables& transfer_tables() {
+    static const TransferTables tables = build_transfer_tables();
+    return tables;
+}
+
+void srgb_decode_row(const uint8_t* src, uint16_t* dst, int32_t pixels) {
+    const uint16_t* dec = transfer_tables().decode;
+    for (int32_t i = 0; i < pixels; i++, src += 4, dst += 4) {
+        dst[0] = dec[src[0]];
+        dst[1] = dec[src[1]];
+        dst[2] = dec[src[2]];
+        dst[3] = (uint16_t)(src[3] * 257);
+    }
+}
+
+void srgb_encode_row(const uint16_t* src, uint8_t* dst, int32_t pixels) {
+    const TransferTables& t = transfer_tables();
+    const int32_t shift = 16 - ENCODE_BITS;
+    for (int32_t i = 0; i < pixels; i++, src += 4, dst += 4) {
+        dst[0] = t.encode[src[0] >> shift];
+        dst[1] = t.encode[src[1] >> shift];
+        dst[2] = t.encode[src[2] >> shift];
+        dst[3] = t.encode_alpha[src[3] >> shift];
+    }
+}
+
+float sigma_from_intensity(float intensity) {
+    if (intensity <= 0.0f) return 0.0f;
+    if (intensity > 1.0f) intensity = 1.0f;
+    return intensity * 20.0f;
+}
+
+/* Unnormalized weight of the tap d pixels from the centre */
+static inline double gaussian_tap(int32_t d, float sigma) {
+    return sigma > 0.0f ? std::exp(-((double)d * d) / (2.0 * sigma * sigma)) : 1.0;
+}
+
+void build_gaussian_kernel(float sigma, BlurKernel* out) {
+    out->sigma = sigma;
+    out->radius = sigma > 0.0f ? (int32_t)std::ceil(sigma * 3.0f) : 0;
+    out->algorithm = BLUR_ALGORITHM_EXACT;
+    out->scale = 1;
+    out->levels = 0;
+    out->work_sigma = sigma;
+    out->box_radius[0] = out->box_radius[1] = out->box_radius[2] = 0;
+    out->transfer = BLUR_TRANSFER_SRGB;
+    out->iir = IirCoefficients();
+
+    /* Taps are evaluated twice rather than kept, so a build only allocates the weights */
+    int32_t taps = out->radius * 2 + 1;
+    double sum = 0.0;
+    for (int32_t i = 0; i < taps; i++) sum += gaussian_tap(i - out->radius, sigma);
+
+    out->weights.assign(taps, 0);
+    int32_t total = 0;
+    for (int32_t i = 0; i < taps; i++) {
+        out->weights[i] = (int32_t)std::lround(gaussian_tap(i - out->radius, sigma) / sum * (1 << BLUR_KERNEL_SHIFT));
+        total += out->weights[i];
+    }
+    /* Put the rounding residue on the centre tap so the sum is exact */
+    out->weights[out->radius] += (1 << BLUR_KERNEL_SHIFT) - total;
+}
+
+size_t cpu_blur_scratch_bytes(int32_t width, int32_t height, int32_t radius, CpuBlurMode mode,
+                              uint32_t transfer) {
+    if (width <= 0 || height <= 0) return 0;
+    size_t taps = (size_t)radius * 2 + 1;
+    size_t row_bytes = (size_t)width * 4 * sizeof(uint16_t);
+    size_t rows = (mode == CPU_BLUR_STREAMING)
+        ? (taps < (size_t)height ? taps : (size_t)height)
+        : (size_t)height;
+    size_t linear = 0;
+    if (transfer == BLUR_TRANSFER_LINEAR) {
+        size_t span = (size_t)width + 2 * (size_t)radius;
+        linear = span * 4 * sizeof(uint16_t)        /* decoded source row */
+               + row_bytes;                         /* linear output row */
+    }
+    return rows * row_bytes
+         + (size_t)width * 4 * sizeof(int32_t)      /* vertical accumulator */
+         + taps * sizeof(const uint16_t*)           /* tap row pointers */
+         + linear;
+}
+
+/*
+ * Blurs columns [x0, x0 + n) of one source row of width w. Pixel i of the row
+ * is at src[(i - origin) * 4]; the caller provides every pixel the taps reach.
+ */
+template <typename T, int32_t SHIFT>
+static void blur_row_h(const T* src, int32_t origin, uint16_t* dst, int32_t w, int32_t x0, int32_t n,
+                       const int32_t* wt, int32_t r) {
+    int32_t taps = r * 2 + 1;
+    for (int32_t x = x0; x < x0 + n; x++) {
+        int32_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+        if (x >= r && x + r < w) {
+            const T* p = src + (size_t)(x - r - origin) * 4;
+            for (int32_t k = 0; k < taps; k++, p += 4) {
+                a0 += p[0] * wt[k]; a1 += p[1] * wt[k];
+                a2 += p[2] * wt[k]; a3 += p[3] * wt[k];
+            }
+        } else {
+            for (int32_t k = 0; k < taps; k++) {
+                const T* p = src + (size_t)(clamp_index(x + k - r, w) - origin) * 4;
+                a0 += p[0] * wt[k]; a1 += p[1] * wt[k];
+                a2 += p[2] * wt[k]; a3 += p[3] * wt[k];
+            }
+        }
+        uint16_t* o = dst + (size_t)(x - x0) * 4;
+        const int32_t round = 1 << (SHIFT - 1);
+        o[0] = (uint16_t)((a0 + round) >> SHIFT);
+        o[1] = (uint16_t)((a1 + round) >> SHIFT);
+        o[2] = (uint16_t)((a2 + round) >> SHIFT);
+        o[3] = (uint16_t)((a3 + round) >> SHIFT);
+    }
+}
+
+static void accumulate_rows_v(const uint16_t* const* rows, int32_t n, const int32_t* wt, int32_t taps,
+                              int32_t* acc) {
+    memset(acc, 0, (size_t)n * sizeof(int32_t));
+
+    /* Four taps per sweep: a quarter of the accumulator loads and stores */
+    int32_t k = 0;
+    for (; k + 4 <= taps; k += 4) {
+        const uint16_t* r0 = rows[k];
+        const uint16_t* r1 = rows[k + 1];
+        const uint16_t* r2 = rows[k + 2];
+        const uint16_t* r3 = rows[k + 3];
+        const int32_t w0 = wt[k], w1 = wt[k + 1], w2 = wt[k + 2], w3 = wt[k + 3];
+        for (int32_t i = 0; i < n; i++) acc[i] += r0[i] * w0 + r1[i] * w1 + r2[i] * w2 + r3[i] * w3;
+    }
+    for (; k < taps; k++) {
+        const uint16_t* row = rows[k];
+        int32_t wk = wt[k];
+        if (wk == 0) continue;
+        for (int32_t i = 0; i < n; i++) acc[i] += row[i] * wk;
+    }
+}
+
+static void blur_rows_v(const uint16_t* const* rows, uint8_t* dst, int32_t n,
+                        const int32_t* wt, int32_t taps, int32_t* acc) {
+    accumulate_rows_v(rows, n, wt, taps, acc);
+    const int32_t round = 1 << (V_SHIFT - 1);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t v = (acc[i] + round) >> V_SHIFT;
+        dst[i] = (uint8_t)(v > 255 ? 255 : v);
+    }
+}
+
+/* Vertical pass for linear rows: the shift vectorizes, then each row is encoded while it is hot */
+static void blur_rows_v_linear(const uint16_t* const* rows, uint8_t* dst, int32_t n,
+                               const int32_t* wt, int32_t taps, int32_t* acc, uint16_t* out) {
+    accumulate_rows_v(rows, n, wt, taps, acc);
+    const int32_t round = 1 << (LINEAR_SHIFT - 1);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t v = (acc[i] + round) >> LINEAR_SHIFT;
+        out[i] = (uint16_t)(v > 65535 ? 65535 : v);
+    }
+    srgb_encode_row(out, dst, n / 4);
+}
+
+int32_t cpu_blur(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                 CpuBlurMode mode) {
+    if (!src || !dst) return BLUR_INVALID_PARAMS;
+    if (src->width != dst->width || src->height != dst->height) return BLUR_INVALID_PARAMS;
+    return cpu_blur_rect(src, dst, kernel, mode, 0, 0);
+}
+
+/* Kernels that work on a copy of their whole footprint: recursive and approximate ones */
+static int32_t blur_rect_copying(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                                 int32_t x0, int32_t y0, const BlurRowHook* hook) {
+    if (kernel_is_recursive(kernel)) {
+        return iir_blur_rect(src, dst, &kernel->iir, kernel->radius, kernel->transfer, x0, y0, hook);
+    }
+    return approx_blur_rect(src, dst, kernel, x0, y0, hook);
+}
+
+static bool surfaces_overlap(const BlurSurface* a, const BlurSurface* b) {
+    const uint8_t* a_end = a->pixels + (size_t)(a->height - 1) * a->stride + (size_t)a->width * 4;
+    const uint8_t* b_end = b->pixels + (size_t)(b->height - 1) * b->stride + (size_t)b->width * 4;
+    return a->pixels < b_end && b->pixels < a_end;
+}
+
+/*
+ * Streaming mode for the copying kernels: the rect in bands of rows, so
+ * their copies hold a band and its halo instead of the whole footprint.
+ * When dst aliases src, each band's result is held back until the next band
+ * has read the rows it overwrites; bands are taller than the radius, so no
+ * other band reads them.
+ */
+static int32_t blur_rect_banded(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                                int32_t x0, int32_t y0, const BlurRowHook* hook) {
+    const int32_t band = std::max(CPU_BLUR_BAND_ROWS, kernel->radius * 4);
+    if (dst->height <= band) return blur_rect_copying(src, dst, kernel, x0, y0, hook);
+
+    ScratchArena& arena = scratch_arena();
+    ArenaScope scope(arena);
+    const size_t held_stride = (size_t)dst->width * 4;
+    uint8_t* held = nullptr;
+    if (surfaces_overlap(src, dst)) {
+        held = arena.alloc_array<uint8_t>(2 * (size_t)band * held_stride);
+        if (!held) return BLUR_OUT_OF_MEMORY;
+    }
+
+    int32_t pending_top = -1, pending_rows = 0;
+    const uint8_t* pending = nullptr;
+    for (int32_t top = 0, i = 0; top < dst->height; top += band, i++) {
+        const int32_t rows = std::min(band, dst->height - top);
+        uint8_t* out = held ? held + (size_t)(i & 1) * band * held_stride : dst->pixels + (size_t)top * dst->stride;
+        BlurSurface part = { out, dst->width, rows, held ? (int32_t)held_stride : dst->stride };
+        BlurRowHook shifted;
+        if (hook) {
+            shifted = *hook;
+            shifted.y += top;
+        }
+        int32_t rc = blur_rect_copying(src, &part, kernel, x0, y0 + top, hook ? &shifted : nullptr);
+        if (rc != BLUR_SUCCESS) return rc;
+        if (!held) continue;
+
+        for (int32_t y = 0; y < pending_rows; y++) {
+            memcpy(dst->pixels + (size_t)(pending_top + y) * dst->stride, pending + (size_t)y * held_stride, held_stride);
+        }
+        pending_top = top;
+        pending_rows = rows;
+        pending = out;
+    }
+    for (int32_t y = 0; y < pending_rows; y++) {
+        memcpy(dst->pixels + (size_t)(pending_top + y) * dst->stride, pending + (size_t)y * held_stride, held_stride);
+    }
+    return BLUR_SUCCESS;
+}
+
+int32_t cpu_blur_rect(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                      CpuBlurMode mode, int32_t x0, int32_t y0, const BlurRowHook* hook) {
+    if (!src || !dst || !kernel || !src->pixels || !dst->pixels) return BLUR_INVALID_PARAMS;
+    if (x0 < 0 || y0 < 0 || x0 + dst->width > src->width || y0 + dst->height > src->height) {
+        return BLUR_INVALID_PARAMS;
+    }
+    if (!kernel_is_direct(kernel)) {
+        if (mode != CPU_BLUR_STREAMING) return blur_rect_copying(src, dst, kernel, x0, y0, hook);
+        return blur_rect_banded(src, dst, kernel, x0, y0, hook);
+    }
+    if (kernel->weights.size() != (size_t)kernel->radius * 2 + 1) return BLUR_INVALID_PARAMS;
+    return cpu_blur_taps(src, dst, kernel->weights.data(), kernel->radius, mode, x0, y0, kernel->transfer,
+                         CPU_VERTICAL_BLOCKED, hook);
+}
+
+/* Strip width in 16-bit elements (whole pixels, at least 32) whose rows for a block fit CPU_BLUR_STRIP_BYTES */
+static int32_t strip_elements(int32_t rows, int32_t n) {
+    int32_t pixels = CPU_BLUR_STRIP_BYTES / (rows * 4 * (int32_t)sizeof(uint16_t));
+    pixels = std::max(pixels & ~15, 32);
+    return std::min(pixels * 4, n);
+}
+
+int32_t cpu_blur_taps(const BlurSurface* src, BlurSurface* dst, const int32_t* wt, int32_t r,
+                      CpuBlurMode mode, int32_t x0, int32_t y0, uint32_t transfer, CpuVerticalOrder order,
+                      const BlurRowHook* hook) {
+    const int32_t w = src->width, h = src->height;
+    const int32_t ow = dst->width, oh = dst->height;
+    if (ow <= 0 || oh <= 0) return BLUR_SUCCESS;
+
+    /* Source rows that feed the output, clamped to the surface */
+    const int32_t first = y0 - r > 0 ? y0 - r : 0;
+    const int32_t last = y0 + oh - 1 + r < h ? y0 + oh - 1 + r : h - 1;
+    const int32_t span = last - first + 1;
+
+    const int32_t n = ow * 4;
+    const int32_t taps = r * 2 + 1;
+    const int32_t ring_rows = (mode == CPU_BLUR_STREAMING) ? (taps < span ? taps : span) : span;
+
+    ScratchArena& arena = scratch_arena();
+    ArenaScope scope(arena);
+    uint16_t* rows_buf = arena.alloc_array<uint16_t>((size_t)ring_rows * n);
+    int32_t* acc = arena.alloc_array<int32_t>(n);
+    const uint16_t** tap_rows = arena.alloc_array<const uint16_t*>(taps);
+    if (!rows_buf || !acc || !tap_rows) return BLUR_OUT_OF_MEMORY;
+
+    /* Linear light: the source columns the taps reach, decoded one row at a time */
+    const bool linear = transfer == BLUR_TRANSFER_LINEAR;
+    const int32_t lo = x0 - r > 0 ? x0 - r : 0;
+    const int32_t hi = x0 + ow + r < w ? x0 + ow + r : w;
+    uint16_t* decoded = nullptr;
+    uint16_t* out_row = nullptr;
+    if (linear) {
+        decoded = arena.alloc_array<uint16_t>((size_t)(hi - lo) * 4);
+        out_row = arena.alloc_array<uint16_t>(n);
+        if (!decoded || !out_row) return BLUR_OUT_OF_MEMORY;
+    }
+    auto produce_row = [&](int32_t yy, uint16_t* row) {
+        const uint8_t* line = src->pixels + (size_t)yy * src->stride;
+        if (linear) {
+            srgb_decode_row(line + (size_t)lo * 4, decoded, hi - lo);
+            blur_row_h<uint16_t, LINEAR_SHIFT>(decoded, lo, row, w, x0, ow, wt, r);
+        } else {
+            blur_row_h<uint8_t, H_SHIFT>(line, 0, row, w, x0, ow, wt, r);
+        }
+    };
+
+    /*
+     * In full-frame mode ring_rows == span so the modulo is the identity and
+     * every row is produced before the first output row. In streaming mode a
+     * row is produced just before it is first needed and its slot is reused
+     * once it leaves the window, which also lets dst alias src. The ring only
+     * holds the rows of one output row, so streaming blocks are a single row.
+     */
+    int32_t loaded = first - 1;
+    if (mode != CPU_BLUR_STREAMING) {
+        for (int32_t yy = first; yy <= last; yy++) produce_row(yy, &rows_buf[(size_t)(yy - first) * n]);
+        loaded = last;
+    }
+
+    const bool blocked = order == CPU_VERTICAL_BLOCKED;
+    const int32_t block = blocked && mode != CPU_BLUR_STREAMING ? CPU_BLUR_BLOCK_ROWS : 1;
+    const int32_t strip = blocked ? strip_elements(taps + block - 1, n) : n;
+    for (int32_t yb = y0; yb < y0 + oh; yb += block) {
+        const int32_t ye = std::min(yb + block, y0 + oh);
+        int32_t need = ye - 1 + r < last ? ye - 1 + r : last;
+        while (loaded < need) {
+            loaded++;
+            produce_row(loaded, &rows_buf[(size_t)((loaded - first) % ring_rows) * n]);
+        }
+        for (int32_t s = 0; s < n; s += strip) {
+            const int32_t m = std::min(strip, n - s);
+            for (int32_t y = yb; y < ye; y++) {
+                for (int32_t k = 0; k < taps; k++) {
+                    int32_t yy = clamp_index(y + k - r, h);
+                    tap_rows[k] = &rows_buf[(size_t)((yy - first) % ring_rows) * n + s];
+                }
+                uint8_t* out = dst->pixels + (size_t)(y - y0) * dst->stride + s;
+                if (linear) {
+                    blur_rows_v_linear(tap_rows, out, m, wt, taps, acc, out_row);
+                } else {
+                    blur_rows_v(tap_rows, out, m, wt, taps, acc);
+                }
+            }
+        }
+        /* Every strip of the block is written; its rows are final */
+        for (int32_t y = yb; hook && y < ye; y++) {
+            run_row_hook(hook, dst->pixels + (size_t)(y - y0) * dst->stride, ow, y - y0);
+        }
+    }
+
+    return BLUR_SUCCESS;
+}
+
+void cpu_fill_tint(BlurSurface* surface, uint32_t color_argb) {
+    if (!surface || !surface->pixels || color_argb == 0) return;
+
+    int32_t a = (color_argb >> 24) & 0xFF;
+    if (a == 0) a = 128;
+    const int32_t inv = 255 - a;
+    const int32_t cb = (color_argb & 0xFF) * a;
+    const int32_t cg = ((color_argb >> 8) & 0xFF) * a;
+    const int32_t cr = ((color_argb >> 16) & 0xFF) * a;
+    const int32_t ca = 255 * a;
+
+    for (int32_t y = 0; y < surface->height; y++) {
+        uint8_t* p = surface->pixels + (size_t)y * surface->stride;
+        for (int32_t x = 0; x < surface->width; x++, p += 4) {
+            p[0] = (uint8_t)((cb + p[0] * inv + 127) / 255);
+            p[1] = (uint8_t)((cg + p[1] * inv + 127) / 255);
+            p[2] = (uint8_t)((cr + p[2] * inv + 127) / 255);
+            p[3] = (uint8_t)((ca + p[3] * inv + 127) / 255);
+        }
+    }
+}
@@ -0,0 +1,209 @@
+/*
+ * cpu_blur.h - Portable CPU blur engine
+ *
+ * Works on top-down 32bpp BGRA surfaces, the same layout DoBlur() gets from
+ * CreateDIBSection. Nothing here depends on Windows headers.
+ */
+
+#ifndef BLUR_LIB_CPU_BLUR_H
+#define BLUR_LIB_CPU_BLUR_H
+
+#include "blur_lib.h"
+#include <stddef.h>
+#include <vector>
+
+/* ============================================================================
+ * Surfaces and kernels
+ * ============================================================================ */
+struct BlurSurface {
+    uint8_t* pixels;    /* BGRA8, top-down */
+    int32_t  width;
+    int32_t  height;
+    int32_t  stride;    /* Bytes per row */
+};
+
+/* Gaussian taps in Q14 fixed point; weights always sum to exactly 1 << 14 */
+#define BLUR_KERNEL_SHIFT 14
+
+/* What a kernel averages: the sRGB-encoded bytes, or linear light decoded from them */
+#define BLUR_TRANSFER_SRGB      0
+#define BLUR_TRANSFER_LINEAR    1
+
+/*
+ * Deriche recursive Gaussian: a forward recursion over x[n..n-3] and a
+ * backward one over x[n+1..n+4], both fed back through d, sum to the blur.
+ * Past either edge the input repeats the edge pixel, so each recursion
+ * starts from gain times that pixel and borders clamp as the exact kernel's.
+ */
+struct IirCoefficients {
+    float n[4];                     /* Forward taps */
+    float m[4];                     /* Backward taps */
+    float d[4];                     /* Feedback of both */
+    float gain[2];                  /* Forward and backward response to a constant 1 */
+};
+
+/* Below this working sigma the recursion is no longer Gaussian; IIR kernels become exact ones */
+#define IIR_MIN_SIGMA 1.0f
+
+struct BlurKernel {
+    float    sigma;
+    int32_t  radius;                /* Reach in full-resolution pixels (the halo a blur reads) */
+    std::vector<int32_t> weights;   /* Direct kernels: 2 * radius + 1 taps */
+    uint32_t algorithm;             /* BLUR_ALGORITHM_* */
+    int32_t  scale;                 /* Working resolution is 1/scale (downsample and pyramid levels) */
+    int32_t  levels;                /* Pyramid 2x reductions included in scale */
+    float    work_sigma;            /* Sigma at the working resolution */
+    int32_t  box_radius[3];         /* BLUR_ALGORITHM_BOX passes at the working resolution */
+    uint32_t transfer;              /* BLUR_TRANSFER_*; linear light needs a full-resolution Gaussian */
+    IirCoefficients iir;            /* BLUR_ALGORITHM_IIR recursion at the working resolution */
+};
+
+/*
+ * Direct kernels stream through a ring of rows. Recursive and approximate
+ * kernels copy their footprint whatever the mode; streaming runs them in
+ * bands of CPU_BLUR_BAND_ROWS rows or four radii, whichever is more, so the
+ * copies hold a band instead of the rect. A recursive band reads only its
+ * halo, so band seams agree with the whole rect to within one level, as
+ * rects do (iir_blur_rect).
+ */
+typedef enum CpuBlurMode {
+    CPU_BLUR_FULL_FRAME = 0,    /* Horizontal pass into a w*h intermediate */
+    CPU_BLUR_STREAMING  = 1     /* Vertical pass over a ring of 2r+1 rows */
+} CpuBlurMode;
+
+/* Smallest band of the streaming mode for recursive and approximate kernels */
+#define CPU_BLUR_BAND_ROWS 64
+
+/* Surfaces at or above this many pixels use the streaming mode in DoBlur() */
+#define BLUR_STREAMING_THRESHOLD_PIXELS (3840 * 2160)
+
+/* Standard deviation DoBlur() hands to the D2D Gaussian for an intensity */
+float sigma_from_intensity(float intensity);
+
+void build_gaussian_kernel(float sigma, BlurKernel* out);
+
+/* Recursion for sigma (at least IIR_MIN_SIGMA); costs the same per pixel at any sigma */
+void build_iir_coefficients(float sigma, IirCoefficients* out);
+
+/*
+ * Kernel for any BLUR_ALGORITHM_* working at 1/downsample resolution (0 or 1
+ * means full resolution). Exact kernels at full resolution are "direct" and
+ * keep the bit-exact streaming engine; the others approximate the same sigma.
+ */
+void build_blur_kernel(float sigma, uint32_t algorithm, int32_t downsample, BlurKernel* out);
+
+inline bool kernel_is_direct(const BlurKernel* k) {
+    return k->scale == 1 && k->algorithm != BLUR_ALGORITHM_BOX && k->algorithm != BLUR_ALGORITHM_IIR;
+}
+
+/* Full-resolution IIR kernels run the recursion over the source (iir_blur.cpp) */
+inline bool kernel_is_recursive(const BlurKernel* k) {
+    return k->scale == 1 && k->algorithm == BLUR_ALGORITHM_IIR;
+}
+
+/* Approximate kernels keep blurring the sRGB bytes */
+inline void kernel_set_linear_light(BlurKernel* k, bool linear) {
+    k->transfer = linear && (kernel_is_direct(k) || kernel_is_recursive(k)) ? BLUR_TRANSFER_LINEAR : BLUR_TRANSFER_SRGB;
+}
+
+/* Same output for the same input, so blurs can be shared between users */
+inline bool kernels_equal(const BlurKernel* a, const BlurKernel* b) {
+    return a == b || (a->radius == b->radius && a->weights == b->weights &&
+                      a->algorithm == b->algorithm && a->scale == b->scale &&
+                      a->work_sigma == b->work_sigma && a->transfer == b->transfer);
+}
+
+/*
+ * Point-wise work folded into a blur's last pass (effect_graph.h): apply()
+ * runs on each dst row as soon as the row is final, while it is still in
+ * cache. x and y place dst's top-left pixel in a width x height window.
+ */
+struct BlurRowHook {
+    void (*apply)(const BlurRowHook* hook, uint8_t* row, int32_t pixels, int32_t y);   /* y: dst row */
+    const void* context;
+    int32_t x, y;
+    int32_t width, height;
+};
+
+inline void run_row_hook(const BlurRowHook* hook, uint8_t* row, int32_t pixels, int32_t y) {
+    if (hook) hook->apply(hook, row, pixels, y);
+}
+
+/* Scratch bytes a cpu_blur() call takes from the thread's arena, excluding the surfaces */
+size_t cpu_blur_scratch_bytes(int32_t width, int32_t height, int32_t radius, CpuBlurMode mode,
+                              uint32_t transfer = BLUR_TRANSFER_SRGB);
+
+/*
+ * Separable Gaussian blur with clamped borders. src and dst must have the same
+ * dimensions and may be the same surface. Both modes produce bit-identical
+ * output; the streaming mode keeps scratch memory at O(width * radius).
+ */
+int32_t cpu_blur(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                 CpuBlurMode mode);
+
+/*
+ * Blurs the dst-sized window of src whose top-left corner is (x, y), reading
+ * up to the kernel radius beyond it and clamping only at the src edges. dst
+ * may alias that same window of src if nothing else writes the halo.
+ */
+int32_t cpu_blur_rect(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                      CpuBlurMode mode, int32_t x, int32_t y, const BlurRowHook* hook = nullptr);
+
+/*
+ * How the vertical pass walks the intermediate rows. Blocked order folds a
+ * column strip of a block of output rows at a time, so the strip's tap rows
+ * and accumulator stay in cache; row order folds whole rows one output row
+ * at a time. Both give identical output; row order is kept for benchmarks.
+ */
+typedef enum CpuVerticalOrder {
+    CPU_VERTICAL_BLOCKED = 0,
+    CPU_VERTICAL_ROWS    = 1
+} CpuVerticalOrder;
+
+/* Output rows per vertical block in full-frame mode (streaming folds one row at a time) */
+#define CPU_BLUR_BLOCK_ROWS 16
+
+/* Intermediate bytes a block's column strip may span: sized for L2 with room for the rest */
+#define CPU_BLUR_STRIP_BYTES (128 * 1024)
+
+/* cpu_blur_rect() for a direct kernel given as 2 * radius + 1 raw Q14 taps; no checks */
+int32_t cpu_blur_taps(const BlurSurface* src, BlurSurface* dst, const int32_t* weights, int32_t radius,
+                      CpuBlurMode mode, int32_t x, int32_t y, uint32_t transfer = BLUR_TRANSFER_SRGB,
+                      CpuVerticalOrder order = CPU_VERTICAL_BLOCKED, const BlurRowHook* hook = nullptr);
+
+/*
+ * Linear-light conversions the BLUR_TRANSFER_LINEAR passes fuse in: BGRA8 to
+ * 16-bit linear through a 256-entry table, and back through a 4096-entry
+ * table indexed by the top 12 bits. Alpha is already linear and only rescales.
+ * Decoding then encoding returns every byte unchanged.
+ */
+void srgb_decode_row(const uint8_t* src, uint16_t* dst, int32_t pixels);
+void srgb_encode_row(const uint16_t* src, uint8_t* dst, int32_t pixels);
+
+/* The exact sRGB transfer functions the tables are built from, on 0..1 */
+double srgb_to_linear(double c);
+double linear_to_srgb(double l);
+
+/*
+ * cpu_blur_rect() for kernels that are not direct (approx_blur.cpp). Works on
+ * a copy of the footprint; the streaming mode calls it per band of rows.
+ * Reductions are aligned to the src origin so neighbouring rects agree at
+ * their seams.
+ */
+int32_t approx_blur_rect(const BlurSurface* src, BlurSurface* dst, const BlurKernel* kernel,
+                         int32_t x, int32_t y, const BlurRowHook* hook = nullptr);
+
+/*
+ * cpu_blur_rect() for recursive kernels, with no checks. Reads up to radius
+ * beyond the dst-sized window at (x, y) and repeats the last pixel read
+ * beyond that, which is the clamp at the src edges. Inside src the few taps
+ * a Gaussian keeps past its radius see that pixel instead, so rects agree
+ * with the whole-surface blur to within one level. dst may alias the window.
+ */
+int32_t iir_blur_rect(const BlurSurface* src, BlurSurface* dst, const IirCoefficients* iir, int32_t radius,
+                      uint32_t transfer, int32_t x, int32_t y, const BlurRowHook* hook = nullptr);
+
+/* Source-over fill matching DoBlur()'s tint (alpha 0 means 0.5) */
+void cpu_fill_tint(BlurSurface* surface, uint32_t color_argb);
+
+#endif /* BLUR_LIB_CPU_BLUR_H */
@@ -0,0 +1,153 @@
+/*
+ * cpu_budget.cpp - Process-wide CPU budget for window refreshes
+ */
+
+#include "cpu_budget.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+CpuBudget::CpuBudget() : m_per_mille(0), m_foreground(0) {}
+
+void CpuBudget::set_budget(uint32_t per_mille) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_per_mille = per_mille;
+    rebalance();
+}
+
+uint32_t CpuBudget::budget() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_per_mille;
+}
+
+void CpuBudget::track(uint64_t handle, uint32_t requested_ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint64_t, Window>::iterator it = m_windows.find(handle);
+    if (it == m_windows.end()) {
+        Window w = { requested_ms, requested_ms, 0.0 };
+        m_windows[handle] = w;
+    } else {
+        it->second.requested_ms = requested_ms;
+    }
+    rebalance();
+}
+
+void CpuBudget::untrack(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_windows.erase(handle)) rebalance();
+}
+
+void CpuBudget::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_windows.clear();
+    m_foreground = 0;
+}
+
+void CpuBudget::set_foreground(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (handle == m_foreground) return;
+    m_foreground = handle;
+    rebalance();
+}
+
+void CpuBudget::record_frame(uint64_t handle, uint64_t cost_us) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint64_t, Window>::iterator it = m_windows.find(handle);
+    if (it == m_windows.end()) return;
+    double c = (double)std::max<uint64_t>(cost_us, 1);
+    double& avg = it->second.cost_us;
+    avg = avg > 0.0 ? avg + CPU_BUDGET_COST_WEIGHT * (c - avg) : c;
+    rebalance();
+}
+
+uint32_t CpuBudget::interval_ms(uint64_t handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint64_t, Window>::const_iterator it = m_windows.find(handle);
+    return it == m_windows.end() ? 0 : it->second.interval_ms;
+}
+
+/* CPU time per second a window spends refreshing every interval_ms */
+static double demand_us(double cost_us, uint32_t interval_ms) {
+    return interval_ms ? cost_us * 1000.0 / (double)interval_ms : 0.0;
+}
+
+uint32_t CpuBudget::used_per_mille() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double used = 0.0;
+    for (const auto& kv : m_windows) used += demand_us(kv.second.cost_us, kv.second.interval_ms);
+    return (uint32_t)(used / 1000.0 + 0.5);
+}
+
+/*
+ * Water-filling: split what is left among the windows not yet settled by
+ * weight; every window whose requested rate fits its share settles at that
+ * rate and returns the difference. When none fits, the rest refresh at the
+ * interval their share pays for.
+ */
+void CpuBudget::rebalance() {
+    std::vector<std::pair<uint64_t, Window*>> open;
+    for (auto& kv : m_windows) {
+        kv.second.interval_ms = kv.second.requested_ms;
+        if (m_per_mille && kv.second.cost_us > 0.0 && kv.second.requested_ms) open.push_back(std::make_pair(kv.first, &kv.second));
+    }
+
+    double left = (double)m_per_mille * 1000.0;   /* us of CPU per second */
+    while (!open.empty()) {
+        uint32_t total = 0;
+        for (const auto& w : open) total += weight(w.first);
+
+        double pass = left;
+        bool settled = false;
+        for (size_t i = 0; i < open.size();) {
+            double share = pass * weight(open[i].first) / (double)total;
+            double demand = demand_us(open[i].second->cost_us, open[i].second->requested_ms);
+            if (demand <= share) {
+                left -= demand;
+                open[i] = open.back();
+                open.pop_back();
+                settled = true;
+            } else {
+                i++;
+            }
+        }
+        if (settled) continue;
+
+        for (const auto& w : open) {
+            double share = left * weight(w.first) / (double)total;
+            double ms = share > 0.0 ? w.second->cost_us * 1000.0 / share : (double)CPU_BUDGET_MAX_INTERVAL_MS;
+            ms = std::min(ms, (double)CPU_BUDGET_MAX_INTERVAL_MS);
+            w.second->interval_ms = std::max(w.second->requested_ms, (uint32_t)std::ceil(ms));
+        }
+        break;
+    }
+}
+
+void CpuBudget::to_json(std::string* out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double used = 0.0;
+    std::ostringstream windows;
+    bool first = true;
+    for (const auto& kv : m_windows) {
+        const Window& w = kv.second;
+        used += demand_us(w.cost_us, w.interval_ms);
+        if (!first) windows << ",";
+        first = false;
+        windows << "{\"handle\":" << kv.first
+                << ",\"weight\":" << weight(kv.first)
+                << ",\"cost_us\":" << (uint64_t)w.cost_us
+                << ",\"requested_ms\":" << w.requested_ms
+                << ",\"interval_ms\":" << w.interval_ms << "}";
+    }
+
+    std::ostringstream oss;
+    oss << "{\"budget_per_mille\":" << m_per_mille
+        << ",\"used_per_mille\":" << (uint32_t)(used / 1000.0 + 0.5)
+        << ",\"windows\":[" << windows.str() << "]}";
+    *out = oss.str();
+}
+
+CpuBudget& cpu_budget(void) {
+    static CpuBudget budget;
+    return budget;
+}
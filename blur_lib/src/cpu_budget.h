@@ -0,0 +1,80 @@
+/*
+ * cpu_budget.h - Process-wide CPU budget for window refreshes
+ *
+ * Every blurred window refreshes at its own interval, so the library's CPU
+ * use grows with the window count. The budget caps the refresh work of all
+ * windows together at a share of one core and splits it by weighted fair
+ * share: the foreground window weighs CPU_BUDGET_FOREGROUND_WEIGHT, every
+ * other window 1. A window whose requested rate costs less than its share
+ * keeps that rate and leaves the rest to the others; the others refresh at
+ * the interval their share pays for, never slower than
+ * CPU_BUDGET_MAX_INTERVAL_MS.
+ *
+ * Costs are an average of each window's measured refreshes. A window not
+ * measured yet refreshes at its requested interval, and with no budget set
+ * every window does.
+ */
+
+#ifndef BLUR_LIB_CPU_BUDGET_H
+#define BLUR_LIB_CPU_BUDGET_H
+
+#include "blur_lib.h"
+#include <map>
+#include <mutex>
+#include <string>
+
+#define CPU_BUDGET_FOREGROUND_WEIGHT    4
+#define CPU_BUDGET_MAX_INTERVAL_MS      2000
+
+/* Weight of the newest refresh in a window's cost average */
+#define CPU_BUDGET_COST_WEIGHT          0.25
+
+class CpuBudget {
+public:
+    CpuBudget();
+
+    /* Per mille of one core for all refreshes together (0 = no limit) */
+    void set_budget(uint32_t per_mille);
+    uint32_t budget() const;
+
+    /* Adds a window or changes its requested interval */
+    void track(uint64_t handle, uint32_t requested_ms);
+    void untrack(uint64_t handle);
+    void clear();
+
+    /* The window weighted highest (0 = none) */
+    void set_foreground(uint64_t handle);
+
+    /* CPU time of a window's latest refresh */
+    void record_frame(uint64_t handle, uint64_t cost_us);
+
+    /* Interval the budget allows the window; 0 for windows not tracked */
+    uint32_t interval_ms(uint64_t handle) const;
+
+    /* Per mille of one core the current intervals spend, by the measured costs */
+    uint32_t used_per_mille() const;
+
+    /* Diagnostics JSON, as returned by blur_get_cpu_budget_info() */
+    void to_json(std::string* out) const;
+
+private:
+    struct Window {
+        uint32_t requested_ms;
+        uint32_t interval_ms;
+        double   cost_us;       /* 0 before the first refresh */
+    };
+
+    /* Recomputes every interval; caller holds m_mutex */
+    void rebalance();
+    uint32_t weight(uint64_t handle) const { return handle == m_foreground ? CPU_BUDGET_FOREGROUND_WEIGHT : 1; }
+
+    mutable std::mutex m_mutex;
+    uint32_t m_per_mille;
+    uint64_t m_foreground;
+    std::map<uint64_t, Window> m_windows;
+};
+
+/* The budget shared by every refresh tick */
+CpuBudget& cpu_budget(void);
+
+#endif /* BLUR_LIB_CPU_BUDGET_H */
@@ -4,70 +4,122 @@
 
 #include <initguid.h>
 #include "internal.h"
+#include "calibration.h"
+#include "backdrop_cache.h"
+#include "capture_planner.h"
+#include "cpu_budget.h"
+#include "cpu_blur.h"
+#include "effect_graph.h"
+#include "effect_params.h"
+#include "kernel_cache.h"
+#include "memory_budget.h"
+#include "quality_governor.h"
+#include "region.h"
+#include "scratch_arena.h"
+#include "stats.h"
+#include "tick_recorder.h"
+#include "visibility.h"
+#include "warmup.h"
+#include "window_registry.h"
 #include <d2d1_1.h>
 #include <d2d1effects.h>
 #include <d3d11.h>
 #include <wincodec.h>
 #include <wrl/client.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <map>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 using Microsoft::WRL::ComPtr;
 
 struct D2DState {
     HWND targetHwnd;
-    UINT_PTR timerId;
     float intensity;
     uint32_t color;
+    uint32_t flags;
+    uint32_t algorithm;
+    int32_t downsample;
+    uint32_t workerThreads;  // Row bands per blurred rect on the executor (0 = one per worker)
+    UINT refreshMs;
+    uint32_t frameBudgetUs;  // Deadline of each refresh (0 = the refresh interval)
+    ULONGLONG nextRefresh;   // GetTickCount64() time the window is due again, per the CPU budget
+    bool hasRegions;
+    BlurRegionList_V1 regions;
+    bool hasEffects;         // BLUR_PARAMS_FLAG_EFFECTS: effects replaces the color tint
+    EffectProgram effects;
 };
 
+// A window's layered-window surface, kept between ticks while the window still fits in it
+struct WindowSurface {
+    HDC dc; HBITMAP bmp; HGDIOBJ old; void* bits; int w; int h;   // w and h are the DIB's, rows are w * 4 bytes
+};
+
+// Surfaces of cleared windows wait here for the next window that fits
+#define SPARE_SURFACES 2
+
 static std::map<HWND, D2DState> g_states;
 static std::mutex g_mtx;
+static std::mutex g_tickMtx;   // Ticks share the cached DIBs and the D2D context, so they never overlap
+static std::map<HWND, WindowSurface> g_surfaces;   // Guarded by g_tickMtx
+static std::vector<WindowSurface> g_spareSurfaces; // Guarded by g_tickMtx, oldest first
+static std::map<HWND, BackdropCache> g_backdrops;  // Guarded by g_tickMtx; last untinted blur per window
+static std::map<HWND, QualityGovernor> g_governors; // Guarded by g_tickMtx; quality rung per window
+static TickRecorder* g_recorder = nullptr;          // Guarded by g_tickMtx; owned by blur_lib.cpp
+static uint64_t g_tickCount;                        // Guarded by g_tickMtx; ticks run so far
+static UINT g_tickMs;          // Guarded by g_mtx; period of the tick timer: the shortest refresh interval
+
+// One thread timer refreshes every window. It lives on a thread of its own that only pumps messages,
+// so it fires whichever thread applied, and arm requests are posted to that thread
+#define WM_TICK_ARM (WM_APP + 1)   // wParam: the timer period in ms, 0 disarms
+static std::thread g_tickThread;
+static DWORD g_tickThreadId;
+static std::mutex g_tickCtlMtx;                // Guards the tick thread and the request counts
+static std::condition_variable g_tickCtlCv;
+static uint64_t g_tickPosted, g_tickAcked;     // Arm requests posted and carried out
+static bool g_tickReady;                       // The tick thread's message queue exists
 
 static ComPtr<ID2D1Factory1> g_d2dFactory;
 static ComPtr<ID2D1Device> g_d2dDevice;
 static ComPtr<ID2D1DeviceContext> g_d2dContext;
 static ComPtr<ID3D11Device> g_d3dDevice;
+static std::mutex g_initMtx;   // The warm-up thread and first use may both create the devices
 
+// Creates the devices once; each step is timed as an init phase, whichever thread runs it
 static HRESULT InitD2D() {
-    if (g_d2dFactory) return S_OK;
-    HRESULT hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, __uuidof(ID2D1Factory1), nullptr, &g_d2dFactory);
-    if (FAILED(hr)) return hr;
-    UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
-    hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, nullptr, 0, D3D11_SDK_VERSION, &g_d3dDevice, nullptr, nullptr);
-    if (FAILED(hr)) return hr;
+    std::lock_guard<std::mutex> l(g_initMtx);
+    if (g_d2dContext) return S_OK;
+    HRESULT hr;
+    if (!g_d2dFactory) {
+        PhaseTimer t(BLUR_INIT_PHASE_D2D_FACTORY);
+        hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, __uuidof(ID2D1Factory1), nullptr, &g_d2dFactory);
+        if (FAILED(hr)) return hr;
+    }
+    if (!g_d3dDevice) {
+        PhaseTimer t(BLUR_INIT_PHASE_D3D_DEVICE);
+        UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, nullptr, 0, D3D11_SDK_VERSION, &g_d3dDevice, nullptr, nullptr);
+        if (FAILED(hr)) return hr;
+    }
+    PhaseTimer t(BLUR_INIT_PHASE_D2D_CONTEXT);
     ComPtr<IDXGIDevice> dxgi;
     hr = g_d3dDevice.As(&dxgi);
     if (FAILED(hr)) return hr;
-    hr = g_d2dFactory->CreateDevice(dxgi.Get(), &g_d2dDevice);
-    if (FAILED(hr)) return hr;
+    if (!g_d2dDevice) {
+        hr = g_d2dFactory->CreateDevice(dxgi.Get(), &g_d2dDevice);
+        if (FAILED(hr)) return hr;
+    }
     return g_d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &g_d2dContext);
 }
 
-static void DoBlur(HWND hwnd, float intens, uint32_t col) {
-    if (FAILED(InitD2D())) return;
-
-    // Use DWMWA_EXTENDED_FRAME_BOUNDS for accurate visible rect
-    RECT rc;
-    if (FAILED(DwmGetWindowAttribute(hwnd, DWMWA_EXTENDED_FRAME_BOUNDS, &rc, sizeof(rc)))) {
-        GetWindowRect(hwnd, &rc);
-    }
-    int w = rc.right - rc.left; int h = rc.bottom - rc.top;
-    if (w <= 0 || h <= 0) return;
-
-    HDC hdcS = GetDC(NULL); HDC hdcM = CreateCompatibleDC(hdcS);
-    BITMAPINFO bmi = {0}; bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
-    bmi.bmiHeader.biWidth = w; bmi.bmiHeader.biHeight = -h;
-    bmi.bmiHeader.biPlanes = 1; bmi.bmiHeader.biBitCount = 32; bmi.bmiHeader.biCompression = BI_RGB;
-    void* bits = nullptr; HBITMAP hbm = CreateDIBSection(hdcS, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
-    HGDIOBJ hOld = SelectObject(hdcM, hbm);
-    
-    // Capture background
-    BitBlt(hdcM, 0, 0, w, h, hdcS, rc.left, rc.top, SRCCOPY);
-
+// GPU path: three more full-size copies of the surface (input, target, staging)
+static void BlurD2D(void* bits, int w, int h, int stride, float intens, uint32_t col) {
     ComPtr<ID2D1Bitmap1> bIn, bTarget, bStage;
     D2D1_BITMAP_PROPERTIES1 prp = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_NONE, D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
-    g_d2dContext->CreateBitmap(D2D1::SizeU(w, h), bits, w * 4, &prp, &bIn);
+    g_d2dContext->CreateBitmap(D2D1::SizeU(w, h), bits, stride, &prp, &bIn);
     
     prp.bitmapOptions = D2D1_BITMAP_OPTIONS_TARGET;
     g_d2dContext->CreateBitmap(D2D1::SizeU(w, h), nullptr, 0, &prp, &bTarget);
@@ -77,7 +129,7 @@ static void DoBlur(HWND hwnd, float intens, uint32_t col) {
     g_d2dContext->Clear(D2D1::ColorF(0,0,0,0));
     
     ComPtr<ID2D1Effect> blur; g_d2dContext->CreateEffect(CLSID_D2D1GaussianBlur, &blur);
-    blur->SetInput(0, bIn.Get()); blur->SetValue(D2D1_GAUSSIANBLUR_PROP_STANDARD_DEVIATION, intens * 20.0f);
+    blur->SetInput(0, bIn.Get()); blur->SetValue(D2D1_GAUSSIANBLUR_PROP_STANDARD_DEVIATION, sigma_from_intensity(intens));
     g_d2dContext->DrawImage(blur.Get());
     
     if (col != 0) {
@@ -99,51 +151,566 @@ static void DoBlur(HWND hwnd, float intens, uint32_t col) {
         bStage->CopyFromBitmap(nullptr, bTarget.Get(), nullptr);
         D2D1_MAPPED_RECT map;
         if (SUCCEEDED(bStage->Map(D2D1_MAP_OPTIONS_READ, &map))) {
-            for (int y = 0; y < h; y++) memcpy((BYTE*)bits + y * w * 4, map.bits + y * map.pitch, w * 4);
+            for (int y = 0; y < h; y++) memcpy((BYTE*)bits + (size_t)y * stride, map.bits + y * map.pitch, w * 4);
             bStage->Unmap();
         }
     }
+}
 
-    // UpdateLayeredWindow is the EXCLUSIVE controller of window appearance
-    POINT ptD = { rc.left, rc.top }; 
-    POINT ptS = { 0, 0 }; 
-    SIZE sz = { w, h }; 
-    BLENDFUNCTION bl = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
-    
-    UpdateLayeredWindow(hwnd, hdcS, &ptD, &sz, hdcM, &ptS, 0, &bl, ULW_ALPHA);
-    
-    SelectObject(hdcM, hOld); DeleteObject(hbm); DeleteDC(hdcM); ReleaseDC(NULL, hdcS);
+static BOOL CALLBACK CollectMonitor(HMONITOR, HDC, LPRECT lprc, LPARAM lp) {
+    RegionRect r = { lprc->left, lprc->top, lprc->right, lprc->bottom };
+    ((std::vector<RegionRect>*)lp)->push_back(r);
+    return TRUE;
+}
+
+static bool IsShownOnScreen(HWND w) {
+    if (!IsWindowVisible(w) || IsIconic(w)) return false;
+    DWORD cloaked = 0;
+    if (SUCCEEDED(DwmGetWindowAttribute(w, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked) return false;
+    return true;
+}
+
+// Visibility stage: everything above hwnd in the z-order plus the monitor layout. The result lives until
+// the next call; caller holds g_tickMtx
+static const VisibilityInfo& ComputeVisibility(HWND hwnd, const RECT& rc) {
+    static std::vector<StackWindow> stack;         // Guarded by g_tickMtx; kept so ticks reuse their capacity
+    static std::vector<RegionRect> monitors;
+    static std::vector<VisibilityInfo> results;
+    stack.clear();
+    for (HWND above = GetWindow(hwnd, GW_HWNDPREV); above; above = GetWindow(above, GW_HWNDPREV)) {
+        if (!IsShownOnScreen(above)) continue;
+        RECT r;
+        if (FAILED(DwmGetWindowAttribute(above, DWMWA_EXTENDED_FRAME_BOUNDS, &r, sizeof(r)))) {
+            GetWindowRect(above, &r);
+        }
+        // Layered and click-through windows may be see-through, so they never occlude
+        LONG ex = GetWindowLong(above, GWL_EXSTYLE);
+        StackWindow sw = { (uintptr_t)above, { r.left, r.top, r.right, r.bottom }, true,
+                           (ex & (WS_EX_LAYERED | WS_EX_TRANSPARENT)) == 0 };
+        stack.push_back(sw);
+    }
+    std::reverse(stack.begin(), stack.end());
+    StackWindow self = { (uintptr_t)hwnd, { rc.left, rc.top, rc.right, rc.bottom }, IsShownOnScreen(hwnd), false };
+    stack.push_back(self);
+
+    monitors.clear();
+    EnumDisplayMonitors(NULL, NULL, CollectMonitor, (LPARAM)&monitors);
+
+    compute_stack_visibility(stack.data(), stack.size(), monitors.data(), monitors.size(), &results);
+    return results.back();
+}
+
+static HBITMAP CreateTopDownDIB(HDC hdc, int w, int h, void** bits) {
+    BITMAPINFO bmi = {0}; bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = w; bmi.bmiHeader.biHeight = -h;
+    bmi.bmiHeader.biPlanes = 1; bmi.bmiHeader.biBitCount = 32; bmi.bmiHeader.biCompression = BI_RGB;
+    return CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, bits, NULL, 0);
+}
+
+// Screen capture for a tick: every cluster reuses one DIB that only grows, so steady ticks allocate nothing
+class GdiCaptureSource : public CaptureSource {
+public:
+    explicit GdiCaptureSource(HDC screen) : m_screen(screen), m_dc(CreateCompatibleDC(screen)), m_old(NULL), m_origin() {}
+    ~GdiCaptureSource() { end_frame(); DeleteDC(m_dc); }
+
+    // Grows the shared DIB to hold w x h; caller holds g_tickMtx
+    static bool Reserve(HDC screen, int w, int h) {
+        if (w <= s_w && h <= s_h) return true;
+        int nw = (std::max)(w, s_w), nh = (std::max)(h, s_h);
+        void* bits = nullptr; HBITMAP bmp = CreateTopDownDIB(screen, nw, nh, &bits);
+        if (!bmp) return false;
+        if (s_bmp) DeleteObject(s_bmp);
+        s_bmp = bmp; s_bits = bits; s_w = nw; s_h = nh;
+        return true;
+    }
+
+    static void Release() {
+        if (s_bmp) DeleteObject(s_bmp);
+        s_bmp = NULL; s_bits = nullptr; s_w = 0; s_h = 0;
+    }
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        int w = bounds.right - bounds.left; int h = bounds.bottom - bounds.top;
+        if (!Reserve(m_screen, w, h)) return BLUR_OUT_OF_MEMORY;
+        m_old = SelectObject(m_dc, s_bmp); m_origin = bounds;
+        BlurSurface f = { (uint8_t*)s_bits, w, h, s_w * 4 };
+        for (int y = 0; y < h; y++) memset(f.pixels + (size_t)y * f.stride, 0, (size_t)w * 4);
+        *frame = f;
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& a) override {
+        BitBlt(m_dc, a.left - m_origin.left, a.top - m_origin.top, a.right - a.left, a.bottom - a.top, m_screen, a.left, a.top, SRCCOPY);
+        GdiFlush(); // The planner reads the DIB bits directly
+    }
+
+    void end_frame() override {
+        if (!m_old) return;
+        SelectObject(m_dc, m_old); m_old = NULL;
+    }
+
+private:
+    HDC m_screen; HDC m_dc; HGDIOBJ m_old; RegionRect m_origin;
+    static HBITMAP s_bmp; static void* s_bits; static int s_w; static int s_h;   // Guarded by g_tickMtx
+};
+
+HBITMAP GdiCaptureSource::s_bmp = NULL;
+void* GdiCaptureSource::s_bits = nullptr;
+int GdiCaptureSource::s_w = 0;
+int GdiCaptureSource::s_h = 0;
+
+static void FreeSurface(WindowSurface& ws) {
+    SelectObject(ws.dc, ws.old); DeleteObject(ws.bmp); DeleteDC(ws.dc);
+}
+
+// A w x h window fits a surface that holds it without wasting more than three quarters of it
+static bool SurfaceFits(const WindowSurface& ws, int w, int h) {
+    return w <= ws.w && h <= ws.h && (int64_t)w * h * 4 >= (int64_t)ws.w * ws.h;
 }
 
-static VOID CALLBACK MyTimer(HWND hwnd, UINT msg, UINT_PTR id, DWORD time) {
-    float i = 0; uint32_t c = 0;
-    { std::lock_guard<std::mutex> l(g_mtx); auto it = g_states.find(hwnd); if (it != g_states.end()) { i = it->second.intensity; c = it->second.color; } else { KillTimer(hwnd, id); return; } }
-    DoBlur(hwnd, i, c);
+static WindowSurface CreateSurface(HDC screen, int w, int h) {
+    WindowSurface ws = { CreateCompatibleDC(screen), NULL, NULL, nullptr, w, h };
+    ws.bmp = CreateTopDownDIB(screen, w, h, &ws.bits);
+    if (!ws.bmp) { DeleteDC(ws.dc); ws.dc = NULL; return ws; }
+    ws.old = SelectObject(ws.dc, ws.bmp);
+    return ws;
 }
 
-int32_t apply_d2d_blur(HWND hwnd, const EffectParams* params) {
+// Spares count against the memory budget as window 0, never presented and so evicted first; caller holds g_tickMtx
+static void AccountSpareSurfaces() {
+    uint64_t bytes = 0;
+    for (const WindowSurface& ws : g_spareSurfaces) bytes += (uint64_t)ws.w * ws.h * 4;
+    memory_budget().update(0, MEMORY_KIND_SURFACE, bytes);
+}
+
+// Keeps a surface for later windows, dropping the oldest spare; caller holds g_tickMtx
+static void RecycleSurface(const WindowSurface& ws) {
+    if (g_spareSurfaces.size() == SPARE_SURFACES) {
+        FreeSurface(g_spareSurfaces.front()); g_spareSurfaces.erase(g_spareSurfaces.begin());
+    }
+    g_spareSurfaces.push_back(ws);
+    AccountSpareSurfaces();
+}
+
+// Frees the buffers of the least recently presented windows until the rest fit the memory budget;
+// their next refresh allocates again. Caller holds g_tickMtx
+static void EvictOverBudget(uint64_t tickNo) {
+    MemoryBudget& memory = memory_budget();
+    std::vector<MemoryVictim> victims;
+    memory.select_victims(tickNo, &victims);
+    for (const MemoryVictim& v : victims) {
+        if (!v.handle) {
+            for (WindowSurface& ws : g_spareSurfaces) FreeSurface(ws);
+            g_spareSurfaces.clear();
+            AccountSpareSurfaces();
+            continue;
+        }
+        HWND hwnd = (HWND)(uintptr_t)v.handle;
+        auto it = g_surfaces.find(hwnd);
+        if (it != g_surfaces.end()) { FreeSurface(it->second); g_surfaces.erase(it); }
+        auto bd = g_backdrops.find(hwnd);
+        if (bd != g_backdrops.end()) backdrop_release(&bd->second);
+        memory.update(v.handle, MEMORY_KIND_SURFACE, 0);
+        memory.update(v.handle, MEMORY_KIND_BACKDROP, 0);
+        LOG_DEBUG("Evicted %llu buffer bytes of window 0x%p", (unsigned long long)v.bytes, hwnd);
+    }
+}
+
+// The window's cached surface, swapped for a spare or a new one when the window no longer
+// fits, with its w x h corner zeroed for the tick; caller holds g_tickMtx
+static WindowSurface* AcquireSurface(HWND hwnd, HDC screen, int w, int h) {
+    auto it = g_surfaces.find(hwnd);
+    if (it != g_surfaces.end() && !SurfaceFits(it->second, w, h)) {
+        RecycleSurface(it->second); g_surfaces.erase(it); it = g_surfaces.end();
+    }
+    if (it == g_surfaces.end()) {
+        int best = -1;
+        for (size_t i = 0; i < g_spareSurfaces.size(); i++) {
+            const WindowSurface& sp = g_spareSurfaces[i];
+            if (SurfaceFits(sp, w, h) && (best < 0 || sp.w * sp.h < g_spareSurfaces[best].w * g_spareSurfaces[best].h)) best = (int)i;
+        }
+        WindowSurface ws;
+        if (best >= 0) {
+            ws = g_spareSurfaces[best]; g_spareSurfaces.erase(g_spareSurfaces.begin() + best);
+            AccountSpareSurfaces();
+        } else {
+            ws = CreateSurface(screen, w, h);
+            if (!ws.dc) return nullptr;
+        }
+        it = g_surfaces.insert(std::make_pair(hwnd, ws)).first;
+    }
+    WindowSurface& ws = it->second;
+    for (int y = 0; y < h; y++) memset((uint8_t*)ws.bits + (size_t)y * ws.w * 4, 0, (size_t)w * 4);
+    return &ws;
+}
+
+// Per-window output of a tick
+struct TickTarget {
+    HWND hwnd; RECT rc; float intensity; uint32_t color; bool gpu;
+    HDC dc; void* bits; uint32_t rung; bool moved; bool regions;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t NowUs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// One refresh for every blurred window that is due (or is `force`, due by forceDeadlineUs): visibility,
+// plan, a shared capture, then blur and present. Overlapping windows capture the desktop under them
+// once and share blur work where kernels match.
+static void RunTick(HWND force, uint64_t forceDeadlineUs) {
+    std::lock_guard<std::mutex> tick(g_tickMtx);
+    uint64_t tickNo = ++g_tickCount;
+    MemoryBudget& memory = memory_budget();
+    HWND foreground = GetForegroundWindow();
+    CpuBudget& budget = cpu_budget();
+    budget.set_foreground((uint64_t)(uintptr_t)foreground);
+    // Kept between ticks with their capacity, so a steady tick makes no heap allocations; guarded by g_tickMtx
+    static std::vector<D2DState> states;
+    static std::vector<BlurKernel> kernels;   // Only used once the kernel cache is full
+    static std::vector<TickWindow> windows;   // The first count are this tick's; the rest keep their capacity
+    static std::vector<TickTarget> targets;
+    states.clear();
+    {
+        std::lock_guard<std::mutex> l(g_mtx);
+        ULONGLONG now = GetTickCount64();
+        for (auto& kv : g_states) {
+            if (kv.first != force && now < kv.second.nextRefresh) continue;
+            uint32_t ms = budget.interval_ms((uint64_t)(uintptr_t)kv.first);
+            kv.second.nextRefresh = now + (ms ? ms : kv.second.refreshMs);
+            states.push_back(kv.second);
+        }
+    }
+    if (states.empty() || FAILED(InitD2D())) return;
+
+    uint64_t tickUs = NowUs();
+    HDC hdcS = GetDC(NULL);
+    if (kernels.size() < states.size()) kernels.resize(states.size());
+    targets.clear();
+    size_t count = 0;
+    for (size_t i = 0; i < states.size(); i++) {
+        const D2DState& st = states[i]; HWND hwnd = st.targetHwnd;
+
+        // Use DWMWA_EXTENDED_FRAME_BOUNDS for accurate visible rect
+        RECT rc;
+        if (FAILED(DwmGetWindowAttribute(hwnd, DWMWA_EXTENDED_FRAME_BOUNDS, &rc, sizeof(rc)))) {
+            GetWindowRect(hwnd, &rc);
+        }
+        int w = rc.right - rc.left; int h = rc.bottom - rc.top;
+        if (w <= 0 || h <= 0) continue;
+
+        // Skip hidden windows entirely and shrink partly covered ones
+        const VisibilityInfo& vis = ComputeVisibility(hwnd, rc);
+        record_visibility_stats(vis);
+        if (vis.state == VISIBILITY_HIDDEN) {
+            g_backdrops.erase(hwnd);
+            memory.update((uint64_t)(uintptr_t)hwnd, MEMORY_KIND_BACKDROP, 0);
+            continue;
+        }
+
+        if (windows.size() == count) windows.emplace_back();
+        TickWindow& tw = windows[count];
+        bool linear = (st.flags & BLUR_PARAMS_FLAG_LINEAR_LIGHT) != 0;
+        float sigma = sigma_from_intensity(st.intensity);
+        uint32_t algorithm = resolve_algorithm(st.algorithm, (int64_t)w * h, sigma);
+        const BlurKernel* kernel = get_blur_kernel(sigma, algorithm, st.downsample, linear, &kernels[i]);
+        if (plan_region_blur(st.hasRegions ? &st.regions : nullptr, w, h, kernel->radius, &tw.plan) != BLUR_SUCCESS) continue;
+        if (vis.state == VISIBILITY_PARTIAL) clip_region_plan(&tw.plan, vis.visible, w, h, kernel->radius);
+        if (tw.plan.output.empty()) continue;
+
+        // The frame is due before the window's next refresh (or its budget, or the apply's timeout).
+        // A frame predicted to miss steps down the window's quality ladder; drags step down at once.
+        // Repeating the last frame needs it on screen where it was, and never serves an apply
+        RegionRect screen = { rc.left, rc.top, rc.right, rc.bottom };
+        BackdropCache& backdrop = g_backdrops[hwnd];
+        bool moved = backdrop_moved(&backdrop, screen);
+        QualityGovernor& governor = g_governors[hwnd];
+        governor.configure(algorithm, st.downsample, sigma);
+        uint32_t held = governor.level();
+        GovernorFrame frame;
+        frame.now_us = tickUs;
+        frame.deadline_us = (hwnd == force) ? forceDeadlineUs
+            : tickUs + (st.frameBudgetUs ? st.frameBudgetUs : (uint64_t)st.refreshMs * 1000);
+        frame.pixels = region_area(tw.plan.output);
+        frame.moving = moved;
+        frame.can_repeat = hwnd != force && !rect_is_empty(backdrop.screen) && g_surfaces.count(hwnd) != 0;
+        uint32_t rung = governor.plan(frame);
+        if (governor.level() != held) {
+            LOG_DEBUG("Window 0x%p quality rung %u -> %u%s", hwnd, held, governor.level(), governor.dragging() ? " (drag)" : "");
+        }
+        const QualityRung& q = governor.rung(rung);
+        if (q.repeat) continue;
+        if (q.algorithm != algorithm || q.downsample != st.downsample) {
+            kernel = get_blur_kernel(sigma, q.algorithm, q.downsample, linear, &kernels[i]);
+            if (plan_region_blur(st.hasRegions ? &st.regions : nullptr, w, h, kernel->radius, &tw.plan) != BLUR_SUCCESS) continue;
+            if (vis.state == VISIBILITY_PARTIAL) clip_region_plan(&tw.plan, vis.visible, w, h, kernel->radius);
+        }
+
+        // Whole windows keep the D2D path for the exact Gaussian, however large or covered; only
+        // BLUR_PARAMS_FLAG_STREAMING asks for the bounded-memory CPU blur instead. The D2D effect
+        // blurs the sRGB values, so linear-light windows stay on the CPU; it only tints, so windows
+        // with an effect graph do too. Windows being dragged or resized also take the CPU path,
+        // which reblurs only what their last tick did not cover. Large windows that end up on the
+        // CPU stream (tw.mode below). Blurring only the visible part of a partly covered window on
+        // the CPU costs the tick thread more than the GPU path's capture and readback at any visible
+        // share (benchmark_cpu), so those stay on the GPU and capture the whole window. Windows with
+        // regions stay on the GPU too: only plan.capture is captured, and everything outside
+        // plan.output is cleared after the D2D blur
+        bool gpu = !moved && !st.hasEffects && !(st.flags & BLUR_PARAMS_FLAG_STREAMING)
+            && kernel->transfer == BLUR_TRANSFER_SRGB
+            && q.algorithm == BLUR_ALGORITHM_EXACT && q.downsample == 1;
+        if (gpu && vis.state == VISIBILITY_PARTIAL) {
+            plan_region_blur(st.hasRegions ? &st.regions : nullptr, w, h, kernel->radius, &tw.plan);
+        }
+        tw.handle = (uintptr_t)hwnd;
+        tw.screen = screen;
+        tw.kernel = gpu ? nullptr : kernel;
+        tw.backdrop = &backdrop;
+        // Background and idle windows keep their backdrop at half resolution
+        backdrop.store_reduction = memory.backdrop_reduction((uint64_t)(uintptr_t)hwnd, tickNo, hwnd == foreground);
+        tw.color_argb = st.color;
+        tw.effects = st.hasEffects ? &st.effects : nullptr;
+        // Applies, updates and the focused window go ahead of other windows' periodic refreshes
+        tw.lane = (hwnd == force || hwnd == foreground) ? EXECUTOR_LANE_INTERACTIVE : EXECUTOR_LANE_BACKGROUND;
+        tw.max_tasks = st.workerThreads;
+        tw.mode = ((st.flags & BLUR_PARAMS_FLAG_STREAMING) || region_area(tw.plan.capture) >= BLUR_STREAMING_THRESHOLD_PIXELS)
+            ? CPU_BLUR_STREAMING : CPU_BLUR_FULL_FRAME;
+
+        WindowSurface* ws = AcquireSurface(hwnd, hdcS, w, h);
+        if (!ws) continue;
+        TickTarget t = { hwnd, rc, st.intensity, st.color, gpu, ws->dc, ws->bits, rung, moved, st.hasRegions };
+        tw.target = { (uint8_t*)t.bits, w, h, ws->w * 4 };
+        targets.push_back(t);
+        count++;
+    }
+
+    // Last-frame cost: the window's CPU time in the shared tick summed across worker bands, plus its own GPU and present time
+    TickStats ts;
+    {
+        GdiCaptureSource gdi(hdcS);
+        RecordingSource recording(&gdi, g_recorder);
+        CaptureSource* source = &gdi;
+        if (g_recorder && !g_recorder->failed()) {
+            g_recorder->record_tick(NowUs(), windows.data(), count);
+            source = &recording;
+        }
+        if (run_shared_tick(windows.data(), count, source, &ts) != BLUR_SUCCESS) {
+            LOG_WARN("Shared capture failed for %u windows", (unsigned)count);
+        } else {
+            record_tick_stats(ts);
+        }
+    }
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        TickTarget& t = targets[i]; const TickWindow& tw = windows[i];
+        int w = tw.target.width; int h = tw.target.height;
+        Clock::time_point winStart = Clock::now();
+        if (t.gpu) {
+            BlurD2D(t.bits, w, h, tw.target.stride, t.intensity, t.color);
+            // D2D blurred and tinted the whole surface; keep only the region output, with its rounded corners
+            BlurSurface surface = tw.target;
+            if (t.regions) mask_region_output(&surface, &tw.plan);
+        }
+
+        // UpdateLayeredWindow is the EXCLUSIVE controller of window appearance; present only the captured bounds
+        RegionRect b = region_bounds(tw.plan.capture);
+        RECT dirty = { b.left, b.top, b.right, b.bottom };
+        POINT ptD = { t.rc.left, t.rc.top };
+        POINT ptS = { 0, 0 };
+        SIZE sz = { w, h };
+        BLENDFUNCTION bl = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+        UPDATELAYEREDWINDOWINFO info = { sizeof(info), hdcS, &ptD, &sz, t.dc, &ptS, 0, &bl, ULW_ALPHA, &dirty };
+        UpdateLayeredWindowIndirect(t.hwnd, &info);
+
+        stats_add(BLUR_STAT_FRAMES_RENDERED, 1);
+        stats_add(BLUR_STAT_PIXELS_BLURRED, (uint64_t)region_area(tw.plan.output));
+
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - winStart).count();
+        us += (double)tw.cost_us;
+        registry_record_frame((uintptr_t)t.hwnd, (uint32_t)us, (uint64_t)region_area(tw.plan.output));
+        g_governors[t.hwnd].record(t.rung, region_area(tw.plan.output), (uint64_t)us);
+        budget.record_frame((uint64_t)(uintptr_t)t.hwnd, (uint64_t)us);
+
+        uint64_t handle = (uint64_t)(uintptr_t)t.hwnd;
+        const WindowSurface& ws = g_surfaces[t.hwnd];
+        memory.presented(handle, tickNo, t.moved);
+        memory.update(handle, MEMORY_KIND_SURFACE, (uint64_t)ws.w * ws.h * 4);
+        memory.update(handle, MEMORY_KIND_BACKDROP, backdrop_bytes(&g_backdrops[t.hwnd]));
+    }
+    EvictOverBudget(tickNo);
+    ReleaseDC(NULL, hdcS);
+    scratch_arena().end_frame();
+}
+
+static VOID CALLBACK TickProc(HWND, UINT, UINT_PTR, DWORD) {
+    RunTick(NULL, 0);
+}
+
+// The tick thread: owns the timer, so SetTimer and KillTimer always run on the thread they must
+static void TickThreadMain() {
+    MSG msg;
+    PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);   // Creates the queue before anyone posts
+    {
+        std::lock_guard<std::mutex> l(g_tickCtlMtx);
+        g_tickReady = true;
+    }
+    g_tickCtlCv.notify_all();
+
+    UINT_PTR timer = 0;
+    while (GetMessage(&msg, NULL, 0, 0) > 0) {
+        if (msg.message != WM_TICK_ARM) { DispatchMessage(&msg); continue; }   // WM_TIMER calls TickProc
+        UINT ms = (UINT)msg.wParam;
+        if (!ms) {
+            if (timer) KillTimer(NULL, timer);
+            timer = 0;
+        } else {
+            timer = SetTimer(NULL, timer, ms, TickProc);
+            if (!timer) LOG_WARN("SetTimer failed for a %u ms refresh: %lu", ms, GetLastError());
+        }
+        {
+            std::lock_guard<std::mutex> l(g_tickCtlMtx);
+            g_tickAcked++;
+        }
+        g_tickCtlCv.notify_all();
+    }
+    if (timer) KillTimer(NULL, timer);
+}
+
+// Asks the tick thread, started on first use, to run the timer every ms (0 stops it)
+static void PostTickPeriod(UINT ms) {
+    std::unique_lock<std::mutex> l(g_tickCtlMtx);
+    if (!g_tickThread.joinable()) {
+        if (!ms) return;
+        g_tickReady = false;
+        g_tickThread = std::thread(TickThreadMain);
+        g_tickThreadId = GetThreadId(g_tickThread.native_handle());
+        g_tickCtlCv.wait(l, []() { return g_tickReady; });
+    }
+    if (PostThreadMessage(g_tickThreadId, WM_TICK_ARM, (WPARAM)ms, 0)) {
+        g_tickPosted++;
+    } else {
+        LOG_WARN("Posting a %u ms refresh to the tick thread failed: %lu", ms, GetLastError());
+    }
+}
+
+// Ends the tick thread and its timer; must not hold g_tickMtx, which a running tick needs
+static void StopTickThread() {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> l(g_tickCtlMtx);
+        if (!g_tickThread.joinable()) return;
+        PostThreadMessage(g_tickThreadId, WM_QUIT, 0, 0);
+        t.swap(g_tickThread);
+        g_tickPosted = g_tickAcked = 0;
+    }
+    t.join();
+}
+
+// Re-arms the tick timer for the fastest window; caller holds g_mtx
+static void UpdateTickTimer() {
+    UINT ms = 0;
+    for (auto& kv : g_states) if (!ms || kv.second.refreshMs < ms) ms = kv.second.refreshMs;
+    if (ms != g_tickMs) PostTickPeriod(ms);
+    g_tickMs = ms;
+}
+
+int32_t apply_d2d_blur(HWND hwnd, const EffectParams* params, uint32_t timeout_ms) {
+    uint64_t deadlineUs = NowUs() + (uint64_t)(timeout_ms ? timeout_ms : APPLY_DEFAULT_TIMEOUT_MS) * 1000;
+    warmup_wait();
     if (FAILED(InitD2D())) return BLUR_INTERNAL_ERROR;
     
     // Ensure WS_EX_LAYERED only. Do NOT call SetLayeredWindowAttributes.
     SetWindowLong(hwnd, GWL_EXSTYLE, GetWindowLong(hwnd, GWL_EXSTYLE) | WS_EX_LAYERED);
     
-    std::lock_guard<std::mutex> l(g_mtx);
-    D2DState& s = g_states[hwnd]; s.targetHwnd = hwnd; s.intensity = params->intensity; s.color = params->color_argb;
-    if (s.timerId) KillTimer(hwnd, s.timerId);
-    s.timerId = SetTimer(hwnd, (UINT_PTR)hwnd, 100, MyTimer);
+    BlurSettings set;
+    if (read_effect_params(params, &set, nullptr) != BLUR_SUCCESS) return BLUR_INVALID_PARAMS;
+    {
+        std::lock_guard<std::mutex> l(g_mtx);
+        D2DState& s = g_states[hwnd]; s.targetHwnd = hwnd; s.intensity = set.intensity; s.color = set.color_argb; s.flags = set.flags;
+        s.algorithm = set.algorithm; s.downsample = set.downsample; s.workerThreads = set.worker_threads; s.refreshMs = set.refresh_interval_ms;
+        s.frameBudgetUs = set.frame_budget_us;
+        s.hasRegions = set.regions && set.regions->rect_count > 0;
+        if (s.hasRegions) s.regions = *set.regions;
+        s.hasEffects = set.effects && compile_effect_graph(set.effects, &s.effects) == BLUR_SUCCESS;
+        cpu_budget().track((uint64_t)(uintptr_t)hwnd, s.refreshMs);
+        UpdateTickTimer();
+    }
     
-    DoBlur(hwnd, s.intensity, s.color);
+    RunTick(hwnd, deadlineUs);
     return BLUR_SUCCESS;
 }
 
-int32_t clear_d2d_blur(HWND hwnd) {
-    std::lock_guard<std::mutex> l(g_mtx);
-    auto it = g_states.find(hwnd);
-    if (it != g_states.end()) {
-        if (it->second.timerId) KillTimer(hwnd, it->second.timerId);
-        g_states.erase(it);
+void detach_d2d_window(HWND hwnd) {
+    {
+        std::lock_guard<std::mutex> l(g_mtx);
+        g_states.erase(hwnd);
+        cpu_budget().untrack((uint64_t)(uintptr_t)hwnd);
+        UpdateTickTimer();
     }
+    {
+        std::lock_guard<std::mutex> tick(g_tickMtx);
+        auto it = g_surfaces.find(hwnd);
+        if (it != g_surfaces.end()) { RecycleSurface(it->second); g_surfaces.erase(it); }
+        g_backdrops.erase(hwnd);
+        g_governors.erase(hwnd);
+        memory_budget().remove((uint64_t)(uintptr_t)hwnd);
+    }
+}
+
+void sync_d2d_refresh(void) {
+    std::unique_lock<std::mutex> l(g_tickCtlMtx);
+    uint64_t posted = g_tickPosted;
+    g_tickCtlCv.wait(l, [posted]() { return !g_tickThread.joinable() || g_tickAcked >= posted; });
+}
+
+int32_t restore_d2d_window_style(HWND hwnd) {
     SetWindowLong(hwnd, GWL_EXSTYLE, GetWindowLong(hwnd, GWL_EXSTYLE) & ~WS_EX_LAYERED);
     RedrawWindow(hwnd, nullptr, nullptr, RDW_INVALIDATE | RDW_ERASE | RDW_ALLCHILDREN | RDW_FRAME);
     return BLUR_SUCCESS;
 }
+
+int32_t clear_d2d_blur(HWND hwnd) {
+    detach_d2d_window(hwnd);
+    return restore_d2d_window_style(hwnd);
+}
+
+// Runs on the warm-up thread: the first apply then finds devices, surfaces and kernels ready
+void warmup_d2d_resources(void) {
+    if (FAILED(InitD2D())) LOG_WARN("Direct2D warm-up failed; the first apply will retry");
+
+    {
+        // A maximized window on the primary monitor is the common first apply
+        PhaseTimer t(BLUR_INIT_PHASE_SURFACE_POOL);
+        int w = GetSystemMetrics(SM_CXSCREEN); int h = GetSystemMetrics(SM_CYSCREEN);
+        std::lock_guard<std::mutex> tick(g_tickMtx);
+        HDC hdcS = GetDC(NULL);
+        if (w > 0 && h > 0 && GdiCaptureSource::Reserve(hdcS, w, h) && g_spareSurfaces.empty()) {
+            WindowSurface ws = CreateSurface(hdcS, w, h);
+            if (ws.dc) g_spareSurfaces.push_back(ws);
+            AccountSpareSurfaces();
+        }
+        ReleaseDC(NULL, hdcS);
+    }
+
+    PhaseTimer t(BLUR_INIT_PHASE_KERNEL_TABLES);
+    prewarm_blur_kernels();
+}
+
+void set_d2d_recorder(TickRecorder* recorder) {
+    std::lock_guard<std::mutex> tick(g_tickMtx);
+    g_recorder = recorder;
+}
+
+void cleanup_d2d_resources(void) {
+    StopTickThread();
+    {
+        std::lock_guard<std::mutex> l(g_mtx);
+        g_tickMs = 0;
+    }
+    std::lock_guard<std::mutex> tick(g_tickMtx);
+    for (WindowSurface& ws : g_spareSurfaces) FreeSurface(ws);
+    g_spareSurfaces.clear();
+    AccountSpareSurfaces();
+    GdiCaptureSource::Release();
+}
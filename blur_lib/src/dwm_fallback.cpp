@@ -3,6 +3,7 @@
  */
 
 #include "internal.h"
+#include "region.h"
 #include <cstdio>
 #include <dwmapi.h>
 
@@ -30,12 +31,28 @@ int32_t apply_dwm_blur(HWND hwnd, const EffectParams* params) {
     bb.fEnable = TRUE;
     bb.hRgnBlur = NULL; /* Blur entire window */
     
+    /* Restrict to the requested rects (client coordinates) if any */
+    const BlurRegionList_V1* regions = effect_params_regions(params);
+    if (regions && regions->rect_count > 0) {
+        bb.hRgnBlur = CreateRectRgn(0, 0, 0, 0);
+        for (uint32_t i = 0; i < regions->rect_count; i++) {
+            const BlurRect& r = regions->rects[i];
+            int d = (int)r.corner_radius * 2;
+            HRGN part = d > 0 ? CreateRoundRectRgn(r.left, r.top, r.right + 1, r.bottom + 1, d, d)
+                              : CreateRectRgn(r.left, r.top, r.right, r.bottom);
+            CombineRgn(bb.hRgnBlur, bb.hRgnBlur, part, RGN_OR);
+            DeleteObject(part);
+        }
+        bb.dwFlags |= DWM_BB_BLURREGION;
+    }
+    
     HRESULT hr = DwmEnableBlurBehindWindow(hwnd, &bb);
+    if (bb.hRgnBlur) {
+        DeleteObject(bb.hRgnBlur);
+    }
     
     if (FAILED(hr)) {
-        char msg[256];
-        snprintf(msg, sizeof(msg), "DwmEnableBlurBehindWindow failed with HRESULT 0x%08lX", hr);
-        set_last_error(msg);
+        set_last_error(BLUR_INTERNAL_ERROR, ERR_MSG_DWM_FAILED, (uint32_t)hr);
         return BLUR_INTERNAL_ERROR;
     }
     
@@ -56,9 +73,7 @@ int32_t clear_dwm_blur(HWND hwnd) {
     HRESULT hr = DwmEnableBlurBehindWindow(hwnd, &bb);
     
     if (FAILED(hr)) {
-        char msg[256];
-        snprintf(msg, sizeof(msg), "DwmEnableBlurBehindWindow (clear) failed with HRESULT 0x%08lX", hr);
-        set_last_error(msg);
+        set_last_error(BLUR_INTERNAL_ERROR, ERR_MSG_DWM_CLEAR_FAILED, (uint32_t)hr);
         return BLUR_INTERNAL_ERROR;
     }
     
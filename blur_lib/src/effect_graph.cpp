@@ -0,0 +1,261 @@
+/*
+ * effect_graph.cpp - Point-wise effect graphs run on the blurred pixels
+ */
+
+#include "effect_graph.h"
+#include <algorithm>
+#include <cmath>
+
+static inline int32_t clamp_to(int32_t v, int32_t hi) {
+    return v < 0 ? 0 : (v > hi ? hi : v);
+}
+
+/* Rounded (b * (255 - op) + c * op) / 255 for b, c in 0..255 */
+static inline int32_t mix255(int32_t b, int32_t c, int32_t op) {
+    return (b * (255 - op) + c * op + 127) / 255;
+}
+
+/* Rec. 709 luma of B, G, R in Q8 weights summing to 256 */
+static inline int32_t luma_of(int32_t b, int32_t g, int32_t r) {
+    return (b * 19 + g * 183 + r * 54 + 128) >> 8;
+}
+
+static inline uint32_t noise_hash(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t h = (x * 0x9E3779B1u) ^ (y * 0x85EBCA77u + seed);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return h;
+}
+
+/* ============================================================================
+ * Nodes, one row at a time
+ * ============================================================================ */
+
+/* Same arithmetic as cpu_fill_tint() */
+static void tint_row(const EffectNode& n, uint8_t* p, int32_t pixels) {
+    const int32_t a = n.opacity, inv = 255 - a;
+    const int32_t cb = n.color[0] * a, cg = n.color[1] * a, cr = n.color[2] * a, ca = 255 * a;
+    for (int32_t i = 0; i < pixels; i++, p += 4) {
+        p[0] = (uint8_t)((cb + p[0] * inv + 127) / 255);
+        p[1] = (uint8_t)((cg + p[1] * inv + 127) / 255);
+        p[2] = (uint8_t)((cr + p[2] * inv + 127) / 255);
+        p[3] = (uint8_t)((ca + p[3] * inv + 127) / 255);
+    }
+}
+
+/* Moves each channel away from (or toward) the pixel's luma */
+static void saturation_row(const EffectNode& n, uint8_t* p, int32_t pixels) {
+    const int32_t k = n.amount;
+    for (int32_t i = 0; i < pixels; i++, p += 4) {
+        const int32_t a = p[3], l = luma_of(p[0], p[1], p[2]);
+        for (int32_t ch = 0; ch < 3; ch++) {
+            p[ch] = (uint8_t)clamp_to(l + (((p[ch] - l) * k + 128) >> 8), a);
+        }
+    }
+}
+
+/* Premultiplied exclusion, b + s - 2bs with s scaled by the pixel's alpha, mixed in by opacity */
+static void exclusion_row(const EffectNode& n, uint8_t* p, int32_t pixels) {
+    const int32_t op = n.opacity;
+    for (int32_t i = 0; i < pixels; i++, p += 4) {
+        const int32_t a = p[3];
+        for (int32_t ch = 0; ch < 3; ch++) {
+            const int32_t b = p[ch], s = n.color[ch];
+            const int32_t e = clamp_to(b + (a * s + 127) / 255 - (2 * b * s + 127) / 255, a);
+            p[ch] = (uint8_t)mix255(b, e, op);
+        }
+    }
+}
+
+/* 65536 / d for the distances 1..510 a channel can lie from the target luma */
+struct LumaReciprocals {
+    uint32_t q16[511];
+    LumaReciprocals() {
+        q16[0] = 0;
+        for (uint32_t d = 1; d < 511; d++) q16[d] = 65536u / d;
+    }
+};
+
+/*
+ * The color's luminosity with the pixel's hue and saturation. Channels that
+ * leave 0..alpha are pulled toward the luma by one Q16 factor, as ClipColor()
+ * does, taken from a reciprocal table instead of a division per pixel.
+ */
+static void luminosity_row(const EffectNode& n, uint8_t* p, int32_t pixels) {
+    static const LumaReciprocals recip;
+    const int32_t op = n.opacity;
+    for (int32_t i = 0; i < pixels; i++, p += 4) {
+        const int32_t a = p[3];
+        const int32_t lt = (n.luma * a + 127) / 255;
+        const int32_t d = lt - luma_of(p[0], p[1], p[2]);
+        int32_t q[3] = { p[0] + d, p[1] + d, p[2] + d };
+        const int32_t lo = std::min(q[0], std::min(q[1], q[2]));
+        const int32_t hi = std::max(q[0], std::max(q[1], q[2]));
+        /* Branch-free: in gamut, f stays 1.0 and the scaling changes nothing */
+        const int32_t f_lo = lo < 0 ? (int32_t)((uint32_t)lt * recip.q16[lt - lo]) : 1 << 16;
+        const int32_t f_hi = hi > a ? (int32_t)((uint32_t)(a - lt) * recip.q16[hi - lt]) : 1 << 16;
+        const int32_t f = std::min(f_lo, f_hi);
+        for (int32_t ch = 0; ch < 3; ch++) q[ch] = clamp_to(lt + (((q[ch] - lt) * f) >> 16), a);
+        for (int32_t ch = 0; ch < 3; ch++) p[ch] = (uint8_t)mix255(p[ch], q[ch], op);
+    }
+}
+
+/* Grey grain of up to +-amount levels, scaled by alpha */
+static void noise_row(const EffectNode& n, uint8_t* p, int32_t pixels, int32_t x, int32_t y) {
+    const uint64_t span = (uint64_t)n.amount * 2 + 1;
+    for (int32_t i = 0; i < pixels; i++, p += 4) {
+        const int32_t a = p[3];
+        /* The hash scaled to 0..span-1 by its high bits */
+        const int32_t level = (int32_t)((noise_hash((uint32_t)(x + i), (uint32_t)y, n.seed) * span) >> 32) - n.amount;
+        const int32_t g = (level * a + (level >= 0 ? 127 : -127)) / 255;
+        for (int32_t ch = 0; ch < 3; ch++) p[ch] = (uint8_t)clamp_to(p[ch] + g, a);
+    }
+}
+
+/* Scales color by 1 - amount * r^2 / 2, r^2 = dx^2 + dy^2 with dx, dy in -1..1 across the window */
+static void vignette_row(const EffectNode& n, uint8_t* p, int32_t pixels, int32_t x, int32_t y,
+                         int32_t width, int32_t height) {
+    /* Squares in Q16 of the window half-size: nx^2 * 2^48 / w^2, shifted down by 32 */
+    const uint64_t rx = ((uint64_t)1 << 48) / ((uint64_t)width * width);
+    const int64_t ny = 2 * (int64_t)y + 1 - height;
+    const uint64_t ty = (uint64_t)(ny * ny) * (((uint64_t)1 << 48) / ((uint64_t)height * height)) >> 32;
+    for (int32_t i = 0; i < pixels; i++, p += 4) {
+        const int64_t nx = 2 * (int64_t)(x + i) + 1 - width;
+        const uint64_t r2 = ((uint64_t)(nx * nx) * rx >> 32) + ty;
+        const int32_t f = 256 - (int32_t)(((uint64_t)n.amount * r2) >> 17);
+        for (int32_t ch = 0; ch < 3; ch++) p[ch] = (uint8_t)((p[ch] * f + 128) >> 8);
+    }
+}
+
+static void apply_node(const EffectNode& n, uint8_t* row, int32_t pixels, int32_t x, int32_t y,
+                       int32_t width, int32_t height) {
+    switch (n.source.type) {
+    case BLUR_EFFECT_SATURATION: saturation_row(n, row, pixels); break;
+    case BLUR_EFFECT_LUMINOSITY: luminosity_row(n, row, pixels); break;
+    case BLUR_EFFECT_EXCLUSION:  exclusion_row(n, row, pixels); break;
+    case BLUR_EFFECT_TINT:       tint_row(n, row, pixels); break;
+    case BLUR_EFFECT_NOISE:      noise_row(n, row, pixels, x, y); break;
+    case BLUR_EFFECT_VIGNETTE:   vignette_row(n, row, pixels, x, y, width, height); break;
+    }
+}
+
+/* ============================================================================
+ * Lists and programs
+ * ============================================================================ */
+const BlurEffectList_V1* effect_params_effects(const EffectParams* params) {
+    if (!params || !(params->reserved_flags & BLUR_PARAMS_FLAG_EFFECTS)) {
+        return nullptr;
+    }
+    size_t size = params->struct_version == 2 ? sizeof(EffectParams_V2) : sizeof(EffectParams_V1);
+    if (params->reserved_flags & BLUR_PARAMS_FLAG_REGIONS) size += sizeof(BlurRegionList_V1);
+    return (const BlurEffectList_V1*)((const uint8_t*)params + size);
+}
+
+int32_t validate_effect_list(const BlurEffectList_V1* list) {
+    if (!list) return BLUR_SUCCESS;
+    if (list->struct_version != 1 || list->effect_count > BLUR_MAX_EFFECTS) {
+        return BLUR_INVALID_PARAMS;
+    }
+    for (uint32_t i = 0; i < list->effect_count; i++) {
+        const BlurEffect& e = list->effects[i];
+        if (e.reserved || !std::isfinite(e.amount)) return BLUR_INVALID_PARAMS;
+        switch (e.type) {
+        case BLUR_EFFECT_SATURATION:
+            if (e.amount < 0.0f || e.amount > 4.0f) return BLUR_INVALID_PARAMS;
+            break;
+        case BLUR_EFFECT_NOISE:
+        case BLUR_EFFECT_VIGNETTE:
+            if (e.amount < 0.0f || e.amount > 1.0f) return BLUR_INVALID_PARAMS;
+            break;
+        case BLUR_EFFECT_LUMINOSITY:
+        case BLUR_EFFECT_EXCLUSION:
+        case BLUR_EFFECT_TINT:
+            break;
+        default:
+            return BLUR_INVALID_PARAMS;
+        }
+    }
+    return BLUR_SUCCESS;
+}
+
+int32_t compile_effect_graph(const BlurEffectList_V1* list, EffectProgram* out) {
+    if (!out) return BLUR_INVALID_PARAMS;
+    int32_t rc = validate_effect_list(list);
+    if (rc != BLUR_SUCCESS) return rc;
+
+    out->count = 0;
+    uint32_t noise = 0;
+    for (uint32_t i = 0; list && i < list->effect_count; i++) {
+        const BlurEffect& e = list->effects[i];
+        EffectNode n = {};
+        n.source = e;
+        n.color[0] = (int32_t)(e.color_argb & 0xFF);
+        n.color[1] = (int32_t)((e.color_argb >> 8) & 0xFF);
+        n.color[2] = (int32_t)((e.color_argb >> 16) & 0xFF);
+        n.opacity = (int32_t)(e.color_argb >> 24);
+        n.luma = luma_of(n.color[0], n.color[1], n.color[2]);
+
+        /* Nodes that leave every pixel as it is are dropped */
+        bool identity;
+        switch (e.type) {
+        case BLUR_EFFECT_SATURATION:
+            n.amount = (int32_t)std::lround(e.amount * 256.0f);
+            identity = n.amount == 256;
+            break;
+        case BLUR_EFFECT_NOISE:
+            n.amount = (int32_t)std::lround(e.amount * EFFECT_NOISE_LEVELS);
+            identity = n.amount == 0;
+            /* Numbered among the kept noise nodes, so recompiling a program's sources repeats it */
+            if (!identity) n.seed = 0x9E3779B9u * ++noise;
+            break;
+        case BLUR_EFFECT_VIGNETTE:
+            n.amount = (int32_t)std::lround(e.amount * 256.0f);
+            identity = n.amount == 0;
+            break;
+        default:
+            identity = n.opacity == 0;
+            break;
+        }
+        if (!identity) out->nodes[out->count++] = n;
+    }
+    return BLUR_SUCCESS;
+}
+
+void effect_apply_row(const EffectProgram* program, uint8_t* row, int32_t pixels,
+                      int32_t x, int32_t y, int32_t width, int32_t height) {
+    /* Node by node over the row: the row stays in L1 while every node runs */
+    for (uint32_t i = 0; i < program->count; i++) {
+        apply_node(program->nodes[i], row, pixels, x, y, width, height);
+    }
+}
+
+void apply_effect_program(const EffectProgram* program, BlurSurface* window, const RegionRect& r, bool fused) {
+    if (!program || !program->count || rect_is_empty(r)) return;
+    BlurSurface view = surface_view(window, r);
+    if (fused) {
+        for (int32_t y = 0; y < view.height; y++) {
+            effect_apply_row(program, view.pixels + (size_t)y * view.stride, view.width,
+                             r.left, r.top + y, window->width, window->height);
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < program->count; i++) {
+        for (int32_t y = 0; y < view.height; y++) {
+            apply_node(program->nodes[i], view.pixels + (size_t)y * view.stride, view.width,
+                       r.left, r.top + y, window->width, window->height);
+        }
+    }
+}
+
+static void effect_hook_apply(const BlurRowHook* hook, uint8_t* row, int32_t pixels, int32_t y) {
+    effect_apply_row((const EffectProgram*)hook->context, row, pixels, hook->x, hook->y + y,
+                     hook->width, hook->height);
+}
+
+BlurRowHook effect_row_hook(const EffectProgram* program, int32_t x, int32_t y, int32_t width, int32_t height) {
+    BlurRowHook hook = { effect_hook_apply, program, x, y, width, height };
+    return hook;
+}
@@ -0,0 +1,62 @@
+/*
+ * effect_graph.h - Point-wise effect graphs run on the blurred pixels
+ *
+ * A BlurEffectList describes the nodes that follow the blur, in order.
+ * Compiling it checks every node, drops the ones that leave pixels as they
+ * are and precomputes their constants. The compiled program runs all of its
+ * nodes on a row before moving to the next row, so the whole chain costs one
+ * pass over memory; folded into the blur's last pass through a BlurRowHook,
+ * it costs none beyond the blur. Every node rounds to 8 bits just as a pass
+ * of its own over the surface would, so fused, single-pass and pass-per-node
+ * execution give identical bytes.
+ *
+ * Pixels are premultiplied BGRA and color nodes keep each channel at or
+ * below alpha. Noise and vignette depend on the pixel's position in the
+ * window, not on the screen, so they move with the window.
+ */
+
+#ifndef BLUR_LIB_EFFECT_GRAPH_H
+#define BLUR_LIB_EFFECT_GRAPH_H
+
+#include "region.h"
+
+/* Noise amplitude in levels at amount 1.0 */
+#define EFFECT_NOISE_LEVELS 64
+
+struct EffectNode {
+    BlurEffect source;      /* As listed; recordings store it */
+    int32_t    color[3];    /* B, G, R of the node's color */
+    int32_t    opacity;     /* Color alpha, 0 to 255 */
+    int32_t    luma;        /* Luminosity of the color */
+    int32_t    amount;      /* Saturation and vignette in Q8, noise amplitude in levels */
+    uint32_t   seed;        /* Noise pattern */
+};
+
+struct EffectProgram {
+    uint32_t   count;
+    EffectNode nodes[BLUR_MAX_EFFECTS];
+};
+
+/* Trailing effect list of params, or NULL if BLUR_PARAMS_FLAG_EFFECTS is clear */
+const BlurEffectList_V1* effect_params_effects(const EffectParams* params);
+
+int32_t validate_effect_list(const BlurEffectList_V1* list);
+
+/* Compiles a list (NULL or empty: a program that changes nothing) */
+int32_t compile_effect_graph(const BlurEffectList_V1* list, EffectProgram* out);
+
+/* Runs every node on pixels of a row starting at (x, y) of a width x height window */
+void effect_apply_row(const EffectProgram* program, uint8_t* row, int32_t pixels,
+                      int32_t x, int32_t y, int32_t width, int32_t height);
+
+/*
+ * Runs the program on r of a window-sized surface: all nodes in one pass, or
+ * (fused false) one pass over r per node, the way a fixed-function chain
+ * would. Both give the same bytes.
+ */
+void apply_effect_program(const EffectProgram* program, BlurSurface* window, const RegionRect& r, bool fused);
+
+/* Hook running the program on a blur's output placed at (x, y) of a width x height window */
+BlurRowHook effect_row_hook(const EffectProgram* program, int32_t x, int32_t y, int32_t width, int32_t height);
+
+#endif /* BLUR_LIB_EFFECT_GRAPH_H */
@@ -0,0 +1,69 @@
+/*
+ * effect_params.cpp - Versioned EffectParams decoding
+ */
+
+#include "effect_params.h"
+#include "calibration.h"
+#include "effect_graph.h"
+#include "region.h"
+
+static int32_t fail(const char** error, const char* message) {
+    if (error) *error = message;
+    return BLUR_INVALID_PARAMS;
+}
+
+int32_t read_effect_params(const EffectParams* params, BlurSettings* settings, const char** error) {
+    if (!params || !settings) return fail(error, "Missing effect parameters");
+    if (params->struct_version != 1 && params->struct_version != 2) {
+        return fail(error, "Invalid struct_version");
+    }
+    if (!(params->intensity >= 0.0f && params->intensity <= 1.0f)) {
+        return fail(error, "Intensity must be between 0.0 and 1.0");
+    }
+
+    BlurSettings s = {};
+    s.struct_version = params->struct_version;
+    s.intensity = params->intensity;
+    s.color_argb = params->color_argb;
+    s.animate = params->animate;
+    s.animation_ms = params->animation_ms;
+    s.flags = params->reserved_flags;
+    s.algorithm = BLUR_ALGORITHM_EXACT;
+    s.downsample = 1;
+    s.refresh_interval_ms = 1000 / BLUR_DEFAULT_REFRESH_HZ;
+
+    if (params->struct_version == 2) {
+        const EffectParams_V2* v2 = (const EffectParams_V2*)params;
+        if (v2->algorithm > BLUR_ALGORITHM_AUTO) return fail(error, "Unknown blur algorithm");
+        if (v2->downsample > BLUR_MAX_DOWNSAMPLE) return fail(error, "Downsample factor out of range");
+        if (v2->max_refresh_hz > BLUR_MAX_REFRESH_HZ) return fail(error, "Refresh rate out of range");
+        if (v2->worker_threads > BLUR_MAX_WORKER_THREADS) return fail(error, "Worker thread budget out of range");
+        for (size_t i = 0; i < sizeof(v2->reserved_v2); i++) {
+            if (v2->reserved_v2[i]) return fail(error, "Reserved V2 bytes must be zero");
+        }
+        s.algorithm = v2->algorithm;
+        s.downsample = v2->downsample > 1 ? (int32_t)v2->downsample : 1;
+        if (v2->max_refresh_hz) s.refresh_interval_ms = (1000 + v2->max_refresh_hz - 1) / v2->max_refresh_hz;
+        s.worker_threads = v2->worker_threads;
+        s.frame_budget_us = v2->frame_budget_us;
+    }
+
+    s.regions = effect_params_regions(params);
+    if (validate_region_list(s.regions) != BLUR_SUCCESS) {
+        return fail(error, "Invalid blur region list");
+    }
+    s.effects = effect_params_effects(params);
+    if (validate_effect_list(s.effects) != BLUR_SUCCESS) {
+        return fail(error, "Invalid effect list");
+    }
+
+    *settings = s;
+    return BLUR_SUCCESS;
+}
+
+void build_settings_kernel(const BlurSettings& settings, int64_t pixels, BlurKernel* kernel) {
+    float sigma = sigma_from_intensity(settings.intensity);
+    build_blur_kernel(sigma, resolve_algorithm(settings.algorithm, pixels, sigma),
+                      settings.downsample, kernel);
+    kernel_set_linear_light(kernel, (settings.flags & BLUR_PARAMS_FLAG_LINEAR_LIGHT) != 0);
+}
@@ -0,0 +1,45 @@
+/*
+ * effect_params.h - Versioned EffectParams decoding
+ *
+ * Backends see one normalized BlurSettings whatever struct_version the caller
+ * passed, with every V2 default already filled in.
+ */
+
+#ifndef BLUR_LIB_EFFECT_PARAMS_H
+#define BLUR_LIB_EFFECT_PARAMS_H
+
+#include "cpu_blur.h"
+
+/* Refresh rate used when max_refresh_hz is 0 (and by every V1 caller) */
+#define BLUR_DEFAULT_REFRESH_HZ 10
+
+struct BlurSettings {
+    uint32_t struct_version;
+    float    intensity;
+    uint32_t color_argb;
+    uint8_t  animate;
+    uint32_t animation_ms;
+    uint32_t flags;                     /* BLUR_PARAMS_FLAG_* */
+    uint32_t algorithm;                 /* BLUR_ALGORITHM_* (AUTO is resolved per frame) */
+    int32_t  downsample;                /* 1 to BLUR_MAX_DOWNSAMPLE */
+    uint32_t refresh_interval_ms;       /* From max_refresh_hz */
+    uint32_t worker_threads;            /* 0 = library default */
+    uint32_t frame_budget_us;           /* 0 = the refresh interval */
+    const BlurRegionList_V1* regions;   /* Points into the caller's params, or NULL */
+    const BlurEffectList_V1* effects;   /* Likewise; replaces the color_argb tint */
+};
+
+/*
+ * Validates a V1 or V2 params block (including trailing region and effect
+ * lists) and fills settings. On failure returns BLUR_INVALID_PARAMS and sets
+ * *error to a static message.
+ */
+int32_t read_effect_params(const EffectParams* params, BlurSettings* settings, const char** error);
+
+/*
+ * Kernel for the settings' intensity, algorithm and downsample factor, with
+ * BLUR_ALGORITHM_AUTO resolved for a surface of pixels
+ */
+void build_settings_kernel(const BlurSettings& settings, int64_t pixels, BlurKernel* kernel);
+
+#endif /* BLUR_LIB_EFFECT_PARAMS_H */
@@ -4,15 +4,17 @@
 
 #include "internal.h"
 #include <string>
-#include <mutex>
 
-static std::mutex g_error_mutex;
-static std::string g_last_error;
+void set_last_error(int32_t code, uint32_t message, uint64_t arg, const char* detail) {
+    error_set(code, message, arg, detail);
 
-void set_last_error(const char* message) {
-    std::lock_guard<std::mutex> lock(g_error_mutex);
-    g_last_error = message ? message : "";
-    LOG_ERROR("%s", message);
+    /* Caller mistakes are routine; only failures of the library itself are errors */
+    int32_t level = (code == BLUR_INTERNAL_ERROR || code == BLUR_OUT_OF_MEMORY) ? BLUR_LOG_ERROR : BLUR_LOG_DEBUG;
+    if (log_enabled(level)) {
+        char text[256];
+        error_format(text, sizeof(text));
+        log_message(level, "%s", text);
+    }
 }
 
 char* alloc_string(const char* src) {
@@ -35,15 +37,20 @@ int32_t BLUR_CALL blur_get_last_error(char** out_utf8) {
         return BLUR_INVALID_PARAMS;
     }
     
-    std::lock_guard<std::mutex> lock(g_error_mutex);
+    char text[256];
+    error_format(text, sizeof(text));
+    *out_utf8 = alloc_string(text);
     
-    if (g_last_error.empty()) {
-        *out_utf8 = alloc_string("No error");
-    } else {
-        *out_utf8 = alloc_string(g_last_error.c_str());
+    return *out_utf8 ? BLUR_SUCCESS : BLUR_OUT_OF_MEMORY;
+}
+
+int32_t BLUR_CALL blur_get_last_error_code(int32_t* out_code) {
+    if (!out_code) {
+        return BLUR_INVALID_PARAMS;
     }
     
-    return *out_utf8 ? BLUR_SUCCESS : BLUR_OUT_OF_MEMORY;
+    *out_code = error_code();
+    return BLUR_SUCCESS;
 }
 
 void BLUR_CALL blur_free_string(char* ptr) {
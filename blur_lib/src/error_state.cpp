@@ -0,0 +1,97 @@
+/*
+ * error_state.cpp - Per-thread last-error records and lock-free error counters
+ */
+
+#include "error_state.h"
+#include <atomic>
+#include <cstdio>
+
+struct ErrorRecord {
+    int32_t code;
+    uint32_t message;
+    uint64_t arg;
+    const char* detail;
+};
+
+static thread_local ErrorRecord t_error = { BLUR_SUCCESS, ERR_MSG_NONE, 0, nullptr };
+
+/* One cache line per code so threads failing differently do not share lines */
+struct alignas(64) ErrorCounter {
+    std::atomic<uint64_t> value;
+};
+
+static ErrorCounter g_counts[BLUR_ERROR_CODE_COUNT];
+
+static const char* const g_messages[ERR_MSG_COUNT] = {
+    "No error",
+    "Library not initialized",
+    "Invalid window handle",
+    "Invalid init options (struct_version, worker_threads or reserved fields)",
+    "Too many windows tracked",
+    "No blur method available or all methods failed",
+    "SetWindowCompositionAttribute not available",
+    "SetWindowCompositionAttribute failed with error %lu",
+    "SetWindowCompositionAttribute (clear) failed with error %lu",
+    "DwmEnableBlurBehindWindow failed with HRESULT 0x%08lX",
+    "DwmEnableBlurBehindWindow (clear) failed with HRESULT 0x%08lX",
+    "Restoring %lu windows failed",
+    "%s",
+};
+
+void error_set(int32_t code, uint32_t message, uint64_t arg, const char* detail) {
+    t_error.code = code;
+    t_error.message = message < ERR_MSG_COUNT ? message : (uint32_t)ERR_MSG_NONE;
+    t_error.arg = arg;
+    t_error.detail = detail;
+    if (code >= 0 && code < BLUR_ERROR_CODE_COUNT) {
+        g_counts[code].value.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void error_clear(void) {
+    t_error.code = BLUR_SUCCESS;
+    t_error.message = ERR_MSG_NONE;
+    t_error.arg = 0;
+    t_error.detail = nullptr;
+}
+
+int32_t error_code(void) {
+    return t_error.code;
+}
+
+size_t error_format(char* buf, size_t size) {
+    if (!buf || !size) return 0;
+    const ErrorRecord& e = t_error;
+    int n;
+    switch (e.message) {
+        case ERR_MSG_SWCA_FAILED:
+        case ERR_MSG_SWCA_CLEAR_FAILED:
+        case ERR_MSG_DWM_FAILED:
+        case ERR_MSG_DWM_CLEAR_FAILED:
+        case ERR_MSG_RESTORE_FAILED:
+            n = snprintf(buf, size, g_messages[e.message], (unsigned long)e.arg);
+            break;
+        case ERR_MSG_DETAIL:
+            n = snprintf(buf, size, "%s", e.detail ? e.detail : "Unknown error");
+            break;
+        default:
+            n = snprintf(buf, size, "%s", g_messages[e.message]);
+            break;
+    }
+    if (n < 0) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+uint64_t error_count(int32_t code) {
+    if (code < 0 || code >= BLUR_ERROR_CODE_COUNT) return 0;
+    return g_counts[code].value.load(std::memory_order_relaxed);
+}
+
+void error_counts_reset(void) {
+    for (int32_t i = 0; i < BLUR_ERROR_CODE_COUNT; i++) {
+        g_counts[i].value.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * error_state.h - Per-thread last-error records and lock-free error counters
+ *
+ * Setting an error stores a code, a message id and one argument in a
+ * thread_local record and bumps a global per-code counter; no lock, no
+ * allocation. The message text is formatted only when someone asks for it,
+ * so expected failures cost a few stores.
+ */
+
+#ifndef BLUR_LIB_ERROR_STATE_H
+#define BLUR_LIB_ERROR_STATE_H
+
+#include "blur_lib.h"
+#include <stddef.h>
+
+/* Static messages; some take the record's argument or detail text */
+enum ErrorMessage {
+    ERR_MSG_NONE = 0,
+    ERR_MSG_NOT_INITIALIZED,
+    ERR_MSG_INVALID_HANDLE,
+    ERR_MSG_INIT_OPTIONS,
+    ERR_MSG_TOO_MANY_WINDOWS,
+    ERR_MSG_NO_METHOD,
+    ERR_MSG_SWCA_UNAVAILABLE,
+    ERR_MSG_SWCA_FAILED,            /* arg: Win32 error */
+    ERR_MSG_SWCA_CLEAR_FAILED,      /* arg: Win32 error */
+    ERR_MSG_DWM_FAILED,             /* arg: HRESULT */
+    ERR_MSG_DWM_CLEAR_FAILED,       /* arg: HRESULT */
+    ERR_MSG_RESTORE_FAILED,         /* arg: windows that could not be restored */
+    ERR_MSG_DETAIL,                 /* detail: a string literal, e.g. from read_effect_params */
+    ERR_MSG_COUNT
+};
+
+/* Records an error for the calling thread; detail must outlive the thread (a literal) */
+void error_set(int32_t code, uint32_t message, uint64_t arg = 0, const char* detail = nullptr);
+
+/* Forgets the calling thread's error (does not touch the counters) */
+void error_clear(void);
+
+/* The calling thread's last error code, BLUR_SUCCESS if none */
+int32_t error_code(void);
+
+/* Formats the calling thread's last error into buf; returns its length */
+size_t error_format(char* buf, size_t size);
+
+/* Errors recorded with this code by every thread */
+uint64_t error_count(int32_t code);
+void error_counts_reset(void);
+
+#endif /* BLUR_LIB_ERROR_STATE_H */
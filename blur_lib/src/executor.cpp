@@ -0,0 +1,272 @@
+/*
+ * executor.cpp - Library-wide work-stealing executor with priority lanes
+ */
+
+#include "executor.h"
+#include "scratch_arena.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Task {
+    TaskFunc   fn;
+    void*      ctx;
+    TaskGroup* group;
+    uint32_t   lane;
+};
+
+/* Initial slots of a lane's ring; a full ring doubles and keeps its size */
+#define TASK_RING_SLOTS 64
+
+/*
+ * Double-ended queue of tasks in a power-of-two ring. Unlike std::deque it
+ * never frees its storage, so once a lane has held its peak load pushing
+ * and popping make no heap allocations.
+ */
+class TaskRing {
+public:
+    TaskRing() : m_slots(TASK_RING_SLOTS), m_head(0), m_count(0) {}
+
+    bool empty() const { return m_count == 0; }
+
+    void push_back(const Task& t) {
+        if (m_count == m_slots.size()) grow();
+        m_slots[(m_head + m_count) & (m_slots.size() - 1)] = t;
+        m_count++;
+    }
+
+    Task pop_back() {
+        m_count--;
+        return m_slots[(m_head + m_count) & (m_slots.size() - 1)];
+    }
+
+    Task pop_front() {
+        Task t = m_slots[m_head];
+        m_head = (m_head + 1) & (m_slots.size() - 1);
+        m_count--;
+        return t;
+    }
+
+private:
+    void grow() {
+        std::vector<Task> slots(m_slots.size() * 2);
+        for (size_t i = 0; i < m_count; i++) slots[i] = m_slots[(m_head + i) & (m_slots.size() - 1)];
+        m_slots.swap(slots);
+        m_head = 0;
+    }
+
+    std::vector<Task> m_slots;
+    size_t m_head;
+    size_t m_count;
+};
+
+struct WorkerQueues {
+    std::mutex mutex;
+    TaskRing lanes[EXECUTOR_LANE_COUNT];
+};
+
+/*
+ * Queues are created on first use and never freed: a waiter may still be
+ * scanning them after executor_stop(), or across the next start. The count
+ * is fixed between executor_start() and executor_stop().
+ */
+static std::unique_ptr<WorkerQueues> g_queues[BLUR_MAX_WORKER_THREADS];
+static std::atomic<uint32_t> g_queue_count(0);
+static std::vector<std::thread> g_threads;
+
+static std::mutex g_control_mutex;                  /* Serializes start and stop */
+static std::atomic<bool> g_running(false);          /* Submissions are queued */
+static std::atomic<uint32_t> g_submitting(0);       /* Submissions between the g_running check and the push */
+static std::atomic<uint32_t> g_queued[EXECUTOR_LANE_COUNT];
+static std::atomic<uint32_t> g_next_queue(0);
+
+/* Idle workers and group waiters sleep here */
+static std::mutex g_sleep_mutex;
+static std::condition_variable g_sleep_cv;
+static bool g_stopping = false;                     /* Guarded by g_sleep_mutex */
+
+static std::atomic<uint64_t> g_executed[EXECUTOR_LANE_COUNT];
+static std::atomic<uint64_t> g_stolen(0), g_helped(0), g_inline_runs(0);
+
+static thread_local int32_t t_worker = -1;
+
+static void wake_all(void) {
+    { std::lock_guard<std::mutex> lock(g_sleep_mutex); }
+    g_sleep_cv.notify_all();
+}
+
+static bool queued_up_to(uint32_t lane) {
+    for (uint32_t l = 0; l <= lane; l++) {
+        if (g_queued[l].load(std::memory_order_acquire)) return true;
+    }
+    return false;
+}
+
+static void run_task(const Task& t) {
+    t.fn(t.ctx);
+    g_executed[t.lane].fetch_add(1, std::memory_order_relaxed);
+    if (t.group && t.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) wake_all();
+}
+
+/* Own deque newest first, then the oldest task of another worker; lanes in priority order */
+static bool take_task(int32_t self, uint32_t max_lane, Task* out) {
+    size_t n = g_queue_count.load(std::memory_order_acquire);
+    for (uint32_t lane = 0; lane <= max_lane; lane++) {
+        if (!g_queued[lane].load(std::memory_order_acquire)) continue;
+        if (self >= 0) {
+            WorkerQueues& q = *g_queues[self];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.lanes[lane].empty()) {
+                *out = q.lanes[lane].pop_back();
+                g_queued[lane].fetch_sub(1, std::memory_order_acq_rel);
+                return true;
+            }
+        }
+        size_t start = self >= 0 ? (size_t)self + 1 : g_next_queue.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < n; i++) {
+            size_t victim = (start + i) % n;
+            if ((int32_t)victim == self) continue;
+            WorkerQueues& q = *g_queues[victim];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.lanes[lane].empty()) continue;
+            *out = q.lanes[lane].pop_front();
+            g_queued[lane].fetch_sub(1, std::memory_order_acq_rel);
+            if (self >= 0) g_stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void worker_main(int32_t index) {
+    t_worker = index;
+    /* Create the arena now rather than inside the first band this worker runs */
+    scratch_arena();
+    for (;;) {
+        Task t;
+        if (take_task(index, EXECUTOR_LANE_BACKGROUND, &t)) {
+            run_task(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(g_sleep_mutex);
+        if (queued_up_to(EXECUTOR_LANE_BACKGROUND)) continue;
+        if (g_stopping) break;
+        g_sleep_cv.wait(lock);
+    }
+    t_worker = -1;
+}
+
+int32_t executor_start(uint32_t workers) {
+    std::lock_guard<std::mutex> control(g_control_mutex);
+    if (!g_threads.empty()) return BLUR_ALREADY_APPLIED;
+
+    if (!workers) {
+        uint32_t cores = std::thread::hardware_concurrency();
+        workers = cores > 1 ? cores - 1 : 1;
+    }
+    if (workers > BLUR_MAX_WORKER_THREADS) workers = BLUR_MAX_WORKER_THREADS;
+
+    /* Queues left by the last run are empty and reused */
+    for (uint32_t i = 0; i < workers; i++) {
+        if (!g_queues[i]) g_queues[i].reset(new WorkerQueues());
+    }
+    g_queue_count.store(workers, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(g_sleep_mutex);
+        g_stopping = false;
+    }
+    for (uint32_t i = 0; i < workers; i++) g_threads.emplace_back(worker_main, (int32_t)i);
+    g_running.store(true, std::memory_order_seq_cst);
+    return BLUR_SUCCESS;
+}
+
+void executor_stop(void) {
+    std::lock_guard<std::mutex> control(g_control_mutex);
+    if (g_threads.empty()) return;
+
+    /* New tasks run inline from here on; wait out submissions already past the check */
+    g_running.store(false, std::memory_order_seq_cst);
+    while (g_submitting.load(std::memory_order_seq_cst)) std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> lock(g_sleep_mutex);
+        g_stopping = true;
+    }
+    g_sleep_cv.notify_all();
+    for (std::thread& t : g_threads) t.join();
+    g_threads.clear();
+    /* The (empty) queues stay: a waiter may still be scanning them */
+}
+
+bool executor_running(void) {
+    return g_running.load(std::memory_order_acquire);
+}
+
+uint32_t executor_workers(void) {
+    return executor_running() ? g_queue_count.load(std::memory_order_acquire) : 0;
+}
+
+bool executor_submit(uint32_t lane, TaskFunc fn, void* ctx, TaskGroup* group) {
+    if (lane >= EXECUTOR_LANE_COUNT) lane = EXECUTOR_LANE_BACKGROUND;
+    Task t = { fn, ctx, group, lane };
+
+    g_submitting.fetch_add(1, std::memory_order_seq_cst);
+    if (!g_running.load(std::memory_order_seq_cst)) {
+        g_submitting.fetch_sub(1, std::memory_order_seq_cst);
+        fn(ctx);
+        g_inline_runs.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (group) group->pending.fetch_add(1, std::memory_order_acq_rel);
+    /* Workers keep their children local; everyone else spreads tasks round robin */
+    size_t target = t_worker >= 0 ? (size_t)t_worker
+                                  : g_next_queue.fetch_add(1, std::memory_order_relaxed) %
+                                    g_queue_count.load(std::memory_order_acquire);
+    {
+        WorkerQueues& q = *g_queues[target];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.lanes[lane].push_back(t);
+        g_queued[lane].fetch_add(1, std::memory_order_acq_rel);
+    }
+    g_submitting.fetch_sub(1, std::memory_order_seq_cst);
+    wake_all();
+    return true;
+}
+
+void executor_wait(TaskGroup* group, uint32_t help_lane) {
+    if (help_lane >= EXECUTOR_LANE_COUNT) help_lane = EXECUTOR_LANE_BACKGROUND;
+    /* A worker waiting inside a task must be able to run anything, or the pool could deadlock */
+    if (t_worker >= 0) help_lane = EXECUTOR_LANE_BACKGROUND;
+
+    while (group->pending.load(std::memory_order_acquire)) {
+        Task t;
+        if (take_task(t_worker, help_lane, &t)) {
+            g_helped.fetch_add(1, std::memory_order_relaxed);
+            run_task(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(g_sleep_mutex);
+        g_sleep_cv.wait(lock, [group, help_lane]() {
+            return !group->pending.load(std::memory_order_acquire) || queued_up_to(help_lane);
+        });
+    }
+}
+
+void executor_get_stats(ExecutorStats* stats) {
+    for (uint32_t l = 0; l < EXECUTOR_LANE_COUNT; l++) {
+        stats->executed[l] = g_executed[l].load(std::memory_order_relaxed);
+    }
+    stats->stolen = g_stolen.load(std::memory_order_relaxed);
+    stats->helped = g_helped.load(std::memory_order_relaxed);
+    stats->inline_runs = g_inline_runs.load(std::memory_order_relaxed);
+}
+
+void executor_reset_stats(void) {
+    for (uint32_t l = 0; l < EXECUTOR_LANE_COUNT; l++) g_executed[l].store(0, std::memory_order_relaxed);
+    g_stolen.store(0, std::memory_order_relaxed);
+    g_helped.store(0, std::memory_order_relaxed);
+    g_inline_runs.store(0, std::memory_order_relaxed);
+}
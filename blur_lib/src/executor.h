@@ -0,0 +1,57 @@
+/*
+ * executor.h - Library-wide work-stealing executor with priority lanes
+ *
+ * One pool of workers runs every parallel blur task. Each worker owns a
+ * deque per lane: it pops its own newest task first and, when it runs dry,
+ * steals the oldest task of another worker. Interactive work (apply,
+ * update, the focused window's frame) always goes before background work
+ * (periodic refreshes of other windows), and a thread waiting for a task
+ * group helps run it instead of blocking, so interactive work never waits
+ * for a free worker.
+ *
+ * While the executor is stopped, submitted tasks run inline on the caller.
+ */
+
+#ifndef BLUR_LIB_EXECUTOR_H
+#define BLUR_LIB_EXECUTOR_H
+
+#include "blur_lib.h"
+#include <atomic>
+
+#define EXECUTOR_LANE_INTERACTIVE   0
+#define EXECUTOR_LANE_BACKGROUND    1
+#define EXECUTOR_LANE_COUNT         2
+
+typedef void (*TaskFunc)(void* ctx);
+
+/* Tasks submitted with the same group can be waited for together */
+struct TaskGroup {
+    std::atomic<uint32_t> pending{ 0 };
+};
+
+struct ExecutorStats {
+    uint64_t executed[EXECUTOR_LANE_COUNT];
+    uint64_t stolen;            /* Tasks taken from another worker's deque */
+    uint64_t helped;            /* Tasks run by threads waiting for a group */
+    uint64_t inline_runs;       /* Tasks run on the caller while stopped */
+};
+
+/* Starts the workers (0: one per core, less one for the waiting caller); BLUR_ALREADY_APPLIED if running */
+int32_t executor_start(uint32_t workers);
+
+/* Stops taking tasks, runs every queued task and joins the workers */
+void executor_stop(void);
+
+bool executor_running(void);
+uint32_t executor_workers(void);
+
+/* Queues fn(ctx) on a lane; runs it inline and returns false while stopped */
+bool executor_submit(uint32_t lane, TaskFunc fn, void* ctx, TaskGroup* group);
+
+/* Runs queued tasks of help_lane or a higher-priority lane until the group is done */
+void executor_wait(TaskGroup* group, uint32_t help_lane);
+
+void executor_get_stats(ExecutorStats* stats);
+void executor_reset_stats(void);
+
+#endif /* BLUR_LIB_EXECUTOR_H */
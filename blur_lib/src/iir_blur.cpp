@@ -0,0 +1,220 @@
+/*
+ * iir_blur.cpp - Recursive (IIR) Gaussian blur
+ *
+ * Deriche's fourth-order recursions forwards and backwards along each row
+ * and column approximate the Gaussian with the same sixteen multiply-adds
+ * per pixel and pass at any sigma, where the exact kernel grows with 6 sigma
+ * taps.
+ *
+ * The vertical pass runs first, over column strips of the footprint: each
+ * step of the recursion is one strip row, so the arithmetic runs across
+ * IIR_STRIP_PIXELS columns at once. Its output rows keep 8 fractional bits
+ * in 16 bits, as the exact engine's intermediate does. The horizontal pass
+ * then runs over IIR_ROWS rows at once, one pixel of each row per step.
+ */
+
+#include "cpu_blur.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* Columns per vertical strip: the strip's rows stay in L2 between the two directions */
+#define IIR_STRIP_PIXELS 16
+#define IIR_STRIP (IIR_STRIP_PIXELS * 4)
+/* Rows per horizontal step: four BGRA pixels fill a 16-float vector */
+#define IIR_ROWS 4
+#define IIR_LANES (IIR_ROWS * 4)
+
+/* Intermediate scale: Q8 for sRGB bytes, Q0 for 16-bit linear */
+#define IIR_SRGB_SCALE 256.0f
+
+void build_iir_coefficients(float sigma, IirCoefficients* out) {
+    /* Deriche (1993): two damped cosines fitted to the Gaussian, stretched by sigma */
+    const double a0 = 1.680, a1 = 3.735, b0 = 1.783, b1 = 1.723;
+    const double w0 = 0.6318, w1 = 1.997, c0 = -0.6803, c1 = -0.2598;
+    const double s = sigma;
+    const double cw0 = std::cos(w0 / s), sw0 = std::sin(w0 / s), cw1 = std::cos(w1 / s), sw1 = std::sin(w1 / s);
+    const double e0 = std::exp(-b0 / s), e1 = std::exp(-b1 / s);
+
+    double n[4], d[4], m[4];
+    n[0] = a0 + c0;
+    n[1] = e1 * (c1 * sw1 - (c0 + 2.0 * a0) * cw1) + e0 * (a1 * sw0 - (2.0 * c0 + a0) * cw0);
+    n[2] = 2.0 * e0 * e1 * ((a0 + c0) * cw1 * cw0 - a1 * cw1 * sw0 - c1 * cw0 * sw1) + c0 * e0 * e0 + a0 * e1 * e1;
+    n[3] = e1 * e0 * e0 * (c1 * sw1 - c0 * cw1) + e0 * e1 * e1 * (a1 * sw0 - a0 * cw0);
+    d[0] = -2.0 * e1 * cw1 - 2.0 * e0 * cw0;
+    d[1] = 4.0 * cw1 * cw0 * e0 * e1 + e1 * e1 + e0 * e0;
+    d[2] = -2.0 * cw0 * e0 * e1 * e1 - 2.0 * cw1 * e1 * e0 * e0;
+    d[3] = e0 * e0 * e1 * e1;
+    /* The backward taps mirror the forward ones about the centre pixel, which only the forward pass counts */
+    m[0] = n[1] - d[0] * n[0];
+    m[1] = n[2] - d[1] * n[0];
+    m[2] = n[3] - d[2] * n[0];
+    m[3] = -d[3] * n[0];
+
+    /* Unit gain overall; each direction's share is what a constant input settles at */
+    const double feedback = 1.0 + d[0] + d[1] + d[2] + d[3];
+    const double sum_n = n[0] + n[1] + n[2] + n[3], sum_m = m[0] + m[1] + m[2] + m[3];
+    const double norm = (sum_n + sum_m) / feedback;
+    for (int32_t i = 0; i < 4; i++) {
+        out->n[i] = (float)(n[i] / norm);
+        out->m[i] = (float)(m[i] / norm);
+        out->d[i] = (float)d[i];
+    }
+    out->gain[0] = (float)(sum_n / norm / feedback);
+    out->gain[1] = (float)(sum_m / norm / feedback);
+}
+
+/*
+ * Blurs L independent lines at once along count steps: x holds count rows of
+ * L inputs and y receives the outputs. Past either end the input repeats the
+ * end row. hist is 6 * L floats of scratch.
+ */
+template <int32_t L>
+static void iir_lines(const IirCoefficients* c, const float* x, float* y, int32_t count, float* hist) {
+    const float n0 = c->n[0], n1 = c->n[1], n2 = c->n[2], n3 = c->n[3];
+    const float m0 = c->m[0], m1 = c->m[1], m2 = c->m[2], m3 = c->m[3];
+    const float d0 = c->d[0], d1 = c->d[1], d2 = c->d[2], d3 = c->d[3];
+    const float* first = x;
+    const float* last = x + (size_t)(count - 1) * L;
+    float* pre = hist;              /* Forward output before the first row */
+    float* post = hist + L;         /* Backward output after the last row */
+    float* ring = hist + 2 * L;     /* Backward outputs of the four rows after the current one */
+    for (int32_t l = 0; l < L; l++) {
+        pre[l] = c->gain[0] * first[l];
+        post[l] = c->gain[1] * last[l];
+    }
+
+    for (int32_t i = 0; i < count; i++) {
+        const float* x0 = x + (size_t)i * L;
+        const float* x1 = i >= 1 ? x0 - L : first;
+        const float* x2 = i >= 2 ? x0 - 2 * L : first;
+        const float* x3 = i >= 3 ? x0 - 3 * L : first;
+        float* out = y + (size_t)i * L;
+        const float* y1 = i >= 1 ? out - L : pre;
+        const float* y2 = i >= 2 ? out - 2 * L : pre;
+        const float* y3 = i >= 3 ? out - 3 * L : pre;
+        const float* y4 = i >= 4 ? out - 4 * L : pre;
+        for (int32_t l = 0; l < L; l++) {
+            out[l] = n0 * x0[l] + n1 * x1[l] + n2 * x2[l] + n3 * x3[l]
+                   - d0 * y1[l] - d1 * y2[l] - d2 * y3[l] - d3 * y4[l];
+        }
+    }
+
+    for (int32_t i = count - 1; i >= 0; i--) {
+        const float* x1 = i + 1 < count ? x + (size_t)(i + 1) * L : last;
+        const float* x2 = i + 2 < count ? x + (size_t)(i + 2) * L : last;
+        const float* x3 = i + 3 < count ? x + (size_t)(i + 3) * L : last;
+        const float* x4 = i + 4 < count ? x + (size_t)(i + 4) * L : last;
+        const float* r1 = i + 1 < count ? ring + ((i + 1) & 3) * L : post;
+        const float* r2 = i + 2 < count ? ring + ((i + 2) & 3) * L : post;
+        const float* r3 = i + 3 < count ? ring + ((i + 3) & 3) * L : post;
+        const float* r4 = i + 4 < count ? ring + ((i + 4) & 3) * L : post;
+        float* r0 = ring + (i & 3) * L;     /* The slot r4 leaves */
+        float* out = y + (size_t)i * L;
+        for (int32_t l = 0; l < L; l++) {
+            const float v = m0 * x1[l] + m1 * x2[l] + m2 * x3[l] + m3 * x4[l]
+                          - d0 * r1[l] - d1 * r2[l] - d2 * r3[l] - d3 * r4[l];
+            r0[l] = v;
+            out[l] += v;
+        }
+    }
+}
+
+static inline uint16_t to_u16(float v, float scale) {
+    v = v * scale + 0.5f;
+    return (uint16_t)(v <= 0.0f ? 0.0f : (v >= 65535.0f ? 65535.0f : v));
+}
+
+static inline uint8_t to_u8(float v) {
+    v = v * (1.0f / IIR_SRGB_SCALE) + 0.5f;
+    return (uint8_t)(v <= 0.0f ? 0.0f : (v >= 255.0f ? 255.0f : v));
+}
+
+int32_t iir_blur_rect(const BlurSurface* src, BlurSurface* dst, const IirCoefficients* c, int32_t r,
+                      uint32_t transfer, int32_t x0, int32_t y0, const BlurRowHook* hook) {
+    const int32_t w = src->width, h = src->height;
+    const int32_t ow = dst->width, oh = dst->height;
+    if (ow <= 0 || oh <= 0) return BLUR_SUCCESS;
+
+    /* Footprint: the columns and rows within the radius, clamped to src */
+    const int32_t fx0 = std::max(x0 - r, 0), fx1 = std::min(x0 + ow + r, w);
+    const int32_t fy0 = std::max(y0 - r, 0), fy1 = std::min(y0 + oh + r, h);
+    const int32_t fw = fx1 - fx0, fh = fy1 - fy0, n = fw * 4;
+    const bool linear = transfer == BLUR_TRANSFER_LINEAR;
+    const float scale = linear ? 1.0f : IIR_SRGB_SCALE;
+
+    ScratchArena& arena = scratch_arena();
+    ArenaScope scope(arena);
+    uint16_t* mid = arena.alloc_array<uint16_t>((size_t)oh * n);
+    float* hist = arena.alloc_array<float>((size_t)6 * IIR_STRIP);
+    if (!mid || !hist) return BLUR_OUT_OF_MEMORY;
+
+    /* Vertical pass, one strip of columns at a time; the last strip's spare lanes blur zeros */
+    {
+        ArenaScope pass(arena);
+        float* xs = arena.alloc_array<float>((size_t)fh * IIR_STRIP);
+        float* ys = arena.alloc_array<float>((size_t)fh * IIR_STRIP);
+        uint16_t* decoded = arena.alloc_array<uint16_t>(IIR_STRIP);
+        if (!xs || !ys || !decoded) return BLUR_OUT_OF_MEMORY;
+
+        for (int32_t s = 0; s < n; s += IIR_STRIP) {
+            const int32_t m = std::min(IIR_STRIP, n - s);
+            for (int32_t y = 0; y < fh; y++) {
+                const uint8_t* line = src->pixels + (size_t)(fy0 + y) * src->stride + (size_t)fx0 * 4 + s;
+                float* in = xs + (size_t)y * IIR_STRIP;
+                if (linear) {
+                    srgb_decode_row(line, decoded, m / 4);
+                    for (int32_t i = 0; i < m; i++) in[i] = decoded[i];
+                } else {
+                    for (int32_t i = 0; i < m; i++) in[i] = line[i];
+                }
+                for (int32_t i = m; i < IIR_STRIP; i++) in[i] = 0.0f;
+            }
+            iir_lines<IIR_STRIP>(c, xs, ys, fh, hist);
+            for (int32_t y = 0; y < oh; y++) {
+                const float* row = ys + (size_t)(y0 + y - fy0) * IIR_STRIP;
+                uint16_t* out = mid + (size_t)y * n + s;
+                for (int32_t i = 0; i < m; i++) out[i] = to_u16(row[i], scale);
+            }
+        }
+    }
+
+    /* Horizontal pass, IIR_ROWS output rows at a time with their pixels interleaved */
+    ArenaScope pass(arena);
+    float* xs = arena.alloc_array<float>((size_t)fw * IIR_LANES);
+    float* ys = arena.alloc_array<float>((size_t)fw * IIR_LANES);
+    uint16_t* out_rows = linear ? arena.alloc_array<uint16_t>((size_t)IIR_ROWS * ow * 4) : nullptr;
+    if (!xs || !ys || (linear && !out_rows)) return BLUR_OUT_OF_MEMORY;
+    const int32_t ox = x0 - fx0;
+
+    for (int32_t yb = 0; yb < oh; yb += IIR_ROWS) {
+        const int32_t count = std::min(IIR_ROWS, oh - yb);
+        for (int32_t j = 0; j < IIR_ROWS; j++) {
+            const uint16_t* row = mid + (size_t)std::min(yb + j, oh - 1) * n;
+            for (int32_t x = 0; x < fw; x++) {
+                float* lane = xs + (size_t)x * IIR_LANES + j * 4;
+                for (int32_t ch = 0; ch < 4; ch++) lane[ch] = row[x * 4 + ch];
+            }
+        }
+        iir_lines<IIR_LANES>(c, xs, ys, fw, hist);
+
+        for (int32_t j = 0; j < count; j++) {
+            const float* lane = ys + (size_t)ox * IIR_LANES + j * 4;
+            if (linear) {
+                uint16_t* o = out_rows + (size_t)j * ow * 4;
+                for (int32_t x = 0; x < ow; x++, lane += IIR_LANES, o += 4) {
+                    for (int32_t ch = 0; ch < 4; ch++) o[ch] = to_u16(lane[ch], 1.0f);
+                }
+                srgb_encode_row(out_rows + (size_t)j * ow * 4, dst->pixels + (size_t)(yb + j) * dst->stride, ow);
+            } else {
+                uint8_t* o = dst->pixels + (size_t)(yb + j) * dst->stride;
+                for (int32_t x = 0; x < ow; x++, lane += IIR_LANES, o += 4) {
+                    for (int32_t ch = 0; ch < 4; ch++) o[ch] = to_u8(lane[ch]);
+                }
+            }
+            run_row_hook(hook, dst->pixels + (size_t)(yb + j) * dst->stride, ow, yb + j);
+        }
+    }
+    return BLUR_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/*
+ * image_metrics.cpp - Quality metrics for blur approximations
+ */
+
+#include "image_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/* Squared error and largest difference of one row; the mask keeps alpha out without a branch */
+static void row_error(const uint8_t* a, const uint8_t* b, int32_t bytes, uint64_t* sq, int32_t* max_error) {
+    uint64_t row_sq = 0;
+    int32_t row_max = 0;
+    for (int32_t i = 0; i < bytes; i++) {
+        int32_t d = ((int32_t)a[i] - (int32_t)b[i]) & -(int32_t)((i & 3) != 3);
+        row_sq += (uint64_t)(d * d);
+        int32_t ad = d < 0 ? -d : d;
+        row_max = ad > row_max ? ad : row_max;
+    }
+    *sq += row_sq;
+    if (row_max > *max_error) *max_error = row_max;
+}
+
+/* Rec. 601 luma in 8 bits */
+static void luma_row(const uint8_t* bgra, uint8_t* y, int32_t width) {
+    for (int32_t x = 0; x < width; x++) {
+        const uint8_t* p = bgra + (size_t)x * 4;
+        y[x] = (uint8_t)((29 * p[0] + 150 * p[1] + 77 * p[2] + 128) >> 8);
+    }
+}
+
+static double window_ssim(const uint8_t* a, const uint8_t* b, int32_t stride) {
+    uint32_t sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+    for (int32_t y = 0; y < METRICS_SSIM_WINDOW; y++) {
+        const uint8_t* ra = a + (size_t)y * stride;
+        const uint8_t* rb = b + (size_t)y * stride;
+        for (int32_t x = 0; x < METRICS_SSIM_WINDOW; x++) {
+            uint32_t va = ra[x], vb = rb[x];
+            sa += va;
+            sb += vb;
+            saa += va * va;
+            sbb += vb * vb;
+            sab += va * vb;
+        }
+    }
+    const double n = METRICS_SSIM_WINDOW * METRICS_SSIM_WINDOW;
+    const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+    double ma = sa / n, mb = sb / n;
+    double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+    return ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+}
+
+int32_t compare_images(const BlurSurface* a, const BlurSurface* b, ImageMetrics* out) {
+    if (!a || !b || !out || !a->pixels || !b->pixels) return BLUR_INVALID_PARAMS;
+    if (a->width != b->width || a->height != b->height || a->width <= 0 || a->height <= 0) {
+        return BLUR_INVALID_PARAMS;
+    }
+    const int32_t w = a->width, h = a->height;
+
+    uint64_t sq = 0;
+    int32_t max_error = 0;
+    for (int32_t y = 0; y < h; y++) {
+        row_error(a->pixels + (size_t)y * a->stride, b->pixels + (size_t)y * b->stride, w * 4, &sq, &max_error);
+    }
+    out->mse = (double)sq / ((double)w * h * 3);
+    out->psnr = out->mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / out->mse) : INFINITY;
+    out->max_error = max_error;
+
+    std::vector<uint8_t> ya((size_t)w * h), yb((size_t)w * h);
+    for (int32_t y = 0; y < h; y++) {
+        luma_row(a->pixels + (size_t)y * a->stride, &ya[(size_t)y * w], w);
+        luma_row(b->pixels + (size_t)y * b->stride, &yb[(size_t)y * w], w);
+    }
+    if (w < METRICS_SSIM_WINDOW || h < METRICS_SSIM_WINDOW) {
+        /* No whole window fits: identical or not is all there is to say */
+        out->ssim = sq ? 0.0 : 1.0;
+        return BLUR_SUCCESS;
+    }
+    double total = 0.0;
+    int64_t windows = 0;
+    for (int32_t y = 0; y + METRICS_SSIM_WINDOW <= h; y += METRICS_SSIM_STEP) {
+        for (int32_t x = 0; x + METRICS_SSIM_WINDOW <= w; x += METRICS_SSIM_STEP) {
+            total += window_ssim(&ya[(size_t)y * w + x], &yb[(size_t)y * w + x], w);
+            windows++;
+        }
+    }
+    out->ssim = total / (double)windows;
+    return BLUR_SUCCESS;
+}
+
+int32_t reference_blur(const BlurSurface* src, BlurSurface* dst, double sigma, bool linear) {
+    if (!src || !dst || !src->pixels || !dst->pixels) return BLUR_INVALID_PARAMS;
+    if (src->width != dst->width || src->height != dst->height) return BLUR_INVALID_PARAMS;
+    const int32_t w = src->width, h = src->height;
+    if (w <= 0 || h <= 0) return BLUR_SUCCESS;
+
+    const int32_t r = sigma > 0.0 ? (int32_t)std::ceil(sigma * 4.0) : 0;
+    std::vector<double> weights((size_t)r * 2 + 1, 1.0);
+    double sum = 0.0;
+    for (int32_t i = -r; i <= r; i++) {
+        if (r) weights[i + r] = std::exp(-(double)i * i / (2.0 * sigma * sigma));
+        sum += weights[i + r];
+    }
+    for (double& wt : weights) wt /= sum;
+
+    double decode[256];
+    for (int32_t v = 0; v < 256; v++) decode[v] = linear ? srgb_to_linear(v / 255.0) : v / 255.0;
+
+    const size_t n = (size_t)w * 4;
+    std::vector<double> plane(n * h), horizontal(n * h);
+    for (int32_t y = 0; y < h; y++) {
+        const uint8_t* row = src->pixels + (size_t)y * src->stride;
+        for (size_t i = 0; i < n; i++) plane[y * n + i] = (i & 3) == 3 ? row[i] / 255.0 : decode[row[i]];
+    }
+
+    for (int32_t y = 0; y < h; y++) {
+        const double* in = &plane[y * n];
+        double* out = &horizontal[y * n];
+        for (int32_t x = 0; x < w; x++) {
+            double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+            for (int32_t k = -r; k <= r; k++) {
+                int32_t sx = x + k < 0 ? 0 : (x + k >= w ? w - 1 : x + k);
+                for (int32_t c = 0; c < 4; c++) acc[c] += weights[k + r] * in[(size_t)sx * 4 + c];
+            }
+            for (int32_t c = 0; c < 4; c++) out[(size_t)x * 4 + c] = acc[c];
+        }
+    }
+
+    std::vector<double> acc(n);
+    for (int32_t y = 0; y < h; y++) {
+        std::fill(acc.begin(), acc.end(), 0.0);
+        for (int32_t k = -r; k <= r; k++) {
+            int32_t sy = y + k < 0 ? 0 : (y + k >= h ? h - 1 : y + k);
+            const double* in = &horizontal[(size_t)sy * n];
+            for (size_t i = 0; i < n; i++) acc[i] += weights[k + r] * in[i];
+        }
+        uint8_t* row = dst->pixels + (size_t)y * dst->stride;
+        for (size_t i = 0; i < n; i++) {
+            double v = (linear && (i & 3) != 3) ? linear_to_srgb(acc[i]) : acc[i];
+            v = std::floor(v * 255.0 + 0.5);
+            row[i] = (uint8_t)(v < 0.0 ? 0.0 : (v > 255.0 ? 255.0 : v));
+        }
+    }
+    return BLUR_SUCCESS;
+}
@@ -6,6 +6,7 @@
 #define BLUR_LIB_INTERNAL_H
 
 #include "blur_lib.h"
+#include "error_state.h"
 
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -82,6 +83,7 @@ typedef BOOL(WINAPI* SetWindowCompositionAttributeFunc)(HWND, WINDOWCOMPOSITIONA
 void log_init(void);
 void log_shutdown(void);
 void log_message(int32_t level, const char* format, ...);
+bool log_enabled(int32_t level);
 
 #define LOG_ERROR(fmt, ...) log_message(BLUR_LOG_ERROR, fmt, ##__VA_ARGS__)
 #define LOG_WARN(fmt, ...)  log_message(BLUR_LOG_WARN, fmt, ##__VA_ARGS__)
@@ -91,15 +93,16 @@ void log_message(int32_t level, const char* format, ...);
 /* ============================================================================
  * Error handling (error.cpp)
  * ============================================================================ */
-void set_last_error(const char* message);
+/* Records the calling thread's error (see error_state.h) and logs it if enabled */
+void set_last_error(int32_t code, uint32_t message, uint64_t arg = 0, const char* detail = nullptr);
 char* alloc_string(const char* src);
 
 /* ============================================================================
- * Window tracking (blur_lib.cpp)
+ * Window tracking (window_tracker.cpp)
  * ============================================================================ */
 void init_window_tracker(void);
 void cleanup_window_tracker(void);
-void track_window(HWND hwnd, const EffectParams* params);
+int32_t track_window(HWND hwnd, const EffectParams* params, uint32_t backend);
 void untrack_window(HWND hwnd);
 bool is_blur_applied(HWND hwnd);
 int32_t restore_all_tracked_windows(SetWindowCompositionAttributeFunc pFunc);
@@ -121,8 +124,18 @@ int32_t clear_dwm_blur(HWND hwnd);
 /* ============================================================================
  * Direct2D Blur implementation (d2d_blur.cpp)
  * ============================================================================ */
-int32_t apply_d2d_blur(HWND hwnd, const EffectParams* params);
+/* Deadline of an apply called with timeout_ms = 0: the apply SLO (95% under 300 ms) */
+#define APPLY_DEFAULT_TIMEOUT_MS 300
+
+int32_t apply_d2d_blur(HWND hwnd, const EffectParams* params, uint32_t timeout_ms);
 int32_t clear_d2d_blur(HWND hwnd);
+void detach_d2d_window(HWND hwnd);               /* Stops refreshing; any thread */
+void sync_d2d_refresh(void);                     /* Returns once the tick thread has re-armed for the detaches so far */
+int32_t restore_d2d_window_style(HWND hwnd);     /* Drops WS_EX_LAYERED; any thread */
+void warmup_d2d_resources(void);     /* Background warm-up (BLUR_INIT_WARMUP) */
+void cleanup_d2d_resources(void);    /* Frees pooled surfaces once no window is blurred */
+class TickRecorder;
+void set_d2d_recorder(TickRecorder* recorder);  /* NULL stops; returns once no tick uses the old one */
 
 
 #endif /* BLUR_LIB_INTERNAL_H */
@@ -0,0 +1,92 @@
+/*
+ * kernel_cache.cpp - Shared table of built blur kernels
+ */
+
+#include "kernel_cache.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+struct KernelEntry {
+    float sigma;
+    uint32_t algorithm;
+    int32_t downsample;
+    bool linear;
+    BlurKernel kernel;
+};
+
+static KernelEntry g_entries[KERNEL_CACHE_SIZE];
+static std::atomic<uint32_t> g_count(0);   /* Entries [0, g_count) are published */
+static std::mutex g_insert_mutex;
+
+/* Intensities apps use most (the slider ends and quarters) */
+static const float g_common_intensities[] = { 0.25f, 0.5f, 0.75f, 1.0f };
+static const uint32_t g_common_algorithms[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX, BLUR_ALGORITHM_PYRAMID };
+
+static inline bool same_key(const KernelEntry& e, float sigma, uint32_t algorithm, int32_t downsample, bool linear) {
+    /* Bitwise so that equal keys always hash the same kernel, NaN included */
+    return memcmp(&e.sigma, &sigma, sizeof(sigma)) == 0 && e.algorithm == algorithm && e.downsample == downsample &&
+           e.linear == linear;
+}
+
+static const BlurKernel* find(uint32_t count, float sigma, uint32_t algorithm, int32_t downsample, bool linear) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (same_key(g_entries[i], sigma, algorithm, downsample, linear)) return &g_entries[i].kernel;
+    }
+    return nullptr;
+}
+
+/* Nearest multiple of KERNEL_SIGMA_STEP; NaN and infinities pass through */
+static inline float quantize_sigma(float sigma) {
+    return std::round(sigma / KERNEL_SIGMA_STEP) * KERNEL_SIGMA_STEP;
+}
+
+const BlurKernel* get_blur_kernel(float sigma, uint32_t algorithm, int32_t downsample, bool linear,
+                                  BlurKernel* fallback) {
+    if (downsample < 1) downsample = 1;
+    sigma = quantize_sigma(sigma);
+    const BlurKernel* k = find(g_count.load(std::memory_order_acquire), sigma, algorithm, downsample, linear);
+    if (k) return k;
+
+    std::lock_guard<std::mutex> lock(g_insert_mutex);
+    uint32_t count = g_count.load(std::memory_order_relaxed);
+    k = find(count, sigma, algorithm, downsample, linear);
+    if (k) return k;
+    if (count == KERNEL_CACHE_SIZE) {
+        build_blur_kernel(sigma, algorithm, downsample, fallback);
+        kernel_set_linear_light(fallback, linear);
+        return fallback;
+    }
+
+    KernelEntry& e = g_entries[count];
+    e.sigma = sigma;
+    e.algorithm = algorithm;
+    e.downsample = downsample;
+    e.linear = linear;
+    build_blur_kernel(sigma, algorithm, downsample, &e.kernel);
+    kernel_set_linear_light(&e.kernel, linear);
+    g_count.store(count + 1, std::memory_order_release);
+    return &e.kernel;
+}
+
+uint32_t prewarm_blur_kernels(void) {
+    for (float intensity : g_common_intensities) {
+        for (uint32_t algorithm : g_common_algorithms) {
+            BlurKernel unused;
+            get_blur_kernel(sigma_from_intensity(intensity), algorithm, 1, false, &unused);
+        }
+    }
+    return kernel_cache_count();
+}
+
+uint32_t kernel_cache_count(void) {
+    return g_count.load(std::memory_order_acquire);
+}
+
+void kernel_cache_clear(void) {
+    std::lock_guard<std::mutex> lock(g_insert_mutex);
+    uint32_t count = g_count.load(std::memory_order_relaxed);
+    g_count.store(0, std::memory_order_release);
+    for (uint32_t i = 0; i < count; i++) g_entries[i].kernel.weights.clear();
+}
@@ -0,0 +1,41 @@
+/*
+ * kernel_cache.h - Shared table of built blur kernels
+ *
+ * Refresh ticks used to rebuild every window's kernel each frame. Kernels
+ * built here are kept for the life of the process and found again without
+ * a lock: entries are immutable once published, and only insertion takes a
+ * mutex. Sigmas are rounded to KERNEL_SIGMA_STEP first, so a slider swept
+ * across the whole intensity range lands on at most 81 keys per algorithm
+ * and keeps hitting the table. The table never evicts, as callers hold its
+ * kernels without a lock; once it is full, callers get a kernel built into
+ * their own storage instead.
+ */
+
+#ifndef BLUR_LIB_KERNEL_CACHE_H
+#define BLUR_LIB_KERNEL_CACHE_H
+
+#include "cpu_blur.h"
+
+#define KERNEL_CACHE_SIZE 256
+/* Sigma resolution of cached kernels in pixels; a quarter pixel of sigma is not visible */
+#define KERNEL_SIGMA_STEP 0.25f
+
+/*
+ * The kernel build_blur_kernel() would produce for sigma rounded to
+ * KERNEL_SIGMA_STEP, blurring in linear light if asked and the kernel is
+ * direct. Returns a cached kernel, or builds into
+ * *fallback when the table is full; the pointer stays valid until
+ * kernel_cache_clear() (cached) or while *fallback lives.
+ */
+const BlurKernel* get_blur_kernel(float sigma, uint32_t algorithm, int32_t downsample, bool linear,
+                                  BlurKernel* fallback);
+
+/* Builds the kernels of common intensities for every CPU algorithm; returns how many are cached */
+uint32_t prewarm_blur_kernels(void);
+
+uint32_t kernel_cache_count(void);
+
+/* Drops every entry; no other thread may hold a cached kernel */
+void kernel_cache_clear(void);
+
+#endif /* BLUR_LIB_KERNEL_CACHE_H */
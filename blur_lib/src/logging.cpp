@@ -25,6 +25,10 @@ void log_shutdown(void) {
     g_log_user_data = nullptr;
 }
 
+bool log_enabled(int32_t level) {
+    return level <= g_log_level;
+}
+
 void log_message(int32_t level, const char* format, ...) {
     if (level > g_log_level) {
         return;
@@ -0,0 +1,115 @@
+/*
+ * memory_budget.cpp - Process-wide memory budget for per-window buffers
+ */
+
+#include "memory_budget.h"
+#include "stats.h"
+#include <algorithm>
+
+MemoryBudget::MemoryBudget() : m_budget(0), m_used(0), m_peak(0) {}
+
+void MemoryBudget::set_budget(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+}
+
+uint64_t MemoryBudget::budget() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+void MemoryBudget::publish() {
+    m_peak = std::max(m_peak, m_used);
+    stats_set(BLUR_STAT_MEMORY_BYTES, m_used);
+    stats_max(BLUR_STAT_MEMORY_PEAK, m_used);
+}
+
+void MemoryBudget::update(uint64_t handle, uint32_t kind, uint64_t bytes) {
+    if (kind >= MEMORY_KINDS) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint64_t, Entry>::iterator it = m_entries.find(handle);
+    if (it == m_entries.end()) {
+        if (!bytes) return;
+        Entry e = Entry();
+        it = m_entries.insert(std::make_pair(handle, e)).first;
+    }
+    m_used = m_used - it->second.bytes[kind] + bytes;
+    it->second.bytes[kind] = bytes;
+
+    bool empty = true;
+    for (uint32_t k = 0; k < MEMORY_KINDS; k++) empty = empty && !it->second.bytes[k];
+    if (empty) m_entries.erase(it);
+    publish();
+}
+
+void MemoryBudget::remove(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint64_t, Entry>::iterator it = m_entries.find(handle);
+    if (it == m_entries.end()) return;
+    for (uint32_t k = 0; k < MEMORY_KINDS; k++) m_used -= it->second.bytes[k];
+    m_entries.erase(it);
+    publish();
+}
+
+void MemoryBudget::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_used = 0;
+    publish();
+}
+
+void MemoryBudget::presented(uint64_t handle, uint64_t tick, bool moved) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& e = m_entries[handle];
+    e.presented_tick = tick;
+    if (moved) e.moved_tick = tick;
+}
+
+int32_t MemoryBudget::backdrop_reduction(uint64_t handle, uint64_t tick, bool foreground) const {
+    if (!foreground) return 2;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint64_t, Entry>::const_iterator it = m_entries.find(handle);
+    uint64_t moved = it == m_entries.end() ? 0 : it->second.moved_tick;
+    return tick >= moved + MEMORY_IDLE_TICKS ? 2 : 1;
+}
+
+void MemoryBudget::select_victims(uint64_t tick, std::vector<MemoryVictim>* out) {
+    out->clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_budget || m_used <= m_budget) return;
+
+    std::vector<std::pair<uint64_t, MemoryVictim>> candidates;
+    for (const auto& kv : m_entries) {
+        if (kv.second.presented_tick >= tick) continue;
+        MemoryVictim v = { kv.first, 0 };
+        for (uint32_t k = 0; k < MEMORY_KINDS; k++) v.bytes += kv.second.bytes[k];
+        if (v.bytes) candidates.push_back(std::make_pair(kv.second.presented_tick, v));
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<uint64_t, MemoryVictim>& a, const std::pair<uint64_t, MemoryVictim>& b) {
+                  return a.first < b.first;
+              });
+
+    uint64_t used = m_used;
+    for (const auto& c : candidates) {
+        if (used <= m_budget) break;
+        out->push_back(c.second);
+        used -= c.second.bytes;
+    }
+    stats_add(BLUR_STAT_MEMORY_EVICTIONS, out->size());
+}
+
+uint64_t MemoryBudget::used() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used;
+}
+
+uint64_t MemoryBudget::peak() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peak;
+}
+
+MemoryBudget& memory_budget(void) {
+    static MemoryBudget budget;
+    return budget;
+}
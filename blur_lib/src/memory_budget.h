@@ -0,0 +1,87 @@
+/*
+ * memory_budget.h - Process-wide memory budget for per-window buffers
+ *
+ * Every blurred window holds a presentation surface and a backdrop cache at
+ * the size of the window, and nothing used to bound their total. The budget
+ * tracks what each window holds and when it was last presented. Once the
+ * total is over the budget, the windows presented least recently give up
+ * their buffers (the next refresh of such a window allocates them again);
+ * windows presented in the current tick are never evicted.
+ *
+ * Idle windows (still for MEMORY_IDLE_TICKS ticks) and background windows
+ * keep their backdrop caches at half resolution; see backdrop_cache.h.
+ *
+ * The total and its peak are published as BLUR_STAT_MEMORY_BYTES and
+ * BLUR_STAT_MEMORY_PEAK, evictions as BLUR_STAT_MEMORY_EVICTIONS.
+ */
+
+#ifndef BLUR_LIB_MEMORY_BUDGET_H
+#define BLUR_LIB_MEMORY_BUDGET_H
+
+#include "blur_lib.h"
+#include <map>
+#include <mutex>
+#include <vector>
+
+#define MEMORY_KIND_SURFACE     0   /* Presentation surface */
+#define MEMORY_KIND_BACKDROP    1   /* Backdrop cache pixels */
+#define MEMORY_KINDS            2
+
+/* Ticks without a move after which a foreground window's backdrop is kept reduced too */
+#define MEMORY_IDLE_TICKS       30
+
+struct MemoryVictim {
+    uint64_t handle;
+    uint64_t bytes;     /* All kinds together */
+};
+
+class MemoryBudget {
+public:
+    MemoryBudget();
+
+    /* Bytes for every window's buffers together (0 = no limit) */
+    void set_budget(uint64_t bytes);
+    uint64_t budget() const;
+
+    /* What a window holds of a kind now; 0 for every kind forgets the window */
+    void update(uint64_t handle, uint32_t kind, uint64_t bytes);
+    void remove(uint64_t handle);
+    void clear();
+
+    /* The window was presented (and moved, if moved) in tick */
+    void presented(uint64_t handle, uint64_t tick, bool moved);
+
+    /* Resolution divisor for the window's next backdrop store (1 or 2) */
+    int32_t backdrop_reduction(uint64_t handle, uint64_t tick, bool foreground) const;
+
+    /*
+     * Windows to evict, least recently presented first, until the rest fit
+     * the budget; windows presented in tick or later are kept. Eviction
+     * counts them; the caller frees their buffers and reports 0 bytes.
+     */
+    void select_victims(uint64_t tick, std::vector<MemoryVictim>* out);
+
+    uint64_t used() const;
+    uint64_t peak() const;
+
+private:
+    struct Entry {
+        uint64_t bytes[MEMORY_KINDS];
+        uint64_t presented_tick;    /* 0 = never */
+        uint64_t moved_tick;
+    };
+
+    /* Publishes the total; caller holds m_mutex */
+    void publish();
+
+    mutable std::mutex m_mutex;
+    uint64_t m_budget;
+    uint64_t m_used;
+    uint64_t m_peak;
+    std::map<uint64_t, Entry> m_entries;
+};
+
+/* The budget shared by every refresh tick */
+MemoryBudget& memory_budget(void);
+
+#endif /* BLUR_LIB_MEMORY_BUDGET_H */
@@ -0,0 +1,88 @@
+/*
+ * parallel_restore.cpp - Clears many tracked windows on a bounded worker pool
+ */
+
+#include "parallel_restore.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct RestoreJob {
+    const BlurWindowInfo_V1* windows;
+    uint32_t count;
+    RestoreFunc fn;
+    void* ctx;
+    std::vector<int32_t> results;
+    std::atomic<uint32_t> next;
+    std::atomic<uint32_t> running;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+};
+
+static void restore_worker(RestoreJob* job) {
+    for (;;) {
+        uint32_t i = job->next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= job->count) break;
+        job->results[i] = job->fn(&job->windows[i], job->ctx);
+    }
+    std::lock_guard<std::mutex> lock(job->done_mutex);
+    if (job->running.fetch_sub(1, std::memory_order_acq_rel) == 1) job->done_cv.notify_all();
+}
+
+int32_t restore_windows(const BlurWindowInfo_V1* windows, uint32_t count, uint32_t max_workers,
+                        RestoreFunc fn, void* ctx, void (*pump)(void), RestoreSummary* summary) {
+    RestoreSummary sum = { 0, 0, 0, 0, BLUR_SUCCESS };
+    if (!fn || (!windows && count)) return BLUR_INVALID_PARAMS;
+
+    uint32_t workers = max_workers ? max_workers : std::thread::hardware_concurrency();
+    if (workers > RESTORE_MAX_WORKERS) workers = RESTORE_MAX_WORKERS;
+    if (workers > count) workers = count;
+
+    RestoreJob job;
+    job.windows = windows;
+    job.count = count;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.results.assign(count, BLUR_SUCCESS);
+    job.next.store(0);
+
+    if (workers <= 1) {
+        /* Not worth a thread: clear on the caller */
+        for (uint32_t i = 0; i < count; i++) job.results[i] = fn(&windows[i], ctx);
+    } else {
+        job.running.store(workers);
+        std::vector<std::thread> threads;
+        threads.reserve(workers);
+        for (uint32_t w = 0; w < workers; w++) threads.emplace_back(restore_worker, &job);
+        sum.workers = workers;
+
+        std::unique_lock<std::mutex> lock(job.done_mutex);
+        while (job.running.load(std::memory_order_acquire) > 0) {
+            if (pump) {
+                lock.unlock();
+                pump();
+                lock.lock();
+            }
+            job.done_cv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        lock.unlock();
+        for (std::thread& t : threads) t.join();
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t rc = job.results[i];
+        if (rc == BLUR_SUCCESS) {
+            sum.cleared++;
+        } else if (rc == BLUR_INVALID_HANDLE) {
+            sum.skipped++;
+        } else {
+            if (!sum.failed) sum.first_error = rc;
+            sum.failed++;
+        }
+    }
+    if (summary) *summary = sum;
+    return sum.first_error;
+}
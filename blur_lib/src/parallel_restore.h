@@ -0,0 +1,38 @@
+/*
+ * parallel_restore.h - Clears many tracked windows on a bounded worker pool
+ *
+ * Undoing blur sends messages to each window's thread, so one slow or hung
+ * window used to hold up every window behind it. Windows are now handed out
+ * to a few worker threads; the calling thread only waits, running the pump
+ * callback so that messages sent to its own windows are still delivered.
+ */
+
+#ifndef BLUR_LIB_PARALLEL_RESTORE_H
+#define BLUR_LIB_PARALLEL_RESTORE_H
+
+#include "blur_lib.h"
+
+/* Upper bound on restore workers, whatever the core count */
+#define RESTORE_MAX_WORKERS 8
+
+/* Clears one window; BLUR_INVALID_HANDLE means it no longer exists and is only skipped */
+typedef int32_t (*RestoreFunc)(const BlurWindowInfo_V1* window, void* ctx);
+
+struct RestoreSummary {
+    uint32_t cleared;
+    uint32_t skipped;       /* Windows already destroyed */
+    uint32_t failed;
+    uint32_t workers;       /* Threads used (0 when the caller cleared them itself) */
+    int32_t  first_error;   /* Code of the first failing window in list order */
+};
+
+/*
+ * Calls fn for every window, on at most max_workers threads (0 = one per core,
+ * capped at RESTORE_MAX_WORKERS). pump, if given, runs on the calling thread
+ * every millisecond until the workers finish. Returns BLUR_SUCCESS when no
+ * window failed, otherwise the first failure's code.
+ */
+int32_t restore_windows(const BlurWindowInfo_V1* windows, uint32_t count, uint32_t max_workers,
+                        RestoreFunc fn, void* ctx, void (*pump)(void), RestoreSummary* summary);
+
+#endif /* BLUR_LIB_PARALLEL_RESTORE_H */
@@ -0,0 +1,182 @@
+/*
+ * quality_governor.cpp - Deadline-aware quality degradation
+ */
+
+#include "quality_governor.h"
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+
+static void add_rung(QualityLadder* out, uint32_t algorithm, int32_t downsample, bool repeat) {
+    if (!repeat && out->count > 0) {
+        const QualityRung& last = out->rungs[out->count - 1];
+        if (last.algorithm == algorithm && last.downsample == downsample) return;
+    }
+    QualityRung r = { algorithm, downsample, repeat };
+    out->rungs[out->count++] = r;
+}
+
+void build_quality_ladder(uint32_t algorithm, int32_t downsample, QualityLadder* out) {
+    int32_t d = downsample < 1 ? 1 : downsample;
+    int32_t d2 = std::min(d * 2, (int32_t)BLUR_MAX_DOWNSAMPLE);
+    int32_t d4 = std::min(d * 4, (int32_t)BLUR_MAX_DOWNSAMPLE);
+    out->count = 0;
+    add_rung(out, algorithm, d, false);
+    add_rung(out, algorithm, d2, false);
+    add_rung(out, BLUR_ALGORITHM_BOX, d2, false);
+    add_rung(out, BLUR_ALGORITHM_BOX, d4, false);
+    add_rung(out, algorithm, d, true);
+}
+
+double rung_cost_units(const CalibrationModel* model, const QualityRung& rung, int64_t pixels, float sigma) {
+    if (rung.repeat) return 0.0;
+    int32_t d = rung.downsample < 1 ? 1 : rung.downsample;
+    int64_t work = std::max<int64_t>(pixels / ((int64_t)d * d), 1);
+    float s = sigma / (float)d;
+    uint32_t algorithm = rung.algorithm;
+    if (algorithm == BLUR_ALGORITHM_IIR && s < IIR_MIN_SIGMA) algorithm = BLUR_ALGORITHM_EXACT;
+
+    if (model && model->valid) {
+        double ns = predict_cost_ns(*model, algorithm, work, s);
+        if (ns >= 0.0) {
+            /* Reduction and expansion touch every pixel, about as much as a box pass */
+            if (d > 1) {
+                for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+                    if (model->costs[i].algorithm == BLUR_ALGORITHM_BOX) ns += (double)pixels * model->costs[i].ns_per_pixel;
+                }
+            }
+            return ns;
+        }
+    }
+
+    /*
+     * Taps per working pixel over both passes: three running sums for a box,
+     * a 5-tap level for a pyramid, two fourth-order recursions for IIR
+     */
+    double taps;
+    if (algorithm == BLUR_ALGORITHM_BOX) {
+        taps = 6.0;
+    } else if (algorithm == BLUR_ALGORITHM_PYRAMID) {
+        taps = 10.0;
+    } else if (algorithm == BLUR_ALGORITHM_IIR) {
+        taps = 32.0;
+    } else {
+        taps = 2.0 * (2.0 * std::ceil(3.0 * s) + 1.0);
+    }
+    return (double)work * taps + (d > 1 ? 2.0 * (double)pixels : 0.0);
+}
+
+QualityGovernor::QualityGovernor()
+    : m_ladder(), m_algorithm(BLUR_ALGORITHM_EXACT), m_downsample(1), m_sigma(0.0f), m_model(),
+      m_level(0), m_saved_level(0), m_dragging(false), m_repeats(0), m_headroom(false),
+      m_headroom_since_us(0), m_budget_us(0), m_us_per_unit(0.0) {
+    build_quality_ladder(m_algorithm, m_downsample, &m_ladder);
+}
+
+void QualityGovernor::configure(uint32_t algorithm, int32_t downsample, float sigma) {
+    CalibrationModel model;
+    bool calibrated = get_active_calibration(&model);
+    if (calibrated != m_model.valid) {
+        /* Units change meaning: a model predicts ns outright, taps need a measurement first */
+        m_us_per_unit = calibrated ? 0.001 : 0.0;
+        m_model = calibrated ? model : CalibrationModel();
+    } else if (calibrated) {
+        m_model = model;
+    }
+    m_sigma = sigma;
+
+    if (algorithm == m_algorithm && downsample == m_downsample) return;
+    m_algorithm = algorithm;
+    m_downsample = downsample;
+    build_quality_ladder(algorithm, downsample, &m_ladder);
+    m_level = std::min(m_level, m_ladder.count - 1);
+    m_saved_level = std::min(m_saved_level, m_ladder.count - 1);
+}
+
+uint64_t QualityGovernor::predict_us(uint32_t rung, int64_t pixels) const {
+    if (m_us_per_unit <= 0.0 || rung >= m_ladder.count) return 0;
+    const CalibrationModel* model = m_model.valid ? &m_model : nullptr;
+    return (uint64_t)(rung_cost_units(model, m_ladder.rungs[rung], pixels, m_sigma) * m_us_per_unit);
+}
+
+uint32_t QualityGovernor::fitting_rung(uint32_t from, int64_t pixels, uint64_t budget_us, bool can_repeat) const {
+    uint32_t cheapest = m_ladder.count - (can_repeat ? 1 : 2);
+    for (uint32_t r = from; r < cheapest; r++) {
+        if (predict_us(r, pixels) <= budget_us) return r;
+    }
+    return std::max(from, cheapest);
+}
+
+uint32_t QualityGovernor::plan(const GovernorFrame& frame) {
+    uint64_t budget = frame.deadline_us > frame.now_us ? frame.deadline_us - frame.now_us : 0;
+    bool can_repeat = frame.can_repeat && !frame.moving && m_repeats < GOVERNOR_MAX_REPEATS;
+    bool measured = m_us_per_unit > 0.0;
+
+    if (frame.moving) {
+        budget = (uint64_t)((double)budget * GOVERNOR_DRAG_SHARE);
+        if (!m_dragging) {
+            m_dragging = true;
+            m_saved_level = m_level;
+            m_headroom = false;
+            uint32_t r = measured ? fitting_rung(m_level, frame.pixels, budget, false) : m_level;
+            if (r > m_level) {
+                m_level = r;
+                stats_add(BLUR_STAT_QUALITY_DRAG_STEPS, 1);
+            }
+        }
+    } else if (m_dragging) {
+        m_dragging = false;
+        m_headroom = false;
+        if (m_saved_level < m_level) {
+            m_level = m_saved_level;
+            stats_add(BLUR_STAT_QUALITY_STEPS_UP, 1);
+        }
+    }
+
+    if (measured) {
+        if (predict_us(m_level, frame.pixels) > budget) {
+            uint32_t r = fitting_rung(m_level, frame.pixels, budget, can_repeat);
+            if (r > m_level) {
+                m_level = r;
+                stats_add(BLUR_STAT_QUALITY_STEPS_DOWN, 1);
+            }
+            m_headroom = false;
+        } else if (m_level > 0 && predict_us(m_level - 1, frame.pixels) <= (uint64_t)((double)budget * GOVERNOR_HEADROOM)) {
+            if (!m_headroom) {
+                m_headroom = true;
+                m_headroom_since_us = frame.now_us;
+            } else if (frame.now_us - m_headroom_since_us >= GOVERNOR_STEP_UP_US) {
+                m_level--;
+                m_headroom = false;
+                stats_add(BLUR_STAT_QUALITY_STEPS_UP, 1);
+            }
+        } else {
+            m_headroom = false;
+        }
+    }
+
+    /* A repeat that is not possible (or has gone on too long) renders the cheapest rung instead */
+    uint32_t rung = m_level;
+    if (m_ladder.rungs[rung].repeat && !can_repeat) rung = m_ladder.count - 2;
+
+    if (m_ladder.rungs[rung].repeat) {
+        m_repeats++;
+        stats_add(BLUR_STAT_FRAMES_REPEATED, 1);
+    } else {
+        m_repeats = 0;
+        if (rung > 0) stats_add(BLUR_STAT_FRAMES_DEGRADED, 1);
+    }
+    m_budget_us = budget;
+    return rung;
+}
+
+void QualityGovernor::record(uint32_t rung, int64_t pixels, uint64_t cost_us) {
+    if (rung >= m_ladder.count) return;
+    const CalibrationModel* model = m_model.valid ? &m_model : nullptr;
+    double units = rung_cost_units(model, m_ladder.rungs[rung], pixels, m_sigma);
+    if (units > 0.0) {
+        double x = (double)std::max<uint64_t>(cost_us, 1) / units;
+        m_us_per_unit = m_us_per_unit > 0.0 ? m_us_per_unit + GOVERNOR_COST_WEIGHT * (x - m_us_per_unit) : x;
+    }
+    if (cost_us > m_budget_us) stats_add(BLUR_STAT_DEADLINE_MISSES, 1);
+}
@@ -0,0 +1,110 @@
+/*
+ * quality_governor.h - Deadline-aware quality degradation
+ *
+ * Every frame carries a deadline: the window's frame budget, else its
+ * refresh interval, or for an apply the caller's timeout. The governor
+ * predicts each frame's cost from the window's recent measurements and, when
+ * the prediction misses the deadline, steps down a ladder of cheaper
+ * settings: twice the downsample factor, a box blur, four times the factor,
+ * and finally presenting the last frame again. It climbs back one rung at a
+ * time once the rung above has fitted with headroom for GOVERNOR_STEP_UP_US.
+ *
+ * Predictions scale a window's measured cost per work unit by each rung's
+ * units: the calibration model's cost when one is active, the kernel taps
+ * per pixel otherwise. Until a window has been measured without a model, it
+ * renders at the rung it holds.
+ *
+ * Drags step down explicitly. On the first frame of a move the governor
+ * jumps to the first rung that fits GOVERNOR_DRAG_SHARE of the deadline and
+ * keeps that tighter deadline while the window moves; the first still frame
+ * returns to the rung held before the drag.
+ *
+ * Callers pass the time in, so tests run the governor on a fake clock.
+ * Decisions are counted in the BLUR_STAT_QUALITY_* and deadline statistics.
+ */
+
+#ifndef BLUR_LIB_QUALITY_GOVERNOR_H
+#define BLUR_LIB_QUALITY_GOVERNOR_H
+
+#include "calibration.h"
+
+#define GOVERNOR_MAX_RUNGS      5
+
+/* Headroom a rung must leave under the deadline, and for how long, before the governor climbs to it */
+#define GOVERNOR_HEADROOM       0.6
+#define GOVERNOR_STEP_UP_US     500000
+
+/* Share of the deadline a frame of a drag may take */
+#define GOVERNOR_DRAG_SHARE     0.5
+
+/* Last-frame repeats in a row before a frame is rendered however late it is */
+#define GOVERNOR_MAX_REPEATS    4
+
+/* Weight of the newest measurement in the cost average */
+#define GOVERNOR_COST_WEIGHT    0.25
+
+struct QualityRung {
+    uint32_t algorithm;     /* BLUR_ALGORITHM_* other than AUTO */
+    int32_t  downsample;
+    bool     repeat;        /* Present the last frame again instead of rendering */
+};
+
+struct QualityLadder {
+    QualityRung rungs[GOVERNOR_MAX_RUNGS];
+    uint32_t    count;      /* Rung 0 is the requested quality */
+};
+
+/* Rungs from the requested settings down to a repeat, skipping ones that would not be cheaper */
+void build_quality_ladder(uint32_t algorithm, int32_t downsample, QualityLadder* out);
+
+/* Relative cost of rendering pixels at sigma on a rung; ns with a valid model */
+double rung_cost_units(const CalibrationModel* model, const QualityRung& rung, int64_t pixels, float sigma);
+
+struct GovernorFrame {
+    uint64_t now_us;
+    uint64_t deadline_us;   /* Absolute, on the same clock as now_us */
+    int64_t  pixels;        /* Output pixels the frame blurs */
+    bool     moving;        /* The window moved or resized since its last frame */
+    bool     can_repeat;    /* The last frame is still on screen and still valid */
+};
+
+class QualityGovernor {
+public:
+    QualityGovernor();
+
+    /* Requested settings for the next frames; a change rebuilds the ladder and keeps the rung */
+    void configure(uint32_t algorithm, int32_t downsample, float sigma);
+
+    /* Rung for a frame; counts step-downs, step-ups, degraded and repeated frames */
+    uint32_t plan(const GovernorFrame& frame);
+
+    /* Measured cost of the frame just rendered at rung */
+    void record(uint32_t rung, int64_t pixels, uint64_t cost_us);
+
+    const QualityRung& rung(uint32_t i) const { return m_ladder.rungs[i]; }
+    uint32_t level() const { return m_level; }
+    bool dragging() const { return m_dragging; }
+
+    /* Predicted cost of a rung, or 0 before the first measurement */
+    uint64_t predict_us(uint32_t rung, int64_t pixels) const;
+
+private:
+    /* First rung from `from` down whose prediction fits budget_us; the cheapest usable one if none */
+    uint32_t fitting_rung(uint32_t from, int64_t pixels, uint64_t budget_us, bool can_repeat) const;
+
+    QualityLadder m_ladder;
+    uint32_t m_algorithm;
+    int32_t m_downsample;
+    float m_sigma;
+    CalibrationModel m_model;
+    uint32_t m_level;
+    uint32_t m_saved_level;     /* Rung held when the current drag began */
+    bool m_dragging;
+    uint32_t m_repeats;         /* Repeats in a row */
+    bool m_headroom;            /* The rung above has fitted with headroom ... */
+    uint64_t m_headroom_since_us;   /* ... since this time */
+    uint64_t m_budget_us;       /* Time left to the deadline of the last planned frame */
+    double m_us_per_unit;       /* Measured cost average, 0 before the first measurement */
+};
+
+#endif /* BLUR_LIB_QUALITY_GOVERNOR_H */
@@ -0,0 +1,385 @@
+/*
+ * region.cpp - Rectangle-list geometry for region-restricted blur
+ */
+
+#include "region.h"
+#include "effect_graph.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+typedef std::pair<int32_t, int32_t> Span;
+
+enum RegionOp { REGION_OP_UNION, REGION_OP_SUBTRACT, REGION_OP_INTERSECT };
+
+/* Sweep temporaries kept per thread so their capacity survives between frames */
+struct RegionScratch {
+    std::vector<int32_t> ys;
+    std::vector<Span> sa, sb, spans, prev, all;
+    std::vector<RegionRect> grown, clipped, whole, outside;
+};
+
+static RegionScratch& region_scratch() {
+    thread_local RegionScratch scratch;
+    return scratch;
+}
+
+RegionRect rect_intersect(const RegionRect& a, const RegionRect& b) {
+    RegionRect r = {
+        std::max(a.left, b.left), std::max(a.top, b.top),
+        std::min(a.right, b.right), std::min(a.bottom, b.bottom)
+    };
+    if (rect_is_empty(r)) {
+        r.left = r.top = r.right = r.bottom = 0;
+    }
+    return r;
+}
+
+RegionRect rect_inflate(const RegionRect& r, int32_t amount) {
+    RegionRect o = { r.left - amount, r.top - amount, r.right + amount, r.bottom + amount };
+    return o;
+}
+
+/* Sorted, merged x-spans of every rectangle that covers the band [y0, y1) */
+static void band_spans(const RegionRect* rects, size_t count, int32_t y0, int32_t y1,
+                       std::vector<Span>* spans) {
+    spans->clear();
+    for (size_t i = 0; i < count; i++) {
+        const RegionRect& r = rects[i];
+        if (!rect_is_empty(r) && r.top <= y0 && r.bottom >= y1) {
+            spans->push_back(Span(r.left, r.right));
+        }
+    }
+    std::sort(spans->begin(), spans->end());
+
+    size_t n = 0;
+    for (size_t i = 0; i < spans->size(); i++) {
+        if (n > 0 && (*spans)[i].first <= (*spans)[n - 1].second) {
+            (*spans)[n - 1].second = std::max((*spans)[n - 1].second, (*spans)[i].second);
+        } else {
+            (*spans)[n++] = (*spans)[i];
+        }
+    }
+    spans->resize(n);
+}
+
+static void combine_spans(const std::vector<Span>& a, const std::vector<Span>& b,
+                          RegionOp op, std::vector<Span>* out) {
+    out->clear();
+    if (op == REGION_OP_UNION) {
+        std::vector<Span>& all = region_scratch().all;
+        all.assign(a.begin(), a.end());
+        all.insert(all.end(), b.begin(), b.end());
+        std::sort(all.begin(), all.end());
+        for (const Span& s : all) {
+            if (!out->empty() && s.first <= out->back().second) {
+                out->back().second = std::max(out->back().second, s.second);
+            } else {
+                out->push_back(s);
+            }
+        }
+    } else if (op == REGION_OP_INTERSECT) {
+        size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size()) {
+            int32_t l = std::max(a[i].first, b[j].first);
+            int32_t r = std::min(a[i].second, b[j].second);
+            if (l < r) out->push_back(Span(l, r));
+            if (a[i].second < b[j].second) i++; else j++;
+        }
+    } else {
+        size_t j = 0;
+        for (const Span& s : a) {
+            int32_t cur = s.first;
+            while (j < b.size() && b[j].second <= cur) j++;
+            size_t k = j;
+            while (k < b.size() && b[k].first < s.second) {
+                if (b[k].first > cur) out->push_back(Span(cur, b[k].first));
+                cur = std::max(cur, b[k].second);
+                k++;
+            }
+            if (cur < s.second) out->push_back(Span(cur, s.second));
+        }
+    }
+}
+
+/* Band sweep shared by all region operations; output is disjoint and banded */
+static void region_op(const RegionRect* a, size_t na, const RegionRect* b, size_t nb,
+                      RegionOp op, std::vector<RegionRect>* out) {
+    out->clear();
+
+    RegionScratch& rs = region_scratch();
+    std::vector<int32_t>& ys = rs.ys;
+    ys.clear();
+    for (size_t i = 0; i < na; i++) {
+        if (!rect_is_empty(a[i])) { ys.push_back(a[i].top); ys.push_back(a[i].bottom); }
+    }
+    for (size_t i = 0; i < nb; i++) {
+        if (!rect_is_empty(b[i])) { ys.push_back(b[i].top); ys.push_back(b[i].bottom); }
+    }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    std::vector<Span>& sa = rs.sa;
+    std::vector<Span>& sb = rs.sb;
+    std::vector<Span>& spans = rs.spans;
+    std::vector<Span>& prev = rs.prev;
+    prev.clear();
+    size_t prev_start = 0;
+    int32_t prev_bottom = 0;
+
+    for (size_t i = 0; i + 1 < ys.size(); i++) {
+        int32_t y0 = ys[i], y1 = ys[i + 1];
+        band_spans(a, na, y0, y1, &sa);
+        band_spans(b, nb, y0, y1, &sb);
+        combine_spans(sa, sb, op, &spans);
+
+        if (spans.empty()) {
+            prev.clear();
+            continue;
+        }
+
+        /* Coalesce with the band above when it has the same spans */
+        if (!prev.empty() && prev_bottom == y0 && prev == spans) {
+            for (size_t k = 0; k < spans.size(); k++) {
+                (*out)[prev_start + k].bottom = y1;
+            }
+        } else {
+            prev_start = out->size();
+            for (const Span& s : spans) {
+                RegionRect r = { s.first, y0, s.second, y1 };
+                out->push_back(r);
+            }
+        }
+        prev.swap(spans);
+        prev_bottom = y1;
+    }
+}
+
+void region_union(const RegionRect* rects, size_t count, std::vector<RegionRect>* out) {
+    region_op(rects, count, nullptr, 0, REGION_OP_UNION, out);
+}
+
+void region_subtract(const std::vector<RegionRect>& a, const std::vector<RegionRect>& b,
+                     std::vector<RegionRect>* out) {
+    region_op(a.data(), a.size(), b.data(), b.size(), REGION_OP_SUBTRACT, out);
+}
+
+void region_intersect(const std::vector<RegionRect>& a, const std::vector<RegionRect>& b,
+                      std::vector<RegionRect>* out) {
+    region_op(a.data(), a.size(), b.data(), b.size(), REGION_OP_INTERSECT, out);
+}
+
+int64_t region_area(const std::vector<RegionRect>& region) {
+    int64_t area = 0;
+    for (const RegionRect& r : region) area += rect_area(r);
+    return area;
+}
+
+RegionRect region_bounds(const std::vector<RegionRect>& region) {
+    RegionRect b = { 0, 0, 0, 0 };
+    bool first = true;
+    for (const RegionRect& r : region) {
+        if (rect_is_empty(r)) continue;
+        if (first) {
+            b = r;
+            first = false;
+        } else {
+            b.left = std::min(b.left, r.left);
+            b.top = std::min(b.top, r.top);
+            b.right = std::max(b.right, r.right);
+            b.bottom = std::max(b.bottom, r.bottom);
+        }
+    }
+    return b;
+}
+
+void region_inflate(const std::vector<RegionRect>& region, int32_t halo,
+                    const RegionRect& clip, std::vector<RegionRect>* out) {
+    std::vector<RegionRect>& grown = region_scratch().grown;
+    grown.clear();
+    for (const RegionRect& r : region) {
+        RegionRect g = rect_intersect(rect_inflate(r, halo), clip);
+        if (!rect_is_empty(g)) grown.push_back(g);
+    }
+    region_union(grown.data(), grown.size(), out);
+}
+
+/* ============================================================================
+ * Region blur plans
+ * ============================================================================ */
+const BlurRegionList_V1* effect_params_regions(const EffectParams* params) {
+    if (!params || !(params->reserved_flags & BLUR_PARAMS_FLAG_REGIONS)) {
+        return nullptr;
+    }
+    size_t size = params->struct_version == 2 ? sizeof(EffectParams_V2) : sizeof(EffectParams_V1);
+    return (const BlurRegionList_V1*)((const uint8_t*)params + size);
+}
+
+int32_t validate_region_list(const BlurRegionList_V1* list) {
+    if (!list) return BLUR_SUCCESS;
+    if (list->struct_version != 1 || list->rect_count > BLUR_MAX_REGIONS) {
+        return BLUR_INVALID_PARAMS;
+    }
+    for (uint32_t i = 0; i < list->rect_count; i++) {
+        const BlurRect& r = list->rects[i];
+        if (r.right < r.left || r.bottom < r.top) return BLUR_INVALID_PARAMS;
+    }
+    return BLUR_SUCCESS;
+}
+
+int32_t plan_region_blur(const BlurRegionList_V1* list, int32_t width, int32_t height,
+                         int32_t radius, RegionBlurPlan* plan) {
+    if (!plan || width < 0 || height < 0) return BLUR_INVALID_PARAMS;
+    int32_t rc = validate_region_list(list);
+    if (rc != BLUR_SUCCESS) return rc;
+
+    plan->output.clear();
+    plan->capture.clear();
+    plan->rects.clear();
+
+    const RegionRect full = { 0, 0, width, height };
+    if (!list || list->rect_count == 0) {
+        if (!rect_is_empty(full)) plan->output.push_back(full);
+    } else {
+        RegionRect clipped[BLUR_MAX_REGIONS];
+        size_t n = 0;
+        for (uint32_t i = 0; i < list->rect_count; i++) {
+            const BlurRect& br = list->rects[i];
+            RegionRect r = { br.left, br.top, br.right, br.bottom };
+            r = rect_intersect(r, full);
+            if (rect_is_empty(r)) continue;
+            clipped[n++] = r;
+            BlurRect c = { r.left, r.top, r.right, r.bottom, br.corner_radius };
+            plan->rects.push_back(c);
+        }
+        region_union(clipped, n, &plan->output);
+    }
+
+    region_inflate(plan->output, radius, full, &plan->capture);
+    return BLUR_SUCCESS;
+}
+
+void clip_region_plan(RegionBlurPlan* plan, const std::vector<RegionRect>& visible,
+                      int32_t width, int32_t height, int32_t radius) {
+    std::vector<RegionRect>& clipped = region_scratch().clipped;
+    region_intersect(plan->output, visible, &clipped);
+    plan->output.swap(clipped);
+
+    const RegionRect full = { 0, 0, width, height };
+    region_inflate(plan->output, radius, full, &plan->capture);
+}
+
+BlurSurface surface_view(const BlurSurface* s, const RegionRect& r) {
+    BlurSurface v = { s->pixels + (size_t)r.top * s->stride + (size_t)r.left * 4,
+                      r.right - r.left, r.bottom - r.top, s->stride };
+    return v;
+}
+
+void clear_rect(BlurSurface* s, const RegionRect& r) {
+    for (int32_t y = r.top; y < r.bottom; y++) {
+        memset(s->pixels + (size_t)y * s->stride + (size_t)r.left * 4, 0, (size_t)(r.right - r.left) * 4);
+    }
+}
+
+static bool point_in_any(const std::vector<BlurRect>& rects, size_t skip, int32_t x, int32_t y) {
+    for (size_t i = 0; i < rects.size(); i++) {
+        const BlurRect& r = rects[i];
+        if (i != skip && x >= r.left && x < r.right && y >= r.top && y < r.bottom) return true;
+    }
+    return false;
+}
+
+/* Fades the pixels outside each rounded corner to transparent */
+static void mask_corners(BlurSurface* s, const RegionBlurPlan* plan) {
+    for (size_t i = 0; i < plan->rects.size(); i++) {
+        const BlurRect& c = plan->rects[i];
+        int32_t rad = (int32_t)c.corner_radius;
+        rad = std::min(rad, std::min(c.right - c.left, c.bottom - c.top) / 2);
+        if (rad <= 0) continue;
+
+        for (int32_t dy = 0; dy < rad; dy++) {
+            for (int32_t dx = 0; dx < rad; dx++) {
+                /* Distance from the circle centre to the pixel centre */
+                float fx = (float)(rad - dx) - 0.5f, fy = (float)(rad - dy) - 0.5f;
+                float cover = (float)rad - std::sqrt(fx * fx + fy * fy) + 0.5f;
+                if (cover >= 1.0f) continue;
+                int32_t scale = cover <= 0.0f ? 0 : (int32_t)(cover * 256.0f);
+
+                const int32_t xs[2] = { c.left + dx, c.right - 1 - dx };
+                const int32_t ys[2] = { c.top + dy, c.bottom - 1 - dy };
+                for (int32_t yi = 0; yi < 2; yi++) {
+                    for (int32_t xi = 0; xi < 2; xi++) {
+                        int32_t x = xs[xi], y = ys[yi];
+                        if (point_in_any(plan->rects, i, x, y)) continue;
+                        uint8_t* p = s->pixels + (size_t)y * s->stride + (size_t)x * 4;
+                        for (int32_t ch = 0; ch < 4; ch++) p[ch] = (uint8_t)((p[ch] * scale) >> 8);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int32_t cpu_blur_regions(BlurSurface* surface, const BlurKernel* kernel, CpuBlurMode mode,
+                         const RegionBlurPlan* plan, uint32_t color_argb, const EffectProgram* effects) {
+    if (!surface || !surface->pixels || !kernel || !plan) return BLUR_INVALID_PARAMS;
+
+    /*
+     * Halos of neighbouring rects can overlap other outputs, so every rect is
+     * blurred into its own scratch buffer before any of them is written back.
+     */
+    ScratchArena& arena = scratch_arena();
+    ArenaScope scope(arena);
+    const size_t count = plan->output.size();
+    uint8_t** scratch = arena.alloc_array<uint8_t*>(count);
+    if (!scratch && count) return BLUR_OUT_OF_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        const RegionRect& r = plan->output[i];
+        scratch[i] = arena.alloc_array<uint8_t>((size_t)rect_area(r) * 4);
+        if (!scratch[i]) return BLUR_OUT_OF_MEMORY;
+        BlurSurface dst = { scratch[i], r.right - r.left, r.bottom - r.top, (r.right - r.left) * 4 };
+        BlurRowHook hook = effect_row_hook(effects, r.left, r.top, surface->width, surface->height);
+        int32_t rc = cpu_blur_rect(surface, &dst, kernel, mode, r.left, r.top, effects ? &hook : nullptr);
+        if (rc != BLUR_SUCCESS) return rc;
+    }
+
+    /* The halo was only needed as blur input; leave it transparent (outputs are rewritten below) */
+    for (const RegionRect& r : plan->capture) clear_rect(surface, r);
+
+    for (size_t i = 0; i < count; i++) {
+        BlurSurface view = surface_view(surface, plan->output[i]);
+        size_t row = (size_t)view.width * 4;
+        for (int32_t y = 0; y < view.height; y++) {
+            memcpy(view.pixels + (size_t)y * view.stride, scratch[i] + (size_t)y * row, row);
+        }
+    }
+
+    if (effects) {
+        mask_corners(surface, plan);
+    } else {
+        finish_region_blur(surface, plan, color_argb);
+    }
+    return BLUR_SUCCESS;
+}
+
+void finish_region_blur(BlurSurface* surface, const RegionBlurPlan* plan, uint32_t color_argb,
+                        const EffectProgram* effects) {
+    for (const RegionRect& r : plan->output) {
+        if (effects) {
+            apply_effect_program(effects, surface, r, true);
+            continue;
+        }
+        BlurSurface view = surface_view(surface, r);
+        cpu_fill_tint(&view, color_argb);
+    }
+    mask_corners(surface, plan);
+}
+
+void mask_region_output(BlurSurface* surface, const RegionBlurPlan* plan) {
+    RegionScratch& rs = region_scratch();
+    rs.whole.assign(1, RegionRect{ 0, 0, surface->width, surface->height });
+    region_subtract(rs.whole, plan->output, &rs.outside);
+    for (const RegionRect& r : rs.outside) clear_rect(surface, r);
+    mask_corners(surface, plan);
+}
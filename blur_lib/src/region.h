@@ -0,0 +1,98 @@
+/*
+ * region.h - Rectangle-list geometry for region-restricted blur
+ *
+ * Regions are kept as disjoint, y-x banded rectangle lists (the same shape
+ * GDI uses for HRGN data) so area and iteration are trivial.
+ */
+
+#ifndef BLUR_LIB_REGION_H
+#define BLUR_LIB_REGION_H
+
+#include "cpu_blur.h"
+#include <vector>
+
+/* Half-open rectangle: [left, right) x [top, bottom) */
+struct RegionRect {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+inline bool rect_is_empty(const RegionRect& r) {
+    return r.right <= r.left || r.bottom <= r.top;
+}
+
+inline int64_t rect_area(const RegionRect& r) {
+    return rect_is_empty(r) ? 0 : (int64_t)(r.right - r.left) * (r.bottom - r.top);
+}
+
+RegionRect rect_intersect(const RegionRect& a, const RegionRect& b);
+RegionRect rect_inflate(const RegionRect& r, int32_t amount);
+
+/* Normalizes any rectangle list into disjoint banded rectangles */
+void region_union(const RegionRect* rects, size_t count, std::vector<RegionRect>* out);
+
+void region_subtract(const std::vector<RegionRect>& a, const std::vector<RegionRect>& b,
+                     std::vector<RegionRect>* out);
+
+void region_intersect(const std::vector<RegionRect>& a, const std::vector<RegionRect>& b,
+                      std::vector<RegionRect>* out);
+
+int64_t region_area(const std::vector<RegionRect>& region);
+RegionRect region_bounds(const std::vector<RegionRect>& region);
+
+/* Inflates every rectangle by halo, clips to clip and re-normalizes */
+void region_inflate(const std::vector<RegionRect>& region, int32_t halo,
+                    const RegionRect& clip, std::vector<RegionRect>* out);
+
+/* ============================================================================
+ * Region blur plans
+ * ============================================================================ */
+struct RegionBlurPlan {
+    std::vector<RegionRect> output;     /* Pixels that end up blurred */
+    std::vector<RegionRect> capture;    /* output plus the kernel halo */
+    std::vector<BlurRect>   rects;      /* Requested rects, clipped, with corner radii */
+};
+
+/* Trailing region list of params, or NULL if BLUR_PARAMS_FLAG_REGIONS is clear */
+const BlurRegionList_V1* effect_params_regions(const EffectParams* params);
+
+int32_t validate_region_list(const BlurRegionList_V1* list);
+
+/* A NULL or empty list plans the whole width x height surface */
+int32_t plan_region_blur(const BlurRegionList_V1* list, int32_t width, int32_t height,
+                         int32_t radius, RegionBlurPlan* plan);
+
+/* Shrinks a plan to the visible part of the window and recomputes its capture */
+void clip_region_plan(RegionBlurPlan* plan, const std::vector<RegionRect>& visible,
+                      int32_t width, int32_t height, int32_t radius);
+
+/* Sub-surface of s covering r (r must lie inside s) */
+BlurSurface surface_view(const BlurSurface* s, const RegionRect& r);
+
+/* Sets r (inside s) to transparent black */
+void clear_rect(BlurSurface* s, const RegionRect& r);
+
+struct EffectProgram;
+
+/*
+ * Blurs and tints plan->output in place and clears the rest of plan->capture;
+ * all other pixels are left untouched. An effect program replaces the tint
+ * and runs inside the blur's last pass.
+ */
+int32_t cpu_blur_regions(BlurSurface* surface, const BlurKernel* kernel, CpuBlurMode mode,
+                         const RegionBlurPlan* plan, uint32_t color_argb,
+                         const EffectProgram* effects = nullptr);
+
+/* Tints (or runs effects on) the blurred output and applies rounded corners */
+void finish_region_blur(BlurSurface* surface, const RegionBlurPlan* plan, uint32_t color_argb,
+                        const EffectProgram* effects = nullptr);
+
+/*
+ * For a blur that already covered the whole surface (the GPU path): clears
+ * every pixel outside plan->output and applies the rounded corners.
+ */
+void mask_region_output(BlurSurface* surface, const RegionBlurPlan* plan);
+
+#endif /* BLUR_LIB_REGION_H */
@@ -0,0 +1,179 @@
+/*
+ * scratch_arena.cpp - Per-thread bump arena for render-path scratch memory
+ */
+
+#include "scratch_arena.h"
+#include "stats.h"
+#include <atomic>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+static std::atomic<bool> g_huge_pages(false);
+
+static inline size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) / a * a;
+}
+
+ScratchArena::ScratchArena(size_t block_bytes, bool huge_pages)
+    : m_count(0), m_block(0), m_offset(0), m_base(0),
+      m_block_bytes(align_up(block_bytes ? block_bytes : ARENA_DEFAULT_BLOCK, ARENA_ALIGNMENT)),
+      m_frame_peak(0), m_high_water(0), m_block_allocs(0), m_published_allocs(0),
+      m_huge_pages(huge_pages) {
+}
+
+ScratchArena::~ScratchArena() {
+    release();
+}
+
+bool ScratchArena::alloc_block(size_t bytes, Block* b) {
+    void* p = nullptr;
+    b->huge = false;
+#ifdef __linux__
+    if (m_huge_pages && bytes >= ARENA_HUGE_PAGE_BYTES) {
+        bytes = align_up(bytes, ARENA_HUGE_PAGE_BYTES);
+        if (posix_memalign(&p, ARENA_HUGE_PAGE_BYTES, bytes) != 0) return false;
+        /* Only a hint: transparent huge pages may be disabled */
+        madvise(p, bytes, MADV_HUGEPAGE);
+        b->huge = true;
+    }
+#endif
+    if (!p) {
+#ifdef _WIN32
+        p = _aligned_malloc(bytes, ARENA_ALIGNMENT);
+#else
+        if (posix_memalign(&p, ARENA_ALIGNMENT, bytes) != 0) p = nullptr;
+#endif
+        if (!p) return false;
+    }
+    b->data = (uint8_t*)p;
+    b->size = bytes;
+    m_block_allocs++;
+    return true;
+}
+
+void ScratchArena::free_block(Block* b) {
+#ifdef _WIN32
+    _aligned_free(b->data);
+#else
+    free(b->data);
+#endif
+    b->data = nullptr;
+    b->size = 0;
+}
+
+/* Moves to the first following block that holds bytes, replacing or adding one if needed */
+bool ScratchArena::grow(size_t bytes) {
+    uint32_t next = m_count ? m_block + 1 : 0;
+    size_t base = m_count ? m_base + m_blocks[m_block].size : 0;
+
+    if (next < m_count && m_blocks[next].size < bytes) {
+        /* Too small for this request; later blocks keep their order */
+        Block b;
+        size_t want = bytes > m_blocks[next].size * 2 ? bytes : m_blocks[next].size * 2;
+        if (!alloc_block(want, &b)) return false;
+        free_block(&m_blocks[next]);
+        m_blocks[next] = b;
+    } else if (next == m_count) {
+        if (m_count == ARENA_MAX_BLOCKS) return false;
+        size_t want = m_count ? m_blocks[m_count - 1].size * 2 : m_block_bytes;
+        if (want < bytes) want = bytes;
+        if (!alloc_block(want, &m_blocks[m_count])) return false;
+        m_count++;
+    }
+
+    m_block = next;
+    m_base = base;
+    m_offset = 0;
+    return true;
+}
+
+void ScratchArena::note_used() {
+    size_t u = m_base + m_offset;
+    if (u > m_frame_peak) m_frame_peak = u;
+    if (u > m_high_water) m_high_water = u;
+}
+
+void* ScratchArena::alloc(size_t bytes) {
+    size_t size = align_up(bytes ? bytes : 1, ARENA_ALIGNMENT);
+    if (size < bytes) return nullptr;
+
+    if (!m_count || m_offset + size > m_blocks[m_block].size) {
+        if (!grow(size)) return nullptr;
+    }
+    void* p = m_blocks[m_block].data + m_offset;
+    m_offset += size;
+    note_used();
+    return p;
+}
+
+ScratchArena::Marker ScratchArena::mark() const {
+    Marker m = { m_block, m_offset };
+    return m;
+}
+
+void ScratchArena::rewind(const Marker& m) {
+    m_base = 0;
+    for (uint32_t i = 0; i < m.block && i < m_count; i++) m_base += m_blocks[i].size;
+    m_block = m.block;
+    m_offset = m.offset;
+}
+
+void ScratchArena::end_frame() {
+    m_block = 0;
+    m_offset = 0;
+    m_base = 0;
+
+    /* One block that holds the whole frame keeps the next frame off the heap */
+    if (m_count > 1) {
+        size_t want = align_up(m_frame_peak, ARENA_ALIGNMENT);
+        if (want < m_block_bytes) want = m_block_bytes;
+        release();
+        if (alloc_block(want, &m_blocks[0])) m_count = 1;
+    }
+
+    stats_max(BLUR_STAT_ARENA_HIGH_WATER, m_high_water);
+    stats_add(BLUR_STAT_ARENA_BLOCK_ALLOCS, m_block_allocs - m_published_allocs);
+    m_published_allocs = m_block_allocs;
+    m_frame_peak = 0;
+}
+
+void ScratchArena::release() {
+    for (uint32_t i = 0; i < m_count; i++) free_block(&m_blocks[i]);
+    m_count = 0;
+    m_block = 0;
+    m_offset = 0;
+    m_base = 0;
+}
+
+size_t ScratchArena::used() const {
+    return m_base + m_offset;
+}
+
+size_t ScratchArena::capacity() const {
+    size_t total = 0;
+    for (uint32_t i = 0; i < m_count; i++) total += m_blocks[i].size;
+    return total;
+}
+
+size_t ScratchArena::high_water() const {
+    return m_high_water;
+}
+
+uint64_t ScratchArena::block_allocs() const {
+    return m_block_allocs;
+}
+
+ScratchArena& scratch_arena(void) {
+    thread_local ScratchArena arena(ARENA_DEFAULT_BLOCK, g_huge_pages.load(std::memory_order_relaxed));
+    return arena;
+}
+
+void set_scratch_huge_pages(bool enable) {
+    g_huge_pages.store(enable, std::memory_order_relaxed);
+}
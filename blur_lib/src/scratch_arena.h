@@ -0,0 +1,113 @@
+/*
+ * scratch_arena.h - Per-thread bump arena for render-path scratch memory
+ *
+ * The blur and capture stages take their temporary buffers from the calling
+ * thread's arena instead of the heap. Allocations are 64-byte aligned and
+ * handed back in LIFO order through ArenaScope. end_frame() resets the arena
+ * and folds any overflow blocks into one block sized for the frame, so once
+ * the working set is known a frame makes no heap allocations.
+ */
+
+#ifndef BLUR_LIB_SCRATCH_ARENA_H
+#define BLUR_LIB_SCRATCH_ARENA_H
+
+#include "blur_lib.h"
+#include <stddef.h>
+
+/* Every allocation starts on a cache line (and a full AVX-512 vector) */
+#define ARENA_ALIGNMENT       64
+/* First block of a new arena */
+#define ARENA_DEFAULT_BLOCK   (256 * 1024)
+/* Overflow blocks at least double, so this is never reached in practice */
+#define ARENA_MAX_BLOCKS      32
+/* Blocks at least this big are huge-page backed when huge pages are enabled */
+#define ARENA_HUGE_PAGE_BYTES (2 * 1024 * 1024)
+
+class ScratchArena {
+public:
+    /* Position to rewind to; see ArenaScope */
+    struct Marker {
+        uint32_t block;
+        size_t   offset;
+    };
+
+    ScratchArena(size_t block_bytes, bool huge_pages);
+    ~ScratchArena();
+
+    /* bytes of ARENA_ALIGNMENT-aligned memory, or NULL when out of memory */
+    void* alloc(size_t bytes);
+
+    /* Uninitialized array of count T, or NULL when out of memory */
+    template <typename T>
+    T* alloc_array(size_t count) {
+        if (count > (size_t)-1 / sizeof(T)) return nullptr;
+        return (T*)alloc(count * sizeof(T));
+    }
+
+    Marker mark() const;
+    void rewind(const Marker& m);
+
+    /*
+     * Frame boundary: drops everything still allocated, merges overflow
+     * blocks into one that holds this frame's peak and publishes the
+     * high-water mark to BLUR_STAT_ARENA_HIGH_WATER.
+     */
+    void end_frame();
+
+    /* Frees every block (the next allocation starts over) */
+    void release();
+
+    size_t   used() const;          /* Bytes allocated, counting skipped block tails */
+    size_t   capacity() const;      /* Bytes in all blocks */
+    size_t   high_water() const;    /* Largest used() ever seen */
+    uint64_t block_allocs() const;  /* Heap allocations made for blocks */
+
+private:
+    struct Block {
+        uint8_t* data;
+        size_t   size;
+        bool     huge;
+    };
+
+    bool grow(size_t bytes);
+    bool alloc_block(size_t bytes, Block* b);
+    void free_block(Block* b);
+    void note_used();
+
+    Block    m_blocks[ARENA_MAX_BLOCKS];
+    uint32_t m_count;           /* Blocks held */
+    uint32_t m_block;           /* Block being bumped */
+    size_t   m_offset;          /* Bump offset in m_block */
+    size_t   m_base;            /* Bytes in the blocks before m_block */
+    size_t   m_block_bytes;
+    size_t   m_frame_peak;
+    size_t   m_high_water;
+    uint64_t m_block_allocs;
+    uint64_t m_published_allocs;
+    bool     m_huge_pages;
+
+    ScratchArena(const ScratchArena&);
+    ScratchArena& operator=(const ScratchArena&);
+};
+
+/* Returns everything allocated from arena during its lifetime */
+class ArenaScope {
+public:
+    explicit ArenaScope(ScratchArena& arena) : m_arena(arena), m_mark(arena.mark()) {}
+    ~ArenaScope() { m_arena.rewind(m_mark); }
+
+private:
+    ScratchArena& m_arena;
+    ScratchArena::Marker m_mark;
+
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+};
+
+/* The calling thread's arena, created on first use */
+ScratchArena& scratch_arena(void);
+
+/* Huge-page backing for arenas created after the call (Linux only; a hint elsewhere) */
+void set_scratch_huge_pages(bool enable);
+
+#endif /* BLUR_LIB_SCRATCH_ARENA_H */
@@ -0,0 +1,38 @@
+/*
+ * stats.cpp - Lock-free statistics counters
+ */
+
+#include "stats.h"
+#include <atomic>
+
+static std::atomic<uint64_t> g_stats[BLUR_STAT_COUNT];
+
+void stats_add(uint32_t stat_id, uint64_t amount) {
+    if (stat_id < BLUR_STAT_COUNT) {
+        g_stats[stat_id].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+void stats_max(uint32_t stat_id, uint64_t value) {
+    if (stat_id >= BLUR_STAT_COUNT) return;
+    uint64_t cur = g_stats[stat_id].load(std::memory_order_relaxed);
+    while (cur < value &&
+           !g_stats[stat_id].compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+}
+
+void stats_set(uint32_t stat_id, uint64_t value) {
+    if (stat_id < BLUR_STAT_COUNT) {
+        g_stats[stat_id].store(value, std::memory_order_relaxed);
+    }
+}
+
+uint64_t stats_get(uint32_t stat_id) {
+    return stat_id < BLUR_STAT_COUNT ? g_stats[stat_id].load(std::memory_order_relaxed) : 0;
+}
+
+void stats_reset(void) {
+    for (uint32_t i = 0; i < BLUR_STAT_COUNT; i++) {
+        g_stats[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,16 @@
+/*
+ * stats.h - Lock-free statistics counters
+ */
+
+#ifndef BLUR_LIB_STATS_H
+#define BLUR_LIB_STATS_H
+
+#include "blur_lib.h"
+
+void stats_add(uint32_t stat_id, uint64_t amount);
+void stats_max(uint32_t stat_id, uint64_t value);
+void stats_set(uint32_t stat_id, uint64_t value);   /* Gauges such as BLUR_STAT_MEMORY_BYTES */
+uint64_t stats_get(uint32_t stat_id);
+void stats_reset(void);
+
+#endif /* BLUR_LIB_STATS_H */
@@ -0,0 +1,528 @@
+/*
+ * tick_recorder.cpp - Recording and replay of refresh ticks
+ */
+
+#include "tick_recorder.h"
+#include <cmath>
+#include <cstring>
+
+static const char TICK_RECORD_MAGIC[8] = { 'B', 'L', 'U', 'R', 'R', 'E', 'C', 0 };
+
+/* Zero runs shorter than this stay in the literal around them */
+#define TICK_RLE_MIN_RUN 8
+
+/* Largest window or frame side a replay accepts */
+#define TICK_MAX_SIDE 32768
+
+/* ============================================================================
+ * Encoding
+ * ============================================================================ */
+template <typename T>
+static void put(std::vector<uint8_t>* out, T value) {
+    size_t at = out->size();
+    out->resize(at + sizeof(T));
+    memcpy(&(*out)[at], &value, sizeof(T));
+}
+
+static void put_rect(std::vector<uint8_t>* out, const RegionRect& r) {
+    put<int32_t>(out, r.left);
+    put<int32_t>(out, r.top);
+    put<int32_t>(out, r.right);
+    put<int32_t>(out, r.bottom);
+}
+
+static void put_rects(std::vector<uint8_t>* out, const std::vector<RegionRect>& rects) {
+    put<uint32_t>(out, (uint32_t)rects.size());
+    for (const RegionRect& r : rects) put_rect(out, r);
+}
+
+static void put_varint(std::vector<uint8_t>* out, uint64_t v) {
+    while (v >= 0x80) {
+        out->push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out->push_back((uint8_t)v);
+}
+
+static size_t zero_run(const uint8_t* p, size_t n) {
+    size_t i = 0;
+    while (i < n && !p[i]) i++;
+    return i;
+}
+
+/* Packets of varint (length << 1 | zero): zero runs, or literals followed by their bytes */
+static void rle_encode(const uint8_t* src, size_t n, std::vector<uint8_t>* out) {
+    size_t i = 0;
+    while (i < n) {
+        size_t z = zero_run(src + i, n - i);
+        if (z >= TICK_RLE_MIN_RUN || z == n - i) {
+            put_varint(out, (uint64_t)z << 1 | 1);
+            i += z;
+            continue;
+        }
+        size_t j = i + z;
+        while (j < n) {
+            if (src[j]) {
+                j++;
+                continue;
+            }
+            size_t k = zero_run(src + j, n - j);
+            if (k >= TICK_RLE_MIN_RUN || j + k == n) break;
+            j += k;
+        }
+        put_varint(out, (uint64_t)(j - i) << 1);
+        out->insert(out->end(), src + i, src + j);
+        i = j;
+    }
+}
+
+static FrameReference* find_reference(std::vector<FrameReference>* refs, const RegionRect& bounds) {
+    for (FrameReference& r : *refs) {
+        if (r.bounds.left == bounds.left && r.bounds.top == bounds.top &&
+            r.bounds.right == bounds.right && r.bounds.bottom == bounds.bottom) return &r;
+    }
+    return nullptr;
+}
+
+static FrameReference* add_reference(std::vector<FrameReference>* refs, const RegionRect& bounds) {
+    if (refs->size() >= TICK_MAX_REFERENCES) refs->clear();
+    refs->push_back(FrameReference());
+    refs->back().bounds = bounds;
+    return &refs->back();
+}
+
+/* ============================================================================
+ * TickRecorder
+ * ============================================================================ */
+TickRecorder::TickRecorder() : m_sink(nullptr), m_flags(0), m_started(false), m_start_us(0), m_stats() {}
+
+int32_t TickRecorder::open(RecordSink* sink, uint32_t flags) {
+    if (!sink || (flags & ~BLUR_RECORD_DELTA)) return BLUR_INVALID_PARAMS;
+    m_sink = sink;
+    m_flags = flags;
+    m_started = false;
+    m_kernels.clear();
+    m_refs.clear();
+    m_stats = TickRecorderStats();
+
+    std::vector<uint8_t> header(TICK_RECORD_MAGIC, TICK_RECORD_MAGIC + sizeof(TICK_RECORD_MAGIC));
+    put<uint32_t>(&header, TICK_RECORD_VERSION);
+    put<uint32_t>(&header, flags);
+    if (!m_sink->write(header.data(), header.size())) {
+        m_sink = nullptr;
+        return BLUR_INVALID_PARAMS;
+    }
+    m_stats.bytes_written = header.size();
+    return BLUR_SUCCESS;
+}
+
+void TickRecorder::write_chunk(uint32_t type, const std::vector<uint8_t>& payload) {
+    if (!m_sink) return;
+    uint32_t head[2] = { type, (uint32_t)payload.size() };
+    if (!m_sink->write(head, sizeof(head)) || !m_sink->write(payload.data(), payload.size())) {
+        m_sink = nullptr;
+        return;
+    }
+    m_stats.bytes_written += sizeof(head) + payload.size();
+}
+
+void TickRecorder::record_tick(uint64_t now_us, const TickWindow* windows, size_t count) {
+    if (!m_sink) return;
+    if (!m_started) {
+        m_started = true;
+        m_start_us = now_us;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const BlurKernel* k = windows[i].kernel;
+        if (!k) continue;
+        RecordedKernel rk = { k->sigma, k->algorithm, k->scale >> k->levels, k->transfer };
+        auto it = m_kernels.find(windows[i].handle);
+        if (it != m_kernels.end() && !memcmp(&it->second, &rk, sizeof(rk))) continue;
+        m_kernels[windows[i].handle] = rk;
+
+        m_chunk.clear();
+        put<uint64_t>(&m_chunk, windows[i].handle);
+        put<float>(&m_chunk, rk.sigma);
+        put<uint32_t>(&m_chunk, rk.algorithm);
+        put<int32_t>(&m_chunk, rk.downsample);
+        put<uint32_t>(&m_chunk, rk.transfer);
+        write_chunk(TICK_CHUNK_PARAMS, m_chunk);
+        m_stats.params++;
+    }
+
+    m_chunk.clear();
+    put<uint64_t>(&m_chunk, now_us - m_start_us);
+    put<uint32_t>(&m_chunk, (uint32_t)count);
+    for (size_t i = 0; i < count; i++) {
+        const TickWindow& tw = windows[i];
+        put<uint64_t>(&m_chunk, tw.handle);
+        put_rect(&m_chunk, tw.screen);
+        put<uint32_t>(&m_chunk, (tw.kernel ? TICK_FLAG_KERNEL : 0u) | (tw.backdrop ? TICK_FLAG_BACKDROP : 0u) |
+                                (tw.backdrop && tw.backdrop->store_reduction == 2 ? TICK_FLAG_HALF_BACKDROP : 0u) |
+                                (tw.effects ? TICK_FLAG_EFFECTS : 0u));
+        put<uint32_t>(&m_chunk, tw.color_argb);
+        put<uint32_t>(&m_chunk, (uint32_t)tw.mode);
+        put<uint32_t>(&m_chunk, tw.lane);
+        put<uint32_t>(&m_chunk, tw.max_tasks);
+        put_rects(&m_chunk, tw.plan.output);
+        put_rects(&m_chunk, tw.plan.capture);
+        put<uint32_t>(&m_chunk, (uint32_t)tw.plan.rects.size());
+        for (const BlurRect& r : tw.plan.rects) {
+            put<int32_t>(&m_chunk, r.left);
+            put<int32_t>(&m_chunk, r.top);
+            put<int32_t>(&m_chunk, r.right);
+            put<int32_t>(&m_chunk, r.bottom);
+            put<uint32_t>(&m_chunk, r.corner_radius);
+        }
+        if (tw.effects) {
+            put<uint32_t>(&m_chunk, tw.effects->count);
+            for (uint32_t e = 0; e < tw.effects->count; e++) {
+                const BlurEffect& src = tw.effects->nodes[e].source;
+                put<uint32_t>(&m_chunk, src.type);
+                put<uint32_t>(&m_chunk, src.color_argb);
+                put<float>(&m_chunk, src.amount);
+            }
+        }
+    }
+    write_chunk(TICK_CHUNK_TICK, m_chunk);
+    m_stats.ticks++;
+}
+
+void TickRecorder::record_frame(const RegionRect& bounds, const BlurSurface* frame) {
+    if (!m_sink) return;
+    const size_t row = (size_t)frame->width * 4;
+    const size_t bytes = row * frame->height;
+
+    m_chunk.clear();
+    put_rect(&m_chunk, bounds);
+    if (!(m_flags & BLUR_RECORD_DELTA)) {
+        put<uint32_t>(&m_chunk, TICK_FRAME_RAW);
+        m_chunk.reserve(m_chunk.size() + bytes);
+        for (int32_t y = 0; y < frame->height; y++) {
+            const uint8_t* s = frame->pixels + (size_t)y * frame->stride;
+            m_chunk.insert(m_chunk.end(), s, s + row);
+        }
+    } else {
+        FrameReference* ref = find_reference(&m_refs, bounds);
+        uint32_t codec = ref ? TICK_FRAME_DELTA_RLE : TICK_FRAME_RLE;
+        if (!ref) {
+            ref = add_reference(&m_refs, bounds);
+            ref->pixels.assign(bytes, 0);
+        }
+
+        /* XOR against the reference (zeros for a new one), which becomes this frame */
+        m_delta.resize(bytes);
+        for (int32_t y = 0; y < frame->height; y++) {
+            const uint8_t* s = frame->pixels + (size_t)y * frame->stride;
+            uint8_t* r = &ref->pixels[y * row];
+            uint8_t* d = &m_delta[y * row];
+            for (size_t x = 0; x < row; x++) {
+                d[x] = s[x] ^ r[x];
+                r[x] = s[x];
+            }
+        }
+        put<uint32_t>(&m_chunk, codec);
+        rle_encode(m_delta.data(), bytes, &m_chunk);
+    }
+    write_chunk(TICK_CHUNK_FRAME, m_chunk);
+    m_stats.frames++;
+    m_stats.frame_bytes += bytes;
+}
+
+int32_t RecordingSource::begin_frame(const RegionRect& bounds, BlurSurface* frame) {
+    int32_t rc = m_inner->begin_frame(bounds, frame);
+    m_bounds = bounds;
+    m_frame = rc == BLUR_SUCCESS ? *frame : BlurSurface();
+    return rc;
+}
+
+void RecordingSource::end_frame() {
+    if (m_frame.pixels) m_recorder->record_frame(m_bounds, &m_frame);
+    m_frame = BlurSurface();
+    m_inner->end_frame();
+}
+
+/* ============================================================================
+ * Decoding
+ * ============================================================================ */
+struct ChunkReader {
+    const uint8_t* p;
+    size_t left;
+    bool ok;
+
+    template <typename T>
+    T get() {
+        T v = T();
+        if (left < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        left -= sizeof(T);
+        return v;
+    }
+
+    RegionRect rect() {
+        RegionRect r;
+        r.left = get<int32_t>();
+        r.top = get<int32_t>();
+        r.right = get<int32_t>();
+        r.bottom = get<int32_t>();
+        return r;
+    }
+
+    /* Counts are checked against the bytes left so corrupt files cannot allocate much */
+    uint32_t count(size_t item_bytes) {
+        uint32_t n = get<uint32_t>();
+        if ((uint64_t)n * item_bytes > left) ok = false;
+        return ok ? n : 0;
+    }
+
+    void rects(std::vector<RegionRect>* out) {
+        uint32_t n = count(16);
+        out->resize(n);
+        for (uint32_t i = 0; i < n; i++) (*out)[i] = rect();
+    }
+
+    bool varint(uint64_t* v) {
+        *v = 0;
+        for (int shift = 0; shift < 64 && left; shift += 7) {
+            uint8_t b = *p++;
+            left--;
+            *v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+};
+
+static bool rle_decode(ChunkReader* r, uint8_t* dst, size_t n) {
+    size_t at = 0;
+    while (r->left) {
+        uint64_t packet;
+        if (!r->varint(&packet)) return false;
+        uint64_t len = packet >> 1;
+        if (len > n - at) return false;
+        if (packet & 1) {
+            memset(dst + at, 0, (size_t)len);
+        } else {
+            if (len > r->left) return false;
+            memcpy(dst + at, r->p, (size_t)len);
+            r->p += len;
+            r->left -= (size_t)len;
+        }
+        at += (size_t)len;
+    }
+    return at == n;
+}
+
+static bool rect_sane(const RegionRect& r) {
+    return r.right > r.left && r.bottom > r.top &&
+           (int64_t)r.right - r.left <= TICK_MAX_SIDE && (int64_t)r.bottom - r.top <= TICK_MAX_SIDE;
+}
+
+static bool rect_within(int32_t left, int32_t top, int32_t right, int32_t bottom, const RegionRect& bounds) {
+    return left >= bounds.left && top >= bounds.top && right <= bounds.right && bottom <= bounds.bottom &&
+           right > left && bottom > top;
+}
+
+/*
+ * A replayed plan is written into a target of the window's size, so every
+ * rect must lie inside it and the output inside the capture it is blurred
+ * from. Whole-window plans carry no requested rects.
+ */
+static bool plan_sane(const RegionBlurPlan& plan, int32_t w, int32_t h) {
+    const RegionRect window = { 0, 0, w, h };
+    if (plan.rects.size() > BLUR_MAX_REGIONS) return false;
+    for (const RegionRect& r : plan.capture) {
+        if (!rect_within(r.left, r.top, r.right, r.bottom, window)) return false;
+    }
+    const RegionRect capture = region_bounds(plan.capture);
+    for (const RegionRect& r : plan.output) {
+        if (!rect_within(r.left, r.top, r.right, r.bottom, capture)) return false;
+    }
+    for (const BlurRect& r : plan.rects) {
+        if (!rect_within(r.left, r.top, r.right, r.bottom, window)) return false;
+    }
+    return true;
+}
+
+/* ============================================================================
+ * TickReader
+ * ============================================================================ */
+TickReader::TickReader() : m_data(nullptr), m_size(0), m_pos(0), m_flags(0) {}
+
+int32_t TickReader::open(const uint8_t* data, size_t size) {
+    m_windows.clear();
+    m_refs.clear();
+    m_data = data;
+    m_size = size;
+    m_pos = 0;
+    if (!data || size < sizeof(TICK_RECORD_MAGIC) + 8 ||
+        memcmp(data, TICK_RECORD_MAGIC, sizeof(TICK_RECORD_MAGIC))) return BLUR_INVALID_PARAMS;
+    ChunkReader r = { data + sizeof(TICK_RECORD_MAGIC), 8, true };
+    uint32_t version = r.get<uint32_t>();
+    m_flags = r.get<uint32_t>();
+    if (version != TICK_RECORD_VERSION || (m_flags & ~BLUR_RECORD_DELTA)) return BLUR_INVALID_PARAMS;
+    m_pos = sizeof(TICK_RECORD_MAGIC) + 8;
+    return BLUR_SUCCESS;
+}
+
+bool TickReader::chunk(uint32_t* type, const uint8_t** payload, uint32_t* bytes) {
+    if (m_size - m_pos < 8) return false;
+    memcpy(type, m_data + m_pos, 4);
+    memcpy(bytes, m_data + m_pos + 4, 4);
+    if (*bytes > m_size - m_pos - 8) return false;
+    *payload = m_data + m_pos + 8;
+    return true;
+}
+
+int32_t TickReader::read_params(const uint8_t* p, uint32_t bytes) {
+    ChunkReader r = { p, bytes, true };
+    uintptr_t handle = (uintptr_t)r.get<uint64_t>();
+    RecordedKernel rk;
+    rk.sigma = r.get<float>();
+    rk.algorithm = r.get<uint32_t>();
+    rk.downsample = r.get<int32_t>();
+    rk.transfer = r.get<uint32_t>();
+    if (!r.ok || !std::isfinite(rk.sigma) || rk.sigma < 0.0f || rk.sigma > 1000.0f ||
+        rk.algorithm > BLUR_ALGORITHM_AUTO || rk.downsample < 1 || rk.downsample > BLUR_MAX_DOWNSAMPLE) {
+        return BLUR_INVALID_PARAMS;
+    }
+
+    WindowState& ws = m_windows[handle];
+    build_blur_kernel(rk.sigma, rk.algorithm, rk.downsample, &ws.kernel);
+    kernel_set_linear_light(&ws.kernel, rk.transfer == BLUR_TRANSFER_LINEAR);
+    ws.has_kernel = true;
+    return BLUR_SUCCESS;
+}
+
+int32_t TickReader::read_tick(const uint8_t* p, uint32_t bytes, ReplayTick* tick) {
+    ChunkReader r = { p, bytes, true };
+    tick->time_us = r.get<uint64_t>();
+    uint32_t count = r.count(56);
+    tick->windows.assign(count, TickWindow());
+    if (tick->targets.size() < count) tick->targets.resize(count);
+    if (tick->effects.size() < count) tick->effects.resize(count);
+
+    for (uint32_t i = 0; i < count && r.ok; i++) {
+        TickWindow& tw = tick->windows[i];
+        tw.handle = (uintptr_t)r.get<uint64_t>();
+        tw.screen = r.rect();
+        uint32_t flags = r.get<uint32_t>();
+        tw.color_argb = r.get<uint32_t>();
+        uint32_t mode = r.get<uint32_t>();
+        tw.lane = r.get<uint32_t>();
+        tw.max_tasks = r.get<uint32_t>();
+        r.rects(&tw.plan.output);
+        r.rects(&tw.plan.capture);
+        uint32_t n = r.count(20);
+        tw.plan.rects.resize(n);
+        for (BlurRect& b : tw.plan.rects) {
+            b.left = r.get<int32_t>();
+            b.top = r.get<int32_t>();
+            b.right = r.get<int32_t>();
+            b.bottom = r.get<int32_t>();
+            b.corner_radius = r.get<uint32_t>();
+        }
+        if (flags & TICK_FLAG_EFFECTS) {
+            BlurEffectList_V1 list = {};
+            list.struct_version = 1;
+            list.effect_count = r.count(12);
+            if (list.effect_count > BLUR_MAX_EFFECTS) return BLUR_INVALID_PARAMS;
+            for (uint32_t e = 0; e < list.effect_count; e++) {
+                list.effects[e].type = r.get<uint32_t>();
+                list.effects[e].color_argb = r.get<uint32_t>();
+                list.effects[e].amount = r.get<float>();
+            }
+            if (!r.ok || compile_effect_graph(&list, &tick->effects[i]) != BLUR_SUCCESS) return BLUR_INVALID_PARAMS;
+            tw.effects = &tick->effects[i];
+        }
+        if (!r.ok || !rect_sane(tw.screen) || mode > CPU_BLUR_STREAMING || tw.lane >= EXECUTOR_LANE_COUNT) {
+            return BLUR_INVALID_PARAMS;
+        }
+        tw.mode = (CpuBlurMode)mode;
+
+        WindowState& ws = m_windows[tw.handle];
+        if ((flags & TICK_FLAG_KERNEL) && !ws.has_kernel) return BLUR_INVALID_PARAMS;
+        tw.kernel = (flags & TICK_FLAG_KERNEL) ? &ws.kernel : nullptr;
+        tw.backdrop = (flags & TICK_FLAG_BACKDROP) ? &ws.backdrop : nullptr;
+        ws.backdrop.store_reduction = (flags & TICK_FLAG_HALF_BACKDROP) ? 2 : 1;
+
+        int32_t w = tw.screen.right - tw.screen.left, h = tw.screen.bottom - tw.screen.top;
+        if (!plan_sane(tw.plan, w, h)) return BLUR_INVALID_PARAMS;
+        std::vector<uint8_t>& target = tick->targets[i];
+        target.assign((size_t)w * h * 4, 0);
+        tw.target = { target.data(), w, h, w * 4 };
+    }
+    return r.ok && !r.left ? BLUR_SUCCESS : BLUR_INVALID_PARAMS;
+}
+
+int32_t TickReader::read_frame(const uint8_t* p, uint32_t bytes, ReplayFrame* frame) {
+    ChunkReader r = { p, bytes, true };
+    frame->bounds = r.rect();
+    uint32_t codec = r.get<uint32_t>();
+    if (!r.ok || !rect_sane(frame->bounds)) return BLUR_INVALID_PARAMS;
+    const size_t size = (size_t)(frame->bounds.right - frame->bounds.left) * (frame->bounds.bottom - frame->bounds.top) * 4;
+    frame->pixels.resize(size);
+
+    if (codec == TICK_FRAME_RAW) {
+        if (r.left != size) return BLUR_INVALID_PARAMS;
+        memcpy(frame->pixels.data(), r.p, size);
+        return BLUR_SUCCESS;
+    }
+    if (codec != TICK_FRAME_RLE && codec != TICK_FRAME_DELTA_RLE) return BLUR_INVALID_PARAMS;
+    if (!rle_decode(&r, frame->pixels.data(), size)) return BLUR_INVALID_PARAMS;
+
+    FrameReference* ref = find_reference(&m_refs, frame->bounds);
+    if (codec == TICK_FRAME_DELTA_RLE) {
+        if (!ref) return BLUR_INVALID_PARAMS;
+        for (size_t i = 0; i < size; i++) frame->pixels[i] ^= ref->pixels[i];
+    } else if (!ref) {
+        ref = add_reference(&m_refs, frame->bounds);
+    }
+    ref->pixels = frame->pixels;
+    return BLUR_SUCCESS;
+}
+
+int32_t TickReader::next_tick(ReplayTick* tick, bool* end) {
+    *end = false;
+    tick->frames.clear();
+    bool have_tick = false;
+    uint32_t type, bytes;
+    const uint8_t* payload;
+    while (m_pos < m_size) {
+        if (!chunk(&type, &payload, &bytes)) return BLUR_INVALID_PARAMS;
+        /* PARAMS and the next TICK start the following tick */
+        if (have_tick && type != TICK_CHUNK_FRAME) return BLUR_SUCCESS;
+
+        int32_t rc;
+        if (type == TICK_CHUNK_PARAMS) {
+            rc = read_params(payload, bytes);
+        } else if (type == TICK_CHUNK_TICK) {
+            rc = read_tick(payload, bytes, tick);
+            have_tick = true;
+        } else if (type == TICK_CHUNK_FRAME && have_tick) {
+            tick->frames.push_back(ReplayFrame());
+            rc = read_frame(payload, bytes, &tick->frames.back());
+        } else {
+            rc = BLUR_INVALID_PARAMS;
+        }
+        if (rc != BLUR_SUCCESS) return rc;
+        m_pos += 8 + (size_t)bytes;
+    }
+    *end = !have_tick;
+    return BLUR_SUCCESS;
+}
+
+int32_t ReplaySource::begin_frame(const RegionRect& bounds, BlurSurface* frame) {
+    if (m_next >= m_tick->frames.size()) return BLUR_INVALID_PARAMS;
+    ReplayFrame& f = m_tick->frames[m_next++];
+    if (f.bounds.left != bounds.left || f.bounds.top != bounds.top ||
+        f.bounds.right != bounds.right || f.bounds.bottom != bounds.bottom) return BLUR_INVALID_PARAMS;
+    int32_t w = bounds.right - bounds.left;
+    *frame = { f.pixels.data(), w, bounds.bottom - bounds.top, w * 4 };
+    return BLUR_SUCCESS;
+}
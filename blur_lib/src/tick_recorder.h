@@ -0,0 +1,198 @@
+/*
+ * tick_recorder.h - Recording and replay of refresh ticks
+ *
+ * A recording holds everything a shared tick depends on: each window's rect,
+ * region plan and blur parameters, and the backdrop frames it captured. A
+ * replay feeds those inputs back through run_shared_tick(), so a slow tick
+ * seen on one desktop can be rerun and profiled anywhere the core builds.
+ *
+ * File layout (little-endian, as on every target):
+ *   header   "BLURREC\0", u32 version, u32 flags (BLUR_RECORD_*)
+ *   chunks   u32 type, u32 payload bytes, payload
+ *
+ * A PARAMS chunk (a window's kernel parameters) precedes the first tick that
+ * blurs the window on the CPU and every tick that changes them. Each TICK
+ * chunk (time, then per window its handle, rects, plan, tint, mode, lane,
+ * backdrop resolution and effect nodes) is followed by one FRAME chunk per
+ * captured cluster, in capture order.
+ * Frames are stored raw, or with BLUR_RECORD_DELTA as the XOR against the
+ * previous frame with the same bounds, zero-run encoded, so a desktop that
+ * hardly changes costs a few bytes per tick.
+ *
+ * Replay keeps every window's backdrop cache for the whole run, so a window
+ * that was hidden for a while may reuse a little more than it did live.
+ *
+ * The core does no file I/O: recordings go to a RecordSink and are read back
+ * from memory (a mapped file in the replay tool).
+ */
+
+#ifndef BLUR_LIB_TICK_RECORDER_H
+#define BLUR_LIB_TICK_RECORDER_H
+
+#include "capture_planner.h"
+#include "effect_graph.h"
+#include <map>
+
+#define TICK_RECORD_VERSION 2
+
+#define TICK_CHUNK_PARAMS   1
+#define TICK_CHUNK_TICK     2
+#define TICK_CHUNK_FRAME    3
+
+#define TICK_FRAME_RAW          0
+#define TICK_FRAME_RLE          1   /* Zero-run encoded pixels (no reference yet) */
+#define TICK_FRAME_DELTA_RLE    2   /* Zero-run encoded XOR against the last frame with the same bounds */
+
+/* Per-window flags of a TICK chunk */
+#define TICK_FLAG_KERNEL        1u  /* Blurred on the CPU with the window's last PARAMS kernel */
+#define TICK_FLAG_BACKDROP      2u  /* Has a backdrop cache */
+#define TICK_FLAG_HALF_BACKDROP 4u  /* The backdrop is stored at half resolution */
+#define TICK_FLAG_EFFECTS       8u  /* Effect nodes follow the corner radii */
+
+/* Distinct frame bounds kept as delta references; more start over with none */
+#define TICK_MAX_REFERENCES 16
+
+/* Where recorded bytes go (a file on Windows, memory in the tests) */
+class RecordSink {
+public:
+    virtual ~RecordSink() {}
+
+    /* False stops the recording */
+    virtual bool write(const void* data, size_t bytes) = 0;
+};
+
+struct TickRecorderStats {
+    uint64_t ticks;
+    uint64_t frames;
+    uint64_t params;            /* PARAMS chunks written */
+    uint64_t frame_bytes;       /* Pixel bytes before encoding */
+    uint64_t bytes_written;     /* Including the header */
+};
+
+/* Previous frames by bounds, mirrored by the recorder and the reader */
+struct FrameReference {
+    RegionRect           bounds;
+    std::vector<uint8_t> pixels;    /* Rows of bounds width * 4 bytes */
+};
+
+/* What a window's kernel is rebuilt from */
+struct RecordedKernel {
+    float    sigma;
+    uint32_t algorithm;
+    int32_t  downsample;
+    uint32_t transfer;
+};
+
+class TickRecorder {
+public:
+    TickRecorder();
+
+    /* Writes the header; sink must outlive the recorder (or the next open) */
+    int32_t open(RecordSink* sink, uint32_t flags);
+
+    /* The sink failed or open was never called */
+    bool failed() const { return m_sink == nullptr; }
+
+    /* Parameter changes and the tick's windows, before run_shared_tick() captures */
+    void record_tick(uint64_t now_us, const TickWindow* windows, size_t count);
+
+    /* One captured cluster frame, in capture order */
+    void record_frame(const RegionRect& bounds, const BlurSurface* frame);
+
+    TickRecorderStats stats() const { return m_stats; }
+
+private:
+    void write_chunk(uint32_t type, const std::vector<uint8_t>& payload);
+
+    RecordSink* m_sink;
+    uint32_t m_flags;
+    bool m_started;
+    uint64_t m_start_us;
+    std::map<uintptr_t, RecordedKernel> m_kernels;
+    std::vector<FrameReference> m_refs;
+    std::vector<uint8_t> m_chunk;
+    std::vector<uint8_t> m_delta;
+    TickRecorderStats m_stats;
+};
+
+/* Passes a tick's capture through and records every frame it ends */
+class RecordingSource : public CaptureSource {
+public:
+    RecordingSource(CaptureSource* inner, TickRecorder* recorder)
+        : m_inner(inner), m_recorder(recorder), m_bounds(), m_frame() {}
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override;
+    void capture(const RegionRect& area) override { m_inner->capture(area); }
+    void end_frame() override;
+
+private:
+    CaptureSource* m_inner;
+    TickRecorder* m_recorder;
+    RegionRect m_bounds;
+    BlurSurface m_frame;
+};
+
+struct ReplayFrame {
+    RegionRect           bounds;
+    std::vector<uint8_t> pixels;
+};
+
+struct ReplayTick {
+    uint64_t time_us;                       /* Since the first recorded tick */
+    std::vector<TickWindow> windows;        /* Kernels and backdrop caches belong to the reader */
+    std::vector<ReplayFrame> frames;        /* Capture order */
+    std::vector<std::vector<uint8_t>> targets;  /* Zeroed window-sized targets of windows */
+    std::vector<EffectProgram> effects;     /* Effect programs of windows, where they have one */
+};
+
+class TickReader {
+public:
+    TickReader();
+
+    /* data must stay valid while reading; BLUR_INVALID_PARAMS for a bad header */
+    int32_t open(const uint8_t* data, size_t size);
+
+    /*
+     * Reads the next tick into tick, reusing its buffers. Returns BLUR_SUCCESS
+     * with *end set once the recording is exhausted, and BLUR_INVALID_PARAMS
+     * for malformed or truncated chunks.
+     */
+    int32_t next_tick(ReplayTick* tick, bool* end);
+
+    uint32_t flags() const { return m_flags; }
+
+private:
+    struct WindowState {
+        bool           has_kernel = false;
+        BlurKernel     kernel;
+        BackdropCache  backdrop;
+    };
+
+    bool chunk(uint32_t* type, const uint8_t** payload, uint32_t* bytes);
+    int32_t read_params(const uint8_t* p, uint32_t bytes);
+    int32_t read_tick(const uint8_t* p, uint32_t bytes, ReplayTick* tick);
+    int32_t read_frame(const uint8_t* p, uint32_t bytes, ReplayFrame* frame);
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos;
+    uint32_t m_flags;
+    std::map<uintptr_t, WindowState> m_windows;
+    std::vector<FrameReference> m_refs;
+};
+
+/* Hands out the tick's recorded frames in order; bounds must match the recording */
+class ReplaySource : public CaptureSource {
+public:
+    explicit ReplaySource(ReplayTick* tick) : m_tick(tick), m_next(0) {}
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override;
+    void capture(const RegionRect&) override {}
+    void end_frame() override {}
+
+private:
+    ReplayTick* m_tick;
+    size_t m_next;
+};
+
+#endif /* BLUR_LIB_TICK_RECORDER_H */
@@ -0,0 +1,88 @@
+/*
+ * visibility.cpp - Window-stack visibility culling
+ */
+
+#include "visibility.h"
+#include "stats.h"
+
+/* Kept per thread so their capacity survives between ticks */
+struct VisibilityScratch {
+    std::vector<RegionRect> desktop, covered, onscreen, visible, merged;
+};
+
+static VisibilityScratch& visibility_scratch() {
+    thread_local VisibilityScratch scratch;
+    return scratch;
+}
+
+void compute_stack_visibility(const StackWindow* stack, size_t count,
+                              const RegionRect* monitors, size_t monitor_count,
+                              std::vector<VisibilityInfo>* out) {
+    /* Entries keep their visible lists' capacity from the last call */
+    out->resize(count);
+
+    VisibilityScratch& vs = visibility_scratch();
+    std::vector<RegionRect>& desktop = vs.desktop;
+    region_union(monitors, monitor_count, &desktop);
+
+    std::vector<RegionRect>& covered = vs.covered;
+    std::vector<RegionRect>& onscreen = vs.onscreen;
+    std::vector<RegionRect>& visible = vs.visible;
+    std::vector<RegionRect>& merged = vs.merged;
+    covered.clear();
+    for (size_t i = 0; i < count; i++) {
+        const StackWindow& win = stack[i];
+        VisibilityInfo& info = (*out)[i];
+        info.visible.clear();
+        info.total_area = rect_area(win.rect);
+        info.visible_area = 0;
+        info.state = VISIBILITY_HIDDEN;
+        if (!win.shown || rect_is_empty(win.rect)) {
+            continue;
+        }
+
+        /* Monitor area under the window, minus everything opaque above it */
+        onscreen.clear();
+        for (const RegionRect& m : desktop) {
+            RegionRect r = rect_intersect(m, win.rect);
+            if (!rect_is_empty(r)) onscreen.push_back(r);
+        }
+        region_subtract(onscreen, covered, &visible);
+
+        info.visible_area = region_area(visible);
+        if (info.visible_area == 0) {
+            info.state = VISIBILITY_HIDDEN;
+        } else if (info.visible_area == info.total_area) {
+            info.state = VISIBILITY_FULL;
+        } else {
+            info.state = VISIBILITY_PARTIAL;
+        }
+        info.visible.reserve(visible.size());
+        for (const RegionRect& r : visible) {
+            RegionRect rel = { r.left - win.rect.left, r.top - win.rect.top,
+                               r.right - win.rect.left, r.bottom - win.rect.top };
+            info.visible.push_back(rel);
+        }
+
+        if (win.opaque) {
+            covered.push_back(win.rect);
+            region_union(covered.data(), covered.size(), &merged);
+            covered.swap(merged);
+        }
+    }
+}
+
+void record_visibility_stats(const VisibilityInfo& info) {
+    uint64_t culled = (uint64_t)(info.total_area - info.visible_area);
+    switch (info.state) {
+        case VISIBILITY_HIDDEN:
+            stats_add(BLUR_STAT_FRAMES_CULLED, 1);
+            break;
+        case VISIBILITY_PARTIAL:
+            stats_add(BLUR_STAT_FRAMES_PARTIAL, 1);
+            break;
+        case VISIBILITY_FULL:
+            break;
+    }
+    stats_add(BLUR_STAT_PIXELS_CULLED, culled);
+}
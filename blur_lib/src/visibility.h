@@ -0,0 +1,45 @@
+/*
+ * visibility.h - Window-stack visibility culling
+ *
+ * Platform-neutral: the Windows side fills a StackWindow list from the real
+ * z-order and monitor layout, tests fill it with synthetic layouts.
+ */
+
+#ifndef BLUR_LIB_VISIBILITY_H
+#define BLUR_LIB_VISIBILITY_H
+
+#include "region.h"
+
+struct StackWindow {
+    uintptr_t  handle;
+    RegionRect rect;        /* Screen coordinates */
+    bool       shown;       /* Visible, not minimized and not cloaked */
+    bool       opaque;      /* Hides the windows underneath it */
+};
+
+typedef enum WindowVisibility {
+    VISIBILITY_HIDDEN  = 0, /* Nothing on screen: skip the frame */
+    VISIBILITY_PARTIAL = 1, /* Partly covered or off-screen: shrink to visible */
+    VISIBILITY_FULL    = 2
+} WindowVisibility;
+
+struct VisibilityInfo {
+    WindowVisibility state;
+    std::vector<RegionRect> visible;    /* Window-relative visible area */
+    int64_t visible_area;
+    int64_t total_area;
+};
+
+/*
+ * Computes the visibility of every window in stack, which is ordered topmost
+ * first. A window is visible where it lies on a monitor and no shown, opaque
+ * window above it covers it.
+ */
+void compute_stack_visibility(const StackWindow* stack, size_t count,
+                              const RegionRect* monitors, size_t monitor_count,
+                              std::vector<VisibilityInfo>* out);
+
+/* Counts the frame and the pixels it saved in the BLUR_STAT_* counters */
+void record_visibility_stats(const VisibilityInfo& info);
+
+#endif /* BLUR_LIB_VISIBILITY_H */
@@ -0,0 +1,76 @@
+/*
+ * warmup.cpp - Background warm-up and init phase timings
+ */
+
+#include "warmup.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static std::atomic<uint64_t> g_timings[BLUR_INIT_PHASE_COUNT];
+
+static std::mutex g_warmup_mutex;
+static std::condition_variable g_warmup_done_cv;
+static std::thread g_warmup_thread;
+static std::atomic<bool> g_warmup_running(false);   /* Lets warmup_wait() skip the mutex once done */
+static bool g_wait_recorded = false;                 /* Guarded by g_warmup_mutex */
+
+static void warmup_main(void (*fn)(void)) {
+    {
+        PhaseTimer total(BLUR_INIT_PHASE_WARMUP_TOTAL);
+        fn();
+    }
+    std::lock_guard<std::mutex> lock(g_warmup_mutex);
+    g_warmup_running.store(false, std::memory_order_release);
+    g_warmup_done_cv.notify_all();
+}
+
+bool warmup_start(void (*fn)(void)) {
+    std::lock_guard<std::mutex> lock(g_warmup_mutex);
+    if (g_warmup_thread.joinable()) return false;
+    g_wait_recorded = false;
+    g_warmup_running.store(true, std::memory_order_release);
+    g_warmup_thread = std::thread(warmup_main, fn);
+    return true;
+}
+
+uint64_t warmup_wait(void) {
+    if (!g_warmup_running.load(std::memory_order_acquire)) return 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(g_warmup_mutex);
+    g_warmup_done_cv.wait(lock, []() { return !g_warmup_running.load(std::memory_order_acquire); });
+    uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!g_wait_recorded) {
+        g_wait_recorded = true;
+        init_timing_record(BLUR_INIT_PHASE_APPLY_WAIT, us);
+    }
+    return us;
+}
+
+bool warmup_running(void) {
+    return g_warmup_running.load(std::memory_order_acquire);
+}
+
+void warmup_join(void) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(g_warmup_mutex);
+        t.swap(g_warmup_thread);
+    }
+    if (t.joinable()) t.join();
+}
+
+void init_timing_record(uint32_t phase, uint64_t us) {
+    if (phase < BLUR_INIT_PHASE_COUNT) g_timings[phase].store(us, std::memory_order_relaxed);
+}
+
+uint64_t init_timing_get(uint32_t phase) {
+    return phase < BLUR_INIT_PHASE_COUNT ? g_timings[phase].load(std::memory_order_relaxed) : 0;
+}
+
+void init_timings_reset(void) {
+    for (uint32_t i = 0; i < BLUR_INIT_PHASE_COUNT; i++) g_timings[i].store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+/*
+ * warmup.h - Background warm-up and init phase timings
+ *
+ * blur_init_ex(BLUR_INIT_WARMUP) hands the slow first-use work (device
+ * creation, surface pool, kernel tables) to one background thread. Callers
+ * that need those resources call warmup_wait(), which returns at once when
+ * warm-up is done or was never started.
+ *
+ * Every init phase records how long it took (BLUR_INIT_PHASE_*), whether it
+ * ran on the warm-up thread or inline on first use.
+ */
+
+#ifndef BLUR_LIB_WARMUP_H
+#define BLUR_LIB_WARMUP_H
+
+#include "blur_lib.h"
+#include <chrono>
+
+/* Starts fn on the warm-up thread; false if warm-up is already running or done */
+bool warmup_start(void (*fn)(void));
+
+/*
+ * Blocks until a started warm-up finishes. Returns the microseconds waited;
+ * the first wait is also recorded as BLUR_INIT_PHASE_APPLY_WAIT.
+ */
+uint64_t warmup_wait(void);
+
+/* True while the warm-up thread is still working */
+bool warmup_running(void);
+
+/* Waits for and joins the warm-up thread, so warmup_start() works again */
+void warmup_join(void);
+
+void init_timing_record(uint32_t phase, uint64_t us);
+uint64_t init_timing_get(uint32_t phase);
+void init_timings_reset(void);
+
+/* Records the lifetime of a scope as an init phase */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(uint32_t phase) : m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - m_start;
+        init_timing_record(m_phase, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+private:
+    PhaseTimer(const PhaseTimer&);
+    PhaseTimer& operator=(const PhaseTimer&);
+
+    uint32_t m_phase;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif /* BLUR_LIB_WARMUP_H */
@@ -0,0 +1,251 @@
+/*
+ * window_registry.cpp - Lock-free registry of tracked windows
+ */
+
+#include "window_registry.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+enum SlotState { SLOT_FREE = 0, SLOT_LIVE = 1, SLOT_REMOVED = 2 };
+
+/* Everything a reader copies out of a slot */
+struct SlotData {
+    BlurWindowInfo_V1 info;     /* info.epoch is the add, update or removal epoch */
+    uint64_t state;             /* SlotState */
+    uint64_t added_epoch;
+};
+
+static_assert(sizeof(SlotData) % sizeof(uint64_t) == 0, "slots are copied in 64-bit words");
+#define SLOT_WORDS (sizeof(SlotData) / sizeof(uint64_t))
+
+/* Seqlock: seq is odd while the words are being rewritten */
+struct Slot {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint64_t> words[SLOT_WORDS];
+};
+
+static Slot g_slots[BLUR_MAX_TRACKED_WINDOWS];
+static std::atomic<uint32_t> g_used(0);        /* Slots [0, g_used) have been written */
+static std::atomic<uint64_t> g_epoch(0);       /* Newest published epoch */
+static std::atomic<uint64_t> g_horizon(0);     /* Feeds older than this cannot see every removal */
+
+/* Writers work on their own copy of each slot and publish it */
+static std::mutex g_write_mutex;
+static SlotData g_shadow[BLUR_MAX_TRACKED_WINDOWS];
+
+/* ============================================================================
+ * Seqlock access
+ * ============================================================================ */
+static void publish_slot(uint32_t i) {
+    uint64_t words[SLOT_WORDS];
+    memcpy(words, &g_shadow[i], sizeof(words));
+
+    Slot& s = g_slots[i];
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t w = 0; w < SLOT_WORDS; w++) s.words[w].store(words[w], std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+}
+
+static void read_slot(uint32_t i, SlotData* out) {
+    const Slot& s = g_slots[i];
+    uint64_t words[SLOT_WORDS];
+    for (;;) {
+        uint32_t before = s.seq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        for (size_t w = 0; w < SLOT_WORDS; w++) words[w] = s.words[w].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == before) break;
+    }
+    memcpy(out, words, sizeof(words));
+}
+
+/* ============================================================================
+ * Writers (caller holds g_write_mutex)
+ * ============================================================================ */
+static int32_t find_live(uint64_t handle) {
+    uint32_t used = g_used.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < used; i++) {
+        if (g_shadow[i].state == SLOT_LIVE && g_shadow[i].info.window_handle == handle) return (int32_t)i;
+    }
+    return -1;
+}
+
+/*
+ * A free slot, else a new one, else the oldest tombstone, whichever window
+ * it belonged to; feeds that missed its removal resync.
+ */
+static int32_t find_unused(void) {
+    uint32_t used = g_used.load(std::memory_order_relaxed);
+    int32_t oldest = -1;
+    for (uint32_t i = 0; i < used; i++) {
+        const SlotData& d = g_shadow[i];
+        if (d.state == SLOT_FREE) return (int32_t)i;
+        if (d.state == SLOT_REMOVED && (oldest < 0 || d.info.epoch < g_shadow[oldest].info.epoch)) {
+            oldest = (int32_t)i;
+        }
+    }
+    if (used < BLUR_MAX_TRACKED_WINDOWS) return (int32_t)used;
+    if (oldest >= 0) {
+        /* Its removal is forgotten: feeds that have not seen it must resync */
+        if (g_shadow[oldest].info.epoch > g_horizon.load(std::memory_order_relaxed)) {
+            g_horizon.store(g_shadow[oldest].info.epoch, std::memory_order_release);
+        }
+    }
+    return oldest;
+}
+
+/* Publishes slot i at the next epoch; the epoch becomes visible only after the slot */
+static void publish_change(uint32_t i) {
+    uint64_t epoch = g_epoch.load(std::memory_order_relaxed) + 1;
+    g_shadow[i].info.epoch = epoch;
+    if (g_shadow[i].state == SLOT_LIVE && g_shadow[i].added_epoch == 0) g_shadow[i].added_epoch = epoch;
+    publish_slot(i);
+    if (i >= g_used.load(std::memory_order_relaxed)) g_used.store(i + 1, std::memory_order_release);
+    g_epoch.store(epoch, std::memory_order_release);
+}
+
+static void fill_params(BlurWindowInfo_V1* info, uint32_t backend, const BlurSettings& settings) {
+    info->backend = backend;
+    info->algorithm = settings.algorithm;
+    info->intensity = settings.intensity;
+    info->color_argb = settings.color_argb;
+    info->flags = settings.flags;
+    info->downsample = (uint32_t)settings.downsample;
+    info->refresh_interval_ms = settings.refresh_interval_ms;
+    info->region_count = settings.regions ? settings.regions->rect_count : 0;
+}
+
+int32_t registry_track(uint64_t handle, uint32_t backend, const BlurSettings& settings) {
+    std::lock_guard<std::mutex> lock(g_write_mutex);
+
+    int32_t i = find_live(handle);
+    if (i >= 0) {
+        BlurWindowInfo_V1 next = g_shadow[i].info;
+        fill_params(&next, backend, settings);
+        if (memcmp(&next, &g_shadow[i].info, sizeof(next)) == 0) return BLUR_SUCCESS;
+        g_shadow[i].info = next;
+        publish_change((uint32_t)i);
+        return BLUR_SUCCESS;
+    }
+
+    i = find_unused();
+    if (i < 0) return BLUR_OUT_OF_MEMORY;
+    SlotData& d = g_shadow[i];
+    memset(&d, 0, sizeof(d));
+    d.info.window_handle = handle;
+    fill_params(&d.info, backend, settings);
+    d.state = SLOT_LIVE;
+    publish_change((uint32_t)i);
+    return BLUR_SUCCESS;
+}
+
+bool registry_untrack(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(g_write_mutex);
+    int32_t i = find_live(handle);
+    if (i < 0) return false;
+    g_shadow[i].state = SLOT_REMOVED;
+    publish_change((uint32_t)i);
+    return true;
+}
+
+bool registry_lookup(uint64_t handle, BlurWindowInfo_V1* info) {
+    uint32_t used = g_used.load(std::memory_order_acquire);
+    SlotData d;
+    for (uint32_t i = 0; i < used; i++) {
+        read_slot(i, &d);
+        if (d.state == SLOT_LIVE && d.info.window_handle == handle) {
+            if (info) *info = d.info;
+            return true;
+        }
+    }
+    return false;
+}
+
+void registry_record_frame(uint64_t handle, uint32_t frame_us, uint64_t pixels) {
+    std::lock_guard<std::mutex> lock(g_write_mutex);
+    int32_t i = find_live(handle);
+    if (i < 0) return;
+    g_shadow[i].info.last_frame_us = frame_us;
+    g_shadow[i].info.last_frame_pixels = pixels;
+    publish_slot((uint32_t)i);
+}
+
+void registry_clear(void) {
+    std::lock_guard<std::mutex> lock(g_write_mutex);
+    uint32_t used = g_used.load(std::memory_order_relaxed);
+    uint64_t epoch = g_epoch.load(std::memory_order_relaxed) + 1;
+    g_horizon.store(epoch, std::memory_order_release);
+    for (uint32_t i = 0; i < used; i++) {
+        memset(&g_shadow[i], 0, sizeof(g_shadow[i]));
+        publish_slot(i);
+    }
+    g_epoch.store(epoch, std::memory_order_release);
+}
+
+/* ============================================================================
+ * Readers
+ * ============================================================================ */
+int32_t registry_snapshot(BlurWindowInfo_V1* out, uint32_t capacity, uint32_t* count, uint64_t* epoch) {
+    if (!count || (!out && capacity)) return BLUR_INVALID_PARAMS;
+
+    uint64_t e = g_epoch.load(std::memory_order_acquire);
+    uint32_t used = g_used.load(std::memory_order_acquire);
+    uint32_t n = 0;
+    SlotData d;
+    for (uint32_t i = 0; i < used; i++) {
+        read_slot(i, &d);
+        if (d.state != SLOT_LIVE) continue;
+        if (n < capacity) out[n] = d.info;
+        n++;
+    }
+    *count = n;
+    if (epoch) *epoch = e;
+    return n <= capacity ? BLUR_SUCCESS : BLUR_INVALID_PARAMS;
+}
+
+int32_t registry_changes(uint64_t since, BlurWindowChange_V1* out, uint32_t capacity, uint32_t* count,
+                         uint64_t* epoch, uint32_t* flags) {
+    if (!count || !epoch || (!out && capacity)) return BLUR_INVALID_PARAMS;
+
+    /* Everything at or before e is visible to the scan; later changes may repeat next time */
+    uint64_t e = g_epoch.load(std::memory_order_acquire);
+    bool resync = since < g_horizon.load(std::memory_order_acquire) || since > e;
+    uint32_t n;
+    for (;;) {
+        /* Removals first, so a window removed and re-added reads as REMOVED then ADDED */
+        n = 0;
+        uint32_t used = g_used.load(std::memory_order_acquire);
+        SlotData d;
+        for (uint32_t pass = 0; pass < 2; pass++) {
+            for (uint32_t i = 0; i < used; i++) {
+                read_slot(i, &d);
+                uint32_t kind;
+                if (pass == 0) {
+                    /* Added and removed since the caller looked: nothing to report */
+                    if (resync || d.state != SLOT_REMOVED || d.info.epoch <= since || d.added_epoch > since) continue;
+                    kind = BLUR_CHANGE_REMOVED;
+                } else {
+                    if (d.state != SLOT_LIVE || (!resync && d.info.epoch <= since)) continue;
+                    kind = resync || d.added_epoch > since ? BLUR_CHANGE_ADDED : BLUR_CHANGE_UPDATED;
+                }
+                if (n < capacity) {
+                    out[n].kind = kind;
+                    out[n].reserved = 0;
+                    out[n].info = d.info;
+                }
+                n++;
+            }
+        }
+        /* A tombstone reused during the scan may have hidden a removal */
+        if (resync || since >= g_horizon.load(std::memory_order_acquire)) break;
+        resync = true;
+    }
+
+    *count = n;
+    *epoch = e;
+    if (flags) *flags = resync ? BLUR_CHANGES_RESYNC : 0;
+    return n <= capacity ? BLUR_SUCCESS : BLUR_INVALID_PARAMS;
+}
@@ -0,0 +1,39 @@
+/*
+ * window_registry.h - Lock-free registry of tracked windows
+ *
+ * A fixed table of BLUR_MAX_TRACKED_WINDOWS slots. Writers (apply, clear and
+ * the refresh tick) serialize on a mutex held only for one slot update;
+ * readers never lock and never allocate: every slot is a seqlock, so a
+ * snapshot copies each entry and retries the rare entry that changed mid-copy.
+ *
+ * Every add, parameter change and removal takes the next value of a global
+ * epoch. Removed windows stay as tombstones until the table is full and their
+ * slot is reused, which lets the change feed report removals; a feed older
+ * than the newest reused tombstone gets a full resync instead.
+ */
+
+#ifndef BLUR_LIB_WINDOW_REGISTRY_H
+#define BLUR_LIB_WINDOW_REGISTRY_H
+
+#include "effect_params.h"
+
+/* Adds or updates a window; BLUR_OUT_OF_MEMORY when every slot holds a live window */
+int32_t registry_track(uint64_t handle, uint32_t backend, const BlurSettings& settings);
+
+/* Removes a window; false if it was not tracked */
+bool registry_untrack(uint64_t handle);
+
+bool registry_lookup(uint64_t handle, BlurWindowInfo_V1* info);
+
+/* Records the cost of a window's latest refresh (does not advance the epoch) */
+void registry_record_frame(uint64_t handle, uint32_t frame_us, uint64_t pixels);
+
+/* Forgets every window; open change feeds resync */
+void registry_clear(void);
+
+/* See blur_get_window_snapshot() and blur_get_window_changes() */
+int32_t registry_snapshot(BlurWindowInfo_V1* out, uint32_t capacity, uint32_t* count, uint64_t* epoch);
+int32_t registry_changes(uint64_t since, BlurWindowChange_V1* out, uint32_t capacity, uint32_t* count,
+                         uint64_t* epoch, uint32_t* flags);
+
+#endif /* BLUR_LIB_WINDOW_REGISTRY_H */
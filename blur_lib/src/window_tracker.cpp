@@ -1,97 +1,118 @@
 /*
  * window_tracker.cpp - Window state tracking
+ *
+ * Tracked windows live in the lock-free registry (window_registry.cpp) so the
+ * snapshot and change-feed APIs can read them without blocking apply/clear.
  */
 
 #include "internal.h"
-#include <unordered_map>
-#include <mutex>
+#include "effect_params.h"
+#include "parallel_restore.h"
+#include "window_registry.h"
 #include <sstream>
-
-struct WindowState {
-    EffectParams params;
-    bool using_composition;  /* true = SetWindowCompositionAttribute, false = DWM */
-};
-
-static std::mutex g_tracker_mutex;
-static std::unordered_map<HWND, WindowState> g_tracked_windows;
+#include <vector>
 
 void init_window_tracker(void) {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
-    g_tracked_windows.clear();
+    registry_clear();
 }
 
 void cleanup_window_tracker(void) {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
-    g_tracked_windows.clear();
+    registry_clear();
 }
 
-void track_window(HWND hwnd, const EffectParams* params) {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
-    
-    WindowState state = {};
-    if (params) {
-        state.params = *params;
+int32_t track_window(HWND hwnd, const EffectParams* params, uint32_t backend) {
+    BlurSettings settings = {};
+    if (params && read_effect_params(params, &settings, nullptr) != BLUR_SUCCESS) {
+        return BLUR_INVALID_PARAMS;
     }
-    state.using_composition = true;  /* Default to composition */
     
-    g_tracked_windows[hwnd] = state;
-    LOG_DEBUG("Tracking window 0x%p, total tracked: %zu", hwnd, g_tracked_windows.size());
+    int32_t result = registry_track((uintptr_t)hwnd, backend, settings);
+    LOG_DEBUG("Tracking window 0x%p via backend %u", hwnd, backend);
+    return result;
 }
 
 void untrack_window(HWND hwnd) {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
-    g_tracked_windows.erase(hwnd);
-    LOG_DEBUG("Untracked window 0x%p, total tracked: %zu", hwnd, g_tracked_windows.size());
+    registry_untrack((uintptr_t)hwnd);
+    LOG_DEBUG("Untracked window 0x%p", hwnd);
 }
 
 bool is_blur_applied(HWND hwnd) {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
-    return g_tracked_windows.find(hwnd) != g_tracked_windows.end();
+    return registry_lookup((uintptr_t)hwnd, nullptr);
 }
 
-int32_t restore_all_tracked_windows(SetWindowCompositionAttributeFunc pFunc) {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
+/* Runs on a restore worker: routes the window to the backend that blurred it */
+static int32_t RestoreWindow(const BlurWindowInfo_V1* window, void* ctx) {
+    SetWindowCompositionAttributeFunc pFunc = (SetWindowCompositionAttributeFunc)ctx;
+    HWND hwnd = (HWND)(uintptr_t)window->window_handle;
+    int32_t rc;
     
-    int32_t result = BLUR_SUCCESS;
+    /* Skip if window is already destroyed */
+    if (!IsWindow(hwnd)) {
+        rc = BLUR_INVALID_HANDLE;
+    } else if (window->backend == BLUR_BACKEND_D2D) {
+        rc = restore_d2d_window_style(hwnd);
+    } else if (window->backend == BLUR_BACKEND_COMPOSITION) {
+        rc = pFunc ? clear_composition_blur(hwnd, pFunc) : BLUR_API_UNSUPPORTED;
+    } else {
+        rc = clear_dwm_blur(hwnd);
+    }
     
-    for (const auto& pair : g_tracked_windows) {
-        HWND hwnd = pair.first;
-        
-        /* Skip if window is already destroyed */
-        if (!IsWindow(hwnd)) {
-            continue;
-        }
-        
-        if (pair.second.using_composition && pFunc) {
-            if (clear_composition_blur(hwnd, pFunc) != BLUR_SUCCESS) {
-                result = BLUR_INTERNAL_ERROR;
-            }
-        } else {
-            if (clear_dwm_blur(hwnd) != BLUR_SUCCESS) {
-                result = BLUR_INTERNAL_ERROR;
-            }
+    registry_untrack(window->window_handle);
+    return rc;
+}
+
+/* Delivers messages other threads send to this thread's windows while it waits */
+static void PumpSentMessages(void) {
+    MSG msg;
+    PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+}
+
+int32_t restore_all_tracked_windows(SetWindowCompositionAttributeFunc pFunc) {
+    std::vector<BlurWindowInfo_V1> windows(BLUR_MAX_TRACKED_WINDOWS);
+    uint32_t count = 0;
+    registry_snapshot(windows.data(), (uint32_t)windows.size(), &count, nullptr);
+    
+    /*
+     * D2D windows stop refreshing before the workers touch them. Detaching
+     * waits out any tick that still holds the window; the timer lives on the
+     * tick thread, so that thread disarms it before the restore starts.
+     */
+    for (uint32_t i = 0; i < count; i++) {
+        if (windows[i].backend == BLUR_BACKEND_D2D) {
+            detach_d2d_window((HWND)(uintptr_t)windows[i].window_handle);
         }
     }
+    sync_d2d_refresh();
     
-    g_tracked_windows.clear();
+    ULONGLONG start = GetTickCount64();
+    RestoreSummary summary;
+    int32_t result = restore_windows(windows.data(), count, 0, RestoreWindow, (void*)pFunc,
+                                     PumpSentMessages, &summary);
+    LOG_INFO("Restored %u windows (%u already gone, %u failed) on %u workers in %llu ms",
+             summary.cleared, summary.skipped, summary.failed, summary.workers,
+             (unsigned long long)(GetTickCount64() - start));
+    
+    if (result != BLUR_SUCCESS) {
+        set_last_error(result, ERR_MSG_RESTORE_FAILED, summary.failed);
+    }
     return result;
 }
 
 std::string get_tracked_windows_json() {
-    std::lock_guard<std::mutex> lock(g_tracker_mutex);
+    std::vector<BlurWindowInfo_V1> windows(BLUR_MAX_TRACKED_WINDOWS);
+    uint32_t count = 0;
+    registry_snapshot(windows.data(), (uint32_t)windows.size(), &count, nullptr);
     
     std::ostringstream oss;
     oss << "[";
     
-    bool first = true;
-    for (const auto& pair : g_tracked_windows) {
-        if (!first) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0) {
             oss << ",";
         }
-        first = false;
         
-        oss << "{\"hwnd\":" << (uintptr_t)pair.first 
-            << ",\"intensity\":" << pair.second.params.intensity 
+        oss << "{\"hwnd\":" << windows[i].window_handle
+            << ",\"intensity\":" << windows[i].intensity 
             << "}";
     }
     
@@ -4,6 +4,7 @@
  * Measures apply/clear latency to verify SLO compliance:
  * - apply: 95th percentile < 300ms
  * - clear: 95th percentile < 200ms
+ * and how long restore_all and shutdown take with many blurred windows.
  */
 
 #include "blur_lib.h"
@@ -174,6 +175,69 @@ void RunBenchmark(int iterations) {
     blur_shutdown();
 }
 
+/* Extra windows for the restore benchmark, all of the benchmark window class */
+static std::vector<HWND> CreateWindows(int count) {
+    std::vector<HWND> windows;
+    for (int i = 0; i < count; i++) {
+        HWND w = CreateWindowW(L"BlurBenchmarkWindow", L"Restore Benchmark Window", WS_OVERLAPPEDWINDOW,
+                               40 + (i % 16) * 20, 40 + (i / 16) * 20, 320, 240, NULL, NULL, GetModuleHandle(NULL), NULL);
+        if (!w) break;
+        ShowWindow(w, SW_SHOWNOACTIVATE);
+        windows.push_back(w);
+    }
+    MSG msg;
+    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+    return windows;
+}
+
+static int ApplyAll(const std::vector<HWND>& windows) {
+    int applied = 0;
+    for (HWND w : windows) {
+        if (blur_apply_to_window((uintptr_t)w, nullptr, 0) == BLUR_SUCCESS) applied++;
+    }
+    return applied;
+}
+
+void RunRestoreBenchmark(int windowCount, int rounds) {
+    printf("\n=== restore_all / shutdown with %d windows ===\n\n", windowCount);
+
+    uint32_t caps = 0;
+    if (blur_init(&caps) != BLUR_SUCCESS) {
+        printf("Failed to initialize blur_lib\n");
+        return;
+    }
+    std::vector<HWND> windows = CreateWindows(windowCount);
+
+    std::vector<double> restoreTimes;
+    for (int r = 0; r < rounds; r++) {
+        int applied = ApplyAll(windows);
+        auto start = high_resolution_clock::now();
+        int32_t result = blur_restore_all();
+        double ms = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+        if (result == BLUR_SUCCESS) restoreTimes.push_back(ms);
+        if (r == 0) printf("Applied %d windows per round\n", applied);
+    }
+
+    if (!restoreTimes.empty()) {
+        printf("blur_restore_all:\n");
+        printf("  Min:  %.2f ms\n", *std::min_element(restoreTimes.begin(), restoreTimes.end()));
+        printf("  P50:  %.2f ms\n", CalculatePercentile(restoreTimes, 50));
+        printf("  Max:  %.2f ms\n", *std::max_element(restoreTimes.begin(), restoreTimes.end()));
+        printf("\n");
+    }
+
+    ApplyAll(windows);
+    auto start = high_resolution_clock::now();
+    blur_shutdown();
+    printf("blur_shutdown with %d blurred windows: %.2f ms\n",
+           (int)windows.size(), duration<double, std::milli>(high_resolution_clock::now() - start).count());
+
+    for (HWND w : windows) DestroyWindow(w);
+}
+
 int main(int argc, char* argv[]) {
     int iterations = 100;
     
@@ -183,6 +247,7 @@ int main(int argc, char* argv[]) {
     }
 
     RunBenchmark(iterations);
+    RunRestoreBenchmark(argc > 2 ? atoi(argv[2]) : 128, 10);
 
     printf("\nBenchmark complete.\n");
     return 0;
@@ -0,0 +1,602 @@
+/*
+ * benchmark_cpu.cpp - Performance benchmark for the portable CPU engine
+ *
+ * Runs on any platform. Reports per-frame time and peak working memory
+ * (surface plus engine scratch) for each blur mode.
+ */
+
+#include "capture_planner.h"
+#include "cpu_blur.h"
+#include "effect_graph.h"
+#include "executor.h"
+#include "region.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+double CalculatePercentile(std::vector<double>& data, double percentile) {
+    if (data.empty()) return 0.0;
+
+    std::sort(data.begin(), data.end());
+    size_t index = (size_t)((percentile / 100.0) * (data.size() - 1));
+    return data[index];
+}
+
+static void FillNoise(std::vector<uint8_t>& buf) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < buf.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+static double MiB(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+void RunStreamingBenchmark(int iterations) {
+    printf("\n=== Full-frame vs streaming blur ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    struct Size { int32_t w, h; const char* label; };
+    const Size sizes[] = {
+        { 1920, 1080, "1080p" },
+        { 3840, 2160, "4K" },
+        { 7680, 2160, "2x4K span" },
+    };
+    const float intensity = 0.5f;
+
+    BlurKernel kernel;
+    build_gaussian_kernel(sigma_from_intensity(intensity), &kernel);
+    printf("Intensity %.2f -> sigma %.1f, radius %d\n\n", intensity, kernel.sigma, kernel.radius);
+
+    for (const Size& sz : sizes) {
+        std::vector<uint8_t> pixels((size_t)sz.w * sz.h * 4);
+        FillNoise(pixels);
+        BlurSurface surface = { pixels.data(), sz.w, sz.h, sz.w * 4 };
+        size_t surface_bytes = pixels.size();
+
+        printf("%s (%dx%d):\n", sz.label, sz.w, sz.h);
+        printf("  D2D path peak (DIB + in + target + staging): %8.1f MiB\n", MiB(surface_bytes * 4));
+
+        const CpuBlurMode modes[] = { CPU_BLUR_FULL_FRAME, CPU_BLUR_STREAMING };
+        for (CpuBlurMode mode : modes) {
+            std::vector<double> times;
+            for (int i = 0; i < iterations; i++) {
+                auto start = high_resolution_clock::now();
+                cpu_blur(&surface, &surface, &kernel, mode);
+                auto end = high_resolution_clock::now();
+                times.push_back(duration<double, std::milli>(end - start).count());
+            }
+            size_t peak = surface_bytes + cpu_blur_scratch_bytes(sz.w, sz.h, kernel.radius, mode);
+            printf("  %-10s peak (DIB + scratch):         %8.1f MiB   P50 %7.2f ms\n",
+                   mode == CPU_BLUR_STREAMING ? "streaming" : "full-frame",
+                   MiB(peak), CalculatePercentile(times, 50));
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * User-space hardware counters of this thread (Linux perf_event_open). Any
+ * counter the PMU or perf_event_paranoid refuses reads as unavailable.
+ */
+class PerfCounters {
+public:
+    enum { L1D_MISSES, LLC_MISSES, DTLB_MISSES, COUNT };
+
+    PerfCounters() {
+        for (int i = 0; i < COUNT; i++) m_fd[i] = -1;
+#ifdef __linux__
+        const uint32_t types[COUNT] = { PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+        const uint64_t configs[COUNT] = {
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        };
+        for (int i = 0; i < COUNT; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            m_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int i = 0; i < COUNT; i++) if (m_fd[i] >= 0) close(m_fd[i]);
+#endif
+    }
+
+    bool available(int i) const { return m_fd[i] >= 0; }
+
+    void start() {
+#ifdef __linux__
+        for (int i = 0; i < COUNT; i++) {
+            if (m_fd[i] < 0) continue;
+            ioctl(m_fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /* Adds the counts since start() to totals */
+    void stop(uint64_t totals[COUNT]) {
+#ifdef __linux__
+        for (int i = 0; i < COUNT; i++) {
+            if (m_fd[i] < 0) continue;
+            ioctl(m_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t v = 0;
+            if (read(m_fd[i], &v, sizeof(v)) == (ssize_t)sizeof(v)) totals[i] += v;
+        }
+#else
+        (void)totals;
+#endif
+    }
+
+private:
+    int m_fd[COUNT];
+};
+
+void RunVerticalPassBenchmark(int iterations) {
+    printf("\n=== Vertical pass: row order vs blocked column strips (intensity 0.5) ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    struct Size { int32_t w, h; const char* label; };
+    const Size sizes[] = {
+        { 1920, 1080, "1080p" },
+        { 3840, 2160, "4K" },
+        { 7680, 2160, "2x4K span" },
+    };
+    BlurKernel kernel;
+    build_gaussian_kernel(sigma_from_intensity(0.5f), &kernel);
+
+    PerfCounters counters;
+    const char* names[PerfCounters::COUNT] = { "L1D miss", "LLC miss", "dTLB miss" };
+    printf("Counters per 1000 pixels:");
+    for (int c = 0; c < PerfCounters::COUNT; c++) {
+        printf(" %s%s", names[c], counters.available(c) ? "" : " (unavailable)");
+    }
+    printf("\n\n");
+
+    for (const Size& sz : sizes) {
+        std::vector<uint8_t> pixels((size_t)sz.w * sz.h * 4), out(pixels.size());
+        FillNoise(pixels);
+        BlurSurface src = { pixels.data(), sz.w, sz.h, sz.w * 4 };
+        BlurSurface dst = { out.data(), sz.w, sz.h, sz.w * 4 };
+        const double kpixels = (double)sz.w * sz.h / 1000.0;
+        printf("%s (%dx%d), radius %d:\n", sz.label, sz.w, sz.h, kernel.radius);
+
+        const CpuBlurMode modes[] = { CPU_BLUR_FULL_FRAME, CPU_BLUR_STREAMING };
+        const CpuVerticalOrder orders[] = { CPU_VERTICAL_ROWS, CPU_VERTICAL_BLOCKED };
+        for (CpuBlurMode mode : modes) {
+            for (CpuVerticalOrder order : orders) {
+                std::vector<double> times;
+                uint64_t totals[PerfCounters::COUNT] = {};
+                for (int i = 0; i < iterations; i++) {
+                    auto start = high_resolution_clock::now();
+                    counters.start();
+                    cpu_blur_taps(&src, &dst, kernel.weights.data(), kernel.radius, mode, 0, 0,
+                                  BLUR_TRANSFER_SRGB, order);
+                    counters.stop(totals);
+                    auto end = high_resolution_clock::now();
+                    times.push_back(duration<double, std::milli>(end - start).count());
+                }
+                double p50 = CalculatePercentile(times, 50);
+                printf("  %-10s %-7s P50 %8.2f ms  %7.1f Mpx/s ", mode == CPU_BLUR_STREAMING ? "streaming" : "full-frame",
+                       order == CPU_VERTICAL_ROWS ? "rows" : "blocked", p50, sz.w * (double)sz.h / p50 / 1000.0);
+                for (int c = 0; c < PerfCounters::COUNT; c++) {
+                    if (counters.available(c)) printf("  %s %8.1f", names[c], totals[c] / (double)iterations / kpixels);
+                }
+                printf("\n");
+            }
+        }
+        printf("\n");
+    }
+}
+
+void RunRegionBenchmark(int iterations) {
+    printf("\n=== Region-restricted blur (3840x2160 window) ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    const int32_t w = 3840, h = 2160;
+    std::vector<uint8_t> pixels((size_t)w * h * 4);
+    FillNoise(pixels);
+    BlurSurface surface = { pixels.data(), w, h, w * 4 };
+
+    BlurKernel kernel;
+    build_gaussian_kernel(sigma_from_intensity(0.5f), &kernel);
+
+    struct Case { const char* label; uint32_t count; BlurRect rects[2]; };
+    const Case cases[] = {
+        { "whole window", 0, {} },
+        { "sidebar 320px", 1, { { 0, 0, 320, h, 0 } } },
+        { "title strip 48px", 1, { { 0, 0, w, 48, 0 } } },
+        { "sidebar + title", 2, { { 0, 0, 320, h, 12 }, { 320, 0, w, 48, 0 } } },
+    };
+
+    for (const Case& c : cases) {
+        BlurRegionList_V1 list = {};
+        list.struct_version = 1;
+        list.rect_count = c.count;
+        for (uint32_t i = 0; i < c.count; i++) list.rects[i] = c.rects[i];
+
+        RegionBlurPlan plan;
+        plan_region_blur(&list, w, h, kernel.radius, &plan);
+
+        std::vector<double> times;
+        for (int i = 0; i < iterations; i++) {
+            auto start = high_resolution_clock::now();
+            cpu_blur_regions(&surface, &kernel, CPU_BLUR_STREAMING, &plan, 0);
+            auto end = high_resolution_clock::now();
+            times.push_back(duration<double, std::milli>(end - start).count());
+        }
+        printf("  %-18s blurred %5.1f%%  captured %5.1f%%   P50 %8.2f ms\n", c.label,
+               100.0 * region_area(plan.output) / ((double)w * h),
+               100.0 * region_area(plan.capture) / ((double)w * h),
+               CalculatePercentile(times, 50));
+    }
+}
+
+/*
+ * A partly covered window either keeps the GPU path, which captures and
+ * reads back the whole window on the tick thread, or blurs only its visible
+ * part on the CPU. Compares the tick-thread cost of the two per visible share:
+ * even a few percent of a window costs more to blur than the whole GPU path.
+ */
+void RunPartialVisibilityBenchmark(int iterations) {
+    printf("\n=== Partly covered 1920x1080 window: GPU path vs clipped CPU blur ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    const int32_t w = 1920, h = 1080;
+    std::vector<uint8_t> screen((size_t)w * h * 4), pixels(screen.size()), readback(screen.size());
+    FillNoise(screen);
+    BlurSurface surface = { pixels.data(), w, h, w * 4 };
+    BlurKernel kernel;
+    build_gaussian_kernel(sigma_from_intensity(0.5f), &kernel);
+
+    /* GPU path on the tick thread: capture the whole window, then copy the staging bitmap back */
+    std::vector<double> times;
+    for (int i = 0; i < iterations; i++) {
+        auto start = high_resolution_clock::now();
+        memcpy(pixels.data(), screen.data(), screen.size());
+        memcpy(readback.data(), pixels.data(), pixels.size());
+        times.push_back(duration<double, std::milli>(high_resolution_clock::now() - start).count());
+    }
+    double gpu_ms = CalculatePercentile(times, 50);
+    printf("  GPU path (capture + readback, any share): P50 %8.2f ms\n", gpu_ms);
+
+    const int32_t per_mille[] = { 900, 750, 500, 250, 100, 50, 20 };
+    for (int32_t pm : per_mille) {
+        /* The window's left part is visible; another window covers the rest */
+        std::vector<RegionRect> visible = { { 0, 0, (int32_t)((int64_t)w * pm / 1000), h } };
+        RegionBlurPlan plan;
+        plan_region_blur(nullptr, w, h, kernel.radius, &plan);
+        clip_region_plan(&plan, visible, w, h, kernel.radius);
+
+        times.clear();
+        for (int i = 0; i < iterations; i++) {
+            auto start = high_resolution_clock::now();
+            for (const RegionRect& r : plan.capture) {
+                for (int32_t y = r.top; y < r.bottom; y++) {
+                    size_t at = ((size_t)y * w + r.left) * 4;
+                    memcpy(pixels.data() + at, screen.data() + at, (size_t)(r.right - r.left) * 4);
+                }
+            }
+            cpu_blur_regions(&surface, &kernel, CPU_BLUR_FULL_FRAME, &plan, 0);
+            times.push_back(duration<double, std::milli>(high_resolution_clock::now() - start).count());
+        }
+        double cpu_ms = CalculatePercentile(times, 50);
+        printf("  visible %4.1f%%  clipped CPU P50 %8.2f ms  (%.1fx the GPU path)\n", pm / 10.0, cpu_ms,
+               cpu_ms / (gpu_ms > 0.0 ? gpu_ms : 1.0));
+    }
+}
+
+void RunAlgorithmBenchmark(int iterations) {
+    printf("\n=== Blur algorithms (1920x1080, intensity 0.5) ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    const int32_t w = 1920, h = 1080;
+    std::vector<uint8_t> pixels((size_t)w * h * 4), out(pixels.size()), ref(pixels.size());
+    FillNoise(pixels);
+    BlurSurface src = { pixels.data(), w, h, w * 4 };
+    BlurSurface dst = { out.data(), w, h, w * 4 };
+    BlurSurface exact_out = { ref.data(), w, h, w * 4 };
+    const float sigma = sigma_from_intensity(0.5f);
+
+    BlurKernel exact;
+    build_gaussian_kernel(sigma, &exact);
+    cpu_blur(&src, &exact_out, &exact, CPU_BLUR_STREAMING);
+
+    struct Case { const char* label; uint32_t algorithm; int32_t downsample; };
+    const Case cases[] = {
+        { "exact", BLUR_ALGORITHM_EXACT, 1 },
+        { "box", BLUR_ALGORITHM_BOX, 1 },
+        { "pyramid", BLUR_ALGORITHM_PYRAMID, 1 },
+        { "iir", BLUR_ALGORITHM_IIR, 1 },
+        { "exact / 2", BLUR_ALGORITHM_EXACT, 2 },
+        { "exact / 4", BLUR_ALGORITHM_EXACT, 4 },
+        { "box / 2", BLUR_ALGORITHM_BOX, 2 },
+    };
+    for (const Case& c : cases) {
+        BlurKernel kernel;
+        build_blur_kernel(sigma, c.algorithm, c.downsample, &kernel);
+
+        std::vector<double> times;
+        for (int i = 0; i < iterations; i++) {
+            auto start = high_resolution_clock::now();
+            cpu_blur(&src, &dst, &kernel, CPU_BLUR_STREAMING);
+            auto end = high_resolution_clock::now();
+            times.push_back(duration<double, std::milli>(end - start).count());
+        }
+        double err = 0.0;
+        for (size_t i = 0; i < out.size(); i++) err += abs((int)out[i] - (int)ref[i]);
+        printf("  %-10s P50 %8.2f ms   mean abs error vs exact %5.2f\n", c.label,
+               CalculatePercentile(times, 50), err / out.size());
+    }
+}
+
+/* Exact cost grows with sigma; the recursion should not */
+void RunSigmaSweepBenchmark(int iterations) {
+    printf("\n=== Exact vs IIR across sigmas (1920x1080) ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    const int32_t w = 1920, h = 1080;
+    std::vector<uint8_t> pixels((size_t)w * h * 4), out(pixels.size()), ref(pixels.size());
+    FillNoise(pixels);
+    BlurSurface src = { pixels.data(), w, h, w * 4 };
+    BlurSurface dst = { out.data(), w, h, w * 4 };
+    BlurSurface exact_out = { ref.data(), w, h, w * 4 };
+
+    const float sigmas[] = { 2.0f, 5.0f, 10.0f, 20.0f, 40.0f };
+    for (float sigma : sigmas) {
+        BlurKernel exact, iir;
+        build_gaussian_kernel(sigma, &exact);
+        build_blur_kernel(sigma, BLUR_ALGORITHM_IIR, 1, &iir);
+        double p50[2];
+        const BlurKernel* kernels[2] = { &exact, &iir };
+        for (int k = 0; k < 2; k++) {
+            std::vector<double> times;
+            for (int i = 0; i < iterations; i++) {
+                auto start = high_resolution_clock::now();
+                cpu_blur(&src, k ? &dst : &exact_out, kernels[k], CPU_BLUR_FULL_FRAME);
+                auto end = high_resolution_clock::now();
+                times.push_back(duration<double, std::milli>(end - start).count());
+            }
+            p50[k] = CalculatePercentile(times, 50);
+        }
+        int worst = 0;
+        for (size_t i = 0; i < out.size(); i++) worst = std::max(worst, abs((int)out[i] - (int)ref[i]));
+        printf("  sigma %4.0f   exact P50 %8.2f ms   iir P50 %8.2f ms (%.2fx)   largest difference %d\n", sigma,
+               p50[0], p50[1], p50[0] / p50[1], worst);
+    }
+}
+
+void RunLinearLightBenchmark(int iterations) {
+    printf("\n=== sRGB vs linear-light blur (1920x1080, intensity 0.5) ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    const int32_t w = 1920, h = 1080;
+    std::vector<uint8_t> pixels((size_t)w * h * 4), out(pixels.size());
+    FillNoise(pixels);
+    BlurSurface src = { pixels.data(), w, h, w * 4 };
+    BlurSurface dst = { out.data(), w, h, w * 4 };
+
+    BlurKernel kernel;
+    build_gaussian_kernel(sigma_from_intensity(0.5f), &kernel);
+    const uint32_t transfers[] = { BLUR_TRANSFER_SRGB, BLUR_TRANSFER_LINEAR };
+    double srgb_ms = 0.0;
+    for (uint32_t transfer : transfers) {
+        kernel_set_linear_light(&kernel, transfer == BLUR_TRANSFER_LINEAR);
+        const CpuBlurMode modes[] = { CPU_BLUR_FULL_FRAME, CPU_BLUR_STREAMING };
+        for (CpuBlurMode mode : modes) {
+            std::vector<double> times;
+            for (int i = 0; i < iterations; i++) {
+                auto start = high_resolution_clock::now();
+                cpu_blur(&src, &dst, &kernel, mode);
+                auto end = high_resolution_clock::now();
+                times.push_back(duration<double, std::milli>(end - start).count());
+            }
+            double p50 = CalculatePercentile(times, 50);
+            if (transfer == BLUR_TRANSFER_SRGB && mode == CPU_BLUR_STREAMING) srgb_ms = p50;
+            printf("  %-7s %-10s P50 %8.2f ms   scratch %6.1f MiB", transfer == BLUR_TRANSFER_SRGB ? "sRGB" : "linear",
+                   mode == CPU_BLUR_STREAMING ? "streaming" : "full-frame", p50,
+                   MiB(cpu_blur_scratch_bytes(w, h, kernel.radius, mode, transfer)));
+            if (transfer == BLUR_TRANSFER_LINEAR && mode == CPU_BLUR_STREAMING && srgb_ms > 0.0) {
+                printf("   (%.2fx sRGB)", p50 / srgb_ms);
+            }
+            printf("\n");
+        }
+    }
+}
+
+void RunEffectGraphBenchmark(int iterations) {
+    printf("\n=== Acrylic effect graph: a pass per node vs fused (1920x1080, intensity 0.5) ===\n");
+    printf("Iterations: %d\n\n", iterations);
+
+    const int32_t w = 1920, h = 1080;
+    std::vector<uint8_t> pixels((size_t)w * h * 4), work(pixels.size()), ref(pixels.size());
+    FillNoise(pixels);
+    BlurSurface surface = { work.data(), w, h, w * 4 };
+
+    /* Blur, saturation, luminosity blend, tint, noise, vignette */
+    BlurEffectList_V1 list = {};
+    list.struct_version = 1;
+    list.effect_count = 5;
+    list.effects[0] = { BLUR_EFFECT_SATURATION, 0, 1.25f, 0 };
+    list.effects[1] = { BLUR_EFFECT_LUMINOSITY, 0x99303040, 0.0f, 0 };
+    list.effects[2] = { BLUR_EFFECT_TINT, 0x40102038, 0.0f, 0 };
+    list.effects[3] = { BLUR_EFFECT_NOISE, 0, 0.02f, 0 };
+    list.effects[4] = { BLUR_EFFECT_VIGNETTE, 0, 0.3f, 0 };
+    EffectProgram prog;
+    compile_effect_graph(&list, &prog);
+
+    const uint32_t algorithms[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_IIR };
+    const char* names[] = { "exact", "iir" };
+    const char* modes[] = { "pass per node", "one effect pass", "fused into blur" };
+    for (int a = 0; a < 2; a++) {
+        BlurKernel kernel;
+        build_blur_kernel(sigma_from_intensity(0.5f), algorithms[a], 1, &kernel);
+        RegionBlurPlan plan;
+        plan_region_blur(nullptr, w, h, kernel.radius, &plan);
+
+        double base = 0.0;
+        for (int m = 0; m < 3; m++) {
+            std::vector<double> times;
+            for (int i = 0; i < iterations; i++) {
+                memcpy(work.data(), pixels.data(), pixels.size());
+                auto start = high_resolution_clock::now();
+                if (m == 2) {
+                    cpu_blur_regions(&surface, &kernel, CPU_BLUR_FULL_FRAME, &plan, 0, &prog);
+                } else {
+                    cpu_blur_regions(&surface, &kernel, CPU_BLUR_FULL_FRAME, &plan, 0);
+                    for (const RegionRect& r : plan.output) apply_effect_program(&prog, &surface, r, m == 1);
+                }
+                auto end = high_resolution_clock::now();
+                times.push_back(duration<double, std::milli>(end - start).count());
+            }
+            if (m == 0) ref = work;
+            double p50 = CalculatePercentile(times, 50);
+            if (m == 0) base = p50;
+            printf("  %-6s %-16s P50 %8.2f ms (%.2fx)   %s\n", names[a], modes[m], p50, base / p50,
+                   work == ref ? "same output" : "OUTPUT DIFFERS");
+        }
+    }
+}
+
+/* Noise "desktop" for refresh ticks; each thread needs its own */
+class NoiseSource : public CaptureSource {
+public:
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        int32_t w = bounds.right - bounds.left, h = bounds.bottom - bounds.top;
+        if (m_pixels.size() < (size_t)w * h * 4) {
+            m_pixels.resize((size_t)w * h * 4);
+            FillNoise(m_pixels);
+        }
+        BlurSurface f = { m_pixels.data(), w, h, w * 4 };
+        *frame = f;
+        return BLUR_SUCCESS;
+    }
+    void capture(const RegionRect&) override {}
+    void end_frame() override {}
+
+private:
+    std::vector<uint8_t> m_pixels;
+};
+
+/* Non-overlapping windows of one tick, with their kernels and targets */
+struct BenchTick {
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+
+    BenchTick(int32_t count, int32_t w, int32_t h, float intensity, uint32_t lane)
+        : kernels(count), targets(count), windows(count) {
+        for (int32_t i = 0; i < count; i++) {
+            build_gaussian_kernel(sigma_from_intensity(intensity), &kernels[i]);
+            targets[i].resize((size_t)w * h * 4);
+            TickWindow& tw = windows[i];
+            tw.handle = (uintptr_t)(i + 1);
+            tw.screen = { i * (w + 100), 0, i * (w + 100) + w, h };
+            plan_region_blur(nullptr, w, h, kernels[i].radius, &tw.plan);
+            tw.kernel = &kernels[i];
+            tw.color_argb = 0;
+            tw.mode = CPU_BLUR_STREAMING;
+            tw.target = { targets[i].data(), w, h, w * 4 };
+            tw.lane = lane;
+        }
+    }
+
+    void run(NoiseSource* source) {
+        TickStats stats;
+        run_shared_tick(windows.data(), windows.size(), source, &stats);
+    }
+};
+
+/*
+ * Latency of the focused window's tick while other windows' refreshes keep
+ * every worker busy. Queued background bands wait behind interactive ones, so
+ * on a machine with spare cores the focused tick stays close to its idle time;
+ * with one lane it queues behind the background bands instead.
+ */
+void RunExecutorBenchmark(int iterations) {
+    executor_start(0);
+    printf("\n=== Interactive tick latency under background load (640x480 focused, 4x 1280x720 background, %u workers) ===\n",
+           executor_workers());
+
+    const int ticks = iterations * 8;
+    NoiseSource source;
+    BenchTick focused(1, 640, 480, 0.3f, EXECUTOR_LANE_INTERACTIVE);
+    const char* names[] = { "idle", "background load", "background load, one lane" };
+    for (int scenario = 0; scenario < 3; scenario++) {
+        for (TickWindow& tw : focused.windows) {
+            tw.lane = scenario == 2 ? EXECUTOR_LANE_BACKGROUND : EXECUTOR_LANE_INTERACTIVE;
+        }
+
+        /* Refreshes of other windows, back to back from their own timer thread */
+        std::atomic<bool> stop(false);
+        std::thread background;
+        if (scenario > 0) {
+            background = std::thread([&stop]() {
+                NoiseSource bg_source;
+                BenchTick bg(4, 1280, 720, 0.5f, EXECUTOR_LANE_BACKGROUND);
+                while (!stop.load()) bg.run(&bg_source);
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        std::vector<double> times;
+        for (int i = 0; i < ticks; i++) {
+            auto start = high_resolution_clock::now();
+            focused.run(&source);
+            times.push_back(duration<double, std::milli>(high_resolution_clock::now() - start).count());
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        stop = true;
+        if (background.joinable()) background.join();
+        printf("  %-26s P50 %8.2f ms   P99 %8.2f ms\n", names[scenario],
+               CalculatePercentile(times, 50), CalculatePercentile(times, 99));
+    }
+    executor_stop();
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = 5;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations < 1) iterations = 5;
+    }
+
+    RunStreamingBenchmark(iterations);
+    RunVerticalPassBenchmark(iterations);
+    RunRegionBenchmark(iterations);
+    RunPartialVisibilityBenchmark(iterations);
+    RunAlgorithmBenchmark(iterations);
+    RunSigmaSweepBenchmark(iterations);
+    RunLinearLightBenchmark(iterations);
+    RunEffectGraphBenchmark(iterations);
+    RunExecutorBenchmark(iterations);
+
+    printf("\nBenchmark complete.\n");
+    return 0;
+}
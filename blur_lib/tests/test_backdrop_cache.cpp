@@ -0,0 +1,244 @@
+/*
+ * test_backdrop_cache.cpp - Tests for backdrop reuse while windows move
+ */
+
+#include "capture_planner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* Deterministic, static "desktop" colour of a screen pixel */
+static uint8_t screen_byte(int32_t x, int32_t y, int32_t ch) {
+    uint32_t v = (uint32_t)(x * 73856093) ^ (uint32_t)(y * 19349663) ^ (uint32_t)(ch * 83492791);
+    return (uint8_t)(v >> 7);
+}
+
+class PatternSource : public CaptureSource {
+public:
+    int64_t pixels_captured = 0;
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        m_bounds = bounds;
+        m_pixels.assign((size_t)rect_area(bounds) * 4, 0);
+        BlurSurface f = { m_pixels.data(), bounds.right - bounds.left, bounds.bottom - bounds.top,
+                          (bounds.right - bounds.left) * 4 };
+        m_frame = *frame = f;
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& area) override {
+        for (int32_t y = area.top; y < area.bottom; y++) {
+            for (int32_t x = area.left; x < area.right; x++) {
+                uint8_t* p = m_frame.pixels + (size_t)(y - m_bounds.top) * m_frame.stride +
+                             (size_t)(x - m_bounds.left) * 4;
+                for (int32_t ch = 0; ch < 4; ch++) p[ch] = screen_byte(x, y, ch);
+            }
+        }
+        pixels_captured += rect_area(area);
+    }
+
+    void end_frame() override {}
+
+private:
+    RegionRect m_bounds;
+    BlurSurface m_frame;
+    std::vector<uint8_t> m_pixels;
+};
+
+/* One window at a time; the target is resized with the window */
+struct Window {
+    BlurKernel kernel;
+    std::vector<uint8_t> pixels;
+    TickWindow tick;
+    const BlurRegionList_V1* regions = nullptr;
+
+    void place(const RegionRect& screen) {
+        int32_t w = screen.right - screen.left, h = screen.bottom - screen.top;
+        pixels.assign((size_t)w * h * 4, 0);
+        tick.handle = 1;
+        tick.screen = screen;
+        plan_region_blur(regions, w, h, kernel.radius, &tick.plan);
+        tick.kernel = &kernel;
+        tick.color_argb = 0x40204060;
+        tick.mode = CPU_BLUR_STREAMING;
+        BlurSurface t = { pixels.data(), w, h, w * 4 };
+        tick.target = t;
+    }
+
+    int32_t run(CaptureSource* source, TickStats* stats) {
+        return run_shared_tick(&tick, 1, source, stats);
+    }
+};
+
+/* Moves a cached window to screen and compares it with a window blurred from scratch there */
+static bool matches_full_tick(Window* cached, BlurKernel kernel, const RegionRect& screen, TickStats* stats) {
+    PatternSource src;
+    cached->place(screen);
+    if (cached->run(&src, stats) != BLUR_SUCCESS) return false;
+
+    Window fresh;
+    fresh.kernel = kernel;
+    fresh.regions = cached->regions;
+    fresh.place(screen);
+    TickStats full;
+    PatternSource fsrc;
+    if (fresh.run(&fsrc, &full) != BLUR_SUCCESS) return false;
+    if (fresh.pixels != cached->pixels) {
+        printf("  moved to (%d,%d)-(%d,%d): output differs from a full tick\n",
+               screen.left, screen.top, screen.right, screen.bottom);
+        return false;
+    }
+    return true;
+}
+
+int test_drag_matches_full_tick() {
+    const uint32_t algorithms[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX };
+    for (uint32_t algorithm : algorithms) {
+        Window win;
+        BackdropCache cache;
+        build_blur_kernel(6.0f, algorithm, 1, &win.kernel);
+        win.tick.backdrop = &cache;
+
+        PatternSource src;
+        TickStats stats;
+        RegionRect at = { 100, 80, 420, 320 };
+        win.place(at);
+        TEST_ASSERT(win.run(&src, &stats) == BLUR_SUCCESS && stats.pixels_reused == 0,
+                    "The first tick blurs in full");
+        TEST_ASSERT(win.run(&src, &stats) == BLUR_SUCCESS && stats.pixels_reused == 0,
+                    "A window that did not move is blurred in full");
+
+        /* A drag: small steps in every direction, then a jump past the old rect */
+        const int32_t steps[][2] = { { 7, 3 }, { -12, 5 }, { 0, -9 }, { 25, 0 }, { -4, -4 }, { 400, 0 } };
+        for (const auto& d : steps) {
+            at = { at.left + d[0], at.top + d[1], at.right + d[0], at.bottom + d[1] };
+            if (!matches_full_tick(&win, win.kernel, at, &stats)) {
+                TEST_ASSERT(false, "A dragged window matches a full tick");
+            }
+        }
+        TEST_ASSERT(true, algorithm == BLUR_ALGORITHM_EXACT ? "Dragging with the exact kernel matches full ticks"
+                                                            : "Dragging with the box kernel matches full ticks");
+        TEST_ASSERT(stats.pixels_reused == 0, "A jump past the old rect reuses nothing");
+    }
+    return 0;
+}
+
+int test_resize_matches_full_tick() {
+    Window win;
+    BackdropCache cache;
+    build_gaussian_kernel(5.0f, &win.kernel);
+    win.tick.backdrop = &cache;
+
+    PatternSource src;
+    TickStats stats;
+    win.place({ 50, 50, 350, 250 });
+    win.run(&src, &stats);
+
+    const RegionRect sizes[] = {
+        { 50, 50, 380, 250 },       /* Grow from the right edge */
+        { 30, 50, 380, 270 },       /* Grow from the left and bottom */
+        { 30, 90, 300, 270 },       /* Shrink from the top and right */
+        { 35, 95, 305, 275 },       /* Then move */
+    };
+    for (const RegionRect& r : sizes) {
+        if (!matches_full_tick(&win, win.kernel, r, &stats)) {
+            TEST_ASSERT(false, "A resized window matches a full tick");
+        }
+        TEST_ASSERT(stats.pixels_reused > 0, "Resizing reuses the overlapping area");
+    }
+
+    /* Region plans reuse only the regions, and a kernel change starts over */
+    BlurRegionList_V1 list = {};
+    list.struct_version = 1;
+    list.rect_count = 2;
+    list.rects[0] = { 10, 10, 150, 90, 12 };
+    list.rects[1] = { 100, 60, 260, 170, 0 };
+    win.regions = &list;
+    win.place({ 35, 95, 305, 275 });
+    win.run(&src, &stats);
+    TEST_ASSERT(matches_full_tick(&win, win.kernel, { 40, 90, 310, 270 }, &stats) && stats.pixels_reused > 0,
+                "A moved region plan matches a full tick");
+
+    build_gaussian_kernel(9.0f, &win.kernel);
+    TEST_ASSERT(matches_full_tick(&win, win.kernel, { 45, 90, 315, 270 }, &stats) && stats.pixels_reused == 0,
+                "A new kernel blurs in full");
+    return 0;
+}
+
+int test_drag_cost() {
+    Window win, fresh;
+    BackdropCache cache;
+    build_gaussian_kernel(sigma_from_intensity(0.5f), &win.kernel);
+    fresh.kernel = win.kernel;
+    win.tick.backdrop = &cache;
+
+    RegionRect at = { 0, 0, 1280, 720 };
+    PatternSource src;
+    TickStats stats;
+    win.place(at);
+    win.run(&src, &stats);
+    fresh.place(at);
+
+    typedef std::chrono::steady_clock Clock;
+    double full_ms = 0.0, drag_ms = 0.0;
+    int64_t full_blurred = 0, drag_blurred = 0, full_captured = 0, drag_captured = 0;
+    const int ticks = 6;
+    for (int i = 0; i < ticks; i++) {
+        at = { at.left + 6, at.top + 4, at.right + 6, at.bottom + 4 };
+
+        PatternSource s1;
+        fresh.place(at);
+        Clock::time_point t0 = Clock::now();
+        fresh.run(&s1, &stats);
+        full_ms += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        full_blurred += stats.pixels_blur_computed;
+        full_captured += s1.pixels_captured;
+
+        PatternSource s2;
+        win.place(at);
+        t0 = Clock::now();
+        win.run(&s2, &stats);
+        drag_ms += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        drag_blurred += stats.pixels_blur_computed;
+        drag_captured += s2.pixels_captured;
+    }
+    printf("  1280x720 drag tick: %.2f ms vs %.2f ms full, blurred %.1f%%, captured %.1f%%\n",
+           drag_ms / ticks, full_ms / ticks, 100.0 * drag_blurred / full_blurred,
+           100.0 * drag_captured / full_captured);
+    TEST_ASSERT(drag_blurred * 5 < full_blurred, "A drag tick blurs a small fraction of a full tick");
+    TEST_ASSERT(drag_captured * 3 < full_captured, "A drag tick captures a fraction of a full tick");
+    TEST_ASSERT(drag_ms < full_ms * 0.5, "A drag tick takes a fraction of the time of a full tick");
+    return 0;
+}
+
+int main() {
+    printf("=== backdrop_cache Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: drag_matches_full_tick\n");
+    failures += test_drag_matches_full_tick();
+    printf("\n");
+
+    printf("Test: resize_matches_full_tick\n");
+    failures += test_resize_matches_full_tick();
+    printf("\n");
+
+    printf("Test: drag_cost\n");
+    failures += test_drag_cost();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
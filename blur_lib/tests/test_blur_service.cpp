@@ -0,0 +1,401 @@
+/*
+ * test_blur_service.cpp - Tests for the shared-memory blur service
+ */
+
+#include "blur_service.h"
+#include "kernel_cache.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* Deterministic "desktop" colour of a screen pixel */
+static uint8_t screen_byte(int32_t x, int32_t y, int32_t ch) {
+    uint32_t v = (uint32_t)(x * 73856093) ^ (uint32_t)(y * 19349663) ^ (uint32_t)(ch * 83492791);
+    return (uint8_t)(v >> 7);
+}
+
+class PatternSource : public CaptureSource {
+public:
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        m_bounds = bounds;
+        m_pixels.assign((size_t)rect_area(bounds) * 4, 0);
+        BlurSurface f = { m_pixels.data(), bounds.right - bounds.left, bounds.bottom - bounds.top,
+                          (bounds.right - bounds.left) * 4 };
+        m_frame = *frame = f;
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& area) override {
+        for (int32_t y = area.top; y < area.bottom; y++) {
+            for (int32_t x = area.left; x < area.right; x++) {
+                uint8_t* p = m_frame.pixels + (size_t)(y - m_bounds.top) * m_frame.stride +
+                             (size_t)(x - m_bounds.left) * 4;
+                for (int32_t ch = 0; ch < 4; ch++) p[ch] = screen_byte(x, y, ch);
+            }
+        }
+    }
+
+    void end_frame() override {}
+
+private:
+    RegionRect m_bounds;
+    BlurSurface m_frame;
+    std::vector<uint8_t> m_pixels;
+};
+
+/* Ticks the host on its own thread, the way a host process's loop would */
+class HostLoop {
+public:
+    explicit HostLoop(ServiceHost* host) : m_host(host), m_stop(false) {
+        m_thread = std::thread([this] {
+            while (!m_stop.load()) {
+                m_host->tick(service_now_us());
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    ~HostLoop() { join(); }
+
+    void join() {
+        m_stop.store(true);
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+private:
+    ServiceHost* m_host;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+static std::string service_name(const char* test) {
+    return std::string("blur_service_test_") + test + "_" + std::to_string(getpid());
+}
+
+static EffectParams_V2 make_params(float intensity, uint32_t color) {
+    EffectParams_V2 p = {};
+    p.struct_version = 2;
+    p.intensity = intensity;
+    p.color_argb = color;
+    p.max_refresh_hz = 60;
+    return p;
+}
+
+/* What a private capture plus cpu_blur_regions() gives a window at screen */
+static std::vector<uint8_t> render_alone(const RegionRect& screen, const EffectParams_V2& params) {
+    int32_t w = screen.right - screen.left, h = screen.bottom - screen.top;
+    BlurKernel fallback;
+    const BlurKernel* k = get_blur_kernel(sigma_from_intensity(params.intensity), BLUR_ALGORITHM_EXACT, 1, false, &fallback);
+    RegionBlurPlan plan;
+    plan_region_blur(nullptr, w, h, k->radius, &plan);
+    std::vector<uint8_t> buf((size_t)w * h * 4, 0);
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            for (int32_t ch = 0; ch < 4; ch++) buf[((size_t)y * w + x) * 4 + ch] = screen_byte(screen.left + x, screen.top + y, ch);
+        }
+    }
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+    cpu_blur_regions(&s, k, CPU_BLUR_FULL_FRAME, &plan, params.color_argb);
+    return buf;
+}
+
+/* Waits up to a second for a frame newer than *frame */
+static int32_t wait_frame(ServiceClient* client, uint64_t handle, uint32_t slot, std::vector<uint8_t>* out,
+                          const RegionRect& screen, uint64_t* frame) {
+    int32_t w = screen.right - screen.left, h = screen.bottom - screen.top;
+    out->assign((size_t)w * h * 4, 0);
+    BlurSurface dst = { out->data(), w, h, w * 4 };
+    int32_t result = BLUR_TIMEOUT;
+    for (int i = 0; i < 1000 && result == BLUR_TIMEOUT; i++) {
+        result = client->read_frame(handle, slot, &dst, frame);
+        if (result == BLUR_TIMEOUT) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return result;
+}
+
+int test_layout() {
+    TEST_ASSERT(SERVICE_MAX_PARAMS_BYTES >= sizeof(EffectParams_V2) + sizeof(BlurRegionList_V1) + sizeof(BlurEffectList_V1),
+                "Commands hold V2 params with both trailing lists");
+    size_t one = service_segment_bytes(1, 1, 4);
+    size_t two = service_segment_bytes(2, 1, 4);
+    TEST_ASSERT(two - one == sizeof(ServiceClientBlock) + SERVICE_SLOT_HEADER_BYTES + 64,
+                "A client costs one block and its slots");
+    TEST_ASSERT(service_segment_bytes(1, 2, 1000) - service_segment_bytes(1, 1, 1000) == SERVICE_SLOT_HEADER_BYTES + 1024,
+                "Slots are 64-byte aligned");
+
+    SharedSegment a, b;
+    std::string name = service_name("layout");
+    TEST_ASSERT(a.create(name.c_str(), 4096) == BLUR_SUCCESS, "Segments can be created");
+    TEST_ASSERT(a.create(name.c_str(), 4096) == BLUR_SUCCESS && b.create(name.c_str(), 4096) == BLUR_ALREADY_APPLIED,
+                "A name is created once");
+    TEST_ASSERT(b.open(name.c_str()) == BLUR_SUCCESS && b.size() == 4096 && b.data() != a.data(),
+                "Opening maps the same segment at another address");
+    a.data()[100] = 42;
+    TEST_ASSERT(b.data()[100] == 42, "Both mappings see the same bytes");
+    a.close();
+    SharedSegment c;
+    TEST_ASSERT(c.open(name.c_str()) == BLUR_NOT_INITIALIZED, "Closing the creator removes the name");
+    TEST_ASSERT(c.create("bad/name", 4096) == BLUR_INVALID_PARAMS, "Names are single path components");
+    return 0;
+}
+
+int test_apply_and_frames() {
+    PatternSource source;
+    ServiceHost host;
+    ServiceHostOptions options;
+    options.slot_bytes = 256 * 256 * 4;
+    std::string name = service_name("frames");
+    TEST_ASSERT(host.start(name.c_str(), options, &source) == BLUR_SUCCESS, "Host starts");
+    ServiceHost second;
+    TEST_ASSERT(second.start(name.c_str(), options, &source) == BLUR_ALREADY_APPLIED,
+                "A second host cannot take a live host's name");
+
+    HostLoop loop(&host);
+    ServiceClient a, b;
+    TEST_ASSERT(a.attach(name.c_str()) == BLUR_SUCCESS && b.attach(name.c_str()) == BLUR_SUCCESS,
+                "Two clients attach");
+
+    /* Overlapping windows of different clients */
+    RegionRect ra = { 100, 100, 260, 220 }, rb = { 180, 150, 340, 300 };
+    EffectParams_V2 pa = make_params(0.3f, 0), pb = make_params(0.5f, 0x40FF0000);
+    uint32_t sa = 99, sb = 99;
+    TEST_ASSERT(a.apply(11, ra, (const EffectParams*)&pa, 1000, &sa) == BLUR_SUCCESS, "Client A applies");
+    TEST_ASSERT(b.apply(22, rb, (const EffectParams*)&pb, 1000, &sb) == BLUR_SUCCESS, "Client B applies");
+    TEST_ASSERT(sa == 0 && sb == 0, "Each client's first window takes its first slot");
+
+    std::vector<uint8_t> fa, fb;
+    uint64_t na = 0, nb = 0;
+    TEST_ASSERT(wait_frame(&a, 11, sa, &fa, ra, &na) == BLUR_SUCCESS && na >= 1, "A's frame is ready after its apply");
+    TEST_ASSERT(wait_frame(&b, 22, sb, &fb, rb, &nb) == BLUR_SUCCESS, "B's frame is ready");
+    TEST_ASSERT(fa == render_alone(ra, pa), "A's frame matches a private capture and blur");
+    TEST_ASSERT(fb == render_alone(rb, pb), "B's frame matches a private capture and blur");
+
+    uint64_t later = na;
+    TEST_ASSERT(wait_frame(&a, 11, sa, &fa, ra, &later) == BLUR_SUCCESS && later > na, "Windows keep refreshing");
+    std::vector<uint8_t> small(4, 0);
+    BlurSurface tiny = { small.data(), 1, 1, 4 };
+    uint64_t none = 0;
+    TEST_ASSERT(a.read_frame(11, sa, &tiny, &none) == BLUR_INVALID_PARAMS, "Frames do not fit smaller surfaces");
+
+    /* Moving re-renders at the new rect */
+    RegionRect moved = { 120, 110, 280, 230 };
+    TEST_ASSERT(a.move(11, moved, 1000) == BLUR_SUCCESS, "Moves succeed");
+    uint64_t before_move = later;
+    std::vector<uint8_t> fm;
+    bool found = false;
+    for (int i = 0; i < 50 && !found; i++) {
+        if (wait_frame(&a, 11, sa, &fm, moved, &later) != BLUR_SUCCESS) break;
+        found = later > before_move && fm == render_alone(moved, pa);
+    }
+    TEST_ASSERT(found, "A moved window's frames follow it");
+
+    TEST_ASSERT(a.clear(11, 1000) == BLUR_SUCCESS && b.clear(22, 1000) == BLUR_SUCCESS, "Clears succeed");
+    TEST_ASSERT(a.read_frame(11, sa, &tiny, &none) == BLUR_INVALID_HANDLE, "A cleared window's slot is empty");
+    loop.join();
+
+    ServiceHostStats st = host.stats();
+    printf("  %llu ticks, %llu frames, %lld of %lld capture pixels copied\n", (unsigned long long)st.ticks,
+           (unsigned long long)st.frames, (long long)st.shared.pixels_captured, (long long)st.shared.pixels_requested);
+    TEST_ASSERT(st.shared.pixels_captured < st.shared.pixels_requested, "Overlapping windows of two clients share captures");
+    TEST_ASSERT(host.window_count() == 0 && st.clients_attached == 2, "Every window is gone");
+    return 0;
+}
+
+int test_ownership() {
+    PatternSource source;
+    ServiceHost host;
+    ServiceHostOptions options;
+    options.slot_bytes = 64 * 64 * 4;
+    std::string name = service_name("owners");
+    host.start(name.c_str(), options, &source);
+    HostLoop loop(&host);
+
+    ServiceClient a, b;
+    a.attach(name.c_str());
+    b.attach(name.c_str());
+    RegionRect r = { 0, 0, 64, 64 };
+    EffectParams_V2 p = make_params(0.2f, 0);
+    uint32_t slot = 0;
+    TEST_ASSERT(a.apply(7, r, (const EffectParams*)&p, 1000, &slot) == BLUR_SUCCESS, "A owns handle 7");
+    TEST_ASSERT(b.apply(7, r, (const EffectParams*)&p, 1000, nullptr) == BLUR_PERMISSION_DENIED,
+                "B cannot apply to A's handle");
+    TEST_ASSERT(b.move(7, r, 1000) == BLUR_PERMISSION_DENIED, "B cannot move A's handle");
+    TEST_ASSERT(b.clear(7, 1000) == BLUR_PERMISSION_DENIED, "B cannot clear A's handle");
+    TEST_ASSERT(b.move(8, r, 1000) == BLUR_INVALID_HANDLE, "Moving an unknown handle fails");
+    TEST_ASSERT(b.clear(8, 1000) == BLUR_SUCCESS, "Clearing an unknown handle succeeds");
+    TEST_ASSERT(a.apply(7, r, (const EffectParams*)&p, 1000, &slot) == BLUR_SUCCESS, "A may re-apply its own handle");
+
+    a.detach();
+    bool freed = false;
+    for (int i = 0; i < 1000 && !freed; i++) {
+        freed = b.apply(7, r, (const EffectParams*)&p, 1000, nullptr) == BLUR_SUCCESS;
+        if (!freed) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TEST_ASSERT(freed, "A detaching hands its handles back");
+    TEST_ASSERT(a.clear(7, 1000) == BLUR_NOT_INITIALIZED, "A detached client cannot send commands");
+    loop.join();
+    TEST_ASSERT(host.stats().denied == 3, "The host counts denied commands");
+    return 0;
+}
+
+int test_limits() {
+    std::string name = service_name("limits");
+    ServiceClient c;
+    TEST_ASSERT(c.attach(name.c_str()) == BLUR_NOT_INITIALIZED, "Attaching without a host fails");
+
+    PatternSource source;
+    ServiceHost host;
+    ServiceHostOptions options;
+    options.max_clients = 2;
+    options.slots_per_client = 2;
+    options.slot_bytes = 32 * 32 * 4;
+    TEST_ASSERT(host.start(name.c_str(), options, &source) == BLUR_SUCCESS, "Host starts");
+
+    /* No tick runs yet: commands wait for the host */
+    TEST_ASSERT(c.attach(name.c_str()) == BLUR_SUCCESS, "Client attaches");
+    RegionRect r = { 0, 0, 32, 32 };
+    EffectParams_V2 p = make_params(0.2f, 0);
+    TEST_ASSERT(c.apply(1, r, (const EffectParams*)&p, 20, nullptr) == BLUR_TIMEOUT, "Calls time out while the host is busy");
+
+    HostLoop loop(&host);
+    ServiceClient d, e;
+    TEST_ASSERT(d.attach(name.c_str()) == BLUR_SUCCESS && e.attach(name.c_str()) == BLUR_OUT_OF_MEMORY,
+                "Clients beyond max_clients are refused");
+    TEST_ASSERT(c.apply(1, r, (const EffectParams*)&p, 1000, nullptr) == BLUR_SUCCESS,
+                "A command after a timed-out one gets its own reply");
+    TEST_ASSERT(c.apply(2, r, (const EffectParams*)&p, 1000, nullptr) == BLUR_SUCCESS, "Second slot");
+    TEST_ASSERT(c.apply(3, r, (const EffectParams*)&p, 1000, nullptr) == BLUR_OUT_OF_MEMORY,
+                "Windows beyond slots_per_client are refused");
+    RegionRect big = { 0, 0, 33, 32 };
+    TEST_ASSERT(c.move(1, big, 1000) == BLUR_OUT_OF_MEMORY, "Windows larger than a slot are refused");
+    RegionRect empty = { 5, 5, 5, 9 };
+    TEST_ASSERT(c.move(1, empty, 1000) == BLUR_INVALID_PARAMS, "Empty rects are refused");
+
+    EffectParams_V2 bad = make_params(0.2f, 0);
+    bad.reserved_v2[0] = 1;
+    TEST_ASSERT(c.apply(2, r, (const EffectParams*)&bad, 1000, nullptr) == BLUR_INVALID_PARAMS,
+                "The host validates params");
+    bad = make_params(0.2f, 0);
+    bad.struct_version = 3;
+    TEST_ASSERT(c.apply(2, r, (const EffectParams*)&bad, 1000, nullptr) == BLUR_INVALID_PARAMS,
+                "Unknown param versions are refused");
+
+    EffectParamsEffects_V2 fx = {};
+    fx.params = make_params(0.2f, 0);
+    fx.params.reserved_flags = BLUR_PARAMS_FLAG_EFFECTS;
+    fx.effects.struct_version = 1;
+    fx.effects.effect_count = 1;
+    fx.effects.effects[0].type = BLUR_EFFECT_SATURATION;
+    fx.effects.effects[0].amount = 0.0f;
+    TEST_ASSERT(c.apply(2, r, (const EffectParams*)&fx, 1000, nullptr) == BLUR_SUCCESS,
+                "Trailing effect lists travel with the params");
+    loop.join();
+
+    /* A host speaking another protocol version */
+    SharedSegment raw;
+    raw.open(name.c_str());
+    ((ServiceHeader*)raw.data())->version = SERVICE_PROTOCOL_VERSION + 1;
+    c.detach();
+    ServiceClient f;
+    host.poll(service_now_us());
+    TEST_ASSERT(f.attach(name.c_str()) == BLUR_API_UNSUPPORTED, "Other protocol versions are refused");
+    host.stop();
+    ServiceClient g;
+    TEST_ASSERT(d.clear(1, 1000) == BLUR_NOT_INITIALIZED && g.attach(name.c_str()) == BLUR_NOT_INITIALIZED,
+                "Clients notice the host stopping");
+    return 0;
+}
+
+/* Child process: applies one window, checks its first frame and exits without detaching */
+static int run_child(const char* name, const RegionRect& r, const EffectParams_V2& p) {
+    ServiceClient client;
+    if (client.attach(name) != BLUR_SUCCESS) return 2;
+    uint32_t slot = 0;
+    if (client.apply(42, r, (const EffectParams*)&p, 5000, &slot) != BLUR_SUCCESS) return 3;
+    std::vector<uint8_t> frame;
+    uint64_t number = 0;
+    if (wait_frame(&client, 42, slot, &frame, r, &number) != BLUR_SUCCESS) return 4;
+    if (frame != render_alone(r, p)) return 5;
+    /* Crashes, as far as the host can tell */
+    _exit(0);
+}
+
+int test_client_process() {
+    PatternSource source;
+    ServiceHost host;
+    ServiceHostOptions options;
+    options.slot_bytes = 128 * 96 * 4;
+    options.client_timeout_us = 200000;
+    std::string name = service_name("process");
+    TEST_ASSERT(host.start(name.c_str(), options, &source) == BLUR_SUCCESS, "Host starts");
+
+    RegionRect r = { 40, 30, 168, 126 };
+    EffectParams_V2 p = make_params(0.4f, 0x30204080);
+    pid_t pid = fork();
+    if (pid == 0) _exit(run_child(name.c_str(), r, p));
+    TEST_ASSERT(pid > 0, "Client process starts");
+
+    /* The host runs on this process's main thread */
+    int status = 0;
+    bool exited = false;
+    uint64_t start = service_now_us();
+    while (service_now_us() - start < 10000000) {
+        host.tick(service_now_us());
+        if (!exited && waitpid(pid, &status, WNOHANG) == pid) exited = true;
+        if (exited && host.window_count() == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TEST_ASSERT(exited && WIFEXITED(status), "Client process finished");
+    printf("  client exit code %d\n", WEXITSTATUS(status));
+    TEST_ASSERT(WEXITSTATUS(status) == 0, "The client in another process got its blurred frame");
+    TEST_ASSERT(host.window_count() == 0 && host.stats().clients_reaped == 1,
+                "A client that stops sending heartbeats loses its windows");
+
+    ServiceClient next;
+    TEST_ASSERT(next.attach(name.c_str()) == BLUR_SUCCESS, "Its block can be claimed again");
+    return 0;
+}
+
+int main() {
+    printf("=== blur_service Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: layout\n");
+    failures += test_layout();
+    printf("\n");
+
+    printf("Test: client_process\n");
+    failures += test_client_process();
+    printf("\n");
+
+    printf("Test: apply_and_frames\n");
+    failures += test_apply_and_frames();
+    printf("\n");
+
+    printf("Test: ownership\n");
+    failures += test_ownership();
+    printf("\n");
+
+    printf("Test: limits\n");
+    failures += test_limits();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
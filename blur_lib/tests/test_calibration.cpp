@@ -0,0 +1,184 @@
+/*
+ * test_calibration.cpp - Tests for startup self-calibration
+ */
+
+#include "calibration.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* Hand-written model: exact is expensive per sigma, box and IIR flat, pyramid cheap but with overhead */
+static CalibrationModel make_model() {
+    CalibrationModel m = {};
+    m.valid = true;
+    m.key.hardware_threads = 4;
+    m.key.size_class = 1;
+    snprintf(m.key.cpu_model, sizeof(m.key.cpu_model), "Test_CPU_@_3.00GHz");
+    m.costs[0] = { BLUR_ALGORITHM_EXACT, 1000.0, 2.0, 4.0 };
+    m.costs[1] = { BLUR_ALGORITHM_BOX, 5000.0, 12.0, 0.0 };
+    m.costs[2] = { BLUR_ALGORITHM_PYRAMID, 200000.0, 3.0, 0.0 };
+    m.costs[3] = { BLUR_ALGORITHM_IIR, 2000.0, 40.0, 0.0 };
+    return m;
+}
+
+int test_measure() {
+    CalibrationModel m;
+    auto start = std::chrono::steady_clock::now();
+    CalibrationKey key;
+    current_calibration_key(1920 * 1080, &key);
+    TEST_ASSERT(run_calibration(key, &m) == BLUR_SUCCESS, "Calibration runs");
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("  measured in %.1f ms\n", ms);
+    TEST_ASSERT(m.valid && !m.from_cache && m.measure_ms > 0.0, "Measured model is valid");
+    TEST_ASSERT(m.key.size_class == key.size_class && strcmp(m.key.cpu_model, key.cpu_model) == 0,
+                "Measured model carries its key");
+    TEST_ASSERT(ms < 2000.0, "Calibration stays short");
+
+    bool positive = true;
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        if (predict_cost_ns(m, m.costs[i].algorithm, 1920 * 1080, 10.0f) <= 0.0) positive = false;
+    }
+    TEST_ASSERT(positive, "Every algorithm predicts a positive cost");
+    TEST_ASSERT(predict_cost_ns(m, BLUR_ALGORITHM_EXACT, 1920 * 1080, 20.0f) >
+                predict_cost_ns(m, BLUR_ALGORITHM_EXACT, 1920 * 1080, 2.0f),
+                "Exact cost grows with sigma");
+    TEST_ASSERT(predict_cost_ns(m, BLUR_ALGORITHM_IIR, 1920 * 1080, 20.0f) <
+                predict_cost_ns(m, BLUR_ALGORITHM_EXACT, 1920 * 1080, 20.0f),
+                "IIR beats exact at large sigma");
+    return 0;
+}
+
+int test_choose() {
+    CalibrationModel m = make_model();
+    /* exact: 1000 + px * (2 + 4 sigma); box: 5000 + 12 px; pyramid: 200000 + 3 px */
+    TEST_ASSERT(choose_algorithm(m, 100, 1.0f) == BLUR_ALGORITHM_EXACT, "Small sigma keeps exact");
+    TEST_ASSERT(choose_algorithm(m, 1000, 10.0f) == BLUR_ALGORITHM_BOX, "Small windows pick box");
+    TEST_ASSERT(choose_algorithm(m, 1920 * 1080, 10.0f) == BLUR_ALGORITHM_PYRAMID,
+                "Large windows amortize the pyramid overhead");
+    TEST_ASSERT(choose_algorithm(m, 1920 * 1080, 2.0f) != BLUR_ALGORITHM_PYRAMID,
+                "Pyramids that cannot reduce are not candidates");
+    m.costs[3].ns_per_pixel = 2.5;
+    TEST_ASSERT(choose_algorithm(m, 1920 * 1080, 10.0f) == BLUR_ALGORITHM_IIR, "A cheap enough IIR is picked");
+    m = make_model();
+
+    CalibrationModel none = {};
+    TEST_ASSERT(choose_algorithm(none, 1920 * 1080, 10.0f) == BLUR_ALGORITHM_EXACT,
+                "No model means exact");
+
+    clear_active_calibration();
+    TEST_ASSERT(resolve_algorithm(BLUR_ALGORITHM_AUTO, 1920 * 1080, 10.0f) == BLUR_ALGORITHM_EXACT,
+                "AUTO without calibration is exact");
+    set_active_calibration(m);
+    TEST_ASSERT(resolve_algorithm(BLUR_ALGORITHM_AUTO, 1920 * 1080, 10.0f) == BLUR_ALGORITHM_PYRAMID,
+                "AUTO follows the active model");
+    TEST_ASSERT(resolve_algorithm(BLUR_ALGORITHM_BOX, 1920 * 1080, 10.0f) == BLUR_ALGORITHM_BOX,
+                "Forced algorithms pass through");
+    clear_active_calibration();
+    return 0;
+}
+
+int test_cache() {
+    CalibrationModel m = make_model();
+    std::string text;
+    calibration_to_text(m, &text);
+
+    CalibrationModel back;
+    TEST_ASSERT(calibration_from_text(text.c_str(), m.key, &back) == BLUR_SUCCESS, "Cache round-trips");
+    TEST_ASSERT(back.valid && back.from_cache && back.measure_ms == 0.0, "Loaded model is marked cached");
+    bool same = true;
+    for (int32_t i = 0; i < CALIBRATION_ALGORITHMS; i++) {
+        if (back.costs[i].algorithm != m.costs[i].algorithm ||
+            back.costs[i].ns_per_pixel != m.costs[i].ns_per_pixel ||
+            back.costs[i].fixed_ns != m.costs[i].fixed_ns) same = false;
+    }
+    TEST_ASSERT(same, "Costs survive the round trip");
+
+    CalibrationKey other = m.key;
+    other.hardware_threads = 8;
+    TEST_ASSERT(calibration_from_text(text.c_str(), other, &back) == BLUR_INVALID_PARAMS,
+                "A cache for another thread count is ignored");
+    other = m.key;
+    snprintf(other.cpu_model, sizeof(other.cpu_model), "Other_CPU");
+    TEST_ASSERT(calibration_from_text(text.c_str(), other, &back) == BLUR_INVALID_PARAMS,
+                "A cache from another CPU model is ignored");
+    other = m.key;
+    other.size_class = calibration_size_class(3840 * 2160);
+    TEST_ASSERT(calibration_from_text(text.c_str(), other, &back) == BLUR_INVALID_PARAMS,
+                "A cache for another screen size class is ignored");
+    const std::string version = " " + std::to_string(CALIBRATION_FORMAT_VERSION) + "\n";
+    std::string old = text;
+    old.replace(old.find(version), version.size(), " 0\n");
+    TEST_ASSERT(calibration_from_text(old.c_str(), m.key, &back) == BLUR_INVALID_PARAMS,
+                "A cache from another format version is ignored");
+    std::string truncated = text.substr(0, text.find("cost 1"));
+    TEST_ASSERT(calibration_from_text(truncated.c_str(), m.key, &back) == BLUR_INVALID_PARAMS, "A truncated cache is ignored");
+    return 0;
+}
+
+int test_key() {
+    TEST_ASSERT(calibration_size_class(1280 * 720) == 0 && calibration_size_class(1920 * 1080) == 1 &&
+                calibration_size_class(2560 * 1440) == 2 && calibration_size_class(3840 * 2160) == 3,
+                "Screens fall into size classes");
+    CalibrationKey a, b;
+    current_calibration_key(1920 * 1080, &a);
+    current_calibration_key(1920 * 1200, &b);
+    printf("  cpu_model %s\n", a.cpu_model);
+    TEST_ASSERT(a.cpu_model[0] && !strchr(a.cpu_model, ' ') && !strchr(a.cpu_model, '"'),
+                "CPU model is one plain token");
+    TEST_ASSERT(strcmp(a.cpu_model, b.cpu_model) == 0 && a.size_class == b.size_class &&
+                a.hardware_threads == b.hardware_threads, "Similar screens share a key");
+    return 0;
+}
+
+int test_json() {
+    std::string json;
+    calibration_to_json(make_model(), &json);
+    TEST_ASSERT(json.find("\"valid\":true") != std::string::npos, "JSON reports validity");
+    TEST_ASSERT(json.find("\"algorithm\":\"pyramid\"") != std::string::npos, "JSON lists the costs");
+    TEST_ASSERT(json.find("\"choices\":[") != std::string::npos, "JSON shows the AUTO choices");
+
+    calibration_to_json(CalibrationModel(), &json);
+    TEST_ASSERT(json.find("\"valid\":false") != std::string::npos && json.find("choices") == std::string::npos,
+                "An empty model reports itself invalid");
+    return 0;
+}
+
+int main() {
+    printf("=== calibration Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: measure\n");
+    failures += test_measure();
+    printf("\n");
+
+    printf("Test: choose\n");
+    failures += test_choose();
+    printf("\n");
+
+    printf("Test: cache\n");
+    failures += test_cache();
+    printf("\n");
+
+    printf("Test: key\n");
+    failures += test_key();
+    printf("\n");
+
+    printf("Test: json\n");
+    failures += test_json();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,446 @@
+/*
+ * test_capture_planner.cpp - Tests for shared per-tick screen capture
+ */
+
+#include "capture_planner.h"
+#include "cpu_budget.h"
+#include "effect_graph.h"
+#include <algorithm>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* Deterministic "desktop" colour of a screen pixel */
+static uint8_t screen_byte(int32_t x, int32_t y, int32_t ch) {
+    uint32_t v = (uint32_t)(x * 73856093) ^ (uint32_t)(y * 19349663) ^ (uint32_t)(ch * 83492791);
+    return (uint8_t)(v >> 7);
+}
+
+/* Synthetic screen that counts every pixel it is asked to copy */
+class PatternSource : public CaptureSource {
+public:
+    int64_t pixels_captured = 0;
+    int32_t frames = 0;
+    bool    out_of_bounds = false;
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        m_bounds = bounds;
+        m_pixels.assign((size_t)rect_area(bounds) * 4, 0);
+        BlurSurface f = { m_pixels.data(), bounds.right - bounds.left, bounds.bottom - bounds.top,
+                          (bounds.right - bounds.left) * 4 };
+        m_frame = *frame = f;
+        frames++;
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& area) override {
+        RegionRect r = rect_intersect(area, m_bounds);
+        if (rect_area(r) != rect_area(area)) out_of_bounds = true;
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            for (int32_t x = r.left; x < r.right; x++) {
+                uint8_t* p = m_frame.pixels + (size_t)(y - m_bounds.top) * m_frame.stride +
+                             (size_t)(x - m_bounds.left) * 4;
+                for (int32_t ch = 0; ch < 4; ch++) p[ch] = screen_byte(x, y, ch);
+            }
+        }
+        pixels_captured += rect_area(r);
+    }
+
+    void end_frame() override {
+        m_pixels.clear();
+    }
+
+private:
+    RegionRect m_bounds;
+    BlurSurface m_frame;
+    std::vector<uint8_t> m_pixels;
+};
+
+struct TestWindow {
+    RegionRect screen;
+    BlurRegionList_V1 regions;      /* rect_count 0 means the whole window */
+    float sigma;                    /* < 0 means capture only */
+    uint32_t color;
+    const EffectProgram* effects;
+};
+
+/* Builds the tick windows; kernels and targets must outlive them */
+static void make_tick(const TestWindow* tw, size_t count, std::vector<BlurKernel>* kernels,
+                      std::vector<std::vector<uint8_t>>* targets, std::vector<TickWindow>* windows) {
+    kernels->assign(count, BlurKernel());
+    targets->assign(count, std::vector<uint8_t>());
+    windows->assign(count, TickWindow());
+    for (size_t i = 0; i < count; i++) {
+        int32_t w = tw[i].screen.right - tw[i].screen.left, h = tw[i].screen.bottom - tw[i].screen.top;
+        build_gaussian_kernel(tw[i].sigma < 0 ? 0.0f : tw[i].sigma, &(*kernels)[i]);
+        (*targets)[i].assign((size_t)w * h * 4, 0);
+
+        TickWindow& win = (*windows)[i];
+        win.handle = i + 1;
+        win.screen = tw[i].screen;
+        plan_region_blur(tw[i].regions.rect_count ? &tw[i].regions : nullptr, w, h,
+                         (*kernels)[i].radius, &win.plan);
+        win.kernel = tw[i].sigma < 0 ? nullptr : &(*kernels)[i];
+        win.color_argb = tw[i].color;
+        win.effects = tw[i].effects;
+        win.mode = CPU_BLUR_STREAMING;
+        BlurSurface t = { (*targets)[i].data(), w, h, w * 4 };
+        win.target = t;
+    }
+}
+
+/* What a private capture plus cpu_blur_regions() in the window's mode produces for one window */
+static std::vector<uint8_t> render_alone(const TickWindow& win) {
+    int32_t w = win.target.width, h = win.target.height;
+    std::vector<uint8_t> buf((size_t)w * h * 4, 0);
+    for (const RegionRect& r : win.plan.capture) {
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            for (int32_t x = r.left; x < r.right; x++) {
+                for (int32_t ch = 0; ch < 4; ch++) {
+                    buf[((size_t)y * w + x) * 4 + ch] = screen_byte(win.screen.left + x, win.screen.top + y, ch);
+                }
+            }
+        }
+    }
+    if (win.kernel) {
+        BlurSurface s = { buf.data(), w, h, w * 4 };
+        cpu_blur_regions(&s, win.kernel, win.mode, &win.plan, win.color_argb, win.effects);
+    }
+    return buf;
+}
+
+static bool matches_private_capture(const std::vector<TickWindow>& windows) {
+    for (const TickWindow& win : windows) {
+        std::vector<uint8_t> expect = render_alone(win);
+        if (memcmp(expect.data(), win.target.pixels, expect.size()) != 0) {
+            printf("  window %u differs from a private capture\n", (unsigned)win.handle);
+            return false;
+        }
+    }
+    return true;
+}
+
+int test_overlapping_capture_once() {
+    TestWindow tw[2] = {};
+    tw[0].screen = { 100, 100, 300, 250 };
+    tw[0].sigma = 3.0f;
+    tw[1].screen = { 200, 150, 400, 300 };
+    tw[1].sigma = 5.0f;
+    tw[1].color = 0x40FF0000;
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 2, &kernels, &targets, &windows);
+
+    PatternSource source;
+    TickStats stats;
+    TEST_ASSERT(run_shared_tick(windows.data(), windows.size(), &source, &stats) == BLUR_SUCCESS,
+                "Shared tick succeeds");
+    TEST_ASSERT(!source.out_of_bounds, "Every captured area lies inside its frame");
+    TEST_ASSERT(source.frames == 1 && stats.frames == 1, "Overlapping windows share one frame");
+    TEST_ASSERT(stats.pixels_requested == 200 * 150 * 2, "Both windows request their full area");
+    TEST_ASSERT(source.pixels_captured == 200 * 150 * 2 - 100 * 100,
+                "The overlap is captured once");
+    TEST_ASSERT(stats.pixels_captured == source.pixels_captured, "Stats match the source count");
+    TEST_ASSERT(stats.pixels_blur_computed == stats.pixels_blur_requested,
+                "Different kernels share no blur");
+    TEST_ASSERT(matches_private_capture(windows), "Output matches private per-window captures");
+    return 0;
+}
+
+int test_shared_blur() {
+    TestWindow tw[3] = {};
+    tw[0].screen = { 0, 0, 120, 100 };
+    tw[0].sigma = 2.0f;
+    tw[1].screen = { 60, 40, 180, 140 };
+    tw[1].sigma = 2.0f;
+    tw[1].color = 0x80000000;
+    tw[2].screen = { 30, 20, 150, 120 };    /* Region list overlapping both */
+    tw[2].sigma = 2.0f;
+    tw[2].regions.struct_version = 1;
+    tw[2].regions.rect_count = 2;
+    tw[2].regions.rects[0] = { 0, 0, 120, 30, 6 };
+    tw[2].regions.rects[1] = { 50, 30, 90, 100, 0 };
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 3, &kernels, &targets, &windows);
+
+    PatternSource source;
+    TickStats stats;
+    TEST_ASSERT(run_shared_tick(windows.data(), windows.size(), &source, &stats) == BLUR_SUCCESS,
+                "Shared tick succeeds");
+    TEST_ASSERT(stats.pixels_captured < stats.pixels_requested, "Overlapping captures are merged");
+    TEST_ASSERT(stats.pixels_blur_computed < stats.pixels_blur_requested,
+                "Equal kernels blur the common interior once");
+    TEST_ASSERT(matches_private_capture(windows), "Shared blur matches private per-window blurs");
+
+    /* A recursive blur depends on the rect it runs over, so IIR windows blur on their own */
+    for (size_t i = 0; i < 3; i++) {
+        build_blur_kernel(tw[i].sigma, BLUR_ALGORITHM_IIR, 1, &kernels[i]);
+        int32_t w = tw[i].screen.right - tw[i].screen.left, h = tw[i].screen.bottom - tw[i].screen.top;
+        plan_region_blur(tw[i].regions.rect_count ? &tw[i].regions : nullptr, w, h, kernels[i].radius,
+                         &windows[i].plan);
+        std::fill(targets[i].begin(), targets[i].end(), 0);
+    }
+    TEST_ASSERT(run_shared_tick(windows.data(), windows.size(), &source, &stats) == BLUR_SUCCESS,
+                "IIR tick succeeds");
+    TEST_ASSERT(stats.pixels_blur_computed == stats.pixels_blur_requested, "IIR kernels share no blur");
+    TEST_ASSERT(matches_private_capture(windows), "IIR windows match private per-window blurs");
+    return 0;
+}
+
+int test_shared_blur_effects() {
+    /* Shared blurs are copied before effects run, so windows with different effects still share */
+    BlurEffectList_V1 acrylic = {};
+    acrylic.struct_version = 1;
+    acrylic.effect_count = 4;
+    acrylic.effects[0] = { BLUR_EFFECT_SATURATION, 0, 1.5f, 0 };
+    acrylic.effects[1] = { BLUR_EFFECT_LUMINOSITY, 0x80404040, 0.0f, 0 };
+    acrylic.effects[2] = { BLUR_EFFECT_TINT, 0x30202060, 0.0f, 0 };
+    acrylic.effects[3] = { BLUR_EFFECT_NOISE, 0, 0.1f, 0 };
+    BlurEffectList_V1 dark = {};
+    dark.struct_version = 1;
+    dark.effect_count = 2;
+    dark.effects[0] = { BLUR_EFFECT_EXCLUSION, 0x40FFFFFF, 0.0f, 0 };
+    dark.effects[1] = { BLUR_EFFECT_VIGNETTE, 0, 0.6f, 0 };
+    EffectProgram programs[2];
+    TEST_ASSERT(compile_effect_graph(&acrylic, &programs[0]) == BLUR_SUCCESS &&
+                compile_effect_graph(&dark, &programs[1]) == BLUR_SUCCESS, "Effect graphs compile");
+
+    TestWindow tw[3] = {};
+    tw[0].screen = { 0, 0, 120, 100 };
+    tw[0].sigma = 2.0f;
+    tw[0].effects = &programs[0];
+    tw[1].screen = { 60, 40, 180, 140 };
+    tw[1].sigma = 2.0f;
+    tw[1].color = 0x80000000;
+    tw[2].screen = { 30, 20, 150, 120 };
+    tw[2].sigma = 2.0f;
+    tw[2].effects = &programs[1];
+    tw[2].regions.struct_version = 1;
+    tw[2].regions.rect_count = 2;
+    tw[2].regions.rects[0] = { 0, 0, 120, 30, 6 };
+    tw[2].regions.rects[1] = { 50, 30, 90, 100, 0 };
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 3, &kernels, &targets, &windows);
+
+    PatternSource source;
+    TickStats stats;
+    TEST_ASSERT(run_shared_tick(windows.data(), windows.size(), &source, &stats) == BLUR_SUCCESS,
+                "Shared tick succeeds");
+    TEST_ASSERT(stats.pixels_blur_computed < stats.pixels_blur_requested,
+                "Windows with different effects share their blur");
+    TEST_ASSERT(matches_private_capture(windows), "After-store effects match effects fused into private blurs");
+    return 0;
+}
+
+int test_disjoint_clusters() {
+    TestWindow tw[3] = {};
+    tw[0].screen = { 0, 0, 64, 64 };
+    tw[0].sigma = 1.0f;
+    tw[1].screen = { 500, 0, 564, 64 };
+    tw[1].sigma = -1.0f;                    /* GPU window: capture only */
+    tw[2].screen = { 40, 40, 104, 104 };
+    tw[2].sigma = 1.0f;
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 3, &kernels, &targets, &windows);
+
+    std::vector<CaptureCluster> clusters;
+    plan_shared_capture(windows.data(), windows.size(), &clusters);
+    TEST_ASSERT(clusters.size() == 2, "Disjoint windows form separate clusters");
+    TEST_ASSERT(clusters[0].members.size() == 2 && clusters[1].members.size() == 1,
+                "Overlapping windows join one cluster");
+    TEST_ASSERT(clusters[1].bounds.left == 500 && clusters[1].bounds.right == 564,
+                "A lone window's frame is its own capture");
+
+    PatternSource source;
+    TickStats stats;
+    run_shared_tick(windows.data(), windows.size(), &source, &stats);
+    TEST_ASSERT(source.frames == 2, "One frame per cluster");
+    TEST_ASSERT(source.pixels_captured == 64 * 64 * 3 - 24 * 24, "Only the overlap is deduplicated");
+    TEST_ASSERT(matches_private_capture(windows), "Capture-only windows get the raw pixels");
+    return 0;
+}
+
+int test_clipped_plan() {
+    /* A partly covered window contributes only its visible capture */
+    TestWindow tw[2] = {};
+    tw[0].screen = { 0, 0, 100, 100 };
+    tw[0].sigma = 2.0f;
+    tw[1].screen = { 50, 0, 150, 100 };
+    tw[1].sigma = 2.0f;
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 2, &kernels, &targets, &windows);
+    std::vector<RegionRect> visible = { { 0, 0, 50, 100 } };
+    clip_region_plan(&windows[0].plan, visible, 100, 100, kernels[0].radius);
+
+    PatternSource source;
+    TickStats stats;
+    run_shared_tick(windows.data(), windows.size(), &source, &stats);
+    TEST_ASSERT(stats.pixels_requested == (50 + kernels[0].radius) * 100 + 100 * 100,
+                "The covered window requests its visible part plus halo");
+    TEST_ASSERT(source.pixels_captured == 150 * 100, "The union is captured once");
+    TEST_ASSERT(matches_private_capture(windows), "Clipped plans match private captures");
+
+    TickStats empty;
+    TEST_ASSERT(run_shared_tick(nullptr, 0, &source, &empty) == BLUR_SUCCESS && empty.frames == 0,
+                "An empty tick captures nothing");
+    TEST_ASSERT(run_shared_tick(windows.data(), windows.size(), nullptr, &empty) == BLUR_INVALID_PARAMS,
+                "A missing source is rejected");
+    return 0;
+}
+
+int test_executor_bands() {
+    /* Tall windows split into several row bands; box, pyramid and IIR kernels too */
+    TestWindow tw[3] = {};
+    tw[0].screen = { 0, 0, 160, 400 };
+    tw[0].sigma = 3.0f;
+    tw[1].screen = { 80, 50, 240, 450 };
+    tw[1].sigma = 3.0f;
+    tw[1].color = 0x30102030;
+    tw[2].screen = { 300, 0, 420, 360 };
+    tw[2].sigma = 6.0f;
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 3, &kernels, &targets, &windows);
+    windows[0].lane = EXECUTOR_LANE_INTERACTIVE;
+    windows[1].max_tasks = 2;
+
+    TEST_ASSERT(executor_start(3) == BLUR_SUCCESS, "Executor starts");
+    const uint32_t algorithms[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX, BLUR_ALGORITHM_PYRAMID,
+                                    BLUR_ALGORITHM_IIR };
+    bool match = true;
+    for (uint32_t algorithm : algorithms) {
+        build_blur_kernel(tw[2].sigma, algorithm, 1, &kernels[2]);
+        for (std::vector<uint8_t>& t : targets) std::fill(t.begin(), t.end(), 0);
+        PatternSource source;
+        TickStats stats;
+        match = run_shared_tick(windows.data(), windows.size(), &source, &stats) == BLUR_SUCCESS &&
+                matches_private_capture(windows) && match;
+    }
+    ExecutorStats st;
+    executor_get_stats(&st);
+    executor_stop();
+    TEST_ASSERT(match, "Banded blurs match private per-window blurs");
+    TEST_ASSERT(st.executed[EXECUTOR_LANE_INTERACTIVE] > 0 && st.executed[EXECUTOR_LANE_BACKGROUND] > 0,
+                "Bands run on their windows' lanes");
+    return 0;
+}
+
+int test_cost_across_bands() {
+    /* Tall windows run as several bands at once; each is charged the time of all its bands */
+    TestWindow tw[3] = {};
+    tw[0].screen = { 0, 0, 200, 600 };
+    tw[0].sigma = 8.0f;
+    tw[1].screen = { 100, 50, 300, 650 };
+    tw[1].sigma = 8.0f;
+    tw[2].screen = { 400, 0, 560, 500 };
+    tw[2].sigma = 12.0f;
+
+    std::vector<BlurKernel> kernels;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    make_tick(tw, 3, &kernels, &targets, &windows);
+
+    CpuBudget budget;
+    for (const TickWindow& w : windows) budget.track(w.handle, 16);
+
+    TEST_ASSERT(executor_start(3) == BLUR_SUCCESS, "Executor starts");
+    bool ok = true, summed = true, charged = true;
+    uint64_t cost_us = 0;
+    std::clock_t cpu_start = std::clock();
+    for (int tick = 0; tick < 4; tick++) {
+        PatternSource source;
+        TickStats stats;
+        ok = run_shared_tick(windows.data(), windows.size(), &source, &stats) == BLUR_SUCCESS && ok;
+        uint64_t sum = 0;
+        for (const TickWindow& w : windows) {
+            sum += w.cost_us;
+            if (!w.cost_us) charged = false;
+            budget.record_frame(w.handle, w.cost_us);
+        }
+        if (sum != stats.cost_us) summed = false;
+        cost_us += stats.cost_us;
+    }
+    double cpu_us = (double)(std::clock() - cpu_start) * 1e6 / CLOCKS_PER_SEC;
+    ExecutorStats st;
+    executor_get_stats(&st);
+    executor_stop();
+
+    TEST_ASSERT(ok, "Ticks succeed with the executor running");
+    TEST_ASSERT(st.executed[EXECUTOR_LANE_BACKGROUND] > 3, "Windows split into bands on the workers");
+    TEST_ASSERT(charged, "Every blurred window is charged");
+    TEST_ASSERT(summed, "The tick cost is the sum of the windows' costs");
+    printf("  charged %llu us for %.0f us of process CPU\n", (unsigned long long)cost_us, cpu_us);
+    TEST_ASSERT((double)cost_us >= cpu_us * 0.5, "Charged cost covers the CPU the workers spent");
+
+    /* Half of what refreshing every 16 ms would spend */
+    uint32_t cap = std::max<uint32_t>(budget.used_per_mille() / 2, 1);
+    budget.set_budget(cap);
+    bool stretched = false;
+    for (const TickWindow& w : windows) stretched = stretched || budget.interval_ms(w.handle) > 16;
+    TEST_ASSERT(stretched && budget.used_per_mille() <= cap + 1, "The budget caps the measured cost");
+    return 0;
+}
+
+int main() {
+    printf("=== capture_planner Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: overlapping_capture_once\n");
+    failures += test_overlapping_capture_once();
+    printf("\n");
+
+    printf("Test: shared_blur\n");
+    failures += test_shared_blur();
+    printf("\n");
+
+    printf("Test: shared_blur_effects\n");
+    failures += test_shared_blur_effects();
+    printf("\n");
+
+    printf("Test: disjoint_clusters\n");
+    failures += test_disjoint_clusters();
+    printf("\n");
+
+    printf("Test: clipped_plan\n");
+    failures += test_clipped_plan();
+    printf("\n");
+
+    printf("Test: executor_bands\n");
+    failures += test_executor_bands();
+    printf("\n");
+
+    printf("Test: cost_across_bands\n");
+    failures += test_cost_across_bands();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
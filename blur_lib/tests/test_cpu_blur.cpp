@@ -0,0 +1,370 @@
+/*
+ * test_cpu_blur.cpp - Tests for the portable CPU blur engine
+ */
+
+#include "cpu_blur.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static void fill_noise(std::vector<uint8_t>& buf, uint32_t seed) {
+    for (size_t i = 0; i < buf.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+static BlurSurface make_surface(std::vector<uint8_t>& buf, int32_t w, int32_t h) {
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+    return s;
+}
+
+int test_kernel() {
+    const float sigmas[] = { 0.0f, 0.5f, 2.0f, 7.5f, 20.0f };
+    for (float sigma : sigmas) {
+        BlurKernel k;
+        build_gaussian_kernel(sigma, &k);
+        int32_t sum = 0;
+        bool symmetric = true;
+        for (size_t i = 0; i < k.weights.size(); i++) {
+            sum += k.weights[i];
+            if (k.weights[i] != k.weights[k.weights.size() - 1 - i]) symmetric = false;
+        }
+        if (sum != (1 << BLUR_KERNEL_SHIFT) || !symmetric) {
+            printf("  sigma %.1f: sum %d symmetric %d\n", sigma, sum, symmetric);
+            TEST_ASSERT(false, "Kernel should be normalized and symmetric");
+        }
+    }
+    TEST_ASSERT(true, "Kernels are normalized and symmetric");
+
+    TEST_ASSERT(sigma_from_intensity(1.0f) == 20.0f, "Intensity 1.0 maps to sigma 20");
+    TEST_ASSERT(sigma_from_intensity(0.0f) == 0.0f, "Intensity 0.0 maps to sigma 0");
+    return 0;
+}
+
+int test_identity() {
+    const int32_t w = 17, h = 9;
+    std::vector<uint8_t> src((size_t)w * h * 4), dst(src.size());
+    fill_noise(src, 1);
+    BlurSurface s = make_surface(src, w, h), d = make_surface(dst, w, h);
+
+    BlurKernel k;
+    build_gaussian_kernel(0.0f, &k);
+    TEST_ASSERT(cpu_blur(&s, &d, &k, CPU_BLUR_FULL_FRAME) == BLUR_SUCCESS, "Zero sigma blur succeeds");
+    TEST_ASSERT(src == dst, "Zero sigma is the identity");
+    return 0;
+}
+
+int test_streaming_matches_full_frame() {
+    struct Case { int32_t w, h; float sigma; };
+    const Case cases[] = {
+        { 64, 48, 1.0f }, { 33, 7, 4.0f }, { 5, 120, 6.0f }, { 200, 3, 20.0f }, { 1, 1, 3.0f },
+    };
+
+    for (const Case& c : cases) {
+        std::vector<uint8_t> src((size_t)c.w * c.h * 4), full(src.size()), stream(src.size());
+        fill_noise(src, (uint32_t)(c.w * 131 + c.h));
+        BlurSurface s = make_surface(src, c.w, c.h);
+        BlurSurface f = make_surface(full, c.w, c.h);
+        BlurSurface st = make_surface(stream, c.w, c.h);
+
+        BlurKernel k;
+        build_gaussian_kernel(c.sigma, &k);
+        cpu_blur(&s, &f, &k, CPU_BLUR_FULL_FRAME);
+        cpu_blur(&s, &st, &k, CPU_BLUR_STREAMING);
+        if (full != stream) {
+            printf("  mismatch at %dx%d sigma %.1f\n", c.w, c.h, c.sigma);
+            TEST_ASSERT(false, "Streaming output should match full-frame output");
+        }
+
+        /* In-place streaming over the source must give the same answer */
+        std::vector<uint8_t> inplace = src;
+        BlurSurface ip = make_surface(inplace, c.w, c.h);
+        cpu_blur(&ip, &ip, &k, CPU_BLUR_STREAMING);
+        if (inplace != full) {
+            printf("  in-place mismatch at %dx%d sigma %.1f\n", c.w, c.h, c.sigma);
+            TEST_ASSERT(false, "In-place streaming should match full-frame output");
+        }
+    }
+    TEST_ASSERT(true, "Streaming matches full-frame, including in place");
+    return 0;
+}
+
+int test_blocked_vertical_matches_rows() {
+    /* Wide enough for several strips with a ragged last one, heights off the block size */
+    struct Case { int32_t w, h; float sigma; int32_t x, y, ow, oh; };
+    const Case cases[] = {
+        { 700, 45, 10.0f, 0, 0, 700, 45 }, { 1500, 37, 3.0f, 0, 0, 1500, 37 },
+        { 613, 70, 6.0f, 17, 9, 580, 50 }, { 40, 5, 2.0f, 0, 0, 40, 5 },
+    };
+    const CpuBlurMode modes[] = { CPU_BLUR_FULL_FRAME, CPU_BLUR_STREAMING };
+    const uint32_t transfers[] = { BLUR_TRANSFER_SRGB, BLUR_TRANSFER_LINEAR };
+
+    for (const Case& c : cases) {
+        std::vector<uint8_t> src((size_t)c.w * c.h * 4);
+        fill_noise(src, (uint32_t)(c.w * 7 + c.h));
+        BlurSurface s = make_surface(src, c.w, c.h);
+        BlurKernel k;
+        build_gaussian_kernel(c.sigma, &k);
+        for (CpuBlurMode mode : modes) {
+            for (uint32_t transfer : transfers) {
+                std::vector<uint8_t> rows((size_t)c.ow * c.oh * 4), blocked(rows.size());
+                BlurSurface ro = make_surface(rows, c.ow, c.oh);
+                BlurSurface bo = make_surface(blocked, c.ow, c.oh);
+                cpu_blur_taps(&s, &ro, k.weights.data(), k.radius, mode, c.x, c.y, transfer, CPU_VERTICAL_ROWS);
+                cpu_blur_taps(&s, &bo, k.weights.data(), k.radius, mode, c.x, c.y, transfer, CPU_VERTICAL_BLOCKED);
+                if (rows != blocked) {
+                    printf("  mismatch at %dx%d sigma %.1f mode %d transfer %u\n", c.w, c.h, c.sigma, mode, transfer);
+                    TEST_ASSERT(false, "Blocked vertical pass should match row order");
+                }
+            }
+        }
+
+        /* In place over the whole surface */
+        std::vector<uint8_t> expect(src.size()), inplace = src;
+        BlurSurface e = make_surface(expect, c.w, c.h);
+        BlurSurface ip = make_surface(inplace, c.w, c.h);
+        cpu_blur_taps(&s, &e, k.weights.data(), k.radius, CPU_BLUR_FULL_FRAME, 0, 0, BLUR_TRANSFER_SRGB,
+                      CPU_VERTICAL_ROWS);
+        cpu_blur(&ip, &ip, &k, CPU_BLUR_FULL_FRAME);
+        if (inplace != expect) {
+            printf("  in-place mismatch at %dx%d sigma %.1f\n", c.w, c.h, c.sigma);
+            TEST_ASSERT(false, "Blocked in-place blur should match row order");
+        }
+    }
+    TEST_ASSERT(true, "Blocked vertical pass matches row order in every mode");
+    return 0;
+}
+
+int test_flat_input() {
+    const int32_t w = 40, h = 30;
+    std::vector<uint8_t> buf((size_t)w * h * 4);
+    for (size_t i = 0; i < buf.size(); i += 4) {
+        buf[i] = 10; buf[i + 1] = 128; buf[i + 2] = 250; buf[i + 3] = 255;
+    }
+    std::vector<uint8_t> expect = buf;
+    BlurSurface s = make_surface(buf, w, h);
+    BlurKernel k;
+    build_gaussian_kernel(5.0f, &k);
+    cpu_blur(&s, &s, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(buf == expect, "Flat input is unchanged by the blur");
+    return 0;
+}
+
+int test_scratch_bounds() {
+    const int32_t w = 3840, h = 2160, r = 60;
+    size_t full = cpu_blur_scratch_bytes(w, h, r, CPU_BLUR_FULL_FRAME);
+    size_t stream = cpu_blur_scratch_bytes(w, h, r, CPU_BLUR_STREAMING);
+    TEST_ASSERT(full >= (size_t)w * h * 8, "Full-frame scratch covers a w*h intermediate");
+    TEST_ASSERT(stream < (size_t)w * (2 * r + 2) * 8 + (size_t)w * 16 + 4096,
+                "Streaming scratch scales with width * radius");
+
+    /* Short surfaces never need more ring rows than they have */
+    TEST_ASSERT(cpu_blur_scratch_bytes(w, 4, r, CPU_BLUR_STREAMING) ==
+                cpu_blur_scratch_bytes(w, 4, r, CPU_BLUR_FULL_FRAME),
+                "Ring is capped at the surface height");
+    return 0;
+}
+
+int test_linear_light() {
+    std::vector<uint8_t> bytes(256 * 4), back(bytes.size());
+    std::vector<uint16_t> linear(bytes.size());
+    for (int32_t i = 0; i < 256; i++) {
+        bytes[i * 4] = bytes[i * 4 + 1] = bytes[i * 4 + 2] = bytes[i * 4 + 3] = (uint8_t)i;
+    }
+    srgb_decode_row(bytes.data(), linear.data(), 256);
+    srgb_encode_row(linear.data(), back.data(), 256);
+    TEST_ASSERT(back == bytes, "Decoding then encoding returns every byte");
+    TEST_ASSERT(linear[0] == 0 && linear[255 * 4] == 65535 && linear[128 * 4] < 65535 / 4,
+                "Decoding follows the sRGB curve");
+
+    BlurKernel k;
+    build_gaussian_kernel(4.0f, &k);
+    kernel_set_linear_light(&k, true);
+    TEST_ASSERT(k.transfer == BLUR_TRANSFER_LINEAR, "Direct kernels take linear light");
+    BlurKernel box;
+    build_blur_kernel(4.0f, BLUR_ALGORITHM_BOX, 1, &box);
+    kernel_set_linear_light(&box, true);
+    TEST_ASSERT(box.transfer == BLUR_TRANSFER_SRGB, "Approximate kernels stay in sRGB");
+
+    const int32_t w = 57, h = 23;
+    std::vector<uint8_t> src((size_t)w * h * 4), full(src.size()), stream(src.size());
+    fill_noise(src, 77);
+    BlurSurface s = make_surface(src, w, h), f = make_surface(full, w, h), st = make_surface(stream, w, h);
+    cpu_blur(&s, &f, &k, CPU_BLUR_FULL_FRAME);
+    cpu_blur(&s, &st, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(full == stream, "Linear streaming matches linear full-frame");
+
+    std::vector<uint8_t> rect(4 * 5 * 4);
+    BlurSurface r = make_surface(rect, 4, 5);
+    cpu_blur_rect(&s, &r, &k, CPU_BLUR_STREAMING, 30, 10);
+    bool same = true;
+    for (int32_t y = 0; y < 5; y++) {
+        same = same && memcmp(&rect[(size_t)y * 16], &full[((size_t)(y + 10) * w + 30) * 4], 16) == 0;
+    }
+    TEST_ASSERT(same, "A linear rectangle matches the same pixels of a full blur");
+
+    std::vector<uint8_t> flat((size_t)w * h * 4);
+    for (size_t i = 0; i < flat.size(); i += 4) {
+        flat[i] = 10; flat[i + 1] = 128; flat[i + 2] = 250; flat[i + 3] = 200;
+    }
+    std::vector<uint8_t> expect = flat;
+    BlurSurface fl = make_surface(flat, w, h);
+    cpu_blur(&fl, &fl, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(flat == expect, "Flat input is unchanged in linear light");
+
+    /* A black/white edge: linear light averages energy, so the middle is brighter than in sRGB */
+    std::vector<uint8_t> edge((size_t)w * h * 4), srgb(edge.size()), lin(edge.size());
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            uint8_t v = x < w / 2 ? 0 : 255;
+            uint8_t* p = &edge[((size_t)y * w + x) * 4];
+            p[0] = p[1] = p[2] = v; p[3] = 255;
+        }
+    }
+    BlurKernel plain;
+    build_gaussian_kernel(4.0f, &plain);
+    BlurSurface e = make_surface(edge, w, h), es = make_surface(srgb, w, h), el = make_surface(lin, w, h);
+    cpu_blur(&e, &es, &plain, CPU_BLUR_FULL_FRAME);
+    cpu_blur(&e, &el, &k, CPU_BLUR_FULL_FRAME);
+    size_t mid = ((size_t)(h / 2) * w + w / 2) * 4;
+    printf("  edge midpoint: sRGB %d, linear %d\n", srgb[mid], lin[mid]);
+    TEST_ASSERT(lin[mid] > srgb[mid] + 30 && lin[mid + 3] == 255, "Linear light keeps edges from darkening");
+    return 0;
+}
+
+int test_invalid_args() {
+    std::vector<uint8_t> a(16 * 4), b(8 * 4);
+    BlurSurface sa = make_surface(a, 4, 4), sb = make_surface(b, 4, 2);
+    BlurKernel k;
+    build_gaussian_kernel(1.0f, &k);
+    TEST_ASSERT(cpu_blur(&sa, &sb, &k, CPU_BLUR_STREAMING) == BLUR_INVALID_PARAMS,
+                "Mismatched surfaces are rejected");
+    TEST_ASSERT(cpu_blur(nullptr, &sb, &k, CPU_BLUR_STREAMING) == BLUR_INVALID_PARAMS,
+                "Null source is rejected");
+    return 0;
+}
+
+int test_approx_algorithms() {
+    const int32_t w = 96, h = 64;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            uint8_t* p = &src[((size_t)y * w + x) * 4];
+            p[0] = (uint8_t)(128 + 100 * std::sin(x * 0.15));
+            p[1] = (uint8_t)(x * 2);
+            p[2] = (uint8_t)(y * 3);
+            p[3] = 255;
+        }
+    }
+    BlurSurface s = make_surface(src, w, h);
+
+    BlurKernel exact;
+    build_gaussian_kernel(6.0f, &exact);
+    std::vector<uint8_t> ref(src.size());
+    BlurSurface rs = make_surface(ref, w, h);
+    cpu_blur(&s, &rs, &exact, CPU_BLUR_FULL_FRAME);
+
+    struct Case { uint32_t algorithm; int32_t downsample; const char* label; };
+    const Case cases[] = {
+        { BLUR_ALGORITHM_BOX, 1, "box" },
+        { BLUR_ALGORITHM_PYRAMID, 1, "pyramid" },
+        { BLUR_ALGORITHM_EXACT, 2, "exact / 2" },
+        { BLUR_ALGORITHM_BOX, 4, "box / 4" },
+    };
+    for (const Case& c : cases) {
+        BlurKernel k;
+        build_blur_kernel(6.0f, c.algorithm, c.downsample, &k);
+        if (kernel_is_direct(&k) || k.radius < exact.radius / 2) {
+            printf("  %s: radius %d\n", c.label, k.radius);
+            TEST_ASSERT(false, "Approximate kernels report their reach");
+        }
+
+        std::vector<uint8_t> out(src.size());
+        BlurSurface os = make_surface(out, w, h);
+        TEST_ASSERT(cpu_blur(&s, &os, &k, CPU_BLUR_STREAMING) == BLUR_SUCCESS, c.label);
+        double err = 0.0;
+        for (size_t i = 0; i < out.size(); i++) err += std::abs((int)out[i] - (int)ref[i]);
+        err /= (double)out.size();
+        if (err > 3.0) {
+            printf("  %s: mean error %.2f\n", c.label, err);
+            TEST_ASSERT(false, "Approximation should stay close to the exact Gaussian");
+        }
+
+        /* Rects of one surface must agree with the whole-surface result */
+        std::vector<uint8_t> tile((size_t)37 * 29 * 4);
+        BlurSurface ts = make_surface(tile, 37, 29);
+        cpu_blur_rect(&s, &ts, &k, CPU_BLUR_FULL_FRAME, 30, 20);
+        for (int32_t y = 0; y < ts.height; y++) {
+            if (memcmp(&tile[(size_t)y * ts.stride], &out[((size_t)(20 + y) * w + 30) * 4], (size_t)ts.stride) != 0) {
+                printf("  %s: row %d\n", c.label, y);
+                TEST_ASSERT(false, "Rect blur should match the whole-surface blur");
+            }
+        }
+
+        std::vector<uint8_t> flat((size_t)w * h * 4, 77);
+        std::vector<uint8_t> flat_expect = flat;
+        BlurSurface fs = make_surface(flat, w, h);
+        cpu_blur(&fs, &fs, &k, CPU_BLUR_STREAMING);
+        TEST_ASSERT(flat == flat_expect, "Flat input is unchanged by approximate kernels");
+    }
+    TEST_ASSERT(true, "Box, pyramid and downsampled kernels approximate the Gaussian");
+
+    return 0;
+}
+
+int main() {
+    printf("=== cpu_blur Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: kernel\n");
+    failures += test_kernel();
+    printf("\n");
+
+    printf("Test: identity\n");
+    failures += test_identity();
+    printf("\n");
+
+    printf("Test: streaming_matches_full_frame\n");
+    failures += test_streaming_matches_full_frame();
+    printf("\n");
+
+    printf("Test: blocked_vertical_matches_rows\n");
+    failures += test_blocked_vertical_matches_rows();
+    printf("\n");
+
+    printf("Test: flat_input\n");
+    failures += test_flat_input();
+    printf("\n");
+
+    printf("Test: scratch_bounds\n");
+    failures += test_scratch_bounds();
+    printf("\n");
+
+    printf("Test: approx_algorithms\n");
+    failures += test_approx_algorithms();
+    printf("\n");
+
+    printf("Test: linear_light\n");
+    failures += test_linear_light();
+    printf("\n");
+
+    printf("Test: invalid_args\n");
+    failures += test_invalid_args();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
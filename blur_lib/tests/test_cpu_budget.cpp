@@ -0,0 +1,164 @@
+/*
+ * test_cpu_budget.cpp - Tests for the process-wide refresh CPU budget
+ *
+ * Windows run on a simulated clock with a fixed cost per refresh: each one
+ * refreshes whenever its granted interval has passed, as the refresh tick
+ * does, and reports what the refresh cost.
+ */
+
+#include "cpu_budget.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+struct SimWindow {
+    uint64_t handle;
+    uint32_t requested_ms;
+    uint64_t cost_us;
+    uint64_t next_ms;
+    uint32_t refreshes;
+};
+
+/* Time for the first refreshes, which every window makes before it has been measured */
+#define WARMUP_MS 2000
+
+/*
+ * Runs the windows for WARMUP_MS plus ms milliseconds; returns the CPU time
+ * spent after the warm-up in per mille of one core, and counts refreshes
+ * after the warm-up.
+ */
+static double simulate(CpuBudget* budget, std::vector<SimWindow>* windows, uint64_t ms) {
+    uint64_t spent = 0;
+    for (SimWindow& w : *windows) {
+        w.next_ms = 0;
+        w.refreshes = 0;
+    }
+    for (uint64_t now = 0; now < WARMUP_MS + ms; now++) {
+        for (SimWindow& w : *windows) {
+            if (now < w.next_ms) continue;
+            budget->record_frame(w.handle, w.cost_us);
+            if (now >= WARMUP_MS) {
+                spent += w.cost_us;
+                w.refreshes++;
+            }
+            w.next_ms = now + budget->interval_ms(w.handle);
+        }
+    }
+    return (double)spent / (double)ms;
+}
+
+static std::vector<SimWindow> make_windows(CpuBudget* budget, uint32_t count, uint64_t cost_us) {
+    std::vector<SimWindow> windows;
+    for (uint32_t i = 0; i < count; i++) {
+        SimWindow w = { 0x1000 + i, 100, cost_us, 0, 0 };
+        budget->track(w.handle, w.requested_ms);
+        windows.push_back(w);
+    }
+    return windows;
+}
+
+int test_unlimited() {
+    CpuBudget budget;
+    std::vector<SimWindow> windows = make_windows(&budget, 8, 5000);
+    double used = simulate(&budget, &windows, 10000);
+    printf("  8 windows, no budget: %.1f per mille\n", used);
+    TEST_ASSERT(used > 390.0, "Without a budget every window refreshes as requested");
+    TEST_ASSERT(budget.interval_ms(windows[0].handle) == 100, "Granted interval is the requested one");
+    TEST_ASSERT(budget.interval_ms(0x42) == 0, "Untracked windows have no interval");
+    return 0;
+}
+
+int test_budget_caps_total() {
+    CpuBudget budget;
+    budget.set_budget(50);
+    std::vector<SimWindow> windows = make_windows(&budget, 8, 5000);
+    budget.set_foreground(windows[0].handle);
+    double used = simulate(&budget, &windows, 20000);
+    printf("  8 windows at 5%%: %.1f per mille, foreground %u refreshes, others %u\n", used,
+           windows[0].refreshes, windows[1].refreshes);
+    TEST_ASSERT(used <= 50.0 * 1.05, "All windows together stay within the budget");
+    TEST_ASSERT(used >= 50.0 * 0.85, "... and use most of it");
+    TEST_ASSERT(budget.used_per_mille() <= 50, "Granted intervals fit the budget");
+
+    double ratio = (double)windows[0].refreshes / (double)windows[1].refreshes;
+    TEST_ASSERT(ratio > 3.5 && ratio < 4.5, "The foreground window refreshes about four times as often");
+    TEST_ASSERT(windows[1].refreshes == windows[7].refreshes, "Background windows share alike");
+    return 0;
+}
+
+int test_cheap_window_keeps_rate() {
+    CpuBudget budget;
+    budget.set_budget(50);
+    std::vector<SimWindow> windows = make_windows(&budget, 4, 20000);
+    SimWindow cheap = { 0x2000, 100, 100, 0, 0 };
+    budget.track(cheap.handle, cheap.requested_ms);
+    windows.push_back(cheap);
+    double used = simulate(&budget, &windows, 20000);
+    printf("  4 heavy windows and a cheap one at 5%%: %.1f per mille\n", used);
+    TEST_ASSERT(budget.interval_ms(cheap.handle) == 100, "A window under its share keeps its rate");
+    TEST_ASSERT(windows[4].refreshes >= 199, "... and refreshes every 100 ms");
+    TEST_ASSERT(budget.interval_ms(windows[0].handle) > 100, "Heavy windows slow down");
+    TEST_ASSERT(used <= 50.0 * 1.05, "The heavy ones get what the cheap one leaves");
+    return 0;
+}
+
+int test_interval_cap_and_changes() {
+    CpuBudget budget;
+    budget.set_budget(1);
+    std::vector<SimWindow> windows = make_windows(&budget, 4, 50000);
+    simulate(&budget, &windows, 5000);
+    TEST_ASSERT(budget.interval_ms(windows[0].handle) == CPU_BUDGET_MAX_INTERVAL_MS,
+                "A starved window still refreshes every CPU_BUDGET_MAX_INTERVAL_MS");
+
+    budget.set_budget(2500);
+    TEST_ASSERT(budget.interval_ms(windows[0].handle) == 100, "A bigger budget restores the requested rate");
+
+    budget.set_budget(100);
+    uint32_t before = budget.interval_ms(windows[0].handle);
+    for (size_t i = 1; i < windows.size(); i++) budget.untrack(windows[i].handle);
+    TEST_ASSERT(budget.interval_ms(windows[0].handle) < before, "Removed windows leave their share to the rest");
+
+    budget.track(0x3000, 50);
+    TEST_ASSERT(budget.interval_ms(0x3000) == 50, "A window not measured yet refreshes as requested");
+
+    std::string json;
+    budget.to_json(&json);
+    TEST_ASSERT(json.find("\"budget_per_mille\":100") != std::string::npos &&
+                json.find("\"requested_ms\":50") != std::string::npos, "Diagnostics list the budget and windows");
+    return 0;
+}
+
+int main() {
+    printf("=== cpu_budget Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: unlimited\n");
+    failures += test_unlimited();
+    printf("\n");
+
+    printf("Test: budget_caps_total\n");
+    failures += test_budget_caps_total();
+    printf("\n");
+
+    printf("Test: cheap_window_keeps_rate\n");
+    failures += test_cheap_window_keeps_rate();
+    printf("\n");
+
+    printf("Test: interval_cap_and_changes\n");
+    failures += test_interval_cap_and_changes();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
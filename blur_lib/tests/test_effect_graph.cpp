@@ -0,0 +1,318 @@
+/*
+ * test_effect_graph.cpp - Tests for effect graphs and their fusion into the blur
+ */
+
+#include "effect_graph.h"
+#include "effect_params.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* Premultiplied noise: every channel at or below its alpha */
+static void fill_premultiplied(std::vector<uint8_t>& buf, uint32_t seed) {
+    for (size_t i = 0; i < buf.size(); i += 4) {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t a = (i / 4) % 7 == 0 ? (seed >> 24) : 255;
+        for (int32_t ch = 0; ch < 3; ch++) {
+            seed = seed * 1664525u + 1013904223u;
+            buf[i + ch] = (uint8_t)((seed >> 24) * a / 255);
+        }
+        buf[i + 3] = (uint8_t)a;
+    }
+}
+
+static BlurSurface make_surface(std::vector<uint8_t>& buf, int32_t w, int32_t h) {
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+    return s;
+}
+
+static BlurEffectList_V1 acrylic_list() {
+    BlurEffectList_V1 list = {};
+    list.struct_version = 1;
+    list.effect_count = 6;
+    list.effects[0] = { BLUR_EFFECT_SATURATION, 0, 1.25f, 0 };
+    list.effects[1] = { BLUR_EFFECT_LUMINOSITY, 0x99303040, 0.0f, 0 };
+    list.effects[2] = { BLUR_EFFECT_EXCLUSION, 0x20FFFFFF, 0.0f, 0 };
+    list.effects[3] = { BLUR_EFFECT_TINT, 0x40102038, 0.0f, 0 };
+    list.effects[4] = { BLUR_EFFECT_NOISE, 0, 0.04f, 0 };
+    list.effects[5] = { BLUR_EFFECT_VIGNETTE, 0, 0.35f, 0 };
+    return list;
+}
+
+int test_params() {
+    struct {
+        EffectParamsRegions_V2 ext;
+        BlurEffectList_V1 effects;
+    } both;
+    memset(&both, 0, sizeof(both));
+    both.ext.params.struct_version = 2;
+    both.ext.params.intensity = 0.5f;
+    both.ext.regions.struct_version = 1;
+    both.effects = acrylic_list();
+
+    const EffectParams* p = (const EffectParams*)&both.ext.params;
+    BlurSettings set;
+    TEST_ASSERT(read_effect_params(p, &set, nullptr) == BLUR_SUCCESS && !set.effects, "No flag means no effect list");
+
+    both.ext.params.reserved_flags = BLUR_PARAMS_FLAG_REGIONS | BLUR_PARAMS_FLAG_EFFECTS;
+    TEST_ASSERT(read_effect_params(p, &set, nullptr) == BLUR_SUCCESS && set.effects == &both.effects,
+                "Effects follow the region list");
+
+    EffectParamsEffects_V1 v1;
+    memset(&v1, 0, sizeof(v1));
+    v1.params.struct_version = 1;
+    v1.params.reserved_flags = BLUR_PARAMS_FLAG_EFFECTS;
+    v1.effects = acrylic_list();
+    TEST_ASSERT(read_effect_params(&v1.params, &set, nullptr) == BLUR_SUCCESS && set.effects == &v1.effects,
+                "... or the params directly");
+
+    const char* error = nullptr;
+    BlurEffectList_V1& list = both.effects;
+    list.effects[4].amount = 1.5f;
+    TEST_ASSERT(read_effect_params(p, &set, &error) == BLUR_INVALID_PARAMS && error &&
+                !strcmp(error, "Invalid effect list"), "Noise beyond 1.0 is rejected");
+    list = acrylic_list();
+    list.effects[0].amount = -0.5f;
+    TEST_ASSERT(validate_effect_list(&list) == BLUR_INVALID_PARAMS, "Negative saturation is rejected");
+    list = acrylic_list();
+    list.effects[2].type = 99;
+    TEST_ASSERT(validate_effect_list(&list) == BLUR_INVALID_PARAMS, "Unknown node types are rejected");
+    list = acrylic_list();
+    list.effects[1].reserved = 1;
+    TEST_ASSERT(validate_effect_list(&list) == BLUR_INVALID_PARAMS, "Reserved fields must be zero");
+    list = acrylic_list();
+    list.effect_count = BLUR_MAX_EFFECTS + 1;
+    TEST_ASSERT(validate_effect_list(&list) == BLUR_INVALID_PARAMS, "Too many nodes are rejected");
+    list = acrylic_list();
+    list.struct_version = 2;
+    TEST_ASSERT(validate_effect_list(&list) == BLUR_INVALID_PARAMS, "Unknown list versions are rejected");
+    return 0;
+}
+
+int test_compile() {
+    BlurEffectList_V1 list = acrylic_list();
+    EffectProgram prog;
+    TEST_ASSERT(compile_effect_graph(&list, &prog) == BLUR_SUCCESS && prog.count == 6, "Every active node is kept");
+
+    list.effects[0].amount = 1.0f;
+    list.effects[3].color_argb = 0x00FFFFFF;
+    list.effects[5].amount = 0.0f;
+    TEST_ASSERT(compile_effect_graph(&list, &prog) == BLUR_SUCCESS && prog.count == 3 &&
+                prog.nodes[0].source.type == BLUR_EFFECT_LUMINOSITY &&
+                prog.nodes[2].source.type == BLUR_EFFECT_NOISE, "Identity nodes are dropped, order kept");
+
+    /* Recompiling the kept nodes, as a replay does, gives the same program */
+    BlurEffectList_V1 kept = {};
+    kept.struct_version = 1;
+    kept.effect_count = prog.count;
+    for (uint32_t i = 0; i < prog.count; i++) kept.effects[i] = prog.nodes[i].source;
+    EffectProgram again;
+    TEST_ASSERT(compile_effect_graph(&kept, &again) == BLUR_SUCCESS && again.count == prog.count &&
+                !memcmp(again.nodes, prog.nodes, prog.count * sizeof(EffectNode)),
+                "Compiling a program's sources repeats it");
+
+    TEST_ASSERT(compile_effect_graph(nullptr, &prog) == BLUR_SUCCESS && prog.count == 0, "No list, no nodes");
+    return 0;
+}
+
+int test_nodes() {
+    const int32_t w = 64, h = 48;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    fill_premultiplied(src, 3);
+    const RegionRect all = { 0, 0, w, h };
+
+    /* Tint nodes are the legacy tint */
+    BlurEffectList_V1 list = {};
+    list.struct_version = 1;
+    list.effect_count = 1;
+    list.effects[0] = { BLUR_EFFECT_TINT, 0x80336699, 0.0f, 0 };
+    EffectProgram prog;
+    compile_effect_graph(&list, &prog);
+    std::vector<uint8_t> a = src, b = src;
+    BlurSurface as = make_surface(a, w, h), bs = make_surface(b, w, h);
+    apply_effect_program(&prog, &as, all, true);
+    cpu_fill_tint(&bs, 0x80336699);
+    TEST_ASSERT(a == b, "Tint nodes match cpu_fill_tint");
+
+    /* Saturation 0 leaves grey */
+    list.effects[0] = { BLUR_EFFECT_SATURATION, 0, 0.0f, 0 };
+    compile_effect_graph(&list, &prog);
+    a = src;
+    apply_effect_program(&prog, &as, all, true);
+    bool grey = true;
+    for (size_t i = 0; i < a.size(); i += 4) grey = grey && a[i] == a[i + 1] && a[i + 1] == a[i + 2];
+    TEST_ASSERT(grey, "Saturation 0 leaves grey");
+
+    /* Exclusion with opaque white inverts opaque pixels */
+    list.effects[0] = { BLUR_EFFECT_EXCLUSION, 0xFFFFFFFF, 0.0f, 0 };
+    compile_effect_graph(&list, &prog);
+    a = src;
+    apply_effect_program(&prog, &as, all, true);
+    bool inverted = true;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        if (src[i + 3] != 255) continue;
+        for (int32_t ch = 0; ch < 3; ch++) inverted = inverted && a[i + ch] == 255 - src[i + ch];
+    }
+    TEST_ASSERT(inverted, "Exclusion with white inverts");
+
+    /* Luminosity takes the color's luma, keeping the pixel's alpha */
+    list.effects[0] = { BLUR_EFFECT_LUMINOSITY, 0xFF808080, 0.0f, 0 };
+    compile_effect_graph(&list, &prog);
+    a = src;
+    apply_effect_program(&prog, &as, all, true);
+    int32_t worst = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        if (src[i + 3] != 255) continue;
+        int32_t l = (a[i] * 19 + a[i + 1] * 183 + a[i + 2] * 54 + 128) >> 8;
+        worst = std::max(worst, std::abs(l - 128));
+    }
+    printf("  luminosity: largest luma error %d\n", worst);
+    TEST_ASSERT(worst <= 2, "Luminosity blends take the color's luma");
+
+    /* Vignette keeps the centre and darkens the corners */
+    std::vector<uint8_t> flat((size_t)w * h * 4, 200);
+    list.effects[0] = { BLUR_EFFECT_VIGNETTE, 0, 1.0f, 0 };
+    compile_effect_graph(&list, &prog);
+    BlurSurface fs = make_surface(flat, w, h);
+    apply_effect_program(&prog, &fs, all, true);
+    const uint8_t* centre = &flat[((size_t)(h / 2) * w + w / 2) * 4];
+    TEST_ASSERT(centre[0] >= 199 && flat[0] < 10 && flat[3] == 200, "Vignette darkens toward the corners, not alpha");
+
+    /* Noise is zero-mean and tied to window positions */
+    flat.assign(flat.size(), 128);
+    for (size_t i = 3; i < flat.size(); i += 4) flat[i] = 255;
+    list.effects[0] = { BLUR_EFFECT_NOISE, 0, 0.25f, 0 };
+    compile_effect_graph(&list, &prog);
+    apply_effect_program(&prog, &fs, all, true);
+    int64_t sum = 0;
+    bool monochrome = true, bounded = true;
+    for (size_t i = 0; i < flat.size(); i += 4) {
+        sum += flat[i] - 128;
+        monochrome = monochrome && flat[i] == flat[i + 1] && flat[i + 1] == flat[i + 2];
+        bounded = bounded && std::abs(flat[i] - 128) <= 16;
+    }
+    TEST_ASSERT(monochrome && bounded, "Noise is grey and within its amplitude");
+    TEST_ASSERT(std::abs(sum) < (int64_t)w * h, "Noise is close to zero-mean");
+
+    /* Every node keeps premultiplied pixels valid */
+    list = acrylic_list();
+    list.effects[0].amount = 4.0f;
+    list.effects[4].amount = 1.0f;
+    compile_effect_graph(&list, &prog);
+    a = src;
+    apply_effect_program(&prog, &as, all, true);
+    bool valid = true;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        valid = valid && a[i] <= a[i + 3] && a[i + 1] <= a[i + 3] && a[i + 2] <= a[i + 3];
+    }
+    TEST_ASSERT(valid, "Channels stay at or below alpha");
+    return 0;
+}
+
+int test_fused_matches_unfused() {
+    const int32_t w = 97, h = 61;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    fill_premultiplied(src, 11);
+    BlurEffectList_V1 list = acrylic_list();
+    EffectProgram prog;
+    compile_effect_graph(&list, &prog);
+    const RegionRect all = { 0, 0, w, h };
+
+    std::vector<uint8_t> per_node = src, fused = src, tiled = src;
+    BlurSurface ps = make_surface(per_node, w, h), fs = make_surface(fused, w, h), ts = make_surface(tiled, w, h);
+    apply_effect_program(&prog, &ps, all, false);
+    apply_effect_program(&prog, &fs, all, true);
+    TEST_ASSERT(per_node != src && fused == per_node, "One pass matches a pass per node");
+
+    /* Any tiling, in any order: nodes only depend on the pixel and its window position */
+    const RegionRect tiles[4] = { { 40, 30, 97, 61 }, { 0, 0, 40, 61 }, { 40, 0, 97, 13 }, { 40, 13, 97, 30 } };
+    for (const RegionRect& r : tiles) apply_effect_program(&prog, &ts, r, true);
+    TEST_ASSERT(tiled == per_node, "Tiles in any order match the whole surface");
+    return 0;
+}
+
+int test_fused_into_blur() {
+    const int32_t w = 150, h = 90;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    fill_premultiplied(src, 5);
+    BlurEffectList_V1 list = acrylic_list();
+    EffectProgram prog;
+    compile_effect_graph(&list, &prog);
+
+    BlurRegionList_V1 regions = {};
+    regions.struct_version = 1;
+    regions.rect_count = 2;
+    regions.rects[0] = { 5, 4, 90, 50, 0 };
+    regions.rects[1] = { 60, 40, 140, 85, 0 };
+
+    struct Case { const char* name; uint32_t algorithm; int32_t downsample; CpuBlurMode mode; } cases[] = {
+        { "exact", BLUR_ALGORITHM_EXACT, 1, CPU_BLUR_FULL_FRAME },
+        { "exact streaming", BLUR_ALGORITHM_EXACT, 1, CPU_BLUR_STREAMING },
+        { "box", BLUR_ALGORITHM_BOX, 1, CPU_BLUR_FULL_FRAME },
+        { "pyramid", BLUR_ALGORITHM_PYRAMID, 1, CPU_BLUR_FULL_FRAME },
+        { "exact / 2", BLUR_ALGORITHM_EXACT, 2, CPU_BLUR_FULL_FRAME },
+        { "iir", BLUR_ALGORITHM_IIR, 1, CPU_BLUR_FULL_FRAME },
+    };
+    for (const Case& c : cases) {
+        BlurKernel k;
+        build_blur_kernel(6.0f, c.algorithm, c.downsample, &k);
+        RegionBlurPlan plan;
+        plan_region_blur(&regions, w, h, k.radius, &plan);
+
+        std::vector<uint8_t> unfused = src, fused = src;
+        BlurSurface us = make_surface(unfused, w, h), fs = make_surface(fused, w, h);
+        /* Unfused: the blur, then a pass per node */
+        cpu_blur_regions(&us, &k, c.mode, &plan, 0);
+        for (const RegionRect& r : plan.output) apply_effect_program(&prog, &us, r, false);
+        if (cpu_blur_regions(&fs, &k, c.mode, &plan, 0, &prog) != BLUR_SUCCESS) {
+            TEST_ASSERT(false, "Fused blur succeeds");
+        }
+        if (fused != unfused) {
+            printf("  %s differs\n", c.name);
+            TEST_ASSERT(false, "Effects fused into the blur match separate passes");
+        }
+    }
+    TEST_ASSERT(true, "Effects fused into every blur engine match separate passes");
+    return 0;
+}
+
+int main() {
+    printf("=== effect_graph Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: params\n");
+    failures += test_params();
+    printf("\n");
+
+    printf("Test: compile\n");
+    failures += test_compile();
+    printf("\n");
+
+    printf("Test: nodes\n");
+    failures += test_nodes();
+    printf("\n");
+
+    printf("Test: fused_matches_unfused\n");
+    failures += test_fused_matches_unfused();
+    printf("\n");
+
+    printf("Test: fused_into_blur\n");
+    failures += test_fused_into_blur();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
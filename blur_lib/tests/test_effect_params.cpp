@@ -0,0 +1,158 @@
+/*
+ * test_effect_params.cpp - Tests for V1/V2 EffectParams decoding
+ */
+
+#include "effect_params.h"
+#include "region.h"
+#include <cstddef>
+#include <cstdio>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+int test_layout() {
+    TEST_ASSERT(sizeof(EffectParams_V1) == 25, "V1 layout is unchanged");
+    TEST_ASSERT(sizeof(EffectParams_V2) == 57, "V2 layout is 57 bytes");
+    TEST_ASSERT(offsetof(EffectParams_V2, reserved_flags) == offsetof(EffectParams_V1, reserved_flags) &&
+                offsetof(EffectParams_V2, algorithm) == sizeof(EffectParams_V1),
+                "V2 starts with the V1 fields");
+    return 0;
+}
+
+int test_v1_defaults() {
+    EffectParams p = {};
+    p.struct_version = 1;
+    p.intensity = 0.5f;
+    p.color_argb = 0x20FFFFFF;
+
+    BlurSettings s;
+    TEST_ASSERT(read_effect_params(&p, &s, nullptr) == BLUR_SUCCESS, "V1 params are accepted");
+    TEST_ASSERT(s.intensity == 0.5f && s.color_argb == 0x20FFFFFF, "V1 fields are copied");
+    TEST_ASSERT(s.algorithm == BLUR_ALGORITHM_EXACT && s.downsample == 1, "V1 uses the exact kernel");
+    TEST_ASSERT(s.refresh_interval_ms == 1000 / BLUR_DEFAULT_REFRESH_HZ, "V1 keeps the default refresh");
+    TEST_ASSERT(s.regions == nullptr, "No region list without the flag");
+    return 0;
+}
+
+int test_v2_fields() {
+    EffectParams_V2 p = {};
+    p.struct_version = 2;
+    p.intensity = 1.0f;
+    p.algorithm = BLUR_ALGORITHM_PYRAMID;
+    p.downsample = 2;
+    p.max_refresh_hz = 60;
+    p.worker_threads = 4;
+    p.frame_budget_us = 4000;
+
+    BlurSettings s;
+    TEST_ASSERT(read_effect_params((const EffectParams*)&p, &s, nullptr) == BLUR_SUCCESS,
+                "V2 params are accepted");
+    TEST_ASSERT(s.algorithm == BLUR_ALGORITHM_PYRAMID && s.downsample == 2, "Quality knobs are read");
+    TEST_ASSERT(s.refresh_interval_ms == 17, "60 Hz rounds up to a 17 ms interval");
+    TEST_ASSERT(s.worker_threads == 4 && s.frame_budget_us == 4000, "Budgets are read");
+
+    BlurKernel k;
+    build_settings_kernel(s, 1920 * 1080, &k);
+    TEST_ASSERT(!kernel_is_direct(&k) && k.scale >= 2, "Settings build a reduced-resolution kernel");
+
+    p.downsample = 0;
+    p.max_refresh_hz = 0;
+    p.algorithm = BLUR_ALGORITHM_EXACT;
+    read_effect_params((const EffectParams*)&p, &s, nullptr);
+    TEST_ASSERT(s.downsample == 1 && s.refresh_interval_ms == 100, "Zero selects the V1 behaviour");
+    build_settings_kernel(s, 1920 * 1080, &k);
+    TEST_ASSERT(kernel_is_direct(&k), "Zeroed V2 builds the direct kernel");
+    return 0;
+}
+
+int test_rejects() {
+    const char* error = nullptr;
+    BlurSettings s;
+    EffectParams_V2 p = {};
+    p.intensity = 0.5f;
+
+    p.struct_version = 3;
+    TEST_ASSERT(read_effect_params((const EffectParams*)&p, &s, &error) == BLUR_INVALID_PARAMS && error,
+                "Unknown struct_version rejected with a message");
+    p.struct_version = 2;
+
+    struct Bad { uint32_t EffectParams_V2::*field; uint32_t value; const char* label; };
+    const Bad bad[] = {
+        { &EffectParams_V2::algorithm, BLUR_ALGORITHM_AUTO + 1, "Unknown algorithm rejected" },
+        { &EffectParams_V2::downsample, BLUR_MAX_DOWNSAMPLE + 1, "Oversized downsample rejected" },
+        { &EffectParams_V2::max_refresh_hz, BLUR_MAX_REFRESH_HZ + 1, "Refresh rate above the cap rejected" },
+        { &EffectParams_V2::worker_threads, BLUR_MAX_WORKER_THREADS + 1, "Thread budget above the cap rejected" },
+    };
+    for (const Bad& b : bad) {
+        EffectParams_V2 q = p;
+        q.*b.field = b.value;
+        TEST_ASSERT(read_effect_params((const EffectParams*)&q, &s, &error) == BLUR_INVALID_PARAMS, b.label);
+    }
+
+    EffectParams_V2 q = p;
+    q.reserved_v2[11] = 1;
+    TEST_ASSERT(read_effect_params((const EffectParams*)&q, &s, &error) == BLUR_INVALID_PARAMS,
+                "Non-zero reserved bytes rejected");
+
+    q = p;
+    q.intensity = 1.5f;
+    TEST_ASSERT(read_effect_params((const EffectParams*)&q, &s, &error) == BLUR_INVALID_PARAMS,
+                "Intensity out of range rejected");
+    return 0;
+}
+
+int test_v2_regions() {
+    EffectParamsRegions_V2 ext = {};
+    ext.params.struct_version = 2;
+    ext.params.intensity = 0.5f;
+    ext.params.reserved_flags = BLUR_PARAMS_FLAG_REGIONS;
+    ext.regions.struct_version = 1;
+    ext.regions.rect_count = 1;
+    ext.regions.rects[0] = { 0, 0, 10, 10, 0 };
+
+    BlurSettings s;
+    TEST_ASSERT(read_effect_params((const EffectParams*)&ext.params, &s, nullptr) == BLUR_SUCCESS,
+                "V2 params with regions are accepted");
+    TEST_ASSERT(s.regions == &ext.regions, "The region list follows the V2 struct");
+
+    ext.regions.rect_count = BLUR_MAX_REGIONS + 1;
+    TEST_ASSERT(read_effect_params((const EffectParams*)&ext.params, &s, nullptr) == BLUR_INVALID_PARAMS,
+                "Invalid trailing list rejected");
+    return 0;
+}
+
+int main() {
+    printf("=== effect_params Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: layout\n");
+    failures += test_layout();
+    printf("\n");
+
+    printf("Test: v1_defaults\n");
+    failures += test_v1_defaults();
+    printf("\n");
+
+    printf("Test: v2_fields\n");
+    failures += test_v2_fields();
+    printf("\n");
+
+    printf("Test: rejects\n");
+    failures += test_rejects();
+    printf("\n");
+
+    printf("Test: v2_regions\n");
+    failures += test_v2_regions();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,177 @@
+/*
+ * test_error_state.cpp - Tests for per-thread errors and error counters
+ *
+ * Linux only: replaces pthread_mutex_lock to check that recording and
+ * reading errors never takes a lock.
+ */
+
+#include "error_state.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* ============================================================================
+ * Lock counting
+ * ============================================================================ */
+static thread_local bool t_counting = false;
+static std::atomic<long> g_mutex_locks(0);
+
+typedef int (*MutexLockFunc)(pthread_mutex_t*);
+static MutexLockFunc g_real_lock = nullptr;
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (t_counting) g_mutex_locks++;
+    return g_real_lock(mutex);
+}
+
+/* Resolved before main so the first lock never races the lookup */
+__attribute__((constructor)) static void resolve_mutex_lock(void) {
+    g_real_lock = (MutexLockFunc)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================ */
+int test_messages() {
+    char text[128];
+    error_clear();
+    TEST_ASSERT(error_code() == BLUR_SUCCESS, "A thread starts without an error");
+    error_format(text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "No error") == 0, "No error formats as such");
+
+    error_set(BLUR_INVALID_HANDLE, ERR_MSG_INVALID_HANDLE);
+    error_format(text, sizeof(text));
+    TEST_ASSERT(error_code() == BLUR_INVALID_HANDLE && strcmp(text, "Invalid window handle") == 0,
+                "Static messages keep their code and text");
+
+    error_set(BLUR_INTERNAL_ERROR, ERR_MSG_DWM_FAILED, 0x80070005u);
+    error_format(text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "DwmEnableBlurBehindWindow failed with HRESULT 0x80070005") == 0,
+                "The argument is formatted on demand");
+
+    error_set(BLUR_INVALID_PARAMS, ERR_MSG_DETAIL, 0, "Intensity out of range");
+    error_format(text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "Intensity out of range") == 0, "Detail text is reported as is");
+
+    char small[8];
+    size_t n = error_format(small, sizeof(small));
+    TEST_ASSERT(n == 7 && strcmp(small, "Intensi") == 0, "A short buffer is truncated and terminated");
+
+    bool other_clean = false;
+    std::thread([&]() { other_clean = error_code() == BLUR_SUCCESS; }).join();
+    TEST_ASSERT(other_clean, "Another thread does not see this thread's error");
+    return 0;
+}
+
+int test_counters() {
+    error_counts_reset();
+    error_set(BLUR_INVALID_HANDLE, ERR_MSG_INVALID_HANDLE);
+    error_set(BLUR_INVALID_HANDLE, ERR_MSG_INVALID_HANDLE);
+    error_set(BLUR_TIMEOUT, ERR_MSG_NONE);
+    TEST_ASSERT(error_count(BLUR_INVALID_HANDLE) == 2 && error_count(BLUR_TIMEOUT) == 1,
+                "Each code is counted");
+    TEST_ASSERT(error_count(-1) == 0 && error_count(BLUR_ERROR_CODE_COUNT) == 0, "Unknown codes read as zero");
+
+    error_set(1000, ERR_MSG_NONE);
+    TEST_ASSERT(error_code() == 1000, "Codes outside the counted range are still recorded");
+    error_counts_reset();
+    TEST_ASSERT(error_count(BLUR_INVALID_HANDLE) == 0, "Counters reset");
+    return 0;
+}
+
+int test_stress() {
+    const int threads = 8;
+    const uint32_t iterations = 200000;
+    error_counts_reset();
+
+    std::mutex probe;
+    t_counting = true;
+    probe.lock();
+    t_counting = false;
+    probe.unlock();
+    TEST_ASSERT(g_mutex_locks.load() == 1, "The counting hook sees mutex locks");
+    g_mutex_locks = 0;
+
+    /* Each thread records its own errors and must always read back its own */
+    std::atomic<long> clobbered(0);
+    std::atomic<int> ready(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            int32_t code = 1 + t % (BLUR_ERROR_CODE_COUNT - 1);
+            char text[128], want[128];
+            ready++;
+            while (ready.load() < threads) {
+            }
+            t_counting = true;
+            for (uint32_t i = 0; i < iterations; i++) {
+                uint64_t arg = (uint64_t)t * 1000000 + i;
+                error_set(code, ERR_MSG_SWCA_FAILED, arg);
+                if (error_code() != code) clobbered++;
+                if ((i & 63) == 0) {
+                    error_format(text, sizeof(text));
+                    t_counting = false;
+                    snprintf(want, sizeof(want), "SetWindowCompositionAttribute failed with error %lu",
+                             (unsigned long)arg);
+                    t_counting = true;
+                    if (strcmp(text, want) != 0) clobbered++;
+                }
+            }
+            t_counting = false;
+        });
+    }
+    for (std::thread& w : workers) w.join();
+
+    TEST_ASSERT(clobbered.load() == 0, "Threads never see each other's errors");
+    TEST_ASSERT(g_mutex_locks.load() == 0, "Recording and formatting errors takes no lock");
+
+    uint64_t total = 0;
+    bool exact = true;
+    for (int32_t code = 1; code < BLUR_ERROR_CODE_COUNT; code++) {
+        uint64_t expected = 0;
+        for (int t = 0; t < threads; t++) {
+            if (1 + t % (BLUR_ERROR_CODE_COUNT - 1) == code) expected += iterations;
+        }
+        exact = exact && error_count(code) == expected;
+        total += error_count(code);
+    }
+    printf("  %llu errors recorded by %d threads\n", (unsigned long long)total, threads);
+    TEST_ASSERT(exact, "Per-code counters lose no concurrent updates");
+    return 0;
+}
+
+int main() {
+    printf("=== error_state Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: messages\n");
+    failures += test_messages();
+    printf("\n");
+
+    printf("Test: counters\n");
+    failures += test_counters();
+    printf("\n");
+
+    printf("Test: stress\n");
+    failures += test_stress();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,211 @@
+/*
+ * test_executor.cpp - Tests for the work-stealing executor and its lanes
+ *
+ * Tasks that need other workers to run alongside them wait until those have
+ * started, so the tests behave the same on one CPU and on a loaded host.
+ */
+
+#include "executor.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static std::atomic<int> g_count(0);
+
+static void count_task(void*) {
+    g_count++;
+}
+
+static void sleep_task(void*) {
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+    g_count++;
+}
+
+static void wait_until(const std::atomic<int>& value, int target) {
+    while (value.load() < target) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/* Holds its worker until a second one has started: only another worker can run that one */
+static void rendezvous_task(void*) {
+    g_count++;
+    wait_until(g_count, 2);
+}
+
+int test_all_tasks_run() {
+    TEST_ASSERT(executor_start(3) == BLUR_SUCCESS, "Executor starts");
+    TEST_ASSERT(executor_start(2) == BLUR_ALREADY_APPLIED, "A running executor cannot restart");
+    TEST_ASSERT(executor_running() && executor_workers() == 3, "The requested workers run");
+    executor_reset_stats();
+
+    g_count = 0;
+    TaskGroup group;
+    bool queued = true;
+    for (int i = 0; i < 1000; i++) queued = executor_submit(i % 2, count_task, nullptr, &group) && queued;
+    TEST_ASSERT(queued, "Submitted tasks are queued");
+    executor_wait(&group, EXECUTOR_LANE_INTERACTIVE);
+    TEST_ASSERT(g_count.load() == 1000 && group.pending.load() == 0, "Waiting returns once every task ran");
+
+    ExecutorStats st;
+    executor_get_stats(&st);
+    TEST_ASSERT(st.executed[EXECUTOR_LANE_INTERACTIVE] == 500 && st.executed[EXECUTOR_LANE_BACKGROUND] == 500,
+                "Tasks run on the lane they were submitted to");
+    TEST_ASSERT(st.inline_runs == 0, "Nothing runs inline while the executor runs");
+    executor_stop();
+    TEST_ASSERT(!executor_running() && executor_workers() == 0, "Executor stops");
+    return 0;
+}
+
+/* Records the order tasks ran in; the first task blocks the only worker until released */
+struct OrderTask {
+    std::mutex* mutex;
+    std::vector<int>* order;
+    std::atomic<bool>* gate;
+    std::atomic<bool>* started;
+    int id;
+};
+
+static void order_task(void* ctx) {
+    OrderTask* t = (OrderTask*)ctx;
+    if (t->gate) {
+        t->started->store(true);
+        while (!t->gate->load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> lock(*t->mutex);
+    t->order->push_back(t->id);
+    g_count++;
+}
+
+int test_interactive_first() {
+    executor_start(1);
+    std::mutex mutex;
+    std::vector<int> order;
+    std::atomic<bool> gate(false), started(false);
+
+    g_count = 0;
+    OrderTask blocker = { &mutex, &order, &gate, &started, -1 };
+    executor_submit(EXECUTOR_LANE_BACKGROUND, order_task, &blocker, nullptr);
+    while (!started.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    /* Background work queued first still waits for every interactive task */
+    OrderTask tasks[10];
+    for (int i = 0; i < 10; i++) {
+        tasks[i] = { &mutex, &order, nullptr, nullptr, i };
+        executor_submit(i < 5 ? EXECUTOR_LANE_BACKGROUND : EXECUTOR_LANE_INTERACTIVE, order_task, &tasks[i], nullptr);
+    }
+    gate = true;
+    wait_until(g_count, 11);
+
+    bool interactive_first = order.size() == 11;
+    for (size_t i = 1; i < 6 && interactive_first; i++) interactive_first = order[i] >= 5;
+    TEST_ASSERT(interactive_first, "Interactive tasks run before queued background tasks");
+    executor_stop();
+    return 0;
+}
+
+static TaskGroup g_children;
+
+static void spawn_task(void*) {
+    for (int i = 0; i < 64; i++) executor_submit(EXECUTOR_LANE_BACKGROUND, rendezvous_task, nullptr, &g_children);
+}
+
+int test_stealing() {
+    executor_start(4);
+    executor_reset_stats();
+    g_count = 0;
+
+    /* One worker queues every child locally; the idle ones have to steal them */
+    TaskGroup parent;
+    executor_submit(EXECUTOR_LANE_BACKGROUND, spawn_task, nullptr, &parent);
+    executor_wait(&parent, EXECUTOR_LANE_INTERACTIVE);
+    executor_wait(&g_children, EXECUTOR_LANE_INTERACTIVE);
+
+    ExecutorStats st;
+    executor_get_stats(&st);
+    printf("  stolen %llu of 64\n", (unsigned long long)st.stolen);
+    TEST_ASSERT(g_count.load() == 64, "Every child task ran");
+    TEST_ASSERT(st.stolen > 0, "Idle workers steal from a busy worker's deque");
+    executor_stop();
+    return 0;
+}
+
+static void nested_task(void*) {
+    TaskGroup inner;
+    for (int i = 0; i < 8; i++) executor_submit(EXECUTOR_LANE_BACKGROUND, count_task, nullptr, &inner);
+    executor_wait(&inner, EXECUTOR_LANE_INTERACTIVE);
+    g_count += 100;
+}
+
+int test_nested_wait() {
+    /* The only worker waits on its own children: it has to run them itself */
+    executor_start(1);
+    g_count = 0;
+    TaskGroup outer;
+    for (int i = 0; i < 3; i++) executor_submit(EXECUTOR_LANE_BACKGROUND, nested_task, nullptr, &outer);
+    executor_wait(&outer, EXECUTOR_LANE_INTERACTIVE);
+    TEST_ASSERT(g_count.load() == 3 * 108, "A worker waiting inside a task runs the tasks it waits for");
+    executor_stop();
+    return 0;
+}
+
+int test_stop_drains() {
+    executor_start(2);
+    executor_reset_stats();
+    g_count = 0;
+    for (int i = 0; i < 100; i++) executor_submit(i % 2, sleep_task, nullptr, nullptr);
+    executor_stop();
+    TEST_ASSERT(g_count.load() == 100, "Stopping runs every queued task first");
+
+    TaskGroup group;
+    TEST_ASSERT(!executor_submit(EXECUTOR_LANE_INTERACTIVE, count_task, nullptr, &group),
+                "Submitting to a stopped executor reports it");
+    executor_wait(&group, EXECUTOR_LANE_INTERACTIVE);
+    ExecutorStats st;
+    executor_get_stats(&st);
+    TEST_ASSERT(g_count.load() == 101 && st.inline_runs == 1, "A stopped executor runs tasks inline");
+
+    TEST_ASSERT(executor_start(1) == BLUR_SUCCESS, "A stopped executor restarts");
+    executor_stop();
+    return 0;
+}
+
+int main() {
+    printf("=== executor Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: all_tasks_run\n");
+    failures += test_all_tasks_run();
+    printf("\n");
+
+    printf("Test: interactive_first\n");
+    failures += test_interactive_first();
+    printf("\n");
+
+    printf("Test: stealing\n");
+    failures += test_stealing();
+    printf("\n");
+
+    printf("Test: nested_wait\n");
+    failures += test_nested_wait();
+    printf("\n");
+
+    printf("Test: stop_drains\n");
+    failures += test_stop_drains();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
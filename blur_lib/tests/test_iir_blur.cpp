@@ -0,0 +1,290 @@
+/*
+ * test_iir_blur.cpp - Tests for the recursive (IIR) Gaussian
+ */
+
+#include "cpu_blur.h"
+#include "effect_graph.h"
+#include "region.h"
+#include "scratch_arena.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static void fill_noise(std::vector<uint8_t>& buf, uint32_t seed) {
+    for (size_t i = 0; i < buf.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+/* Bars, a gradient and a hard edge at the borders, where clamping matters */
+static void fill_pattern(std::vector<uint8_t>& buf, int32_t w, int32_t h) {
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            uint8_t* p = &buf[((size_t)y * w + x) * 4];
+            p[0] = (uint8_t)(128 + 100 * std::sin(x * 0.15));
+            p[1] = (uint8_t)(x * 255 / (w - 1));
+            p[2] = (uint8_t)(((x / 9) + (y / 7)) % 2 ? 240 : 10);
+            p[3] = (uint8_t)(x < 3 || y >= h - 3 ? 0 : 255);
+        }
+    }
+}
+
+static BlurSurface make_surface(std::vector<uint8_t>& buf, int32_t w, int32_t h) {
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+    return s;
+}
+
+/* Mean and largest absolute difference */
+static void compare(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, double* mean, int* worst) {
+    double sum = 0.0;
+    *worst = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int d = std::abs((int)a[i] - (int)b[i]);
+        sum += d;
+        if (d > *worst) *worst = d;
+    }
+    *mean = sum / (double)a.size();
+}
+
+int test_kernel_selection() {
+    BlurKernel k;
+    build_blur_kernel(6.0f, BLUR_ALGORITHM_IIR, 1, &k);
+    TEST_ASSERT(kernel_is_recursive(&k) && !kernel_is_direct(&k), "Full-resolution IIR kernels run the recursion");
+    TEST_ASSERT(k.radius == 18, "IIR kernels reach as far as the exact kernel");
+    TEST_ASSERT(std::fabs(k.iir.gain[0] + k.iir.gain[1] - 1.0f) < 1e-5f, "The recursion has unit gain");
+
+    build_blur_kernel(0.5f, BLUR_ALGORITHM_IIR, 1, &k);
+    TEST_ASSERT(k.algorithm == BLUR_ALGORITHM_EXACT && kernel_is_direct(&k), "Narrow IIR kernels become exact ones");
+
+    build_blur_kernel(12.0f, BLUR_ALGORITHM_IIR, 2, &k);
+    TEST_ASSERT(!kernel_is_recursive(&k) && k.algorithm == BLUR_ALGORITHM_IIR && k.scale == 2,
+                "Downsampled IIR kernels recurse at the working resolution");
+
+    kernel_set_linear_light(&k, true);
+    TEST_ASSERT(k.transfer == BLUR_TRANSFER_SRGB, "... and blur sRGB bytes");
+    build_blur_kernel(6.0f, BLUR_ALGORITHM_IIR, 1, &k);
+    kernel_set_linear_light(&k, true);
+    TEST_ASSERT(k.transfer == BLUR_TRANSFER_LINEAR, "Full-resolution IIR kernels blur in linear light");
+    return 0;
+}
+
+int test_matches_exact() {
+    const int32_t w = 160, h = 120;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    fill_pattern(src, w, h);
+    BlurSurface s = make_surface(src, w, h);
+
+    const float sigmas[] = { 1.0f, 2.0f, 4.0f, 10.0f, 20.0f };
+    for (float sigma : sigmas) {
+        BlurKernel exact, iir;
+        build_gaussian_kernel(sigma, &exact);
+        build_blur_kernel(sigma, BLUR_ALGORITHM_IIR, 1, &iir);
+        std::vector<uint8_t> ref(src.size()), out(src.size());
+        BlurSurface rs = make_surface(ref, w, h), os = make_surface(out, w, h);
+        cpu_blur(&s, &rs, &exact, CPU_BLUR_FULL_FRAME);
+        if (cpu_blur(&s, &os, &iir, CPU_BLUR_FULL_FRAME) != BLUR_SUCCESS) {
+            TEST_ASSERT(false, "IIR blur should succeed");
+        }
+
+        double mean;
+        int worst;
+        compare(out, ref, &mean, &worst);
+        printf("  sigma %4.1f: mean error %.3f, largest %d\n", sigma, mean, worst);
+        if (mean > 0.25 || worst > 1) TEST_ASSERT(false, "IIR blur should stay close to the exact kernel");
+    }
+    TEST_ASSERT(true, "IIR blur stays close to the exact kernel, borders included");
+    return 0;
+}
+
+int test_rects_and_aliasing() {
+    const int32_t w = 96, h = 64;
+    std::vector<uint8_t> src((size_t)w * h * 4), out(src.size());
+    fill_noise(src, 7);
+    BlurSurface s = make_surface(src, w, h), os = make_surface(out, w, h);
+    BlurKernel k;
+    build_blur_kernel(5.0f, BLUR_ALGORITHM_IIR, 1, &k);
+    cpu_blur(&s, &os, &k, CPU_BLUR_FULL_FRAME);
+
+    std::vector<uint8_t> streamed(src.size());
+    BlurSurface ss = make_surface(streamed, w, h);
+    cpu_blur(&s, &ss, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(streamed == out, "Both modes give the same result");
+
+    /* Interior rects see the pixel at their reach repeated past it */
+    std::vector<uint8_t> tile((size_t)37 * 29 * 4);
+    BlurSurface ts = make_surface(tile, 37, 29);
+    cpu_blur_rect(&s, &ts, &k, CPU_BLUR_FULL_FRAME, 30, 20);
+    int worst = 0;
+    for (int32_t y = 0; y < ts.height; y++) {
+        for (int32_t i = 0; i < ts.stride; i++) {
+            int d = std::abs((int)tile[(size_t)y * ts.stride + i] - (int)out[((size_t)(20 + y) * w + 30) * 4 + i]);
+            if (d > worst) worst = d;
+        }
+    }
+    printf("  rect vs whole surface: largest difference %d\n", worst);
+    TEST_ASSERT(worst <= 1, "Rects agree with the whole-surface blur to within one level");
+
+    std::vector<uint8_t> inplace = src;
+    BlurSurface is = make_surface(inplace, w, h);
+    cpu_blur(&is, &is, &k, CPU_BLUR_FULL_FRAME);
+    TEST_ASSERT(inplace == out, "dst may alias src");
+
+    std::vector<uint8_t> flat((size_t)w * h * 4, 77);
+    std::vector<uint8_t> expect = flat;
+    BlurSurface fs = make_surface(flat, w, h);
+    cpu_blur(&fs, &fs, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(flat == expect, "Flat input is unchanged");
+
+    kernel_set_linear_light(&k, true);
+    cpu_blur(&fs, &fs, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(flat == expect, "Flat input is unchanged in linear light");
+    return 0;
+}
+
+int test_linear_light() {
+    const int32_t w = 64, h = 48;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    fill_pattern(src, w, h);
+    BlurSurface s = make_surface(src, w, h);
+
+    BlurKernel exact, iir;
+    build_gaussian_kernel(6.0f, &exact);
+    build_blur_kernel(6.0f, BLUR_ALGORITHM_IIR, 1, &iir);
+    kernel_set_linear_light(&exact, true);
+    kernel_set_linear_light(&iir, true);
+    std::vector<uint8_t> ref(src.size()), out(src.size());
+    BlurSurface rs = make_surface(ref, w, h), os = make_surface(out, w, h);
+    cpu_blur(&s, &rs, &exact, CPU_BLUR_FULL_FRAME);
+    cpu_blur(&s, &os, &iir, CPU_BLUR_FULL_FRAME);
+
+    double mean;
+    int worst;
+    compare(out, ref, &mean, &worst);
+    printf("  linear light: mean error %.3f, largest %d\n", mean, worst);
+    TEST_ASSERT(mean <= 0.25 && worst <= 1, "Linear-light IIR blur stays close to the exact kernel");
+    return 0;
+}
+
+int test_downsampled() {
+    const int32_t w = 96, h = 64;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    fill_pattern(src, w, h);
+    BlurSurface s = make_surface(src, w, h);
+
+    BlurKernel exact, k;
+    build_blur_kernel(12.0f, BLUR_ALGORITHM_EXACT, 2, &exact);
+    build_blur_kernel(12.0f, BLUR_ALGORITHM_IIR, 2, &k);
+    std::vector<uint8_t> ref(src.size()), out(src.size());
+    BlurSurface rs = make_surface(ref, w, h), os = make_surface(out, w, h);
+    cpu_blur(&s, &rs, &exact, CPU_BLUR_STREAMING);
+    TEST_ASSERT(cpu_blur(&s, &os, &k, CPU_BLUR_STREAMING) == BLUR_SUCCESS, "Downsampled IIR blur succeeds");
+
+    double mean;
+    int worst;
+    compare(out, ref, &mean, &worst);
+    printf("  iir / 2 vs exact / 2: mean error %.3f, largest %d\n", mean, worst);
+    TEST_ASSERT(mean <= 0.25 && worst <= 1, "Downsampled IIR blur matches the downsampled exact kernel");
+    return 0;
+}
+
+/* Scratch high-water mark of one blur, on a thread with a fresh arena */
+static size_t blur_scratch(const BlurSurface* src, BlurSurface* dst, const BlurKernel* k, CpuBlurMode mode) {
+    size_t high_water = 0;
+    std::thread t([&]() {
+        cpu_blur(src, dst, k, mode);
+        high_water = scratch_arena().high_water();
+    });
+    t.join();
+    return high_water;
+}
+
+int test_streaming_bands() {
+    /* Tall enough for several bands of a radius-18 kernel */
+    const int32_t w = 160, h = 600;
+    std::vector<uint8_t> src((size_t)w * h * 4), full(src.size()), streamed(src.size());
+    fill_noise(src, 11);
+    BlurSurface s = make_surface(src, w, h), fs = make_surface(full, w, h), ss = make_surface(streamed, w, h);
+    BlurKernel k;
+    build_blur_kernel(6.0f, BLUR_ALGORITHM_IIR, 1, &k);
+
+    size_t full_bytes = blur_scratch(&s, &fs, &k, CPU_BLUR_FULL_FRAME);
+    size_t streamed_bytes = blur_scratch(&s, &ss, &k, CPU_BLUR_STREAMING);
+    printf("  scratch: full frame %zu bytes, streaming %zu bytes\n", full_bytes, streamed_bytes);
+    TEST_ASSERT(streamed_bytes * 4 < full_bytes, "Streaming holds a band instead of the whole rect");
+
+    double mean;
+    int worst;
+    compare(streamed, full, &mean, &worst);
+    printf("  streaming vs full frame: mean %.4f, largest %d\n", mean, worst);
+    TEST_ASSERT(worst <= 1, "Band seams agree with the whole rect to within one level");
+
+    std::vector<uint8_t> inplace = src;
+    BlurSurface is = make_surface(inplace, w, h);
+    cpu_blur(&is, &is, &k, CPU_BLUR_STREAMING);
+    TEST_ASSERT(inplace == streamed, "Bands may alias src");
+
+    /* Effects see each band's rows at their place in the window */
+    BlurEffectList_V1 list = {};
+    list.struct_version = 1;
+    list.effect_count = 2;
+    list.effects[0] = { BLUR_EFFECT_NOISE, 0, 0.05f, 0 };
+    list.effects[1] = { BLUR_EFFECT_VIGNETTE, 0, 0.4f, 0 };
+    EffectProgram prog;
+    compile_effect_graph(&list, &prog);
+    RegionBlurPlan plan;
+    plan_region_blur(nullptr, w, h, k.radius, &plan);
+    std::vector<uint8_t> fx_full = src, fx_streamed = src;
+    BlurSurface a = make_surface(fx_full, w, h), b = make_surface(fx_streamed, w, h);
+    cpu_blur_regions(&a, &k, CPU_BLUR_FULL_FRAME, &plan, 0, &prog);
+    cpu_blur_regions(&b, &k, CPU_BLUR_STREAMING, &plan, 0, &prog);
+    compare(fx_streamed, fx_full, &mean, &worst);
+    printf("  with effects: mean %.4f, largest %d\n", mean, worst);
+    TEST_ASSERT(worst <= 2, "Banded effects match the whole rect");
+    return 0;
+}
+
+int main() {
+    printf("=== iir_blur Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: kernel_selection\n");
+    failures += test_kernel_selection();
+    printf("\n");
+
+    printf("Test: matches_exact\n");
+    failures += test_matches_exact();
+    printf("\n");
+
+    printf("Test: rects_and_aliasing\n");
+    failures += test_rects_and_aliasing();
+    printf("\n");
+
+    printf("Test: streaming_bands\n");
+    failures += test_streaming_bands();
+    printf("\n");
+
+    printf("Test: linear_light\n");
+    failures += test_linear_light();
+    printf("\n");
+
+    printf("Test: downsampled\n");
+    failures += test_downsampled();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,120 @@
+/*
+ * test_image_metrics.cpp - Tests for the blur quality metrics and the reference Gaussian
+ */
+
+#include "image_metrics.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static void fill_noise(std::vector<uint8_t>& buf, uint32_t seed) {
+    for (size_t i = 0; i < buf.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (i & 3) == 3 ? 255 : (uint8_t)(seed >> 24);
+    }
+}
+
+static BlurSurface make_surface(std::vector<uint8_t>& buf, int32_t w, int32_t h) {
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+    return s;
+}
+
+int test_metrics() {
+    const int32_t w = 64, h = 48;
+    std::vector<uint8_t> a((size_t)w * h * 4), b;
+    fill_noise(a, 7);
+    for (uint8_t& v : a) v = (uint8_t)(v / 2 + 60);
+    b = a;
+    BlurSurface sa = make_surface(a, w, h), sb = make_surface(b, w, h);
+
+    ImageMetrics m;
+    TEST_ASSERT(compare_images(&sa, &sb, &m) == BLUR_SUCCESS, "Equal sizes compare");
+    TEST_ASSERT(m.mse == 0.0 && std::isinf(m.psnr) && m.max_error == 0 && std::fabs(m.ssim - 1.0) < 1e-12,
+                "Identical images are perfect");
+
+    /* +10 on every colour channel, alpha changed too */
+    for (size_t i = 0; i < b.size(); i++) b[i] = (i & 3) == 3 ? 0 : (uint8_t)(b[i] + 10);
+    compare_images(&sa, &sb, &m);
+    TEST_ASSERT(m.max_error == 10 && std::fabs(m.mse - 100.0) < 1e-9, "Error covers colour channels only");
+    TEST_ASSERT(std::fabs(m.psnr - 10.0 * std::log10(65025.0 / 100.0)) < 1e-9, "PSNR follows the MSE");
+    TEST_ASSERT(m.ssim > 0.95 && m.ssim < 1.0, "A brightness shift barely moves SSIM");
+
+    std::vector<uint8_t> c((size_t)w * h * 4);
+    fill_noise(c, 99);
+    BlurSurface sc = make_surface(c, w, h);
+    compare_images(&sa, &sc, &m);
+    TEST_ASSERT(m.ssim < 0.2, "Unrelated noise has low SSIM");
+
+    BlurSurface small = make_surface(a, w / 2, h);
+    TEST_ASSERT(compare_images(&sa, &small, &m) == BLUR_INVALID_PARAMS, "Size mismatch is rejected");
+    return 0;
+}
+
+int test_reference() {
+    const int32_t w = 80, h = 60;
+    std::vector<uint8_t> src((size_t)w * h * 4), ref(src.size()), out(src.size());
+    fill_noise(src, 3);
+    BlurSurface s = make_surface(src, w, h), r = make_surface(ref, w, h), o = make_surface(out, w, h);
+
+    TEST_ASSERT(reference_blur(&s, &r, 0.0, false) == BLUR_SUCCESS && ref == src, "Sigma 0 copies");
+
+    /* A flat image stays flat in either space */
+    std::vector<uint8_t> flat(src.size(), 173), flat_out(src.size());
+    BlurSurface f = make_surface(flat, w, h), fo = make_surface(flat_out, w, h);
+    reference_blur(&f, &fo, 5.0, true);
+    TEST_ASSERT(flat_out == flat, "A flat image survives the linear round trip");
+
+    /* The exact engine only truncates at 3 sigma and rounds in Q14 */
+    const float sigma = 4.0f;
+    reference_blur(&s, &r, sigma, false);
+    BlurKernel exact, box;
+    build_gaussian_kernel(sigma, &exact);
+    cpu_blur(&s, &o, &exact, CPU_BLUR_FULL_FRAME);
+    ImageMetrics em;
+    compare_images(&r, &o, &em);
+    build_blur_kernel(sigma, BLUR_ALGORITHM_BOX, 1, &box);
+    cpu_blur(&s, &o, &box, CPU_BLUR_FULL_FRAME);
+    ImageMetrics bm;
+    compare_images(&r, &o, &bm);
+    printf("  exact %.1f dB (max %d), box %.1f dB (max %d)\n", em.psnr, em.max_error, bm.psnr, bm.max_error);
+    TEST_ASSERT(em.psnr > 45.0 && em.max_error <= 3, "The exact engine is close to the reference");
+    TEST_ASSERT(bm.psnr < em.psnr, "The box approximation measures worse than exact");
+
+    /* Linear light has its own reference */
+    BlurKernel linear;
+    build_gaussian_kernel(sigma, &linear);
+    kernel_set_linear_light(&linear, true);
+    reference_blur(&s, &r, sigma, true);
+    cpu_blur(&s, &o, &linear, CPU_BLUR_FULL_FRAME);
+    compare_images(&r, &o, &em);
+    TEST_ASSERT(em.psnr > 40.0, "The linear-light engine is close to the linear reference");
+    return 0;
+}
+
+int main() {
+    printf("=== image_metrics Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: metrics\n");
+    failures += test_metrics();
+    printf("\n");
+
+    printf("Test: reference\n");
+    failures += test_reference();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
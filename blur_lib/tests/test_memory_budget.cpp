@@ -0,0 +1,279 @@
+/*
+ * test_memory_budget.cpp - Tests for the window memory budget and reduced backdrops
+ */
+
+#include "backdrop_cache.h"
+#include "memory_budget.h"
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* A blurred desktop: nothing but low frequencies */
+static uint8_t backdrop_byte(int32_t x, int32_t y, int32_t ch) {
+    double v = 128.0 + 60.0 * std::sin(x * 0.05 + ch) + 50.0 * std::cos(y * 0.043 - ch * 0.7);
+    return (uint8_t)(v + 0.5);
+}
+
+/* Fills a window at screen with the blurred desktop under it */
+static void fill_window(const RegionRect& screen, std::vector<uint8_t>* pixels, BlurSurface* target) {
+    int32_t w = screen.right - screen.left, h = screen.bottom - screen.top;
+    pixels->resize((size_t)w * h * 4);
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            for (int32_t ch = 0; ch < 4; ch++) {
+                (*pixels)[((size_t)y * w + x) * 4 + ch] = backdrop_byte(screen.left + x, screen.top + y, ch);
+            }
+        }
+    }
+    *target = { pixels->data(), w, h, w * 4 };
+}
+
+static std::vector<RegionRect> whole(const RegionRect& screen) {
+    RegionRect r = { 0, 0, screen.right - screen.left, screen.bottom - screen.top };
+    return std::vector<RegionRect>(1, r);
+}
+
+int test_reduced_backdrop() {
+    BlurKernel k;
+    build_blur_kernel(4.0f, BLUR_ALGORITHM_EXACT, 1, &k);
+    const RegionRect before = { 100, 80, 421, 319 }, after = { 107, 85, 428, 324 };
+
+    std::vector<uint8_t> src;
+    BlurSurface frame;
+    fill_window(before, &src, &frame);
+    BackdropCache full, reduced;
+    reduced.store_reduction = 2;
+    backdrop_store(&full, before, &k, whole(before), &frame);
+    backdrop_store(&reduced, before, &k, whole(before), &frame);
+    printf("  full %zu bytes, reduced %zu bytes\n", backdrop_bytes(&full), backdrop_bytes(&reduced));
+    TEST_ASSERT(reduced.reduction == 2 && backdrop_bytes(&reduced) * 3 < backdrop_bytes(&full),
+                "Reduced cache takes about a quarter of the memory");
+
+    std::vector<RegionRect> reuse_full, reuse_reduced;
+    backdrop_reusable(&full, after, &k, whole(after), &reuse_full);
+    backdrop_reusable(&reduced, after, &k, whole(after), &reuse_reduced);
+    int64_t area_full = 0, area_reduced = 0;
+    for (const RegionRect& r : reuse_full) area_full += rect_area(r);
+    for (const RegionRect& r : reuse_reduced) area_reduced += rect_area(r);
+    TEST_ASSERT(area_reduced > 0 && area_reduced < area_full && area_reduced * 10 > area_full * 9,
+                "Reduced cache gives up only a thin border of reuse");
+
+    std::vector<uint8_t> expect;
+    BlurSurface truth;
+    fill_window(after, &expect, &truth);
+    std::vector<uint8_t> out(expect.size(), 0);
+    BlurSurface target = { out.data(), truth.width, truth.height, truth.stride };
+    backdrop_restore(&reduced, after, reuse_reduced, &target);
+    int32_t worst = 0;
+    for (const RegionRect& r : reuse_reduced) {
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            for (int32_t x = r.left * 4; x < r.right * 4; x++) {
+                size_t i = (size_t)y * truth.stride + x;
+                worst = std::max(worst, std::abs((int32_t)out[i] - (int32_t)expect[i]));
+            }
+        }
+    }
+    printf("  largest upsampling error %d\n", worst);
+    TEST_ASSERT(worst <= 2, "Upsampled reuse matches the full-resolution blur");
+
+    /* Back at full resolution on the next store */
+    backdrop_store(&full, after, &k, whole(after), &truth);
+    reduced.store_reduction = 1;
+    backdrop_store(&reduced, after, &k, whole(after), &truth);
+    TEST_ASSERT(reduced.reduction == 1 && reduced.valid.size() == full.valid.size(), "Stores switch back to full resolution");
+
+    backdrop_release(&reduced);
+    TEST_ASSERT(backdrop_bytes(&reduced) == 0 && reduced.valid.empty(), "Released caches hold nothing");
+    return 0;
+}
+
+int test_lru_eviction() {
+    stats_reset();
+    MemoryBudget m;
+    m.set_budget(2500000);
+    for (uint64_t h = 1; h <= 3; h++) {
+        m.update(h, MEMORY_KIND_SURFACE, 1000000);
+        m.presented(h, h, false);
+    }
+    TEST_ASSERT(m.used() == 3000000 && stats_get(BLUR_STAT_MEMORY_BYTES) == 3000000, "Usage tracked and published");
+
+    std::vector<MemoryVictim> victims;
+    m.select_victims(4, &victims);
+    TEST_ASSERT(victims.size() == 1 && victims[0].handle == 1, "Least recently presented window goes first");
+    m.update(1, MEMORY_KIND_SURFACE, 0);
+    TEST_ASSERT(m.used() == 2000000 && m.peak() == 3000000, "Eviction lowers usage, peak stays");
+    TEST_ASSERT(stats_get(BLUR_STAT_MEMORY_PEAK) == 3000000 && stats_get(BLUR_STAT_MEMORY_EVICTIONS) == 1,
+                "Peak and evictions published");
+
+    m.update(4, MEMORY_KIND_SURFACE, 1000000);
+    m.update(4, MEMORY_KIND_BACKDROP, 500000);
+    m.presented(4, 5, false);
+    m.presented(2, 5, false);
+    m.presented(3, 5, false);
+    m.select_victims(5, &victims);
+    TEST_ASSERT(victims.empty(), "Windows presented in the current tick are kept even over the budget");
+    m.select_victims(6, &victims);
+    TEST_ASSERT(victims.size() == 1 && victims[0].bytes == 1000000, "Next tick evicts one whole window");
+
+    m.remove(4);
+    TEST_ASSERT(m.used() == 2000000, "Removed windows release everything");
+    m.set_budget(0);
+    m.select_victims(10, &victims);
+    TEST_ASSERT(victims.empty(), "No budget, no evictions");
+    return 0;
+}
+
+int test_reduction_policy() {
+    MemoryBudget m;
+    TEST_ASSERT(m.backdrop_reduction(1, 5, false) == 2, "Background windows are reduced");
+    m.presented(1, 5, true);
+    TEST_ASSERT(m.backdrop_reduction(1, 6, true) == 1, "A foreground window that just moved is not");
+    TEST_ASSERT(m.backdrop_reduction(1, 5 + MEMORY_IDLE_TICKS, true) == 2, "... until it has been idle for a while");
+    return 0;
+}
+
+/*
+ * Windows come and go, move and get presented at random, as a busy desktop
+ * would; after every tick the budget is met except by the windows the tick
+ * presented.
+ */
+struct ChurnWindow {
+    RegionRect screen;
+    BackdropCache backdrop;
+    uint64_t surface_bytes;
+};
+
+static uint32_t next_random(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static int run_churn(bool reduce, uint64_t budget, uint64_t* peak_out) {
+    MemoryBudget m;
+    m.set_budget(budget);
+    BlurKernel k;
+    build_blur_kernel(3.0f, BLUR_ALGORITHM_EXACT, 1, &k);
+    std::map<uint64_t, ChurnWindow> windows;
+    std::vector<uint8_t> pixels;
+    std::vector<MemoryVictim> victims;
+    uint32_t rng = 12345;
+    uint64_t next_handle = 1;
+
+    for (uint64_t tick = 1; tick <= 200; tick++) {
+        if (windows.size() < 12 && next_random(&rng) % 3 == 0) {
+            ChurnWindow w;
+            int32_t x = next_random(&rng) % 800, y = next_random(&rng) % 600;
+            w.screen = { x, y, x + 120 + (int32_t)(next_random(&rng) % 200), y + 100 + (int32_t)(next_random(&rng) % 150) };
+            w.surface_bytes = 0;
+            windows[next_handle++] = w;
+        }
+        if (!windows.empty() && next_random(&rng) % 5 == 0) {
+            std::map<uint64_t, ChurnWindow>::iterator it = windows.begin();
+            std::advance(it, next_random(&rng) % windows.size());
+            m.remove(it->first);
+            windows.erase(it);
+        }
+
+        uint64_t foreground = windows.empty() ? 0 : std::next(windows.begin(), tick % windows.size())->first;
+        uint64_t kept = 0;
+        for (auto& kv : windows) {
+            if (kv.first != foreground && next_random(&rng) % 3 != 0) continue;   /* Not due this tick */
+            ChurnWindow& w = kv.second;
+            bool moved = kv.first == foreground && next_random(&rng) % 2 == 0;
+            if (moved) w.screen = { w.screen.left + 3, w.screen.top + 2, w.screen.right + 3, w.screen.bottom + 2 };
+
+            w.backdrop.store_reduction = reduce ? m.backdrop_reduction(kv.first, tick, kv.first == foreground) : 1;
+            BlurSurface target;
+            fill_window(w.screen, &pixels, &target);
+            backdrop_store(&w.backdrop, w.screen, &k, whole(w.screen), &target);
+            w.surface_bytes = (uint64_t)rect_area(w.screen) * 4;
+
+            m.presented(kv.first, tick, moved);
+            m.update(kv.first, MEMORY_KIND_SURFACE, w.surface_bytes);
+            m.update(kv.first, MEMORY_KIND_BACKDROP, backdrop_bytes(&w.backdrop));
+            kept += w.surface_bytes + backdrop_bytes(&w.backdrop);
+        }
+
+        m.select_victims(tick, &victims);
+        for (const MemoryVictim& v : victims) {
+            ChurnWindow& w = windows[v.handle];
+            backdrop_release(&w.backdrop);
+            w.surface_bytes = 0;
+            m.update(v.handle, MEMORY_KIND_SURFACE, 0);
+            m.update(v.handle, MEMORY_KIND_BACKDROP, 0);
+        }
+
+        uint64_t held = 0;
+        for (const auto& kv : windows) held += kv.second.surface_bytes + backdrop_bytes(&kv.second.backdrop);
+        if (held != m.used() || stats_get(BLUR_STAT_MEMORY_BYTES) != held) {
+            printf("  tick %llu: budget says %llu bytes, windows hold %llu\n", (unsigned long long)tick,
+                   (unsigned long long)m.used(), (unsigned long long)held);
+            return 1;
+        }
+        if (budget && held > std::max(budget, kept)) {
+            printf("  tick %llu: %llu bytes held over a %llu budget\n", (unsigned long long)tick,
+                   (unsigned long long)held, (unsigned long long)budget);
+            return 1;
+        }
+    }
+    *peak_out = m.peak();
+    return 0;
+}
+
+int test_churn() {
+    stats_reset();
+    uint64_t peak_full = 0, peak_reduced = 0, peak_budget = 0;
+    TEST_ASSERT(run_churn(false, 0, &peak_full) == 0, "Unbudgeted churn is accounted exactly");
+    TEST_ASSERT(run_churn(true, 0, &peak_reduced) == 0, "Churn with reduced backdrops is accounted exactly");
+    printf("  peak %llu bytes full, %llu reduced\n", (unsigned long long)peak_full, (unsigned long long)peak_reduced);
+    TEST_ASSERT(peak_reduced * 10 < peak_full * 8, "Reduced backdrops lower the peak");
+
+    stats_reset();
+    const uint64_t budget = 1500000;
+    TEST_ASSERT(run_churn(true, budget, &peak_budget) == 0, "Budgeted churn stays within the budget after every tick");
+    printf("  peak %llu bytes under a %llu budget, %llu evictions\n", (unsigned long long)peak_budget,
+           (unsigned long long)budget, (unsigned long long)stats_get(BLUR_STAT_MEMORY_EVICTIONS));
+    TEST_ASSERT(stats_get(BLUR_STAT_MEMORY_EVICTIONS) > 0, "Evictions happened and were counted");
+    TEST_ASSERT(stats_get(BLUR_STAT_MEMORY_PEAK) == peak_budget, "Peak published");
+    return 0;
+}
+
+int main() {
+    printf("=== memory_budget Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: reduced_backdrop\n");
+    failures += test_reduced_backdrop();
+    printf("\n");
+
+    printf("Test: lru_eviction\n");
+    failures += test_lru_eviction();
+    printf("\n");
+
+    printf("Test: reduction_policy\n");
+    failures += test_reduction_policy();
+    printf("\n");
+
+    printf("Test: churn\n");
+    failures += test_churn();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
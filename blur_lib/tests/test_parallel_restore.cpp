@@ -0,0 +1,160 @@
+/*
+ * test_parallel_restore.cpp - Tests for clearing tracked windows on a worker pool
+ */
+
+#include "parallel_restore.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* A window's flags carry the result the fake backend returns for it */
+struct FakeBackend {
+    std::atomic<int> active;
+    std::atomic<int> peak;
+    std::atomic<int> calls[256];
+    std::thread::id caller;
+    std::atomic<int> on_caller;
+    int delay_ms;
+};
+
+static int32_t fake_clear(const BlurWindowInfo_V1* window, void* ctx) {
+    FakeBackend* fb = (FakeBackend*)ctx;
+    int now = ++fb->active;
+    int peak = fb->peak.load();
+    while (now > peak && !fb->peak.compare_exchange_weak(peak, now)) {
+    }
+    if (std::this_thread::get_id() == fb->caller) fb->on_caller++;
+    fb->calls[window->window_handle]++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(fb->delay_ms));
+    fb->active--;
+    return (int32_t)window->flags;
+}
+
+static std::atomic<int> g_pumps(0);
+static std::thread::id g_pump_thread;
+static std::atomic<int> g_pumps_elsewhere(0);
+
+static void count_pump(void) {
+    g_pumps++;
+    if (std::this_thread::get_id() != g_pump_thread) g_pumps_elsewhere++;
+}
+
+static void reset(FakeBackend* fb, int delay_ms) {
+    fb->active = 0;
+    fb->peak = 0;
+    for (int i = 0; i < 256; i++) fb->calls[i] = 0;
+    fb->caller = std::this_thread::get_id();
+    fb->on_caller = 0;
+    fb->delay_ms = delay_ms;
+}
+
+static std::vector<BlurWindowInfo_V1> make_windows(uint32_t count) {
+    std::vector<BlurWindowInfo_V1> windows(count);
+    for (uint32_t i = 0; i < count; i++) {
+        windows[i] = BlurWindowInfo_V1();
+        windows[i].window_handle = i;
+        windows[i].flags = BLUR_SUCCESS;
+    }
+    return windows;
+}
+
+int test_parallel() {
+    FakeBackend fb;
+    reset(&fb, 2);
+    std::vector<BlurWindowInfo_V1> windows = make_windows(64);
+    g_pumps = 0;
+    g_pumps_elsewhere = 0;
+    g_pump_thread = std::this_thread::get_id();
+
+    RestoreSummary sum;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int32_t rc = restore_windows(windows.data(), 64, 4, fake_clear, &fb, count_pump, &sum);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("  64 windows at 2 ms each: %.1f ms on %u workers\n", ms, sum.workers);
+
+    TEST_ASSERT(rc == BLUR_SUCCESS && sum.cleared == 64 && sum.failed == 0, "Every window is cleared");
+    bool once = true;
+    for (int i = 0; i < 64; i++) once = once && fb.calls[i] == 1;
+    TEST_ASSERT(once, "Each window is cleared exactly once");
+    TEST_ASSERT(sum.workers == 4 && fb.peak.load() >= 2 && fb.peak.load() <= 4,
+                "Windows are cleared concurrently within the worker bound");
+    TEST_ASSERT(fb.on_caller.load() == 0, "The calling thread only waits");
+    TEST_ASSERT(g_pumps.load() > 0 && g_pumps_elsewhere.load() == 0, "The caller pumps while it waits");
+
+    reset(&fb, 0);
+    restore_windows(windows.data(), 64, 0, fake_clear, &fb, nullptr, &sum);
+    TEST_ASSERT(sum.workers <= RESTORE_MAX_WORKERS && sum.cleared == 64,
+                "The default pool stays within RESTORE_MAX_WORKERS");
+    return 0;
+}
+
+int test_aggregate() {
+    FakeBackend fb;
+    reset(&fb, 0);
+    std::vector<BlurWindowInfo_V1> windows = make_windows(32);
+    windows[3].flags = BLUR_INVALID_HANDLE;
+    windows[4].flags = BLUR_INVALID_HANDLE;
+    windows[10].flags = BLUR_API_UNSUPPORTED;
+    windows[20].flags = BLUR_INTERNAL_ERROR;
+
+    RestoreSummary sum;
+    int32_t rc = restore_windows(windows.data(), 32, 4, fake_clear, &fb, nullptr, &sum);
+    TEST_ASSERT(sum.cleared == 28 && sum.skipped == 2 && sum.failed == 2, "Results are tallied per window");
+    TEST_ASSERT(rc == BLUR_API_UNSUPPORTED && sum.first_error == BLUR_API_UNSUPPORTED,
+                "The first failure in list order is returned");
+
+    windows[10].flags = BLUR_SUCCESS;
+    windows[20].flags = BLUR_SUCCESS;
+    rc = restore_windows(windows.data(), 32, 4, fake_clear, &fb, nullptr, &sum);
+    TEST_ASSERT(rc == BLUR_SUCCESS && sum.skipped == 2, "Destroyed windows are not failures");
+    return 0;
+}
+
+int test_small() {
+    FakeBackend fb;
+    reset(&fb, 0);
+    std::vector<BlurWindowInfo_V1> windows = make_windows(8);
+
+    RestoreSummary sum;
+    TEST_ASSERT(restore_windows(windows.data(), 8, 1, fake_clear, &fb, nullptr, &sum) == BLUR_SUCCESS &&
+                sum.workers == 0 && fb.on_caller.load() == 8, "One worker means the caller clears inline");
+
+    TEST_ASSERT(restore_windows(nullptr, 0, 4, fake_clear, &fb, nullptr, &sum) == BLUR_SUCCESS &&
+                sum.cleared == 0 && sum.workers == 0, "Nothing to restore succeeds");
+    TEST_ASSERT(restore_windows(nullptr, 3, 4, fake_clear, &fb, nullptr, &sum) == BLUR_INVALID_PARAMS,
+                "A missing window list is rejected");
+    return 0;
+}
+
+int main() {
+    printf("=== parallel_restore Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: parallel\n");
+    failures += test_parallel();
+    printf("\n");
+
+    printf("Test: aggregate\n");
+    failures += test_aggregate();
+    printf("\n");
+
+    printf("Test: small\n");
+    failures += test_small();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
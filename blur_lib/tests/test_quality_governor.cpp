@@ -0,0 +1,218 @@
+/*
+ * test_quality_governor.cpp - Tests for deadline-aware quality degradation
+ *
+ * Frames run on a fake clock: each costs its rung's work units times a
+ * machine speed the test sets, and the clock advances by the refresh
+ * interval between frames.
+ */
+
+#include "quality_governor.h"
+#include "stats.h"
+#include <cstdio>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+#define FRAME_US    16667
+#define PIXELS      (1920 * 1080)
+#define SIGMA       20.0f
+
+struct FakeWindow {
+    QualityGovernor governor;
+    uint64_t now_us = 1000000;
+    double us_per_unit;             /* Speed of the fake machine */
+    uint64_t last_cost_us = 0;
+
+    explicit FakeWindow(double speed) : us_per_unit(speed) {
+        governor.configure(BLUR_ALGORITHM_EXACT, 1, SIGMA);
+    }
+
+    /* Plans, "renders" and records one frame due within budget_us; returns the rung */
+    uint32_t frame(uint64_t budget_us, bool moving = false, bool can_repeat = true) {
+        GovernorFrame f;
+        f.now_us = now_us;
+        f.deadline_us = now_us + budget_us;
+        f.pixels = PIXELS;
+        f.moving = moving;
+        f.can_repeat = can_repeat;
+        uint32_t r = governor.plan(f);
+        last_cost_us = 0;
+        if (!governor.rung(r).repeat) {
+            last_cost_us = (uint64_t)(rung_cost_units(nullptr, governor.rung(r), PIXELS, SIGMA) * us_per_unit);
+            governor.record(r, PIXELS, last_cost_us);
+        }
+        now_us += FRAME_US;
+        return r;
+    }
+};
+
+/* Speed at which rung r of a fresh exact ladder costs share * FRAME_US */
+static double speed_for(uint32_t r, double share) {
+    QualityLadder ladder;
+    build_quality_ladder(BLUR_ALGORITHM_EXACT, 1, &ladder);
+    return share * FRAME_US / rung_cost_units(nullptr, ladder.rungs[r], PIXELS, SIGMA);
+}
+
+int test_ladder() {
+    QualityLadder l;
+    build_quality_ladder(BLUR_ALGORITHM_EXACT, 1, &l);
+    TEST_ASSERT(l.count == 5, "Exact blur has four render rungs and a repeat");
+    TEST_ASSERT(l.rungs[1].downsample == 2 && l.rungs[2].algorithm == BLUR_ALGORITHM_BOX &&
+                l.rungs[3].downsample == 4 && l.rungs[4].repeat, "Downsample, box, more downsample, repeat");
+    for (uint32_t i = 1; i + 1 < l.count; i++) {
+        if (rung_cost_units(nullptr, l.rungs[i], PIXELS, SIGMA) >= rung_cost_units(nullptr, l.rungs[i - 1], PIXELS, SIGMA)) {
+            TEST_ASSERT(false, "Every rung is cheaper than the one above");
+        }
+    }
+
+    build_quality_ladder(BLUR_ALGORITHM_BOX, BLUR_MAX_DOWNSAMPLE, &l);
+    TEST_ASSERT(l.count == 2 && l.rungs[1].repeat, "Cheapest settings only leave the repeat");
+    build_quality_ladder(BLUR_ALGORITHM_PYRAMID, 4, &l);
+    TEST_ASSERT(l.count == 4 && l.rungs[2].algorithm == BLUR_ALGORITHM_BOX && l.rungs[2].downsample == 8,
+                "Rungs that repeat the one above are dropped");
+    return 0;
+}
+
+int test_steps_down_to_meet_deadline() {
+    clear_active_calibration();
+    stats_reset();
+    FakeWindow win(speed_for(0, 3.0));
+
+    TEST_ASSERT(win.frame(FRAME_US) == 0, "First frame renders as requested");
+    TEST_ASSERT(win.last_cost_us > FRAME_US, "... and misses its deadline");
+    uint32_t r = win.frame(FRAME_US);
+    TEST_ASSERT(r > 0 && !win.governor.rung(r).repeat, "Second frame steps down to a render rung");
+    TEST_ASSERT(win.last_cost_us <= FRAME_US, "... that meets the deadline");
+    for (int i = 0; i < 20; i++) win.frame(FRAME_US);
+    TEST_ASSERT(win.governor.level() == r, "The rung holds while the load does");
+
+    TEST_ASSERT(stats_get(BLUR_STAT_QUALITY_STEPS_DOWN) == 1, "One step down counted");
+    TEST_ASSERT(stats_get(BLUR_STAT_DEADLINE_MISSES) == 1, "Only the first frame missed");
+    TEST_ASSERT(stats_get(BLUR_STAT_FRAMES_DEGRADED) == 21, "Degraded frames counted");
+    return 0;
+}
+
+int test_steps_up_with_headroom() {
+    clear_active_calibration();
+    stats_reset();
+    FakeWindow win(speed_for(0, 3.0));
+    for (int i = 0; i < 5; i++) win.frame(FRAME_US);
+    uint32_t low = win.governor.level();
+    TEST_ASSERT(low > 0, "Stepped down under load");
+
+    /* The load goes: everything fits with room to spare */
+    win.us_per_unit = speed_for(0, 0.2);
+    uint64_t relief = win.now_us;
+    uint64_t first_up = 0;
+    for (int i = 0; i < 400 && win.governor.level() > 0; i++) {
+        uint32_t before = win.governor.level();
+        win.frame(FRAME_US);
+        if (!first_up && win.governor.level() < before) first_up = win.now_us;
+    }
+    TEST_ASSERT(win.governor.level() == 0, "Back at the requested quality");
+    TEST_ASSERT(first_up - relief >= GOVERNOR_STEP_UP_US, "Not before the headroom held for the step-up time");
+    TEST_ASSERT(stats_get(BLUR_STAT_QUALITY_STEPS_UP) == low, "One rung at a time");
+    return 0;
+}
+
+int test_repeats_last_frame() {
+    clear_active_calibration();
+    stats_reset();
+    /* Even the cheapest render rung takes three frames */
+    QualityLadder ladder;
+    build_quality_ladder(BLUR_ALGORITHM_EXACT, 1, &ladder);
+    FakeWindow win(speed_for(ladder.count - 2, 3.0));
+
+    win.frame(FRAME_US);
+    int repeats = 0, renders = 0;
+    for (int i = 0; i < 10; i++) {
+        if (win.governor.rung(win.frame(FRAME_US)).repeat) repeats++; else renders++;
+    }
+    TEST_ASSERT(win.governor.rung(win.governor.level()).repeat, "Falls to repeating the last frame");
+    TEST_ASSERT(repeats == 8 && renders == 2, "A frame is rendered after GOVERNOR_MAX_REPEATS repeats");
+    TEST_ASSERT(stats_get(BLUR_STAT_FRAMES_REPEATED) == 8, "Repeated frames counted");
+
+    uint32_t r = win.frame(FRAME_US, false, false);
+    TEST_ASSERT(!win.governor.rung(r).repeat && r == ladder.count - 2, "Without a last frame the cheapest rung renders");
+    return 0;
+}
+
+int test_drag_steps_down() {
+    clear_active_calibration();
+    stats_reset();
+    FakeWindow win(speed_for(0, 0.7));
+    for (int i = 0; i < 5; i++) win.frame(FRAME_US);
+    TEST_ASSERT(win.governor.level() == 0 && stats_get(BLUR_STAT_DEADLINE_MISSES) == 0, "Still window fits at full quality");
+
+    uint32_t r = win.frame(FRAME_US, true);
+    TEST_ASSERT(r > 0 && win.governor.dragging(), "A drag steps down on its first frame");
+    TEST_ASSERT(win.last_cost_us <= FRAME_US * GOVERNOR_DRAG_SHARE, "... to a rung that fits the drag share");
+    TEST_ASSERT(stats_get(BLUR_STAT_QUALITY_DRAG_STEPS) == 1 && stats_get(BLUR_STAT_QUALITY_STEPS_DOWN) == 0,
+                "Counted as a drag step");
+    for (int i = 0; i < 10; i++) {
+        if (win.governor.rung(win.frame(FRAME_US, true)).repeat) TEST_ASSERT(false, "Drags never repeat a frame");
+    }
+    TEST_ASSERT(win.governor.level() == r, "The drag holds its rung");
+
+    TEST_ASSERT(win.frame(FRAME_US) == 0 && !win.governor.dragging(), "The first still frame is back at full quality");
+    return 0;
+}
+
+int test_apply_deadline() {
+    clear_active_calibration();
+    stats_reset();
+    FakeWindow win(speed_for(0, 0.5));
+    for (int i = 0; i < 3; i++) win.frame(FRAME_US);
+
+    /* An apply due in a tenth of a frame */
+    uint32_t r = win.frame(FRAME_US / 10, false, false);
+    TEST_ASSERT(r > 0 && !win.governor.rung(r).repeat, "A tight apply renders a cheaper rung");
+    TEST_ASSERT(win.last_cost_us <= FRAME_US / 10, "... within its timeout");
+
+    /* A deadline already past renders the cheapest rung rather than nothing */
+    GovernorFrame late = { win.now_us, win.now_us - 1, PIXELS, false, false };
+    QualityLadder ladder;
+    build_quality_ladder(BLUR_ALGORITHM_EXACT, 1, &ladder);
+    TEST_ASSERT(win.governor.plan(late) == ladder.count - 2, "A missed deadline renders the cheapest rung");
+    return 0;
+}
+
+int main() {
+    printf("=== quality_governor Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: ladder\n");
+    failures += test_ladder();
+    printf("\n");
+
+    printf("Test: steps_down_to_meet_deadline\n");
+    failures += test_steps_down_to_meet_deadline();
+    printf("\n");
+
+    printf("Test: steps_up_with_headroom\n");
+    failures += test_steps_up_with_headroom();
+    printf("\n");
+
+    printf("Test: repeats_last_frame\n");
+    failures += test_repeats_last_frame();
+    printf("\n");
+
+    printf("Test: drag_steps_down\n");
+    failures += test_drag_steps_down();
+    printf("\n");
+
+    printf("Test: apply_deadline\n");
+    failures += test_apply_deadline();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
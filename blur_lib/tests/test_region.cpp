@@ -0,0 +1,278 @@
+/*
+ * test_region.cpp - Tests for region geometry and region-restricted blur
+ */
+
+#include "region.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static uint32_t g_seed = 7;
+
+static int32_t next_rand(int32_t n) {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return (int32_t)((g_seed >> 8) % (uint32_t)n);
+}
+
+/* Coverage bitmap of a rect list on a size x size grid; returns false on overlap */
+static bool rasterize(const std::vector<RegionRect>& rects, int32_t size,
+                      std::vector<uint8_t>* grid, bool require_disjoint) {
+    grid->assign((size_t)size * size, 0);
+    for (const RegionRect& r : rects) {
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            for (int32_t x = r.left; x < r.right; x++) {
+                uint8_t& cell = (*grid)[(size_t)y * size + x];
+                if (cell && require_disjoint) return false;
+                cell = 1;
+            }
+        }
+    }
+    return true;
+}
+
+int test_union_basic() {
+    RegionRect rects[] = { { 0, 0, 10, 10 }, { 5, 5, 15, 15 } };
+    std::vector<RegionRect> out;
+    region_union(rects, 2, &out);
+    TEST_ASSERT(region_area(out) == 100 + 100 - 25, "Union area excludes the overlap once");
+
+    RegionRect bounds = region_bounds(out);
+    TEST_ASSERT(bounds.left == 0 && bounds.top == 0 && bounds.right == 15 && bounds.bottom == 15,
+                "Union bounds cover both rects");
+
+    RegionRect stacked[] = { { 0, 0, 10, 5 }, { 0, 5, 10, 10 } };
+    region_union(stacked, 2, &out);
+    TEST_ASSERT(out.size() == 1 && out[0].bottom == 10, "Adjacent bands with equal spans coalesce");
+
+    RegionRect touching[] = { { 0, 0, 5, 5 }, { 5, 0, 10, 5 } };
+    region_union(touching, 2, &out);
+    TEST_ASSERT(out.size() == 1 && out[0].right == 10, "Touching spans merge");
+
+    RegionRect empty[] = { { 3, 3, 3, 9 } };
+    region_union(empty, 1, &out);
+    TEST_ASSERT(out.empty(), "Empty rects vanish");
+    return 0;
+}
+
+int test_union_random() {
+    const int32_t size = 48;
+    for (int iter = 0; iter < 200; iter++) {
+        std::vector<RegionRect> a, b;
+        int32_t na = 1 + next_rand(6), nb = next_rand(6);
+        for (int32_t i = 0; i < na + nb; i++) {
+            int32_t l = next_rand(size), t = next_rand(size);
+            RegionRect r = { l, t, l + 1 + next_rand(size - l), t + 1 + next_rand(size - t) };
+            (i < na ? a : b).push_back(r);
+        }
+
+        std::vector<RegionRect> u, d;
+        region_union(a.data(), a.size(), &u);
+        region_subtract(a, b, &d);
+
+        std::vector<uint8_t> ga, gb, gu, gd;
+        rasterize(a, size, &ga, false);
+        rasterize(b, size, &gb, false);
+        if (!rasterize(u, size, &gu, true) || !rasterize(d, size, &gd, true)) {
+            TEST_ASSERT(false, "Region results should be disjoint");
+        }
+        for (size_t i = 0; i < ga.size(); i++) {
+            if (gu[i] != ga[i] || gd[i] != (ga[i] && !gb[i])) {
+                TEST_ASSERT(false, "Region coverage should match brute force");
+            }
+        }
+    }
+    TEST_ASSERT(true, "Random union/subtract match brute-force coverage");
+    return 0;
+}
+
+int test_inflate() {
+    std::vector<RegionRect> in = { { 0, 0, 10, 10 }, { 30, 30, 40, 40 } };
+    RegionRect clip = { 0, 0, 50, 45 };
+    std::vector<RegionRect> out;
+    region_inflate(in, 5, clip, &out);
+
+    RegionRect b = region_bounds(out);
+    TEST_ASSERT(b.left == 0 && b.top == 0, "Inflation is clipped at the window origin");
+    TEST_ASSERT(b.right == 45 && b.bottom == 45, "Inflation is clipped at the far edges");
+    TEST_ASSERT(region_area(out) == 15 * 15 + 20 * 20, "Inflated area counts each halo once");
+
+    region_inflate(in, 20, clip, &out);
+    std::vector<uint8_t> grid;
+    TEST_ASSERT(rasterize(out, 50, &grid, true), "Overlapping halos are merged");
+    return 0;
+}
+
+int test_plan() {
+    RegionBlurPlan plan;
+    TEST_ASSERT(plan_region_blur(nullptr, 100, 50, 4, &plan) == BLUR_SUCCESS, "Null list plans");
+    TEST_ASSERT(plan.output.size() == 1 && region_area(plan.output) == 5000, "Null list is the whole window");
+
+    BlurRegionList_V1 list = {};
+    list.struct_version = 1;
+    list.rect_count = 2;
+    list.rects[0] = { 0, 0, 20, 50, 0 };        /* Sidebar */
+    list.rects[1] = { 90, -10, 120, 10, 4 };    /* Partly outside the window */
+    TEST_ASSERT(plan_region_blur(&list, 100, 50, 4, &plan) == BLUR_SUCCESS, "Region list plans");
+    TEST_ASSERT(region_area(plan.output) == 20 * 50 + 10 * 10, "Output is clipped to the window");
+    TEST_ASSERT(region_area(plan.capture) == 24 * 50 + 14 * 14, "Capture adds the kernel halo");
+    TEST_ASSERT(plan.rects.size() == 2 && plan.rects[1].corner_radius == 4, "Corner radii are kept");
+
+    list.struct_version = 2;
+    TEST_ASSERT(plan_region_blur(&list, 100, 50, 4, &plan) == BLUR_INVALID_PARAMS, "Unknown version rejected");
+    list.struct_version = 1;
+    list.rect_count = BLUR_MAX_REGIONS + 1;
+    TEST_ASSERT(validate_region_list(&list) == BLUR_INVALID_PARAMS, "Too many rects rejected");
+
+    EffectParamsRegions_V1 ext = {};
+    ext.params.struct_version = 1;
+    TEST_ASSERT(effect_params_regions(&ext.params) == nullptr, "No flag means no region list");
+    ext.params.reserved_flags = BLUR_PARAMS_FLAG_REGIONS;
+    TEST_ASSERT(effect_params_regions(&ext.params) == &ext.regions, "Flag finds the trailing list");
+    return 0;
+}
+
+int test_region_blur_matches_full() {
+    const int32_t w = 64, h = 40;
+    std::vector<uint8_t> src((size_t)w * h * 4);
+    for (size_t i = 0; i < src.size(); i++) src[i] = (uint8_t)next_rand(256);
+
+    BlurKernel k;
+    build_gaussian_kernel(2.0f, &k);
+
+    std::vector<uint8_t> full(src.size());
+    BlurSurface s = { src.data(), w, h, w * 4 }, f = { full.data(), w, h, w * 4 };
+    cpu_blur(&s, &f, &k, CPU_BLUR_FULL_FRAME);
+
+    BlurRegionList_V1 list = {};
+    list.struct_version = 1;
+    list.rect_count = 2;
+    list.rects[0] = { 0, 0, 12, 40, 0 };
+    list.rects[1] = { 16, 0, 64, 8, 0 };      /* Halo overlaps the sidebar */
+    RegionBlurPlan plan;
+    plan_region_blur(&list, w, h, k.radius, &plan);
+
+    std::vector<uint8_t> work = src;
+    BlurSurface ws = { work.data(), w, h, w * 4 };
+    TEST_ASSERT(cpu_blur_regions(&ws, &k, CPU_BLUR_STREAMING, &plan, 0) == BLUR_SUCCESS,
+                "Region blur succeeds");
+
+    std::vector<uint8_t> out_mask, cap_mask;
+    rasterize(plan.output, 64, &out_mask, true);
+    rasterize(plan.capture, 64, &cap_mask, true);
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            size_t p = ((size_t)y * w + x) * 4;
+            bool in_out = out_mask[(size_t)y * 64 + x] != 0;
+            bool in_cap = cap_mask[(size_t)y * 64 + x] != 0;
+            const uint8_t* expect = in_out ? &full[p] : &src[p];
+            static const uint8_t zero[4] = { 0, 0, 0, 0 };
+            if (in_cap && !in_out) expect = zero;
+            if (memcmp(&work[p], expect, 4) != 0) {
+                printf("  mismatch at (%d, %d)\n", x, y);
+                TEST_ASSERT(false, "Region blur should match the full-frame blur inside the region");
+            }
+        }
+    }
+    TEST_ASSERT(true, "Blurred regions match full-frame; halo cleared; rest untouched");
+    return 0;
+}
+
+int test_rounded_corners() {
+    const int32_t w = 32, h = 32;
+    std::vector<uint8_t> buf((size_t)w * h * 4, 200);
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+    BlurKernel k;
+    build_gaussian_kernel(0.0f, &k);
+
+    BlurRegionList_V1 list = {};
+    list.struct_version = 1;
+    list.rect_count = 1;
+    list.rects[0] = { 0, 0, 32, 32, 8 };
+    RegionBlurPlan plan;
+    plan_region_blur(&list, w, h, k.radius, &plan);
+    cpu_blur_regions(&s, &k, CPU_BLUR_FULL_FRAME, &plan, 0);
+
+    TEST_ASSERT(buf[3] == 0, "Corner pixel outside the radius is transparent");
+    TEST_ASSERT(buf[((size_t)16 * w + 16) * 4 + 3] == 200, "Centre pixel is kept");
+    TEST_ASSERT(buf[((size_t)0 * w + 16) * 4 + 3] == 200, "Edge midpoint is kept");
+    return 0;
+}
+
+int test_mask_region_output() {
+    const int32_t w = 48, h = 40;
+    std::vector<uint8_t> buf((size_t)w * h * 4, 200);
+    BlurSurface s = { buf.data(), w, h, w * 4 };
+
+    BlurRegionList_V1 list = {};
+    list.struct_version = 1;
+    list.rect_count = 2;
+    list.rects[0] = { 4, 4, 24, 20, 6 };
+    list.rects[1] = { 30, 10, 44, 36, 0 };
+    RegionBlurPlan plan;
+    plan_region_blur(&list, w, h, 3, &plan);
+    mask_region_output(&s, &plan);
+
+    int errors = 0;
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            bool inside = false;
+            for (const RegionRect& r : plan.output) {
+                inside |= x >= r.left && x < r.right && y >= r.top && y < r.bottom;
+            }
+            uint8_t a = buf[((size_t)y * w + x) * 4 + 3];
+            if (!inside && a != 0) errors++;
+        }
+    }
+    TEST_ASSERT(errors == 0, "Everything outside the output is cleared");
+    TEST_ASSERT(buf[((size_t)4 * w + 4) * 4 + 3] == 0, "Rounded corner is faded");
+    TEST_ASSERT(buf[((size_t)12 * w + 14) * 4 + 3] == 200, "Inside of a rounded rect is kept");
+    TEST_ASSERT(buf[((size_t)10 * w + 30) * 4 + 3] == 200, "Square corner is kept");
+    return 0;
+}
+
+int main() {
+    printf("=== region Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: union_basic\n");
+    failures += test_union_basic();
+    printf("\n");
+
+    printf("Test: union_random\n");
+    failures += test_union_random();
+    printf("\n");
+
+    printf("Test: inflate\n");
+    failures += test_inflate();
+    printf("\n");
+
+    printf("Test: plan\n");
+    failures += test_plan();
+    printf("\n");
+
+    printf("Test: region_blur_matches_full\n");
+    failures += test_region_blur_matches_full();
+    printf("\n");
+
+    printf("Test: rounded_corners\n");
+    failures += test_rounded_corners();
+    printf("\n");
+
+    printf("Test: mask_region_output\n");
+    failures += test_mask_region_output();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
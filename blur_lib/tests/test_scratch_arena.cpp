@@ -0,0 +1,383 @@
+/*
+ * test_scratch_arena.cpp - Tests for the render-path scratch arena
+ *
+ * Linux only: replaces the global allocation functions to count heap calls
+ * and checks that steady-state frames make none, with the executor running.
+ */
+
+#include "capture_planner.h"
+#include "effect_graph.h"
+#include "scratch_arena.h"
+#include "stats.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+/* ============================================================================
+ * Allocation counting
+ * ============================================================================ */
+/* Workers allocate too, so both are atomic */
+static std::atomic<bool> g_counting(false);
+static std::atomic<long> g_heap_calls(0);
+
+static inline void count_call() {
+    if (g_counting) g_heap_calls++;
+}
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) {
+    count_call();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    count_call();
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+    count_call();
+    return __libc_realloc(p, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    count_call();
+    void* p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count_call();
+    return __libc_memalign(alignment, size);
+}
+}
+
+void* operator new(size_t size) {
+    count_call();
+    void* p = __libc_malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+/* ============================================================================
+ * Frame workload
+ * ============================================================================ */
+static void fill_noise(std::vector<uint8_t>* buf) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < buf->size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        (*buf)[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+/* Synthetic screen whose frame buffer keeps its capacity between frames */
+class ReusingSource : public CaptureSource {
+public:
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        m_bounds = bounds;
+        m_pixels.assign((size_t)rect_area(bounds) * 4, 0);
+        BlurSurface f = { m_pixels.data(), bounds.right - bounds.left, bounds.bottom - bounds.top,
+                          (bounds.right - bounds.left) * 4 };
+        m_frame = *frame = f;
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& area) override {
+        for (int32_t y = area.top; y < area.bottom; y++) {
+            uint8_t* p = m_frame.pixels + (size_t)(y - m_bounds.top) * m_frame.stride +
+                         (size_t)(area.left - m_bounds.left) * 4;
+            for (int32_t x = area.left; x < area.right; x++, p += 4) {
+                p[0] = (uint8_t)x; p[1] = (uint8_t)y; p[2] = (uint8_t)(x ^ y); p[3] = 255;
+            }
+        }
+    }
+
+    void end_frame() override {}
+
+private:
+    RegionRect m_bounds;
+    BlurSurface m_frame;
+    std::vector<uint8_t> m_pixels;
+};
+
+/* Every blur algorithm, each in sRGB and in linear light */
+static const uint32_t g_algorithms[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX, BLUR_ALGORITHM_PYRAMID,
+                                         BLUR_ALGORITHM_IIR };
+#define ALGORITHM_COUNT (sizeof(g_algorithms) / sizeof(g_algorithms[0]))
+#define KERNEL_COUNT    (ALGORITHM_COUNT * 2 + 1)
+#define WINDOW_COUNT    7
+
+struct Workload {
+    std::vector<uint8_t> pixels;
+    BlurSurface surface;
+    BlurKernel kernels[KERNEL_COUNT];   /* Algorithms in sRGB, then in linear light, then downsampled */
+    BlurKernel shared_kernel;
+    RegionBlurPlan plan;
+    EffectProgram effects;
+    std::vector<std::vector<uint8_t>> targets;
+    std::vector<TickWindow> windows;
+    BackdropCache backdrops[2];
+    RegionRect screens[WINDOW_COUNT];
+    ReusingSource source;
+    uint32_t frame;
+};
+
+static void setup(Workload* wl) {
+    const int32_t w = 192, h = 128;
+    wl->pixels.resize((size_t)w * h * 4);
+    fill_noise(&wl->pixels);
+    BlurSurface s = { wl->pixels.data(), w, h, w * 4 };
+    wl->surface = s;
+    wl->frame = 0;
+
+    for (size_t i = 0; i < ALGORITHM_COUNT; i++) {
+        for (size_t linear = 0; linear < 2; linear++) {
+            BlurKernel* k = &wl->kernels[linear * ALGORITHM_COUNT + i];
+            build_blur_kernel(g_algorithms[i] == BLUR_ALGORITHM_PYRAMID ? 12.0f : 6.0f, g_algorithms[i], 1, k);
+            kernel_set_linear_light(k, linear != 0);
+        }
+    }
+    build_blur_kernel(8.0f, BLUR_ALGORITHM_EXACT, 2, &wl->kernels[KERNEL_COUNT - 1]);
+    build_blur_kernel(3.0f, BLUR_ALGORITHM_EXACT, 1, &wl->shared_kernel);
+
+    BlurRegionList_V1 list = {};
+    list.struct_version = 1;
+    list.rect_count = 2;
+    list.rects[0] = { 10, 10, 90, 60, 8 };
+    list.rects[1] = { 60, 40, 180, 120, 0 };
+    plan_region_blur(&list, w, h, wl->kernels[0].radius, &wl->plan);
+
+    BlurEffectList_V1 effects = {};
+    effects.struct_version = 1;
+    effects.effect_count = 3;
+    effects.effects[0] = { BLUR_EFFECT_SATURATION, 0, 1.25f, 0 };
+    effects.effects[1] = { BLUR_EFFECT_TINT, 0x40102038, 0.0f, 0 };
+    effects.effects[2] = { BLUR_EFFECT_NOISE, 0, 0.02f, 0 };
+    compile_effect_graph(&effects, &wl->effects);
+
+    /*
+     * Two overlapping windows with equal kernels, one capture-only window and
+     * one window per remaining kind of kernel. The first two keep backdrops
+     * and move every frame; the linear box window runs the effect graph.
+     */
+    const RegionRect screens[WINDOW_COUNT] = {
+        { 0, 0, 96, 80 }, { 48, 40, 144, 120 }, { 400, 0, 464, 64 }, { 0, 200, 96, 280 },
+        { 200, 200, 296, 280 }, { 400, 200, 496, 280 }, { 600, 200, 696, 280 }
+    };
+    const BlurKernel* kernels[WINDOW_COUNT] = {
+        &wl->shared_kernel, &wl->shared_kernel, nullptr, &wl->kernels[ALGORITHM_COUNT + 1],
+        &wl->kernels[2], &wl->kernels[ALGORITHM_COUNT + 3], &wl->kernels[KERNEL_COUNT - 1]
+    };
+    wl->targets.resize(WINDOW_COUNT);
+    wl->windows.resize(WINDOW_COUNT);
+    for (size_t i = 0; i < WINDOW_COUNT; i++) {
+        TickWindow& tw = wl->windows[i];
+        int32_t ww = screens[i].right - screens[i].left, wh = screens[i].bottom - screens[i].top;
+        wl->screens[i] = screens[i];
+        wl->targets[i].assign((size_t)ww * wh * 4, 0);
+        tw.handle = i + 1;
+        tw.screen = screens[i];
+        tw.kernel = kernels[i];
+        plan_region_blur(i == 1 ? &list : nullptr, ww, wh, kernels[i] ? kernels[i]->radius : 0, &tw.plan);
+        tw.color_argb = 0x40102030;
+        tw.effects = i == 3 ? &wl->effects : nullptr;
+        tw.backdrop = i < 2 ? &wl->backdrops[i] : nullptr;
+        tw.mode = i == 0 ? CPU_BLUR_FULL_FRAME : CPU_BLUR_STREAMING;
+        BlurSurface t = { wl->targets[i].data(), ww, wh, ww * 4 };
+        tw.target = t;
+    }
+}
+
+/*
+ * One frame: every kernel in both modes, region blurs with and without
+ * effects, and a shared capture tick in which the first two windows moved
+ */
+static int32_t run_frame(Workload* wl) {
+    int32_t rc = BLUR_SUCCESS;
+    for (size_t i = 0; rc == BLUR_SUCCESS && i < KERNEL_COUNT; i++) {
+        rc = cpu_blur(&wl->surface, &wl->surface, &wl->kernels[i], CPU_BLUR_FULL_FRAME);
+        if (rc == BLUR_SUCCESS) rc = cpu_blur(&wl->surface, &wl->surface, &wl->kernels[i], CPU_BLUR_STREAMING);
+    }
+    if (rc == BLUR_SUCCESS) {
+        rc = cpu_blur_regions(&wl->surface, &wl->kernels[0], CPU_BLUR_STREAMING, &wl->plan, 0x80FFFFFF);
+    }
+    if (rc == BLUR_SUCCESS) {
+        rc = cpu_blur_regions(&wl->surface, &wl->kernels[ALGORITHM_COUNT], CPU_BLUR_FULL_FRAME, &wl->plan, 0,
+                              &wl->effects);
+    }
+
+    int32_t dx = (int32_t)(++wl->frame % 2) * 8;
+    for (size_t i = 0; i < 2; i++) {
+        const RegionRect& r = wl->screens[i];
+        RegionRect moved = { r.left + dx, r.top + dx, r.right + dx, r.bottom + dx };
+        wl->windows[i].screen = moved;
+    }
+    TickStats ts;
+    if (rc == BLUR_SUCCESS) rc = run_shared_tick(wl->windows.data(), wl->windows.size(), &wl->source, &ts);
+    scratch_arena().end_frame();
+    return rc;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================ */
+int test_bump_and_rewind() {
+    ScratchArena arena(4096, false);
+    void* a = arena.alloc(10);
+    void* b = arena.alloc(100);
+    TEST_ASSERT(a && b, "Allocations succeed");
+    TEST_ASSERT(((uintptr_t)a % ARENA_ALIGNMENT) == 0 && ((uintptr_t)b % ARENA_ALIGNMENT) == 0,
+                "Allocations are 64-byte aligned");
+    TEST_ASSERT((uint8_t*)b - (uint8_t*)a == ARENA_ALIGNMENT, "Small allocations are bumped one line apart");
+
+    size_t before = arena.used();
+    {
+        ArenaScope scope(arena);
+        TEST_ASSERT(arena.alloc(1000) != nullptr, "Scoped allocation succeeds");
+        TEST_ASSERT(arena.used() > before, "Scoped allocation is counted");
+    }
+    TEST_ASSERT(arena.used() == before, "Leaving a scope rewinds the arena");
+    TEST_ASSERT(arena.alloc_array<uint64_t>((size_t)-1) == nullptr, "Overflowing array sizes fail");
+    return 0;
+}
+
+int test_overflow_blocks() {
+    ScratchArena arena(4096, true);
+    {
+        ArenaScope scope(arena);
+        for (int i = 0; i < 20; i++) {
+            uint8_t* p = arena.alloc_array<uint8_t>(3000);
+            if (!p) break;
+            memset(p, i, 3000);
+        }
+        TEST_ASSERT(arena.used() >= 20 * 3000, "The arena grows past its first block");
+        TEST_ASSERT(arena.block_allocs() > 1, "Growth adds overflow blocks");
+    }
+    size_t peak = arena.high_water();
+
+    stats_reset();
+    arena.end_frame();
+    TEST_ASSERT(arena.used() == 0, "end_frame resets the arena");
+    TEST_ASSERT(arena.capacity() >= peak, "Overflow blocks merge into one that holds the frame");
+    TEST_ASSERT(stats_get(BLUR_STAT_ARENA_HIGH_WATER) == peak, "The high-water mark is published");
+    TEST_ASSERT(stats_get(BLUR_STAT_ARENA_BLOCK_ALLOCS) == arena.block_allocs(),
+                "Block allocations are published");
+
+    uint64_t blocks = arena.block_allocs();
+    for (int frame = 0; frame < 3; frame++) {
+        {
+            ArenaScope scope(arena);
+            for (int i = 0; i < 20; i++) arena.alloc_array<uint8_t>(3000);
+        }
+        arena.end_frame();
+    }
+    TEST_ASSERT(arena.block_allocs() == blocks, "Repeated frames reuse the merged block");
+    TEST_ASSERT(stats_get(BLUR_STAT_ARENA_BLOCK_ALLOCS) == blocks, "Steady frames add no block allocations");
+
+    arena.release();
+    TEST_ASSERT(arena.capacity() == 0, "release frees every block");
+    return 0;
+}
+
+int test_steady_state_frames() {
+    Workload wl;
+    setup(&wl);
+
+    g_heap_calls = 0;
+    g_counting = true;
+    std::vector<int>* probe = new std::vector<int>(16);
+    g_counting = false;
+    delete probe;
+    TEST_ASSERT(g_heap_calls >= 2, "The counting hooks see heap calls");
+
+    /* Row bands go to the workers, whose arenas must reach steady state too */
+    TEST_ASSERT(executor_start(3) == BLUR_SUCCESS, "Executor starts");
+
+    /* Warm-up frames size the arenas and every reused container, at both window positions */
+    int32_t rc = BLUR_SUCCESS;
+    for (int frame = 0; frame < 4 && rc == BLUR_SUCCESS; frame++) rc = run_frame(&wl);
+    TEST_ASSERT(rc == BLUR_SUCCESS, "Warm-up frames succeed");
+
+    ExecutorStats before, after;
+    executor_get_stats(&before);
+    g_heap_calls = 0;
+    g_counting = true;
+    for (int frame = 0; frame < 6 && rc == BLUR_SUCCESS; frame++) rc = run_frame(&wl);
+    g_counting = false;
+    executor_get_stats(&after);
+    executor_stop();
+
+    printf("  heap calls in 6 steady frames: %ld (arena high water %zu bytes)\n",
+           g_heap_calls.load(), scratch_arena().high_water());
+    TEST_ASSERT(rc == BLUR_SUCCESS, "Steady frames succeed");
+    TEST_ASSERT(after.executed[EXECUTOR_LANE_BACKGROUND] > before.executed[EXECUTOR_LANE_BACKGROUND],
+                "Steady frames ran bands on the executor");
+    TEST_ASSERT(wl.windows[0].reused.size() > 0, "Moving windows reused their backdrops");
+    TEST_ASSERT(g_heap_calls == 0, "Steady-state frames make no heap allocations");
+    TEST_ASSERT(scratch_arena().high_water() >= cpu_blur_scratch_bytes(192, 128, wl.kernels[0].radius,
+                                                                       CPU_BLUR_FULL_FRAME),
+                "The arena served the full-frame scratch");
+    return 0;
+}
+
+int main() {
+    printf("=== scratch_arena Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: bump_and_rewind\n");
+    failures += test_bump_and_rewind();
+    printf("\n");
+
+    printf("Test: overflow_blocks\n");
+    failures += test_overflow_blocks();
+    printf("\n");
+
+    printf("Test: steady_state_frames\n");
+    failures += test_steady_state_frames();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,301 @@
+/*
+ * test_tick_recorder.cpp - Tests for tick recording and replay
+ */
+
+#include "tick_recorder.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+#define TICKS 8
+
+/* Desktop colour of a screen pixel; a clock in the top-left corner changes every tick */
+static uint8_t screen_byte(int32_t x, int32_t y, int32_t ch, int32_t tick) {
+    uint32_t v = (uint32_t)(x * 73856093) ^ (uint32_t)(y * 19349663) ^ (uint32_t)(ch * 83492791);
+    if (x < 24 && y < 16) v += (uint32_t)tick * 40503u;
+    return (uint8_t)(v >> 7);
+}
+
+class ScreenSource : public CaptureSource {
+public:
+    int32_t tick = 0;
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        m_bounds = bounds;
+        m_pixels.assign((size_t)rect_area(bounds) * 4, 0);
+        int32_t w = bounds.right - bounds.left;
+        m_frame = *frame = { m_pixels.data(), w, bounds.bottom - bounds.top, w * 4 };
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& area) override {
+        for (int32_t y = area.top; y < area.bottom; y++) {
+            for (int32_t x = area.left; x < area.right; x++) {
+                uint8_t* p = m_frame.pixels + (size_t)(y - m_bounds.top) * m_frame.stride +
+                             (size_t)(x - m_bounds.left) * 4;
+                for (int32_t ch = 0; ch < 4; ch++) p[ch] = screen_byte(x, y, ch, tick);
+            }
+        }
+    }
+
+    void end_frame() override {
+        m_pixels.clear();
+    }
+
+private:
+    RegionRect m_bounds;
+    BlurSurface m_frame;
+    std::vector<uint8_t> m_pixels;
+};
+
+class MemorySink : public RecordSink {
+public:
+    std::vector<uint8_t> bytes;
+
+    bool write(const void* data, size_t n) override {
+        bytes.insert(bytes.end(), (const uint8_t*)data, (const uint8_t*)data + n);
+        return true;
+    }
+};
+
+/*
+ * Three windows live: one that stays put, one dragged to the right for the
+ * first ticks with a backdrop cache and an effect graph, and one that
+ * switches from a pyramid to a downsampled box blur half way; the first is a
+ * GPU window (capture only) on odd ticks.
+ * Every tick is recorded and each window's target kept.
+ */
+struct LiveRun {
+    std::vector<std::vector<std::vector<uint8_t>>> targets;    /* [tick][window] */
+    TickRecorderStats stats;
+};
+
+static int32_t run_live(RecordSink* sink, uint32_t flags, LiveRun* out) {
+    TickRecorder recorder;
+    if (recorder.open(sink, flags) != BLUR_SUCCESS) return BLUR_INVALID_PARAMS;
+
+    BlurKernel still, pyramid, box;
+    build_blur_kernel(3.0f, BLUR_ALGORITHM_EXACT, 1, &still);
+    kernel_set_linear_light(&still, true);
+    build_blur_kernel(9.0f, BLUR_ALGORITHM_PYRAMID, 1, &pyramid);
+    build_blur_kernel(6.0f, BLUR_ALGORITHM_BOX, 2, &box);
+    BackdropCache dragged;
+    ScreenSource screen;
+    BlurEffectList_V1 list = {};
+    list.struct_version = 1;
+    list.effect_count = 3;
+    list.effects[0] = { BLUR_EFFECT_SATURATION, 0, 1.4f, 0 };
+    list.effects[1] = { BLUR_EFFECT_TINT, 0x40203040, 0.0f, 0 };
+    list.effects[2] = { BLUR_EFFECT_NOISE, 0, 0.05f, 0 };
+    EffectProgram effects;
+    if (compile_effect_graph(&list, &effects) != BLUR_SUCCESS) return BLUR_INVALID_PARAMS;
+
+    out->targets.assign(TICKS, std::vector<std::vector<uint8_t>>(3));
+    for (int32_t t = 0; t < TICKS; t++) {
+        std::vector<TickWindow> windows(3);
+        const int32_t d = (t < 3 ? t : 3) * 6;
+        const RegionRect rects[3] = { { 0, 0, 96, 64 }, { 40 + d, 30, 140 + d, 110 }, { 200, 0, 280, 70 } };
+        const BlurKernel* kernels[3] = { (t & 1) ? nullptr : &still, &still, t < TICKS / 2 ? &pyramid : &box };
+        for (int32_t i = 0; i < 3; i++) {
+            TickWindow& tw = windows[i];
+            int32_t w = rects[i].right - rects[i].left, h = rects[i].bottom - rects[i].top;
+            tw.handle = 0x100 + i;
+            tw.screen = rects[i];
+            tw.kernel = kernels[i];
+            plan_region_blur(nullptr, w, h, (kernels[i] ? kernels[i] : &still)->radius, &tw.plan);
+            tw.color_argb = i == 2 ? 0x40102030 : 0;
+            tw.mode = i == 0 ? CPU_BLUR_STREAMING : CPU_BLUR_FULL_FRAME;
+            tw.backdrop = i == 1 ? &dragged : nullptr;
+            tw.effects = i == 1 ? &effects : nullptr;
+            out->targets[t][i].assign((size_t)w * h * 4, 0);
+            tw.target = { out->targets[t][i].data(), w, h, w * 4 };
+        }
+
+        screen.tick = t;
+        recorder.record_tick(1000000 + (uint64_t)t * 16667, windows.data(), windows.size());
+        RecordingSource source(&screen, &recorder);
+        TickStats ts;
+        int32_t rc = run_shared_tick(windows.data(), windows.size(), &source, &ts);
+        if (rc != BLUR_SUCCESS) return rc;
+    }
+    out->stats = recorder.stats();
+    return recorder.failed() ? BLUR_INVALID_PARAMS : BLUR_SUCCESS;
+}
+
+/* Replays a recording and compares every target with the live run */
+static bool replay_matches(const std::vector<uint8_t>& bytes, const LiveRun& live) {
+    TickReader reader;
+    if (reader.open(bytes.data(), bytes.size()) != BLUR_SUCCESS) return false;
+    ReplayTick tick;
+    bool end = false;
+    for (int32_t t = 0; t <= TICKS; t++) {
+        if (reader.next_tick(&tick, &end) != BLUR_SUCCESS) return false;
+        if (end) return t == TICKS;
+        if (tick.time_us != (uint64_t)t * 16667 || tick.windows.size() != 3) return false;
+
+        ReplaySource source(&tick);
+        TickStats ts;
+        if (run_shared_tick(tick.windows.data(), tick.windows.size(), &source, &ts) != BLUR_SUCCESS) return false;
+        for (size_t i = 0; i < 3; i++) {
+            if (tick.targets[i] != live.targets[t][i]) {
+                printf("  tick %d window %zu differs\n", t, i);
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+int test_replay_raw() {
+    MemorySink sink;
+    LiveRun live;
+    TEST_ASSERT(run_live(&sink, 0, &live) == BLUR_SUCCESS, "Live ticks recorded");
+    TEST_ASSERT(live.stats.ticks == TICKS && live.stats.frames >= TICKS, "Every tick and frame counted");
+    TEST_ASSERT(live.stats.bytes_written == sink.bytes.size(), "Written bytes counted");
+    TEST_ASSERT(replay_matches(sink.bytes, live), "Raw replay reproduces every target");
+    return 0;
+}
+
+int test_replay_delta() {
+    MemorySink raw, delta;
+    LiveRun live_raw, live;
+    TEST_ASSERT(run_live(&raw, 0, &live_raw) == BLUR_SUCCESS, "Raw recording");
+    TEST_ASSERT(run_live(&delta, BLUR_RECORD_DELTA, &live) == BLUR_SUCCESS, "Delta recording");
+    TEST_ASSERT(replay_matches(delta.bytes, live), "Delta replay reproduces every target");
+
+    printf("  raw %zu bytes, delta %zu bytes, %llu frame bytes\n", raw.bytes.size(), delta.bytes.size(),
+           (unsigned long long)live.stats.frame_bytes);
+    TEST_ASSERT(delta.bytes.size() * 2 < raw.bytes.size(), "Deltas of a mostly static desktop are much smaller");
+    return 0;
+}
+
+int test_params_on_change() {
+    MemorySink sink;
+    LiveRun live;
+    TEST_ASSERT(run_live(&sink, BLUR_RECORD_DELTA, &live) == BLUR_SUCCESS, "Recording");
+    /* Each window once, plus the switch to the box kernel */
+    TEST_ASSERT(live.stats.params == 4, "Kernel parameters written only when they change");
+    return 0;
+}
+
+int test_corrupt_recordings() {
+    MemorySink sink;
+    LiveRun live;
+    TEST_ASSERT(run_live(&sink, BLUR_RECORD_DELTA, &live) == BLUR_SUCCESS, "Recording");
+
+    TickReader reader;
+    std::vector<uint8_t> bad = sink.bytes;
+    bad[0] = 'X';
+    TEST_ASSERT(reader.open(bad.data(), bad.size()) == BLUR_INVALID_PARAMS, "Bad magic rejected");
+    bad = sink.bytes;
+    bad[8] = TICK_RECORD_VERSION + 1;
+    TEST_ASSERT(reader.open(bad.data(), bad.size()) == BLUR_INVALID_PARAMS, "Unknown version rejected");
+
+    /* Cut in the middle of the last frame */
+    bad.assign(sink.bytes.begin(), sink.bytes.end() - 5);
+    TEST_ASSERT(reader.open(bad.data(), bad.size()) == BLUR_SUCCESS, "Truncated recording opens");
+    ReplayTick tick;
+    bool end = false;
+    int32_t rc = BLUR_SUCCESS;
+    int32_t ticks = 0;
+    while (rc == BLUR_SUCCESS && !end) {
+        rc = reader.next_tick(&tick, &end);
+        if (rc == BLUR_SUCCESS && !end) ticks++;
+    }
+    TEST_ASSERT(rc == BLUR_INVALID_PARAMS && ticks == TICKS - 1, "Truncated tick reported after the whole ones");
+
+    /* A delta frame whose reference was never seen */
+    TickReader fresh;
+    const size_t header = 16;
+    bad.assign(sink.bytes.begin(), sink.bytes.begin() + header);
+    size_t pos = header;
+    while (pos < sink.bytes.size()) {
+        uint32_t type, bytes;
+        memcpy(&type, &sink.bytes[pos], 4);
+        memcpy(&bytes, &sink.bytes[pos + 4], 4);
+        uint32_t codec = 0;
+        if (type == TICK_CHUNK_FRAME) memcpy(&codec, &sink.bytes[pos + 8 + 16], 4);
+        /* Keep everything but the frames of the first tick */
+        if (type != TICK_CHUNK_FRAME || codec == TICK_FRAME_DELTA_RLE) {
+            bad.insert(bad.end(), sink.bytes.begin() + pos, sink.bytes.begin() + pos + 8 + bytes);
+        }
+        pos += 8 + bytes;
+    }
+    TEST_ASSERT(fresh.open(bad.data(), bad.size()) == BLUR_SUCCESS, "Recording without keyframes opens");
+    TEST_ASSERT(fresh.next_tick(&tick, &end) == BLUR_SUCCESS && tick.frames.empty(), "First tick has no frames");
+    TEST_ASSERT(fresh.next_tick(&tick, &end) == BLUR_INVALID_PARAMS, "Delta without a reference rejected");
+    return 0;
+}
+
+int test_corrupt_plans() {
+    MemorySink sink;
+    LiveRun live;
+    TEST_ASSERT(run_live(&sink, 0, &live) == BLUR_SUCCESS, "Recording");
+
+    /* First window's first output rect: time, count, handle, screen, five words, rect count */
+    size_t pos = 16;
+    uint32_t type = 0, bytes = 0;
+    while (pos < sink.bytes.size()) {
+        memcpy(&type, &sink.bytes[pos], 4);
+        memcpy(&bytes, &sink.bytes[pos + 4], 4);
+        if (type == TICK_CHUNK_TICK) break;
+        pos += 8 + bytes;
+    }
+    TEST_ASSERT(type == TICK_CHUNK_TICK, "Tick chunk found");
+    const size_t output = pos + 8 + 8 + 4 + 8 + 16 + 20 + 4;
+    const int32_t whole[4] = { 0, 0, 96, 64 };
+    TEST_ASSERT(!memcmp(&sink.bytes[output], whole, sizeof(whole)), "Output rect located");
+
+    const int32_t cases[3][4] = { { 0, 0, 4096, 64 }, { -8, 0, 96, 64 }, { 10, 10, 10, 20 } };
+    const char* names[3] = { "Output past the window rejected", "Output before the window rejected",
+                             "Empty output rejected" };
+    for (int32_t c = 0; c < 3; c++) {
+        std::vector<uint8_t> bad = sink.bytes;
+        memcpy(&bad[output], cases[c], sizeof(cases[c]));
+        TickReader reader;
+        ReplayTick tick;
+        bool end = false;
+        TEST_ASSERT(reader.open(bad.data(), bad.size()) == BLUR_SUCCESS, "Corrupt recording opens");
+        TEST_ASSERT(reader.next_tick(&tick, &end) == BLUR_INVALID_PARAMS, names[c]);
+    }
+    return 0;
+}
+
+int main() {
+    printf("=== tick_recorder Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: replay_raw\n");
+    failures += test_replay_raw();
+    printf("\n");
+
+    printf("Test: replay_delta\n");
+    failures += test_replay_delta();
+    printf("\n");
+
+    printf("Test: params_on_change\n");
+    failures += test_params_on_change();
+    printf("\n");
+
+    printf("Test: corrupt_recordings\n");
+    failures += test_corrupt_recordings();
+    printf("\n");
+
+    printf("Test: corrupt_plans\n");
+    failures += test_corrupt_plans();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
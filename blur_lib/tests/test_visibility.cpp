@@ -0,0 +1,157 @@
+/*
+ * test_visibility.cpp - Tests for window-stack visibility culling
+ */
+
+#include "visibility.h"
+#include "stats.h"
+#include <cstdio>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static const RegionRect kMonitor = { 0, 0, 1920, 1080 };
+
+static StackWindow make_window(uintptr_t id, int32_t l, int32_t t, int32_t r, int32_t b,
+                               bool shown = true, bool opaque = true) {
+    StackWindow w = { id, { l, t, r, b }, shown, opaque };
+    return w;
+}
+
+int test_unobstructed() {
+    StackWindow stack[] = { make_window(1, 100, 100, 500, 400) };
+    std::vector<VisibilityInfo> out;
+    compute_stack_visibility(stack, 1, &kMonitor, 1, &out);
+    TEST_ASSERT(out[0].state == VISIBILITY_FULL, "Lone window is fully visible");
+    TEST_ASSERT(out[0].visible.size() == 1 && out[0].visible[0].left == 0 &&
+                out[0].visible[0].right == 400, "Visible area is window-relative");
+    return 0;
+}
+
+int test_fully_covered() {
+    StackWindow stack[] = {
+        make_window(1, 0, 0, 1000, 800),        /* Big opaque window on top */
+        make_window(2, 100, 100, 500, 400),     /* Blurred window underneath */
+    };
+    std::vector<VisibilityInfo> out;
+    compute_stack_visibility(stack, 2, &kMonitor, 1, &out);
+    TEST_ASSERT(out[1].state == VISIBILITY_HIDDEN, "Covered window is hidden");
+    TEST_ASSERT(out[1].visible_area == 0, "Covered window has no visible pixels");
+
+    /* Two windows that only cover it together */
+    StackWindow pair[] = {
+        make_window(1, 0, 0, 300, 800),
+        make_window(2, 300, 0, 1000, 800),
+        make_window(3, 100, 100, 500, 400),
+    };
+    compute_stack_visibility(pair, 3, &kMonitor, 1, &out);
+    TEST_ASSERT(out[2].state == VISIBILITY_HIDDEN, "Window covered by a union is hidden");
+    return 0;
+}
+
+int test_partially_covered() {
+    StackWindow stack[] = {
+        make_window(1, 0, 0, 300, 1080),        /* Covers the left 200px */
+        make_window(2, 100, 100, 500, 400),
+    };
+    std::vector<VisibilityInfo> out;
+    compute_stack_visibility(stack, 2, &kMonitor, 1, &out);
+    TEST_ASSERT(out[1].state == VISIBILITY_PARTIAL, "Half-covered window is partial");
+    TEST_ASSERT(out[1].visible_area == 200 * 300, "Only the uncovered strip is visible");
+    RegionRect b = region_bounds(out[1].visible);
+    TEST_ASSERT(b.left == 200 && b.right == 400 && b.top == 0 && b.bottom == 300,
+                "Visible strip is reported window-relative");
+    return 0;
+}
+
+int test_non_occluders() {
+    StackWindow stack[] = {
+        make_window(1, 0, 0, 1920, 1080, true, false),     /* Layered overlay */
+        make_window(2, 0, 0, 1920, 1080, false, true),     /* Minimized or cloaked */
+        make_window(3, 100, 100, 500, 400),
+    };
+    std::vector<VisibilityInfo> out;
+    compute_stack_visibility(stack, 3, &kMonitor, 1, &out);
+    TEST_ASSERT(out[2].state == VISIBILITY_FULL, "See-through and hidden windows do not occlude");
+    TEST_ASSERT(out[1].state == VISIBILITY_HIDDEN, "A hidden window is itself culled");
+    return 0;
+}
+
+int test_monitors() {
+    RegionRect monitors[] = { { 0, 0, 1920, 1080 }, { 1920, 0, 3840, 1080 } };
+    StackWindow stack[] = {
+        make_window(1, 5000, 0, 5400, 300),     /* Entirely off-screen */
+        make_window(2, 1800, 900, 2100, 1200),  /* Spans both, hangs off the bottom */
+    };
+    std::vector<VisibilityInfo> out;
+    compute_stack_visibility(stack, 2, monitors, 2, &out);
+    TEST_ASSERT(out[0].state == VISIBILITY_HIDDEN, "Off-screen window is hidden");
+    TEST_ASSERT(out[1].state == VISIBILITY_PARTIAL, "Window hanging off the desktop is partial");
+    TEST_ASSERT(out[1].visible_area == 300 * 180, "Visible area spans both monitors");
+    TEST_ASSERT(out[1].visible.size() == 1, "Adjacent monitors merge into one visible rect");
+    return 0;
+}
+
+int test_plan_and_stats() {
+    StackWindow stack[] = {
+        make_window(1, 0, 0, 300, 1080),
+        make_window(2, 100, 100, 500, 400),
+        make_window(3, 0, 0, 200, 200),          /* Fully under window 1 */
+    };
+    std::vector<VisibilityInfo> out;
+    compute_stack_visibility(stack, 3, &kMonitor, 1, &out);
+
+    RegionBlurPlan plan;
+    plan_region_blur(nullptr, 400, 300, 10, &plan);
+    clip_region_plan(&plan, out[1].visible, 400, 300, 10);
+    TEST_ASSERT(region_area(plan.output) == 200 * 300, "Plan output shrinks to the visible area");
+    TEST_ASSERT(region_area(plan.capture) == 210 * 300, "Capture keeps a halo into covered pixels");
+
+    stats_reset();
+    record_visibility_stats(out[1]);
+    record_visibility_stats(out[2]);
+    TEST_ASSERT(stats_get(BLUR_STAT_FRAMES_PARTIAL) == 1, "Partial frame is counted");
+    TEST_ASSERT(stats_get(BLUR_STAT_FRAMES_CULLED) == 1, "Culled frame is counted");
+    TEST_ASSERT(stats_get(BLUR_STAT_PIXELS_CULLED) == 200 * 300 + 200 * 200, "Culled pixels are counted");
+    return 0;
+}
+
+int main() {
+    printf("=== visibility Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: unobstructed\n");
+    failures += test_unobstructed();
+    printf("\n");
+
+    printf("Test: fully_covered\n");
+    failures += test_fully_covered();
+    printf("\n");
+
+    printf("Test: partially_covered\n");
+    failures += test_partially_covered();
+    printf("\n");
+
+    printf("Test: non_occluders\n");
+    failures += test_non_occluders();
+    printf("\n");
+
+    printf("Test: monitors\n");
+    failures += test_monitors();
+    printf("\n");
+
+    printf("Test: plan_and_stats\n");
+    failures += test_plan_and_stats();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
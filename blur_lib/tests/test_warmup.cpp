@@ -0,0 +1,157 @@
+/*
+ * test_warmup.cpp - Tests for background warm-up, init timings and the kernel cache
+ */
+
+#include "kernel_cache.h"
+#include "warmup.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static std::atomic<bool> g_release(false);
+static std::atomic<bool> g_finished(false);
+
+/* Stands in for device creation: holds warm-up open until the test releases it */
+static void slow_warmup(void) {
+    {
+        PhaseTimer t(BLUR_INIT_PHASE_D3D_DEVICE);
+        while (!g_release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    PhaseTimer t(BLUR_INIT_PHASE_KERNEL_TABLES);
+    prewarm_blur_kernels();
+    g_finished.store(true);
+}
+
+static void quick_warmup(void) {
+}
+
+int test_wait() {
+    init_timings_reset();
+    kernel_cache_clear();
+    TEST_ASSERT(warmup_wait() == 0, "Waiting without a warm-up returns at once");
+
+    TEST_ASSERT(warmup_start(slow_warmup), "Warm-up starts");
+    TEST_ASSERT(!warmup_start(quick_warmup), "Only one warm-up runs at a time");
+    TEST_ASSERT(warmup_running(), "Warm-up runs in the background");
+
+    /* The first apply arrives early and has to wait */
+    std::thread releaser([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        g_release.store(true);
+    });
+    uint64_t waited = warmup_wait();
+    releaser.join();
+    TEST_ASSERT(g_finished.load() && !warmup_running(), "Waiting returns once warm-up is done");
+    TEST_ASSERT(waited >= 10000, "The wait lasts until warm-up finishes");
+    TEST_ASSERT(init_timing_get(BLUR_INIT_PHASE_APPLY_WAIT) == waited, "The first wait is recorded");
+    TEST_ASSERT(init_timing_get(BLUR_INIT_PHASE_D3D_DEVICE) >= 10000, "Phases record their own time");
+    TEST_ASSERT(init_timing_get(BLUR_INIT_PHASE_WARMUP_TOTAL) >= init_timing_get(BLUR_INIT_PHASE_D3D_DEVICE),
+                "The warm-up total covers its phases");
+    TEST_ASSERT(warmup_wait() == 0, "Later waits return at once");
+
+    warmup_join();
+    TEST_ASSERT(warmup_start(quick_warmup), "A joined warm-up can start again");
+    warmup_join();
+    TEST_ASSERT(init_timing_get(BLUR_INIT_PHASE_COUNT) == 0, "Unknown phases read as zero");
+    return 0;
+}
+
+int test_kernel_cache() {
+    kernel_cache_clear();
+    uint32_t warmed = prewarm_blur_kernels();
+    TEST_ASSERT(warmed == 12, "Common intensities are built for every CPU algorithm");
+
+    BlurKernel fallback;
+    float sigma = sigma_from_intensity(0.5f);
+    const BlurKernel* k = get_blur_kernel(sigma, BLUR_ALGORITHM_BOX, 1, false, &fallback);
+    TEST_ASSERT(k != &fallback && kernel_cache_count() == warmed, "Prewarmed kernels are found again");
+
+    BlurKernel built;
+    build_blur_kernel(sigma, BLUR_ALGORITHM_BOX, 1, &built);
+    TEST_ASSERT(kernels_equal(k, &built) && k->box_radius[0] == built.box_radius[0],
+                "Cached kernels match freshly built ones");
+    TEST_ASSERT(get_blur_kernel(sigma, BLUR_ALGORITHM_BOX, 0, false, &fallback) == k,
+                "Downsample 0 and 1 share an entry");
+
+    const BlurKernel* d2 = get_blur_kernel(sigma, BLUR_ALGORITHM_EXACT, 2, false, &fallback);
+    TEST_ASSERT(d2 != &fallback && d2->scale == 2 && kernel_cache_count() == warmed + 1,
+                "New keys are added");
+
+    const BlurKernel* lin = get_blur_kernel(sigma, BLUR_ALGORITHM_EXACT, 1, true, &fallback);
+    TEST_ASSERT(lin != get_blur_kernel(sigma, BLUR_ALGORITHM_EXACT, 1, false, &fallback) &&
+                lin->transfer == BLUR_TRANSFER_LINEAR && kernel_cache_count() == warmed + 2,
+                "Linear-light kernels are cached separately");
+
+    /* A slider dragged across the whole range, twice: the second pass builds nothing */
+    uint32_t before_sweep = kernel_cache_count();
+    bool fell_back = false;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass) before_sweep = kernel_cache_count();
+        for (int i = 0; i <= 1000; i++) {
+            const BlurKernel* s = get_blur_kernel(sigma_from_intensity(i / 1000.0f), BLUR_ALGORITHM_EXACT, 1, false,
+                                                  &fallback);
+            if (s == &fallback) fell_back = true;
+        }
+    }
+    TEST_ASSERT(!fell_back, "An intensity sweep always gets cached kernels");
+    TEST_ASSERT(kernel_cache_count() == before_sweep, "A repeated sweep only hits the cache");
+    TEST_ASSERT(kernel_cache_count() <= warmed + 2 + 81, "A sweep adds at most one key per quarter pixel of sigma");
+    const BlurKernel* near = get_blur_kernel(sigma + 0.1f, BLUR_ALGORITHM_EXACT, 1, false, &fallback);
+    TEST_ASSERT(near == get_blur_kernel(sigma, BLUR_ALGORITHM_EXACT, 1, false, &fallback) && near->sigma == sigma,
+                "Nearby sigmas share the quantized kernel");
+
+    for (int i = 0; kernel_cache_count() < KERNEL_CACHE_SIZE; i++) {
+        get_blur_kernel(1.0f + (float)i * 0.5f, BLUR_ALGORITHM_EXACT, 1, false, &fallback);
+    }
+    const BlurKernel* full = get_blur_kernel(999.0f, BLUR_ALGORITHM_EXACT, 1, false, &fallback);
+    TEST_ASSERT(full == &fallback && fallback.sigma == 999.0f, "A full table builds into the caller's kernel");
+
+    /* Readers look up while another thread inserts */
+    kernel_cache_clear();
+    std::atomic<int> wrong(0);
+    std::thread writer([]() {
+        BlurKernel unused;
+        for (int i = 0; i < KERNEL_CACHE_SIZE; i++) get_blur_kernel(0.5f + (float)i, BLUR_ALGORITHM_EXACT, 1, false, &unused);
+    });
+    std::thread reader([&]() {
+        BlurKernel own;
+        for (int round = 0; round < 200; round++) {
+            for (int i = 0; i < 8; i++) {
+                const BlurKernel* r = get_blur_kernel(0.5f + (float)i, BLUR_ALGORITHM_EXACT, 1, false, &own);
+                if (r->sigma != 0.5f + (float)i || r->weights.size() != (size_t)r->radius * 2 + 1) wrong++;
+            }
+        }
+    });
+    writer.join();
+    reader.join();
+    TEST_ASSERT(wrong.load() == 0, "Concurrent lookups always see complete kernels");
+    return 0;
+}
+
+int main() {
+    printf("=== warmup Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: wait\n");
+    failures += test_wait();
+    printf("\n");
+
+    printf("Test: kernel_cache\n");
+    failures += test_kernel_cache();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,259 @@
+/*
+ * test_window_registry.cpp - Tests for the tracked-window snapshot and change feed
+ */
+
+#include "window_registry.h"
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+
+#define TEST_ASSERT(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s\n", msg); \
+            return 1; \
+        } \
+        printf("PASS: %s\n", msg); \
+    } while (0)
+
+static BlurSettings settings_for(float intensity, uint32_t algorithm) {
+    BlurSettings s = {};
+    s.struct_version = 2;
+    s.intensity = intensity;
+    s.color_argb = 0x80000000;
+    s.algorithm = algorithm;
+    s.downsample = 1;
+    s.refresh_interval_ms = 100;
+    return s;
+}
+
+struct Feed {
+    uint64_t epoch = 0;
+    std::vector<BlurWindowChange_V1> changes = std::vector<BlurWindowChange_V1>(BLUR_MAX_TRACKED_WINDOWS);
+    uint32_t count = 0;
+    uint32_t flags = 0;
+
+    int32_t poll() {
+        return registry_changes(epoch, changes.data(), (uint32_t)changes.size(), &count, &epoch, &flags);
+    }
+
+    const BlurWindowChange_V1* find(uint64_t handle) const {
+        for (uint32_t i = 0; i < count; i++) {
+            if (changes[i].info.window_handle == handle) return &changes[i];
+        }
+        return nullptr;
+    }
+};
+
+int test_snapshot() {
+    registry_clear();
+    registry_track(0x100, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_BOX));
+    registry_track(0x200, BLUR_BACKEND_COMPOSITION, settings_for(1.0f, BLUR_ALGORITHM_EXACT));
+    registry_track(0x300, BLUR_BACKEND_DWM, settings_for(0.25f, BLUR_ALGORITHM_AUTO));
+    registry_record_frame(0x100, 1234, 5000);
+
+    BlurWindowInfo_V1 infos[4];
+    uint32_t count = 0;
+    uint64_t epoch = 0;
+    TEST_ASSERT(registry_snapshot(infos, 4, &count, &epoch) == BLUR_SUCCESS && count == 3,
+                "Snapshot lists every tracked window");
+    TEST_ASSERT(epoch > 0, "Snapshot reports its epoch");
+    TEST_ASSERT(infos[0].window_handle == 0x100 && infos[0].backend == BLUR_BACKEND_D2D &&
+                infos[0].algorithm == BLUR_ALGORITHM_BOX && infos[0].intensity == 0.5f,
+                "Snapshot carries backend and parameters");
+    TEST_ASSERT(infos[0].last_frame_us == 1234 && infos[0].last_frame_pixels == 5000,
+                "Snapshot carries the last frame cost");
+
+    TEST_ASSERT(registry_snapshot(infos, 2, &count, nullptr) == BLUR_INVALID_PARAMS && count == 3,
+                "A short array reports the size it needs");
+    TEST_ASSERT(registry_snapshot(nullptr, 0, &count, nullptr) == BLUR_INVALID_PARAMS && count == 3,
+                "A size query needs no array");
+
+    BlurWindowInfo_V1 one;
+    TEST_ASSERT(registry_lookup(0x200, &one) && one.backend == BLUR_BACKEND_COMPOSITION, "Lookup finds a window");
+    TEST_ASSERT(!registry_lookup(0x999, nullptr), "Lookup misses untracked windows");
+    return 0;
+}
+
+int test_change_feed() {
+    registry_clear();
+    Feed feed;
+    registry_track(0x1, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT));
+    registry_track(0x2, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT));
+
+    TEST_ASSERT(feed.poll() == BLUR_SUCCESS && feed.count == 2, "First poll reports every window");
+    TEST_ASSERT(feed.changes[0].kind == BLUR_CHANGE_ADDED && feed.changes[1].kind == BLUR_CHANGE_ADDED,
+                "Windows the caller has not seen are added");
+
+    TEST_ASSERT(feed.poll() == BLUR_SUCCESS && feed.count == 0, "Nothing changed, nothing reported");
+
+    registry_track(0x2, BLUR_BACKEND_D2D, settings_for(0.75f, BLUR_ALGORITHM_EXACT));
+    registry_track(0x1, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT));
+    registry_record_frame(0x1, 500, 100);
+    feed.poll();
+    TEST_ASSERT(feed.count == 1 && feed.changes[0].kind == BLUR_CHANGE_UPDATED &&
+                feed.changes[0].info.window_handle == 0x2 && feed.changes[0].info.intensity == 0.75f,
+                "Only real parameter changes are updates");
+
+    registry_untrack(0x1);
+    registry_track(0x3, BLUR_BACKEND_DWM, settings_for(1.0f, BLUR_ALGORITHM_EXACT));
+    registry_track(0x4, BLUR_BACKEND_DWM, settings_for(1.0f, BLUR_ALGORITHM_EXACT));
+    registry_untrack(0x4);
+    feed.poll();
+    TEST_ASSERT(feed.count == 2 && feed.flags == 0, "Removal and addition are reported once each");
+    TEST_ASSERT(feed.find(0x1) && feed.find(0x1)->kind == BLUR_CHANGE_REMOVED, "Removed windows are reported");
+    TEST_ASSERT(feed.find(0x3) && feed.find(0x3)->kind == BLUR_CHANGE_ADDED, "New windows are reported");
+    TEST_ASSERT(!feed.find(0x4), "Windows added and removed between polls are not reported");
+
+    registry_untrack(0x3);
+    registry_track(0x3, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT));
+    feed.poll();
+    TEST_ASSERT(feed.count == 2 && feed.changes[0].kind == BLUR_CHANGE_REMOVED &&
+                feed.changes[1].kind == BLUR_CHANGE_ADDED && feed.changes[1].info.backend == BLUR_BACKEND_D2D,
+                "A window removed and re-applied reads as a removal then an addition");
+
+    uint32_t count = 0;
+    uint64_t epoch = 0;
+    TEST_ASSERT(registry_changes(0, nullptr, 0, &count, &epoch, nullptr) == BLUR_INVALID_PARAMS && count == 2,
+                "A size query reports the changes pending");
+    return 0;
+}
+
+int test_resync() {
+    registry_clear();
+    Feed stale, fresh;
+    for (uint64_t h = 1; h <= BLUR_MAX_TRACKED_WINDOWS; h++) {
+        registry_track(h, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT));
+    }
+    stale.poll();
+    TEST_ASSERT(stale.count == BLUR_MAX_TRACKED_WINDOWS, "A full table fits the documented array size");
+    TEST_ASSERT(registry_track(0x10000, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT)) ==
+                BLUR_OUT_OF_MEMORY, "Tracking fails once every slot holds a live window");
+
+    registry_untrack(7);
+    fresh.poll();
+    TEST_ASSERT(registry_track(0x10000, BLUR_BACKEND_D2D, settings_for(0.5f, BLUR_ALGORITHM_EXACT)) ==
+                BLUR_SUCCESS, "A tombstone is reused when the table is full");
+
+    stale.poll();
+    TEST_ASSERT(stale.flags == BLUR_CHANGES_RESYNC, "A feed that missed a forgotten removal resyncs");
+    TEST_ASSERT(stale.count == BLUR_MAX_TRACKED_WINDOWS && !stale.find(7) && stale.find(0x10000),
+                "A resync lists exactly the live windows");
+
+    fresh.poll();
+    TEST_ASSERT(fresh.flags == 0 && fresh.count == 1 && fresh.changes[0].kind == BLUR_CHANGE_ADDED,
+                "A feed that saw the removal continues normally");
+
+    registry_clear();
+    fresh.poll();
+    TEST_ASSERT(fresh.flags == BLUR_CHANGES_RESYNC && fresh.count == 0, "Clearing the registry resyncs feeds");
+    fresh.poll();
+    TEST_ASSERT(fresh.flags == 0 && fresh.count == 0, "The feed settles after a resync");
+    return 0;
+}
+
+int test_concurrent_readers() {
+    registry_clear();
+    const uint64_t windows = 32;
+    for (uint64_t h = 1; h <= windows; h++) {
+        registry_track(h, BLUR_BACKEND_D2D, settings_for(0.0f, BLUR_ALGORITHM_EXACT));
+    }
+
+    /* The writer keeps intensity and color in lockstep so torn copies are visible */
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (uint32_t round = 1; round <= 3000; round++) {
+            uint64_t h = 1 + round % windows;
+            BlurSettings s = settings_for((float)round, BLUR_ALGORITHM_EXACT);
+            s.color_argb = round * 3;
+            if (round % 7 == 0) {
+                registry_untrack(h);
+            } else {
+                registry_track(h, BLUR_BACKEND_D2D, s);
+            }
+            registry_record_frame(h, round, (uint64_t)round * 2);
+        }
+        done.store(true);
+    });
+
+    std::atomic<int> torn(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back([&]() {
+            BlurWindowInfo_V1 infos[BLUR_MAX_TRACKED_WINDOWS];
+            while (!done.load()) {
+                uint32_t count = 0;
+                registry_snapshot(infos, BLUR_MAX_TRACKED_WINDOWS, &count, nullptr);
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t k = (uint32_t)infos[i].intensity;
+                    if (k && infos[i].color_argb != k * 3) torn++;
+                    if (infos[i].last_frame_pixels != (uint64_t)infos[i].last_frame_us * 2) torn++;
+                }
+            }
+        });
+    }
+
+    /* A feed follower rebuilds the live set from changes alone */
+    std::map<uint64_t, float> mirror;
+    Feed feed;
+    do {
+        feed.poll();
+        if (feed.flags & BLUR_CHANGES_RESYNC) mirror.clear();
+        for (uint32_t i = 0; i < feed.count; i++) {
+            const BlurWindowChange_V1& c = feed.changes[i];
+            if (c.kind == BLUR_CHANGE_REMOVED) mirror.erase(c.info.window_handle);
+            else mirror[c.info.window_handle] = c.info.intensity;
+        }
+    } while (!done.load());
+    writer.join();
+    for (std::thread& t : readers) t.join();
+
+    feed.poll();
+    if (feed.flags & BLUR_CHANGES_RESYNC) mirror.clear();
+    for (uint32_t i = 0; i < feed.count; i++) {
+        const BlurWindowChange_V1& c = feed.changes[i];
+        if (c.kind == BLUR_CHANGE_REMOVED) mirror.erase(c.info.window_handle);
+        else mirror[c.info.window_handle] = c.info.intensity;
+    }
+
+    TEST_ASSERT(torn.load() == 0, "Readers never see a torn entry");
+
+    BlurWindowInfo_V1 infos[BLUR_MAX_TRACKED_WINDOWS];
+    uint32_t count = 0;
+    registry_snapshot(infos, BLUR_MAX_TRACKED_WINDOWS, &count, nullptr);
+    bool same = mirror.size() == count;
+    for (uint32_t i = 0; same && i < count; i++) {
+        auto it = mirror.find(infos[i].window_handle);
+        same = it != mirror.end() && it->second == infos[i].intensity;
+    }
+    TEST_ASSERT(same, "Following the feed reproduces the final snapshot");
+    return 0;
+}
+
+int main() {
+    printf("=== window_registry Test Suite ===\n\n");
+
+    int failures = 0;
+
+    printf("Test: snapshot\n");
+    failures += test_snapshot();
+    printf("\n");
+
+    printf("Test: change_feed\n");
+    failures += test_change_feed();
+    printf("\n");
+
+    printf("Test: resync\n");
+    failures += test_resync();
+    printf("\n");
+
+    printf("Test: concurrent_readers\n");
+    failures += test_concurrent_readers();
+    printf("\n");
+
+    printf("=== Results: %d failures ===\n", failures);
+
+    return failures;
+}
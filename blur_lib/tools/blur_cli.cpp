@@ -0,0 +1,351 @@
+/*
+ * blur_cli.cpp - Offline blur of image files and raw frame streams
+ *
+ * Runs the library's CPU path (EffectParams decoding, region plans, the
+ * shared tick and its banded blur) over PPM, PAM or raw BGRA files, for
+ * batch jobs such as pre-blurring wallpapers and for profiling. Inputs are
+ * memory-mapped and blurred in place from the page cache; the output is
+ * created at its final size and written through a shared mapping. RGBA and
+ * BGRA frames never leave the mappings; RGB frames pass through one BGRA
+ * scratch frame each.
+ *
+ * Frames are blurred concurrently on the executor, and each frame is split
+ * into row bands on it as well. The output matches what a window would show:
+ * outside the regions (if any) it stays transparent.
+ *
+ * Profiling the kernels without the executor in the way:
+ *   perf record -g -- blur_cli --serial --repeat 200 in.pam out.pam
+ *   perf report
+ */
+
+#include "capture_planner.h"
+#include "effect_graph.h"
+#include "effect_params.h"
+#include "executor.h"
+#include "image_io.h"
+#include "mapped_file.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s [options] INPUT OUTPUT\n"
+        "Input and output: binary PPM/PAM (several images may be concatenated) or, with --raw, BGRA frames.\n"
+        "  --raw WxH               Input is headerless BGRA frames of W x H\n"
+        "  --intensity F           0.0 to 1.0 (default 0.5)\n"
+        "  --color AARRGGBB        Tint, hex (default none)\n"
+        "  --algorithm NAME        exact, box, pyramid, iir or auto (default exact)\n"
+        "  --downsample N          Blur at 1/N resolution, 1 to %d\n"
+        "  --streaming             Bounded-memory streaming blur\n"
+        "  --linear-light          Blur in linear light\n"
+        "  --region L,T,R,B[,RAD]  Blur only this rect (repeatable, up to %d)\n"
+        "  --effect NAME,VALUE     After the blur, in order (repeatable, up to %d; replaces --color):\n"
+        "                          saturation, noise or vignette with an amount; luminosity,\n"
+        "                          exclusion or tint with an AARRGGBB color\n"
+        "  --worker-threads N      Row bands per frame (0 = one per executor worker)\n"
+        "  --animate, --animation-ms N, --max-refresh-hz N, --frame-budget-us N\n"
+        "                          Validated like blur_apply_to_window; no effect offline\n"
+        "  --jobs N                Executor workers (0 = one per core, less one)\n"
+        "  --serial                Blur on the calling thread only\n"
+        "  --repeat N              Blur the whole input N times (for profilers)\n",
+        argv0, BLUR_MAX_DOWNSAMPLE, BLUR_MAX_REGIONS, BLUR_MAX_EFFECTS);
+}
+
+static bool parse_uint(const char* text, uint32_t* out) {
+    char* end;
+    unsigned long v = strtoul(text, &end, 0);
+    if (end == text || *end) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static bool parse_algorithm(const char* name, uint32_t* out) {
+    const char* names[] = { "exact", "box", "pyramid", "iir", "auto" };
+    const uint32_t values[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX, BLUR_ALGORITHM_PYRAMID,
+                                BLUR_ALGORITHM_IIR, BLUR_ALGORITHM_AUTO };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!strcmp(name, names[i])) {
+            *out = values[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_effect(const char* text, BlurEffect* out) {
+    const char* names[] = { "saturation", "luminosity", "exclusion", "tint", "noise", "vignette" };
+    const uint32_t types[] = { BLUR_EFFECT_SATURATION, BLUR_EFFECT_LUMINOSITY, BLUR_EFFECT_EXCLUSION,
+                               BLUR_EFFECT_TINT, BLUR_EFFECT_NOISE, BLUR_EFFECT_VIGNETTE };
+    const char* comma = strchr(text, ',');
+    if (!comma) return false;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strlen(names[i]) != (size_t)(comma - text) || strncmp(text, names[i], comma - text)) continue;
+        memset(out, 0, sizeof(*out));
+        out->type = types[i];
+        char* end;
+        if (types[i] == BLUR_EFFECT_SATURATION || types[i] == BLUR_EFFECT_NOISE || types[i] == BLUR_EFFECT_VIGNETTE) {
+            out->amount = strtof(comma + 1, &end);
+        } else {
+            out->color_argb = (uint32_t)strtoul(comma + 1, &end, 16);
+        }
+        return end != comma + 1 && *end == '\0';
+    }
+    return false;
+}
+
+/* Colors are written as B, G, R; R, G, B frames need red and blue swapped */
+static uint32_t rgb_order(uint32_t color) {
+    return (color & 0xFF00FF00) | ((color >> 16) & 0xFF) | ((color & 0xFF) << 16);
+}
+
+/* The frame's pixels as the shared tick's capture: a view of the input, never written */
+class FrameSource : public CaptureSource {
+public:
+    explicit FrameSource(const BlurSurface& input) : m_input(input) {}
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        *frame = surface_view(&m_input, bounds);
+        return BLUR_SUCCESS;
+    }
+    void capture(const RegionRect&) override {}
+    void end_frame() override {}
+
+private:
+    BlurSurface m_input;
+};
+
+struct FrameJob {
+    const uint8_t*      input;      /* Mapped stream bases */
+    uint8_t*            output;
+    ImageFrame          frame;
+    bool                rgb_order;  /* Netpbm samples are R, G, B(, A); raw frames are B, G, R, A */
+    const BlurSettings* settings;
+    int32_t             rc;
+};
+
+static void run_frame(void* ctx) {
+    FrameJob* job = (FrameJob*)ctx;
+    const ImageFrame& f = job->frame;
+    const BlurSettings& set = *job->settings;
+    const int32_t w = f.width, h = f.height;
+
+    BlurKernel kernel;
+    build_settings_kernel(set, (int64_t)w * h, &kernel);
+
+    /* Four-sample frames are blurred mapping to mapping; RGB goes through BGRA-sized scratch */
+    std::vector<uint8_t> in_scratch, out_scratch;
+    BlurSurface input, target;
+    if (f.depth == 4) {
+        input = { (uint8_t*)job->input + f.pixels, w, h, w * 4 };
+        target = { job->output + f.pixels, w, h, w * 4 };
+    } else {
+        in_scratch.resize((size_t)w * h * 4);
+        out_scratch.assign(in_scratch.size(), 0);
+        const uint8_t* s = job->input + f.pixels;
+        for (size_t i = 0; i < (size_t)w * h; i++) {
+            memcpy(&in_scratch[i * 4], s + i * 3, 3);
+            in_scratch[i * 4 + 3] = 255;
+        }
+        input = { in_scratch.data(), w, h, w * 4 };
+        target = { out_scratch.data(), w, h, w * 4 };
+    }
+
+    uint32_t color = job->rgb_order ? rgb_order(set.color_argb) : set.color_argb;
+    EffectProgram effects;
+    if (set.effects) {
+        BlurEffectList_V1 list = *set.effects;
+        for (uint32_t i = 0; job->rgb_order && i < list.effect_count; i++) {
+            list.effects[i].color_argb = rgb_order(list.effects[i].color_argb);
+        }
+        job->rc = compile_effect_graph(&list, &effects);
+        if (job->rc != BLUR_SUCCESS) return;
+    }
+
+    TickWindow tw;
+    tw.handle = 1;
+    tw.screen = { 0, 0, w, h };
+    job->rc = plan_region_blur(set.regions, w, h, kernel.radius, &tw.plan);
+    if (job->rc != BLUR_SUCCESS) return;
+    tw.kernel = &kernel;
+    tw.color_argb = color;
+    tw.effects = set.effects ? &effects : nullptr;
+    tw.mode = ((set.flags & BLUR_PARAMS_FLAG_STREAMING) || (int64_t)w * h >= BLUR_STREAMING_THRESHOLD_PIXELS)
+        ? CPU_BLUR_STREAMING : CPU_BLUR_FULL_FRAME;
+    tw.target = target;
+    tw.lane = EXECUTOR_LANE_BACKGROUND;
+    tw.max_tasks = set.worker_threads;
+
+    FrameSource source(input);
+    TickStats stats;
+    job->rc = run_shared_tick(&tw, 1, &source, &stats);
+
+    if (f.depth == 3) {
+        uint8_t* d = job->output + f.pixels;
+        for (size_t i = 0; i < (size_t)w * h; i++) memcpy(d + i * 3, &out_scratch[i * 4], 3);
+    }
+}
+
+/* The params with both trailing lists; effects set both flags (no rects = the whole frame) */
+#pragma pack(push, 1)
+struct CliParams {
+    EffectParams_V2   params;
+    BlurRegionList_V1 regions;
+    BlurEffectList_V1 effects;
+};
+#pragma pack(pop)
+
+int main(int argc, char* argv[]) {
+    CliParams ext;
+    memset(&ext, 0, sizeof(ext));
+    EffectParams_V2& p = ext.params;
+    p.struct_version = 2;
+    p.intensity = 0.5f;
+    ext.regions.struct_version = 1;
+    ext.effects.struct_version = 1;
+
+    int32_t raw_w = 0, raw_h = 0;
+    uint32_t jobs = 0, repeat = 1;
+    bool serial = false;
+    const char* paths[2] = { nullptr, nullptr };
+    int32_t path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (!strcmp(a, "--raw") && v) {
+            ok = sscanf(v, "%dx%d", &raw_w, &raw_h) == 2;
+            i++;
+        } else if (!strcmp(a, "--intensity") && v) {
+            p.intensity = strtof(v, nullptr);
+            i++;
+        } else if (!strcmp(a, "--color") && v) {
+            p.color_argb = (uint32_t)strtoul(v, nullptr, 16);
+            i++;
+        } else if (!strcmp(a, "--algorithm") && v) {
+            ok = parse_algorithm(v, &p.algorithm);
+            i++;
+        } else if (!strcmp(a, "--downsample") && v) {
+            ok = parse_uint(v, &p.downsample);
+            i++;
+        } else if (!strcmp(a, "--streaming")) {
+            p.reserved_flags |= BLUR_PARAMS_FLAG_STREAMING;
+        } else if (!strcmp(a, "--linear-light")) {
+            p.reserved_flags |= BLUR_PARAMS_FLAG_LINEAR_LIGHT;
+        } else if (!strcmp(a, "--region") && v) {
+            if (ext.regions.rect_count >= BLUR_MAX_REGIONS) {
+                ok = false;
+            } else {
+                BlurRect& r = ext.regions.rects[ext.regions.rect_count];
+                int n = sscanf(v, "%d,%d,%d,%d,%u", &r.left, &r.top, &r.right, &r.bottom, &r.corner_radius);
+                ok = n == 4 || n == 5;
+                ext.regions.rect_count++;
+                p.reserved_flags |= BLUR_PARAMS_FLAG_REGIONS;
+            }
+            i++;
+        } else if (!strcmp(a, "--effect") && v) {
+            ok = ext.effects.effect_count < BLUR_MAX_EFFECTS &&
+                 parse_effect(v, &ext.effects.effects[ext.effects.effect_count]);
+            ext.effects.effect_count++;
+            p.reserved_flags |= BLUR_PARAMS_FLAG_REGIONS | BLUR_PARAMS_FLAG_EFFECTS;
+            i++;
+        } else if (!strcmp(a, "--worker-threads") && v) {
+            ok = parse_uint(v, &p.worker_threads);
+            i++;
+        } else if (!strcmp(a, "--animate")) {
+            p.animate = 1;
+        } else if (!strcmp(a, "--animation-ms") && v) {
+            ok = parse_uint(v, &p.animation_ms);
+            i++;
+        } else if (!strcmp(a, "--max-refresh-hz") && v) {
+            ok = parse_uint(v, &p.max_refresh_hz);
+            i++;
+        } else if (!strcmp(a, "--frame-budget-us") && v) {
+            ok = parse_uint(v, &p.frame_budget_us);
+            i++;
+        } else if (!strcmp(a, "--jobs") && v) {
+            ok = parse_uint(v, &jobs);
+            i++;
+        } else if (!strcmp(a, "--serial")) {
+            serial = true;
+        } else if (!strcmp(a, "--repeat") && v) {
+            ok = parse_uint(v, &repeat) && repeat > 0;
+            i++;
+        } else if (a[0] != '-' && path_count < 2) {
+            paths[path_count++] = a;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (path_count != 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    BlurSettings settings;
+    const char* param_error = nullptr;
+    if (read_effect_params((const EffectParams*)&ext.params, &settings, &param_error) != BLUR_SUCCESS) {
+        fprintf(stderr, "Invalid parameters: %s\n", param_error ? param_error : "?");
+        return 2;
+    }
+
+    MappedFile in, out;
+    std::string error;
+    ImageStream stream;
+    if (in.open_read(paths[0], &error) != BLUR_SUCCESS ||
+        (raw_w ? parse_raw_stream(in.size(), raw_w, raw_h, &stream, &error)
+               : parse_netpbm_stream(in.data(), in.size(), &stream, &error)) != BLUR_SUCCESS ||
+        out.create(paths[1], in.size(), &error) != BLUR_SUCCESS) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    /* Headers (and anything else between frames) carry over byte for byte */
+    size_t copied = 0;
+    for (const ImageFrame& f : stream.frames) {
+        memcpy(out.data() + f.header, in.data() + f.header, f.pixels - f.header);
+        copied = f.pixels + f.bytes();
+    }
+    if (copied < in.size()) memcpy(out.data() + copied, in.data() + copied, in.size() - copied);
+
+    if (!serial) executor_start(jobs);
+    std::vector<FrameJob> frame_jobs(stream.frames.size());
+    int64_t pixels = 0;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for (uint32_t r = 0; r < repeat; r++) {
+        TaskGroup group;
+        for (size_t i = 0; i < stream.frames.size(); i++) {
+            FrameJob& job = frame_jobs[i];
+            job = { in.data(), out.data(), stream.frames[i], stream.format != IMAGE_FORMAT_RAW, &settings, BLUR_SUCCESS };
+            pixels += (int64_t)job.frame.width * job.frame.height;
+            executor_submit(EXECUTOR_LANE_BACKGROUND, run_frame, &job, &group);
+        }
+        executor_wait(&group, EXECUTOR_LANE_BACKGROUND);
+    }
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+    uint32_t workers = executor_workers();
+    executor_stop();
+
+    for (const FrameJob& job : frame_jobs) {
+        if (job.rc != BLUR_SUCCESS) {
+            fprintf(stderr, "Blur failed with error %d\n", job.rc);
+            return 1;
+        }
+    }
+    out.close();
+
+    printf("%zu frames x %u: %.1f ms, %.1f Mpixel/s, %.2f ns/pixel (%s)\n", stream.frames.size(), repeat,
+           seconds * 1000.0, pixels / seconds / 1e6, seconds * 1e9 / (double)pixels,
+           serial ? "serial" : (std::to_string(workers) + " workers").c_str());
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * blur_quality.cpp - Quality versus speed of every CPU blur setting
+ *
+ * Runs each algorithm, transfer and downsample setting over a corpus of
+ * images at several intensities and measures it against the double-precision
+ * Gaussian DoBlur() asks for: PSNR, largest channel error and luma SSIM,
+ * next to the time per pixel. The summary marks the Pareto front (no other
+ * setting is both faster and closer on average), which is where production
+ * defaults should come from.
+ *
+ * Usage: blur_quality [--repeat N] [--intensity a,b,...] [--csv FILE] [image.ppm|image.pam ...]
+ * Without images, a synthetic corpus (UI, photo-like and noise) is used.
+ */
+
+#include "image_io.h"
+#include "image_metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+/* Infinite PSNR (an exact match) counts as this much in averages */
+#define QUALITY_PSNR_CAP 99.0
+
+struct Setting {
+    uint32_t algorithm;
+    int32_t  downsample;
+    bool     linear;
+    std::string name;
+};
+
+struct Summary {
+    double  ns_per_pixel = 0.0;     /* Sums until the end, then means */
+    double  psnr = 0.0;
+    double  psnr_min = QUALITY_PSNR_CAP;
+    int32_t max_error = 0;
+    double  ssim = 0.0;
+    double  ssim_min = 1.0;
+    int32_t runs = 0;
+    bool    pareto = false;
+};
+
+static const char* algorithm_name(uint32_t algorithm) {
+    switch (algorithm) {
+    case BLUR_ALGORITHM_EXACT:   return "exact";
+    case BLUR_ALGORITHM_BOX:     return "box";
+    case BLUR_ALGORITHM_PYRAMID: return "pyramid";
+    case BLUR_ALGORITHM_IIR:     return "iir";
+    default:                     return "?";
+    }
+}
+
+/* Every combination; linear light only exists for direct kernels, so runs on others are skipped */
+static std::vector<Setting> all_settings() {
+    const uint32_t algorithms[] = { BLUR_ALGORITHM_EXACT, BLUR_ALGORITHM_BOX, BLUR_ALGORITHM_PYRAMID, BLUR_ALGORITHM_IIR };
+    const int32_t downsamples[] = { 1, 2, 4 };
+    std::vector<Setting> settings;
+    for (uint32_t algorithm : algorithms) {
+        for (int32_t downsample : downsamples) {
+            for (int32_t linear = 0; linear < 2; linear++) {
+                Setting s = { algorithm, downsample, linear != 0, "" };
+                char name[64];
+                snprintf(name, sizeof(name), "%s /%d %s", algorithm_name(algorithm), downsample, linear ? "linear" : "sRGB");
+                s.name = name;
+                settings.push_back(s);
+            }
+        }
+    }
+    return settings;
+}
+
+static uint8_t clamp_byte(double v) {
+    return (uint8_t)(v < 0.0 ? 0.0 : (v > 255.0 ? 255.0 : v));
+}
+
+/* Stand-ins for real desktops: flat UI with thin lines and text, smooth photo-like content, noise */
+static std::vector<LoadedImage> synthetic_corpus() {
+    const int32_t w = 640, h = 400;
+    std::vector<LoadedImage> corpus(3);
+    const char* names[] = { "synthetic-ui", "synthetic-photo", "synthetic-noise" };
+    uint32_t seed = 12345;
+    for (size_t c = 0; c < corpus.size(); c++) {
+        LoadedImage& img = corpus[c];
+        img.name = names[c];
+        img.width = w;
+        img.height = h;
+        img.pixels.resize((size_t)w * h * 4);
+        for (int32_t y = 0; y < h; y++) {
+            for (int32_t x = 0; x < w; x++) {
+                uint8_t* p = &img.pixels[((size_t)y * w + x) * 4];
+                seed = seed * 1664525u + 1013904223u;
+                int32_t grain = (int32_t)(seed >> 28) - 8;
+                if (c == 0) {
+                    bool panel = x > 40 && x < 300 && y > 30 && y < 370;
+                    bool line = (y % 48) == 0 || (x % 160) == 0;
+                    bool text = panel && (y % 16) < 9 && ((x * 7 + y) % 11) < 5 && x % 120 < 100;
+                    uint8_t v = line ? 40 : (text ? 20 : (panel ? 245 : 200));
+                    p[0] = v;
+                    p[1] = v;
+                    p[2] = (uint8_t)(panel ? v : 120);
+                } else if (c == 1) {
+                    double fx = x / (double)w, fy = y / (double)h;
+                    p[0] = clamp_byte(128 + 90 * std::sin(fx * 9.0 + fy * 3.0) + grain);
+                    p[1] = clamp_byte(128 + 80 * std::sin(fy * 7.0 - fx * 2.0) + grain);
+                    p[2] = clamp_byte(128 + 100 * std::cos((fx - 0.5) * (fy - 0.3) * 40.0) + grain);
+                } else {
+                    p[0] = (uint8_t)(seed >> 8);
+                    p[1] = (uint8_t)(seed >> 16);
+                    p[2] = (uint8_t)(seed >> 24);
+                }
+                p[3] = 255;
+            }
+        }
+    }
+    return corpus;
+}
+
+static std::vector<float> parse_list(const char* text) {
+    std::vector<float> values;
+    while (*text) {
+        char* end;
+        float v = strtof(text, &end);
+        if (end == text) break;
+        values.push_back(v);
+        text = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    int32_t repeat = 3;
+    std::vector<float> intensities = { 0.1f, 0.3f, 0.6f };
+    const char* csv_path = nullptr;
+    std::vector<LoadedImage> corpus;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+            if (repeat < 1) repeat = 1;
+        } else if (!strcmp(argv[i], "--intensity") && i + 1 < argc) {
+            intensities = parse_list(argv[++i]);
+        } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--repeat N] [--intensity a,b,...] [--csv FILE] [image.ppm|image.pam ...]\n", argv[0]);
+            return 2;
+        } else {
+            LoadedImage img;
+            std::string error;
+            if (load_image(argv[i], &img, &error) != BLUR_SUCCESS) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            corpus.push_back(img);
+        }
+    }
+    if (corpus.empty()) corpus = synthetic_corpus();
+    if (intensities.empty()) intensities.push_back(0.3f);
+
+    FILE* csv = nullptr;
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            fprintf(stderr, "cannot write %s\n", csv_path);
+            return 1;
+        }
+        fprintf(csv, "image,intensity,sigma,algorithm,downsample,transfer,ns_per_pixel,psnr_db,max_error,ssim\n");
+    }
+
+    std::vector<Setting> settings = all_settings();
+    std::vector<Summary> summary(settings.size());
+    printf("%zu images, %zu intensities, %zu settings\n", corpus.size(), intensities.size(), settings.size());
+
+    for (LoadedImage& img : corpus) {
+        BlurSurface src = img.surface();
+        const int64_t pixels = (int64_t)img.width * img.height;
+        std::vector<uint8_t> out_pixels(img.pixels.size()), ref_pixels[2];
+        BlurSurface out = { out_pixels.data(), img.width, img.height, img.width * 4 };
+        CpuBlurMode mode = pixels >= BLUR_STREAMING_THRESHOLD_PIXELS ? CPU_BLUR_STREAMING : CPU_BLUR_FULL_FRAME;
+
+        for (float intensity : intensities) {
+            float sigma = sigma_from_intensity(intensity);
+            for (int32_t t = 0; t < 2; t++) {
+                ref_pixels[t].resize(img.pixels.size());
+                BlurSurface ref = { ref_pixels[t].data(), img.width, img.height, img.width * 4 };
+                reference_blur(&src, &ref, sigma, t == BLUR_TRANSFER_LINEAR);
+            }
+
+            for (size_t i = 0; i < settings.size(); i++) {
+                const Setting& s = settings[i];
+                BlurKernel kernel;
+                build_blur_kernel(sigma, s.algorithm, s.downsample, &kernel);
+                kernel_set_linear_light(&kernel, s.linear);
+                if (s.linear && kernel.transfer != BLUR_TRANSFER_LINEAR) continue;
+
+                double best_ns = 0.0;
+                for (int32_t r = 0; r < repeat; r++) {
+                    high_resolution_clock::time_point start = high_resolution_clock::now();
+                    cpu_blur(&src, &out, &kernel, mode);
+                    double ns = (double)duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+                    if (r == 0 || ns < best_ns) best_ns = ns;
+                }
+
+                BlurSurface ref = { ref_pixels[kernel.transfer].data(), img.width, img.height, img.width * 4 };
+                ImageMetrics m;
+                compare_images(&ref, &out, &m);
+                double psnr = std::isinf(m.psnr) ? QUALITY_PSNR_CAP : m.psnr;
+
+                Summary& sum = summary[i];
+                sum.ns_per_pixel += best_ns / (double)pixels;
+                sum.psnr += psnr;
+                sum.psnr_min = std::min(sum.psnr_min, psnr);
+                sum.max_error = std::max(sum.max_error, m.max_error);
+                sum.ssim += m.ssim;
+                sum.ssim_min = std::min(sum.ssim_min, m.ssim);
+                sum.runs++;
+
+                if (csv) {
+                    fprintf(csv, "%s,%.2f,%.3f,%s,%d,%s,%.3f,%.3f,%d,%.5f\n", img.name.c_str(), intensity, sigma,
+                            algorithm_name(s.algorithm), s.downsample, s.linear ? "linear" : "srgb",
+                            best_ns / (double)pixels, psnr, m.max_error, m.ssim);
+                }
+            }
+        }
+    }
+    if (csv) fclose(csv);
+
+    for (Summary& s : summary) {
+        if (!s.runs) continue;
+        s.ns_per_pixel /= s.runs;
+        s.psnr /= s.runs;
+        s.ssim /= s.runs;
+    }
+    for (size_t i = 0; i < summary.size(); i++) {
+        summary[i].pareto = summary[i].runs > 0;
+        for (size_t j = 0; j < summary.size() && summary[i].pareto; j++) {
+            const Summary& a = summary[i];
+            const Summary& b = summary[j];
+            if (j != i && b.runs && b.ns_per_pixel <= a.ns_per_pixel && b.psnr >= a.psnr &&
+                (b.ns_per_pixel < a.ns_per_pixel || b.psnr > a.psnr)) {
+                summary[i].pareto = false;
+            }
+        }
+    }
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < settings.size(); i++) {
+        if (summary[i].runs) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&summary](size_t a, size_t b) {
+        return summary[a].ns_per_pixel < summary[b].ns_per_pixel;
+    });
+
+    printf("\n  %-22s %9s %9s %9s %7s %8s %8s %5s\n", "setting", "ns/pixel", "PSNR dB", "min dB", "max err", "SSIM",
+           "min SSIM", "runs");
+    for (size_t i : order) {
+        const Summary& s = summary[i];
+        printf("%s %-22s %9.2f %9.2f %9.2f %7d %8.5f %8.5f %5d\n", s.pareto ? "*" : " ", settings[i].name.c_str(),
+               s.ns_per_pixel, s.psnr, s.psnr_min, s.max_error, s.ssim, s.ssim_min, s.runs);
+    }
+    printf("\n* Pareto front: no other setting is both faster and closer to the reference on average.\n");
+    printf("  Linear settings are measured against the linear-light reference, and only where the\n");
+    printf("  kernel is direct (fewer runs); the CSV has every run.\n");
+    return 0;
+}
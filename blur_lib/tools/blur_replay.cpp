@@ -0,0 +1,168 @@
+/*
+ * blur_replay.cpp - Replays a tick recording through the shared tick
+ *
+ * Recordings come from blur_record_start() on a user's desktop. Each tick's
+ * windows, plans and captured frames go back through run_shared_tick() with
+ * the recorded kernels, lanes and backdrop caches, so a slow desktop becomes
+ * a repeatable benchmark. By default ticks run back to back; --realtime
+ * keeps the recorded spacing, which shows whether ticks fit their interval.
+ *
+ * Profiling one recording:
+ *   perf record -g -- blur_replay --repeat 20 slow.blurrec
+ */
+
+#include "executor.h"
+#include "mapped_file.h"
+#include "tick_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s [options] RECORDING\n"
+        "  --realtime      Start each tick at its recorded time instead of at once\n"
+        "  --repeat N      Replay the recording N times (backdrop caches start empty each time)\n"
+        "  --jobs N        Executor workers (0 = one per core, less one)\n"
+        "  --serial        Blur on the calling thread only\n"
+        "  --verbose       One line per tick\n",
+        argv0);
+}
+
+static bool parse_uint(const char* text, uint32_t* out) {
+    char* end;
+    unsigned long v = strtoul(text, &end, 0);
+    if (end == text || *end) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t i = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+int main(int argc, char* argv[]) {
+    bool realtime = false, serial = false, verbose = false;
+    uint32_t jobs = 0, repeat = 1;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (!strcmp(a, "--realtime")) {
+            realtime = true;
+        } else if (!strcmp(a, "--repeat") && v) {
+            ok = parse_uint(v, &repeat) && repeat > 0;
+            i++;
+        } else if (!strcmp(a, "--jobs") && v) {
+            ok = parse_uint(v, &jobs);
+            i++;
+        } else if (!strcmp(a, "--serial")) {
+            serial = true;
+        } else if (!strcmp(a, "--verbose")) {
+            verbose = true;
+        } else if (a[0] != '-' && !path) {
+            path = a;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    MappedFile file;
+    std::string error;
+    TickReader reader;
+    if (file.open_read(path, &error) != BLUR_SUCCESS) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (reader.open(file.data(), file.size()) != BLUR_SUCCESS) {
+        fprintf(stderr, "%s: not a tick recording\n", path);
+        return 1;
+    }
+
+    if (!serial) executor_start(jobs);
+    std::vector<double> tick_ms;
+    TickStats total = TickStats();
+    int64_t windows = 0;
+    double late_ms = 0.0;
+    ReplayTick tick;
+    int32_t rc = BLUR_SUCCESS;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for (uint32_t r = 0; r < repeat && rc == BLUR_SUCCESS; r++) {
+        reader.open(file.data(), file.size());
+        steady_clock::time_point pass_start = steady_clock::now();
+        for (uint32_t n = 0;; n++) {
+            bool end = false;
+            rc = reader.next_tick(&tick, &end);
+            if (rc != BLUR_SUCCESS) {
+                fprintf(stderr, "%s: malformed or truncated after %u ticks\n", path, n);
+                break;
+            }
+            if (end) break;
+
+            if (realtime) {
+                steady_clock::time_point due = pass_start + microseconds(tick.time_us);
+                if (steady_clock::now() < due) {
+                    std::this_thread::sleep_until(due);
+                } else {
+                    late_ms += duration<double, std::milli>(steady_clock::now() - due).count();
+                }
+            }
+
+            ReplaySource source(&tick);
+            TickStats ts;
+            high_resolution_clock::time_point t0 = high_resolution_clock::now();
+            rc = run_shared_tick(tick.windows.data(), tick.windows.size(), &source, &ts);
+            double ms = duration<double, std::milli>(high_resolution_clock::now() - t0).count();
+            if (rc != BLUR_SUCCESS) {
+                fprintf(stderr, "Tick %u failed with error %d\n", n, rc);
+                break;
+            }
+
+            tick_ms.push_back(ms);
+            windows += (int64_t)tick.windows.size();
+            total.pixels_captured += ts.pixels_captured;
+            total.pixels_blur_computed += ts.pixels_blur_computed;
+            total.pixels_reused += ts.pixels_reused;
+            total.frames += ts.frames;
+            if (verbose) {
+                printf("tick %5u  t=%9.1f ms  %2zu windows  %2d frames  %9lld blurred  %8.2f ms\n", n,
+                       tick.time_us / 1000.0, tick.windows.size(), ts.frames,
+                       (long long)ts.pixels_blur_computed, ms);
+            }
+        }
+    }
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+    uint32_t workers = executor_workers();
+    executor_stop();
+    if (rc != BLUR_SUCCESS) return 1;
+
+    std::vector<double> sorted = tick_ms;
+    std::sort(sorted.begin(), sorted.end());
+    printf("%zu ticks, %lld windows, %d frames: %.1f ms (%s)\n", tick_ms.size(), (long long)windows,
+           total.frames, seconds * 1000.0, serial ? "serial" : (std::to_string(workers) + " workers").c_str());
+    printf("tick ms: P50 %.2f  P99 %.2f  max %.2f\n", percentile(sorted, 0.50), percentile(sorted, 0.99),
+           sorted.empty() ? 0.0 : sorted.back());
+    printf("pixels: %lld captured, %lld blurred, %lld reused\n", (long long)total.pixels_captured,
+           (long long)total.pixels_blur_computed, (long long)total.pixels_reused);
+    if (realtime) printf("ticks started late by %.1f ms in total\n", late_ms);
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * blur_service_load.cpp - Load test for the shared-memory blur service
+ *
+ * Runs a service host over a synthetic desktop and forks client processes
+ * that each blur several overlapping windows through it, reading every frame
+ * and optionally dragging a window around. Reports what the host's shared
+ * ticks saved and how long client commands took to come back, e.g.:
+ *   blur_service_load --clients 8 --windows 4 --seconds 10 --drag
+ */
+
+#include "blur_service.h"
+#include "executor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DESKTOP_WIDTH  2560
+#define DESKTOP_HEIGHT 1440
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --clients N     Client processes (default 4)\n"
+        "  --windows N     Windows per client (default 2)\n"
+        "  --seconds N     Run time (default 5)\n"
+        "  --size WxH      Window size (default 480x320)\n"
+        "  --hz N          Refresh rate of every window (default 30)\n"
+        "  --drag          Each client keeps moving its first window\n"
+        "  --jobs N        Host executor workers (0 = one per core, less one)\n"
+        "  --serial        Blur on the host's tick thread only\n",
+        argv0);
+}
+
+static bool parse_uint(const char* text, uint32_t* out) {
+    char* end;
+    unsigned long v = strtoul(text, &end, 0);
+    if (end == text || *end) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static bool parse_size(const char* text, int32_t* w, int32_t* h) {
+    return sscanf(text, "%dx%d", w, h) == 2 && *w > 0 && *h > 0 && *w <= DESKTOP_WIDTH && *h <= DESKTOP_HEIGHT;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t i = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+/* A fixed desktop, captured by copying rows */
+class DesktopSource : public CaptureSource {
+public:
+    DesktopSource() : m_desktop((size_t)DESKTOP_WIDTH * DESKTOP_HEIGHT * 4) {
+        for (int32_t y = 0; y < DESKTOP_HEIGHT; y++) {
+            for (int32_t x = 0; x < DESKTOP_WIDTH; x++) {
+                uint8_t* p = &m_desktop[((size_t)y * DESKTOP_WIDTH + x) * 4];
+                p[0] = (uint8_t)(x * 255 / DESKTOP_WIDTH);
+                p[1] = (uint8_t)(y * 255 / DESKTOP_HEIGHT);
+                p[2] = (uint8_t)(((x / 40) + (y / 40)) % 2 ? 220 : 30);
+                p[3] = 255;
+            }
+        }
+    }
+
+    int32_t begin_frame(const RegionRect& bounds, BlurSurface* frame) override {
+        m_bounds = bounds;
+        m_frame.assign((size_t)rect_area(bounds) * 4, 0);
+        BlurSurface f = { m_frame.data(), bounds.right - bounds.left, bounds.bottom - bounds.top,
+                          (bounds.right - bounds.left) * 4 };
+        m_surface = *frame = f;
+        return BLUR_SUCCESS;
+    }
+
+    void capture(const RegionRect& area) override {
+        RegionRect screen = { 0, 0, DESKTOP_WIDTH, DESKTOP_HEIGHT };
+        RegionRect r = rect_intersect(area, screen);
+        for (int32_t y = r.top; y < r.bottom; y++) {
+            memcpy(m_surface.pixels + (size_t)(y - m_bounds.top) * m_surface.stride + (size_t)(r.left - m_bounds.left) * 4,
+                   &m_desktop[((size_t)y * DESKTOP_WIDTH + r.left) * 4], (size_t)(r.right - r.left) * 4);
+        }
+    }
+
+    void end_frame() override {}
+
+private:
+    std::vector<uint8_t> m_desktop;
+    std::vector<uint8_t> m_frame;
+    RegionRect m_bounds;
+    BlurSurface m_surface;
+};
+
+struct LoadConfig {
+    uint32_t clients = 4;
+    uint32_t windows = 2;
+    uint32_t seconds = 5;
+    int32_t  width = 480;
+    int32_t  height = 320;
+    uint32_t hz = 30;
+    bool     drag = false;
+};
+
+/* What a client process reports back through its pipe */
+struct ClientResult {
+    int32_t  status;            /* BLUR_* of the first failure, or BLUR_SUCCESS */
+    uint32_t commands;
+    uint32_t frames;            /* New frames read */
+    double   p50_ms, p99_ms, max_ms;    /* Command round trips */
+};
+
+static RegionRect window_rect(const LoadConfig& cfg, uint32_t client, uint32_t window, int32_t shift) {
+    int32_t span_x = DESKTOP_WIDTH - cfg.width, span_y = DESKTOP_HEIGHT - cfg.height;
+    int32_t x = span_x ? (int32_t)((client * 97 + window * 211 + (uint32_t)shift) % (uint32_t)(span_x + 1)) : 0;
+    int32_t y = span_y ? (int32_t)((client * 53 + window * 131) % (uint32_t)(span_y + 1)) : 0;
+    RegionRect r = { x, y, x + cfg.width, y + cfg.height };
+    return r;
+}
+
+static ClientResult run_client(const char* name, const LoadConfig& cfg, uint32_t index) {
+    ClientResult result = ClientResult();
+    ServiceClient client;
+    int32_t rc = BLUR_NOT_INITIALIZED;
+    for (int i = 0; i < 500 && rc == BLUR_NOT_INITIALIZED; i++) {
+        rc = client.attach(name);
+        if (rc == BLUR_NOT_INITIALIZED) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (rc != BLUR_SUCCESS) {
+        result.status = rc;
+        return result;
+    }
+
+    EffectParams_V2 params = {};
+    params.struct_version = 2;
+    params.intensity = 0.5f;
+    params.color_argb = 0x20FFFFFF;
+    params.max_refresh_hz = cfg.hz;
+
+    std::vector<double> ms;
+    std::vector<uint32_t> slots(cfg.windows);
+    std::vector<uint64_t> frames(cfg.windows, 0);
+    std::vector<uint8_t> pixels((size_t)cfg.width * cfg.height * 4);
+    BlurSurface dst = { pixels.data(), cfg.width, cfg.height, cfg.width * 4 };
+    uint64_t base = (uint64_t)(index + 1) << 32;
+
+    auto timed = [&](int32_t status, std::chrono::steady_clock::time_point t0) {
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        result.commands++;
+        if (status != BLUR_SUCCESS && result.status == BLUR_SUCCESS) result.status = status;
+    };
+
+    for (uint32_t w = 0; w < cfg.windows; w++) {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        timed(client.apply(base + w, window_rect(cfg, index, w, 0), (const EffectParams*)&params, 5000, &slots[w]), t0);
+    }
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(cfg.seconds);
+    std::chrono::steady_clock::time_point next_move = std::chrono::steady_clock::now();
+    int32_t shift = 0;
+    while (std::chrono::steady_clock::now() < end && result.status == BLUR_SUCCESS) {
+        for (uint32_t w = 0; w < cfg.windows; w++) {
+            if (client.read_frame(base + w, slots[w], &dst, &frames[w]) == BLUR_SUCCESS) result.frames++;
+        }
+        if (cfg.drag && std::chrono::steady_clock::now() >= next_move) {
+            shift += 8;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            timed(client.move(base, window_rect(cfg, index, 0, shift), 5000), t0);
+            next_move = t0 + std::chrono::milliseconds(16);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    for (uint32_t w = 0; w < cfg.windows; w++) {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        timed(client.clear(base + w, 5000), t0);
+    }
+    client.detach();
+
+    std::sort(ms.begin(), ms.end());
+    result.p50_ms = percentile(ms, 0.50);
+    result.p99_ms = percentile(ms, 0.99);
+    result.max_ms = ms.empty() ? 0.0 : ms.back();
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig cfg;
+    bool serial = false;
+    uint32_t jobs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (!strcmp(a, "--clients") && v) {
+            ok = parse_uint(v, &cfg.clients) && cfg.clients > 0 && cfg.clients <= SERVICE_MAX_CLIENTS;
+            i++;
+        } else if (!strcmp(a, "--windows") && v) {
+            ok = parse_uint(v, &cfg.windows) && cfg.windows > 0 && cfg.windows <= SERVICE_MAX_SLOTS;
+            i++;
+        } else if (!strcmp(a, "--seconds") && v) {
+            ok = parse_uint(v, &cfg.seconds) && cfg.seconds > 0;
+            i++;
+        } else if (!strcmp(a, "--size") && v) {
+            ok = parse_size(v, &cfg.width, &cfg.height);
+            i++;
+        } else if (!strcmp(a, "--hz") && v) {
+            ok = parse_uint(v, &cfg.hz) && cfg.hz > 0 && cfg.hz <= BLUR_MAX_REFRESH_HZ;
+            i++;
+        } else if (!strcmp(a, "--drag")) {
+            cfg.drag = true;
+        } else if (!strcmp(a, "--jobs") && v) {
+            ok = parse_uint(v, &jobs);
+            i++;
+        } else if (!strcmp(a, "--serial")) {
+            serial = true;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::string name = "blur_service_load_" + std::to_string(getpid());
+    DesktopSource desktop;
+    ServiceHost host;
+    ServiceHostOptions options;
+    options.max_clients = cfg.clients;
+    options.slots_per_client = cfg.windows;
+    options.slot_bytes = (uint64_t)cfg.width * cfg.height * 4;
+    int32_t rc = host.start(name.c_str(), options, &desktop);
+    if (rc != BLUR_SUCCESS) {
+        fprintf(stderr, "Cannot start the service host (error %d)\n", rc);
+        return 1;
+    }
+
+    /* Clients fork before the executor starts any threads */
+    std::vector<pid_t> pids;
+    std::vector<int> pipes;
+    for (uint32_t c = 0; c < cfg.clients; c++) {
+        int fds[2];
+        if (pipe(fds) != 0) break;
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            ClientResult r = run_client(name.c_str(), cfg, c);
+            ssize_t written = write(fds[1], &r, sizeof(r));
+            _exit(written == (ssize_t)sizeof(r) ? 0 : 1);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            break;
+        }
+        pids.push_back(pid);
+        pipes.push_back(fds[0]);
+    }
+    if (!serial) executor_start(jobs);
+
+    /* The host loop: tick when a window is due, otherwise keep answering commands */
+    std::vector<double> tick_ms;
+    size_t running = pids.size();
+    std::vector<bool> done(pids.size(), false);
+    while (running) {
+        uint64_t now = service_now_us();
+        uint64_t before = host.stats().ticks;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        host.tick(now);
+        if (host.stats().ticks != before) {
+            tick_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        }
+        for (size_t i = 0; i < pids.size(); i++) {
+            if (!done[i] && waitpid(pids[i], nullptr, WNOHANG) == pids[i]) {
+                done[i] = true;
+                running--;
+            }
+        }
+        uint64_t due = host.next_due_us();
+        uint64_t wait = due > now ? std::min<uint64_t>(due - now, 500) : 0;
+        if (wait) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+    }
+    host.poll(service_now_us());
+    uint32_t workers = executor_workers();
+    executor_stop();
+
+    std::vector<double> lat_p50, lat_p99;
+    double lat_max = 0.0;
+    uint64_t commands = 0, frames = 0;
+    int failures = 0;
+    for (size_t i = 0; i < pipes.size(); i++) {
+        ClientResult r;
+        if (read(pipes[i], &r, sizeof(r)) != (ssize_t)sizeof(r)) {
+            fprintf(stderr, "Client %zu reported nothing\n", i);
+            failures++;
+        } else {
+            if (r.status != BLUR_SUCCESS) {
+                fprintf(stderr, "Client %zu failed with error %d\n", i, r.status);
+                failures++;
+            }
+            commands += r.commands;
+            frames += r.frames;
+            lat_p50.push_back(r.p50_ms);
+            lat_p99.push_back(r.p99_ms);
+            lat_max = std::max(lat_max, r.max_ms);
+        }
+        close(pipes[i]);
+    }
+
+    ServiceHostStats st = host.stats();
+    std::sort(tick_ms.begin(), tick_ms.end());
+    std::sort(lat_p50.begin(), lat_p50.end());
+    std::sort(lat_p99.begin(), lat_p99.end());
+    printf("%u clients x %u windows of %dx%d at %u Hz%s, %u s (%s)\n", cfg.clients, cfg.windows, cfg.width,
+           cfg.height, cfg.hz, cfg.drag ? ", dragging" : "", cfg.seconds,
+           serial ? "serial" : (std::to_string(workers) + " workers").c_str());
+    printf("host: %llu ticks, %llu frames published, %llu commands (%llu rejected), %llu replies dropped\n",
+           (unsigned long long)st.ticks, (unsigned long long)st.frames, (unsigned long long)st.commands,
+           (unsigned long long)st.rejected, (unsigned long long)st.replies_dropped);
+    printf("tick ms: P50 %.2f  P99 %.2f  max %.2f\n", percentile(tick_ms, 0.50), percentile(tick_ms, 0.99),
+           tick_ms.empty() ? 0.0 : tick_ms.back());
+    printf("pixels: %lld of %lld captured, %lld of %lld blurred, %lld reused\n",
+           (long long)st.shared.pixels_captured, (long long)st.shared.pixels_requested,
+           (long long)st.shared.pixels_blur_computed, (long long)st.shared.pixels_blur_requested,
+           (long long)st.shared.pixels_reused);
+    printf("clients: %llu commands, %llu frames read; round trip ms: median client P50 %.2f, worst P99 %.2f, max %.2f\n",
+           (unsigned long long)commands, (unsigned long long)frames, percentile(lat_p50, 0.5),
+           lat_p99.empty() ? 0.0 : lat_p99.back(), lat_max);
+    return failures ? 1 : 0;
+}
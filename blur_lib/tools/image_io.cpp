@@ -0,0 +1,139 @@
+/*
+ * image_io.cpp - Image files and streams for the offline tools
+ */
+
+#include "image_io.h"
+#include "mapped_file.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+static int32_t fail(std::string* error, const std::string& why) {
+    if (error) *error = why;
+    return BLUR_INVALID_PARAMS;
+}
+
+/* Header tokenizer over mapped bytes */
+struct HeaderReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+
+    /* Next whitespace-separated token, skipping # comments; consumes the one whitespace byte after it */
+    bool token(std::string* out) {
+        for (;;) {
+            while (pos < size && isspace(data[pos])) pos++;
+            if (pos >= size || data[pos] != '#') break;
+            while (pos < size && data[pos] != '\n') pos++;
+        }
+        size_t start = pos;
+        while (pos < size && !isspace(data[pos])) pos++;
+        out->assign((const char*)data + start, pos - start);
+        if (pos < size) pos++;
+        return !out->empty();
+    }
+
+    bool number(int32_t* value) {
+        std::string t;
+        if (!token(&t) || t.size() > 8) return false;
+        char* end;
+        long v = strtol(t.c_str(), &end, 10);
+        if (*end || v < 0) return false;
+        *value = (int32_t)v;
+        return true;
+    }
+};
+
+static bool read_frame_header(HeaderReader* r, uint32_t* format, ImageFrame* frame) {
+    std::string magic;
+    frame->header = r->pos;
+    if (!r->token(&magic)) return false;
+    int32_t maxval = 0;
+    if (magic == "P6") {
+        *format = IMAGE_FORMAT_PPM;
+        frame->depth = 3;
+        if (!r->number(&frame->width) || !r->number(&frame->height) || !r->number(&maxval)) return false;
+    } else if (magic == "P7") {
+        *format = IMAGE_FORMAT_PAM;
+        frame->depth = 0;
+        std::string key, type;
+        for (;;) {
+            if (!r->token(&key)) return false;
+            if (key == "ENDHDR") break;
+            bool ok = key == "WIDTH" ? r->number(&frame->width)
+                    : key == "HEIGHT" ? r->number(&frame->height)
+                    : key == "DEPTH" ? r->number(&frame->depth)
+                    : key == "MAXVAL" ? r->number(&maxval)
+                    : key == "TUPLTYPE" ? r->token(&type)
+                    : false;
+            if (!ok) return false;
+        }
+    } else {
+        return false;
+    }
+    frame->pixels = r->pos;
+    return maxval == 255 && (frame->depth == 3 || frame->depth == 4);
+}
+
+int32_t parse_netpbm_stream(const uint8_t* data, size_t size, ImageStream* out, std::string* error) {
+    HeaderReader r = { data, size, 0 };
+    out->frames.clear();
+    while (r.pos < size) {
+        /* Trailing whitespace after the last image is allowed */
+        size_t rest = r.pos;
+        while (rest < size && isspace(data[rest])) rest++;
+        if (rest == size) break;
+
+        uint32_t format = IMAGE_FORMAT_PPM;
+        ImageFrame frame = {};
+        if (!read_frame_header(&r, &format, &frame) || frame.width <= 0 || frame.height <= 0) {
+            return fail(error, "not an 8-bit RGB or RGBA binary PPM or PAM image");
+        }
+        if (!out->frames.empty() && format != out->format) return fail(error, "PPM and PAM images mixed in one stream");
+        if (frame.bytes() > size - frame.pixels) return fail(error, "truncated pixel data");
+        out->format = format;
+        out->frames.push_back(frame);
+        r.pos = frame.pixels + frame.bytes();
+    }
+    if (out->frames.empty()) return fail(error, "no image");
+    return BLUR_SUCCESS;
+}
+
+int32_t parse_raw_stream(size_t size, int32_t width, int32_t height, ImageStream* out, std::string* error) {
+    if (width <= 0 || height <= 0) return fail(error, "raw frames need a width and height");
+    size_t frame_bytes = (size_t)width * height * 4;
+    if (size == 0 || size % frame_bytes) return fail(error, "file size is not a whole number of raw frames");
+    out->format = IMAGE_FORMAT_RAW;
+    out->frames.clear();
+    for (size_t offset = 0; offset < size; offset += frame_bytes) {
+        ImageFrame frame = { offset, offset, width, height, 4 };
+        out->frames.push_back(frame);
+    }
+    return BLUR_SUCCESS;
+}
+
+int32_t load_image(const char* path, LoadedImage* out, std::string* error) {
+    MappedFile file;
+    if (file.open_read(path, error) != BLUR_SUCCESS) return BLUR_INVALID_PARAMS;
+    ImageStream stream;
+    if (parse_netpbm_stream(file.data(), file.size(), &stream, error) != BLUR_SUCCESS) {
+        if (error) *error = std::string(path) + ": " + *error;
+        return BLUR_INVALID_PARAMS;
+    }
+
+    const ImageFrame& f = stream.frames[0];
+    out->name = path;
+    out->width = f.width;
+    out->height = f.height;
+    out->pixels.resize((size_t)f.width * f.height * 4);
+    const uint8_t* src = file.data() + f.pixels;
+    for (size_t i = 0; i < (size_t)f.width * f.height; i++) {
+        const uint8_t* s = src + i * f.depth;
+        uint8_t* d = &out->pixels[i * 4];
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = s[0];
+        d[3] = f.depth == 4 ? s[3] : 255;
+    }
+    return BLUR_SUCCESS;
+}
@@ -0,0 +1,57 @@
+/*
+ * image_io.h - Image files and streams for the offline tools
+ *
+ * Understands binary PPM (P6) and PAM (P7, RGB or RGB_ALPHA) with 8-bit
+ * samples, including several images concatenated into one file, and
+ * headerless raw BGRA streams of equally sized frames. Streams are parsed
+ * in place, so the pixels can be used straight from a mapping.
+ */
+
+#ifndef BLUR_TOOLS_IMAGE_IO_H
+#define BLUR_TOOLS_IMAGE_IO_H
+
+#include "cpu_blur.h"
+#include <string>
+#include <vector>
+
+#define IMAGE_FORMAT_PPM 0
+#define IMAGE_FORMAT_PAM 1
+#define IMAGE_FORMAT_RAW 2      /* BGRA, no header */
+
+struct ImageFrame {
+    size_t  header;     /* Offset of the frame's header (== pixels for raw frames) */
+    size_t  pixels;     /* Offset of its first sample */
+    int32_t width;
+    int32_t height;
+    int32_t depth;      /* Samples per pixel: 3 (RGB) or 4 (RGBA, or BGRA for raw) */
+
+    size_t bytes() const { return (size_t)width * height * depth; }
+};
+
+struct ImageStream {
+    uint32_t format;
+    std::vector<ImageFrame> frames;
+};
+
+/* Every image in a PPM or PAM file; BLUR_INVALID_PARAMS with *error set if malformed */
+int32_t parse_netpbm_stream(const uint8_t* data, size_t size, ImageStream* out, std::string* error);
+
+/* Frames of width x height BGRA filling size bytes exactly */
+int32_t parse_raw_stream(size_t size, int32_t width, int32_t height, ImageStream* out, std::string* error);
+
+struct LoadedImage {
+    std::string          name;
+    std::vector<uint8_t> pixels;    /* BGRA8, stride width * 4 */
+    int32_t              width;
+    int32_t              height;
+
+    BlurSurface surface() {
+        BlurSurface s = { pixels.data(), width, height, width * 4 };
+        return s;
+    }
+};
+
+/* First image of a PPM or PAM file in BGRA; images without alpha come back opaque */
+int32_t load_image(const char* path, LoadedImage* out, std::string* error);
+
+#endif /* BLUR_TOOLS_IMAGE_IO_H */
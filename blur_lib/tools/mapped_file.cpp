@@ -0,0 +1,71 @@
+/*
+ * mapped_file.cpp - Memory-mapped files for the offline tools (POSIX)
+ */
+
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int32_t fail(std::string* error, const char* path, const char* what) {
+    if (error) *error = std::string(path) + ": " + what + " (" + strerror(errno) + ")";
+    return BLUR_INVALID_PARAMS;
+}
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_writable(false) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+int32_t MappedFile::open_read(const char* path, std::string* error) {
+    close();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return fail(error, path, "cannot open");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        if (error) *error = std::string(path) + ": empty or unreadable";
+        return BLUR_INVALID_PARAMS;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return fail(error, path, "cannot map");
+
+    /* Frames are read front to back */
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    m_data = (uint8_t*)p;
+    m_size = (size_t)st.st_size;
+    m_writable = false;
+    return BLUR_SUCCESS;
+}
+
+int32_t MappedFile::create(const char* path, size_t size, std::string* error) {
+    close();
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return fail(error, path, "cannot create");
+    if (ftruncate(fd, (off_t)size) != 0) {
+        ::close(fd);
+        return fail(error, path, "cannot size");
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return fail(error, path, "cannot map");
+
+    m_data = (uint8_t*)p;
+    m_size = size;
+    m_writable = true;
+    return BLUR_SUCCESS;
+}
+
+void MappedFile::close() {
+    if (!m_data) return;
+    if (m_writable) msync(m_data, m_size, MS_SYNC);
+    munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_writable = false;
+}
@@ -0,0 +1,41 @@
+/*
+ * mapped_file.h - Memory-mapped files for the offline tools (POSIX)
+ *
+ * Inputs are mapped read-only and blurred straight from the page cache;
+ * outputs are created at their final size and written through a shared
+ * mapping, so no frame is ever read into or written from a private copy.
+ */
+
+#ifndef BLUR_TOOLS_MAPPED_FILE_H
+#define BLUR_TOOLS_MAPPED_FILE_H
+
+#include "blur_lib.h"
+#include <stddef.h>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /* Maps an existing file read-only; BLUR_INVALID_PARAMS with *error set on failure */
+    int32_t open_read(const char* path, std::string* error);
+
+    /* Creates (or truncates) a file of size zero-filled bytes and maps it writable */
+    int32_t create(const char* path, size_t size, std::string* error);
+
+    /* Unmaps; a writable mapping is flushed to the file first */
+    void close();
+
+    uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    uint8_t* m_data;
+    size_t   m_size;
+    bool     m_writable;
+};
+
+#endif /* BLUR_TOOLS_MAPPED_FILE_H */
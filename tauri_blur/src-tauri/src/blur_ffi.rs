@@ -16,7 +16,15 @@ pub const BLUR_CAP_SETWINDOWCOMPOSITION: u32 = 0x0001;
 pub const BLUR_CAP_DWM_BLUR: u32 = 0x0002;
 pub const BLUR_CAP_COLOR_CONTROL: u32 = 0x0008;
 
-/// EffectParams structure matching C definition
+/// Blur algorithms (EffectParams_V2::algorithm)
+pub const BLUR_ALGORITHM_EXACT: u32 = 0;
+pub const BLUR_ALGORITHM_BOX: u32 = 1;
+pub const BLUR_ALGORITHM_PYRAMID: u32 = 2;
+pub const BLUR_ALGORITHM_IIR: u32 = 3;
+pub const BLUR_ALGORITHM_AUTO: u32 = 4;
+
+/// EffectParams structure matching the C EffectParams_V2 definition.
+/// The first seven fields are the V1 layout at the same offsets.
 #[repr(C, packed)]
 #[derive(Clone, Copy)]
 pub struct EffectParams {
@@ -27,22 +35,37 @@ pub struct EffectParams {
     pub animation_ms: u32,
     pub reserved_flags: u32,
     pub reserved_padding: [u8; 4],
+    pub algorithm: u32,
+    pub downsample: u32,
+    pub max_refresh_hz: u32,
+    pub worker_threads: u32,
+    pub frame_budget_us: u32,
+    pub reserved_v2: [u8; 12],
 }
 
 impl Default for EffectParams {
     fn default() -> Self {
         Self {
-            struct_version: 1,
+            struct_version: 2,
             intensity: 1.0,
             color_argb: 0x80000000,
             animate: 0,
             animation_ms: 0,
             reserved_flags: 0,
             reserved_padding: [0; 4],
+            algorithm: BLUR_ALGORITHM_EXACT,
+            downsample: 0,
+            max_refresh_hz: 0,
+            worker_threads: 0,
+            frame_budget_us: 0,
+            reserved_v2: [0; 12],
         }
     }
 }
 
+// Must match sizeof(EffectParams_V2) in blur_lib.h
+const _: () = assert!(std::mem::size_of::<EffectParams>() == 57);
+
 #[cfg(windows)]
 #[link(name = "blur_lib")]
 extern "C" {
@@ -86,14 +109,18 @@ pub fn shutdown() {
 #[cfg(windows)]
 pub fn apply_blur(hwnd: usize, intensity: f32, color: u32) -> Result<(), String> {
     let params = EffectParams {
-        struct_version: 1,
         intensity,
         color_argb: color,
         ..Default::default()
     };
-    
+    apply_blur_with_params(hwnd, &params)
+}
+
+/// Safe wrapper for apply_blur_to_window with every V2 knob
+#[cfg(windows)]
+pub fn apply_blur_with_params(hwnd: usize, params: &EffectParams) -> Result<(), String> {
     unsafe {
-        let result = blur_apply_to_window(hwnd, &params, 0);
+        let result = blur_apply_to_window(hwnd, params, 0);
         if result == BLUR_SUCCESS {
             Ok(())
         } else if result == BLUR_ALREADY_APPLIED {